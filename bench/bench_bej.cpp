@@ -0,0 +1,912 @@
+/**
+ * @file bench_bej.cpp
+ * @brief Performance benchmarks for BEJparser using Google Benchmark
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <string>
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_escape.h"
+#include "../src/bej_compiled.h"
+#include "../src/bej_stream.h"
+#include "../src/bej_encode.h"
+#include "../src/bej_tree.h"
+#include "../src/bej_query.h"
+#include "../src/bej_validate.h"
+#include "../src/bej_real.h"
+#include "../src/bej_output.h"
+#include "../src/bej_registry.h"
+}
+
+#ifdef BEJ_BENCH_JSONCPP
+#include <json/json.h>
+#endif
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static std::vector<uint8_t>
+load_example(const char *name)
+{
+    std::string path = std::string(BEJ_EXAMPLES_DIR) + "/" + name;
+    std::vector<uint8_t> data;
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    return data;
+}
+
+static size_t
+count_nodes(const bej_node_t *node)
+{
+    size_t n = 1;
+    for (size_t i = 0; i < bej_node_count(node); i++)
+        n += count_nodes(bej_node_at(node, i));
+    return n;
+}
+
+// number of SFLV tuples in the document, for the tuples/s counters
+static size_t
+count_tuples(bej_dictionary_context_t *dict, const std::vector<uint8_t> &bej_data)
+{
+    bej_tree_t tree;
+    size_t n = 0;
+    if (!bej_tree_decode(&tree, dict, bej_data.data(), bej_data.size()))
+        n = count_nodes(tree.root);
+    bej_tree_free(&tree);
+    return n;
+}
+
+/* PCIeDevice document with `conditions` entries in Status/Conditions, built through the
+*  encoder so that it is as valid as the examples
+*/
+static std::vector<uint8_t>
+make_conditions_document(bej_dictionary_context_t *dict, size_t conditions)
+{
+    std::string json = "{\"Id\":\"1\",\"Name\":\"GPU\",\"Status\":{\"Health\":\"Warning\",\"Conditions\":[";
+    for (size_t i = 0; i < conditions; i++) {
+        if (i)
+            json += ",";
+        json += "{\"MessageId\":\"Base.1.0.LinkDegraded\",\"Message\":\"Link " + std::to_string(i)
+              + " retrained at reduced width\",\"Severity\":\"Warning\",\"Timestamp\":\"2025-01-01T00:00:00Z\"}";
+    }
+    json += "]}}";
+
+    std::vector<uint8_t> doc;
+    bej_encoder_t enc;
+    if (!bej_encoder_init(&enc, dict)) {
+        if (!bej_encode(&enc, json.data(), json.size()))
+            doc.assign(enc.out.data, enc.out.data + enc.out.len);
+        bej_encoder_free(&enc);
+    }
+    return doc;
+}
+
+/* (child_offset, child_count, sequence) of every property reachable in the dictionary,
+*  i.e. one lookup for every SFLV a document using all of the schema would carry
+*/
+struct lookup_t {
+    uint16_t child_offset;
+    uint16_t child_count;
+    uint16_t sequence;
+};
+
+static std::vector<lookup_t>
+collect_lookups(bej_dictionary_context_t *dict)
+{
+    std::vector<lookup_t> lookups;
+
+    for (uint16_t i = 0; i < dict->entry_count; i++) {
+        bej_dict_entry_t parent = dict->index.entries[i];
+        for (uint16_t k = 0; k < parent.child_count; k++) {
+            size_t off = parent.child_offset + k * BEJ_DICT_ENTRY_SIZE;
+            if (off + BEJ_DICT_ENTRY_SIZE > dict->data_size)
+                break;
+            lookups.push_back({parent.child_offset, parent.child_count,
+                               (uint16_t)READ_U16_LE(dict->data, off + 1)});
+        }
+    }
+
+    return lookups;
+}
+
+static void
+run_lookups(benchmark::State &state, bej_dictionary_context_t *dict,
+            const std::vector<lookup_t> &lookups)
+{
+    bej_dict_entry_t entry;
+
+    for (auto _ : state) {
+        for (const lookup_t &l : lookups) {
+            uint8_t rc = bej_dict_lookup(dict, l.child_offset, l.child_count, l.sequence, &entry);
+            benchmark::DoNotOptimize(rc);
+            benchmark::DoNotOptimize(entry);
+        }
+    }
+    state.counters["lookups/s"] = benchmark::Counter(
+        (double)lookups.size() * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// ============================================================================
+// NNINT reads, every value encoded in the given number of bytes
+// ============================================================================
+
+static void
+BM_ReadNNINT(benchmark::State &state)
+{
+    const size_t count = 1024;
+    uint8_t width = (uint8_t)state.range(0);
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < count; i++) {
+        data.push_back(width);
+        for (uint8_t b = 0; b < width; b++)
+            data.push_back((uint8_t)(i >> (8 * b)));
+    }
+
+    uint32_t value = 0U;
+    for (auto _ : state) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            bej_read_nnint(data.data(), &offset, data.size(), &value);
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetBytesProcessed((int64_t)data.size() * state.iterations());
+    state.counters["nnints/s"] = benchmark::Counter((double)count * state.iterations(),
+                                                    benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ReadNNINT)->ArgName("bytes")->DenseRange(1, 4);
+
+// ============================================================================
+// Dictionary lookup: linear scan (no index) vs sequence index
+// ============================================================================
+
+static void
+BM_DictLookup_Memory(benchmark::State &state)
+{
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    bej_dictionary_context_t dict;
+    if (data.empty() || bej_parse_dict(&dict, data.data(), data.size()) || !dict.index.entries) {
+        state.SkipWithError("Failed to load Memory_v1.bin");
+        return;
+    }
+
+    std::vector<lookup_t> lookups = collect_lookups(&dict);
+
+    if (state.range(0)) {
+        run_lookups(state, &dict, lookups);
+    } else {
+        bej_dictionary_context_t plain = dict;
+        memset(&plain.index, 0, sizeof(plain.index));
+        run_lookups(state, &plain, lookups);
+    }
+
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_DictLookup_Memory)->ArgName("indexed")->Arg(0)->Arg(1);
+
+// same lookups through the decoder context, the way decode_bej_sflv() does them
+static void
+BM_FindDictEntry_Memory(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load Memory_v1.bin");
+        return;
+    }
+
+    std::vector<lookup_t> lookups = collect_lookups(&dict);
+    bej_context_t ctx;
+    bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+    bej_dict_entry_t entry;
+    for (auto _ : state) {
+        for (const lookup_t &l : lookups) {
+            ctx.parent_child_offset[0] = l.child_offset;
+            ctx.parent_child_count[0] = l.child_count;
+            benchmark::DoNotOptimize(bej_find_dict_entry(&ctx, &ctx.schema_dict, l.sequence, &entry));
+        }
+    }
+    state.counters["lookups/s"] = benchmark::Counter(
+        (double)lookups.size() * state.iterations(), benchmark::Counter::kIsRate);
+
+    bej_free_context(&ctx);
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_FindDictEntry_Memory);
+
+// ============================================================================
+// Dictionary startup: parse + index build vs compiled dictionary
+// ============================================================================
+
+static void
+BM_DictLoad_Parse(benchmark::State &state)
+{
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    bej_dictionary_context_t dict;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bej_parse_dict(&dict, data.data(), data.size()));
+        bej_free_dict(&dict);
+    }
+}
+BENCHMARK(BM_DictLoad_Parse);
+
+static void
+BM_DictLoad_Compiled(benchmark::State &state)
+{
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    bej_dictionary_context_t dict;
+    uint8_t *blob = NULL;
+    size_t blob_size = 0;
+    if (bej_parse_dict(&dict, data.data(), data.size()) || bej_compile_dict(&dict, &blob, &blob_size)) {
+        state.SkipWithError("Failed to compile Memory_v1.bin");
+        return;
+    }
+    bej_free_dict(&dict);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bej_load_compiled_dict(&dict, blob, blob_size));
+        bej_free_dict(&dict);
+    }
+
+    free(blob);
+}
+BENCHMARK(BM_DictLoad_Compiled);
+
+// borrowing a resident dictionary per document, against parsing it every time above
+static void
+BM_Registry_Acquire(benchmark::State &state)
+{
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    static bej_registry_t reg;
+    if (state.thread_index() == 0) {
+        if (bej_registry_init(&reg, 0) || bej_registry_load_buffer(&reg, data.data(), data.size()))
+            state.SkipWithError("Failed to load Memory_v1.bin");
+    }
+
+    for (auto _ : state) {
+        bej_registry_dict_t *dict = bej_registry_acquire(&reg, "Memory", BEJ_REGISTRY_ANY_VERSION);
+        benchmark::DoNotOptimize(dict);
+        bej_registry_release(dict);
+    }
+
+    if (state.thread_index() == 0)
+        bej_registry_free(&reg);
+}
+BENCHMARK(BM_Registry_Acquire)->ThreadRange(1, 8);
+
+// ============================================================================
+// Whole document decode
+// ============================================================================
+
+static void
+BM_Decode_ExampleMemory(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    FILE *sink = fopen("/dev/null", "w");
+    if (dict_data.empty() || bej_data.empty() || !sink) {
+        state.SkipWithError("Failed to load example_memory.bin");
+        if (sink)
+            fclose(sink);
+        return;
+    }
+
+    bej_context_t ctx;
+    for (auto _ : state) {
+        state.PauseTiming();
+        bej_init_context(&ctx, dict_data.data(), dict_data.size(),
+                         bej_data.data(), bej_data.size(), sink);
+        bej_dict_index_t index = ctx.schema_dict.index;
+        if (!state.range(0))
+            memset(&ctx.schema_dict.index, 0, sizeof(ctx.schema_dict.index));
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(bej_decode(&ctx));
+
+        state.PauseTiming();
+        ctx.schema_dict.index = index;
+        bej_free_context(&ctx);
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    fclose(sink);
+}
+BENCHMARK(BM_Decode_ExampleMemory)->ArgName("indexed")->Arg(0)->Arg(1);
+
+/* whole bej_decode() into memory, context reused so only decoding is timed,
+*  reports tuples/s next to bytes/s and the size of the output
+*/
+static void
+run_decode(benchmark::State &state, bej_dictionary_context_t *dict, std::vector<uint8_t> &bej_data,
+           uint8_t style = BEJ_STYLE_PRETTY, uint8_t encoding = BEJ_ENCODING_JSON, unsigned threads = 1U)
+{
+    size_t tuples = count_tuples(dict, bej_data);
+    if (!tuples) {
+        state.SkipWithError("Document does not decode");
+        return;
+    }
+
+    bej_context_t ctx;
+    bej_init_context_with_dict(&ctx, dict, bej_data.data(), bej_data.size(), NULL);
+    bej_set_style(&ctx, style);
+    bej_set_encoding(&ctx, encoding);
+    bej_set_parallel(&ctx, threads, 0);
+    for (auto _ : state) {
+        ctx.offset = 0UL;
+        ctx.out.len = 0UL;
+        ctx.indent_level = 0;
+        benchmark::DoNotOptimize(bej_decode(&ctx));
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+    state.counters["tuples/s"] = benchmark::Counter((double)tuples * state.iterations(),
+                                                    benchmark::Counter::kIsRate);
+    state.counters["out_bytes"] = (double)ctx.out.len;
+    bej_free_context(&ctx);
+}
+
+static void
+BM_Decode_Example(benchmark::State &state, const char *dict_name, const char *bej_name, uint8_t style)
+{
+    std::vector<uint8_t> dict_data = load_example(dict_name);
+    std::vector<uint8_t> bej_data = load_example(bej_name);
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example");
+        return;
+    }
+
+    run_decode(state, &dict, bej_data, style);
+    bej_free_dict(&dict);
+}
+BENCHMARK_CAPTURE(BM_Decode_Example, memory, "Memory_v1.bin", "example_memory.bin", BEJ_STYLE_PRETTY);
+BENCHMARK_CAPTURE(BM_Decode_Example, memory_compact, "Memory_v1.bin", "example_memory.bin",
+                  BEJ_STYLE_COMPACT);
+BENCHMARK_CAPTURE(BM_Decode_Example, pciedevice, "PCIeDevice_v1.bin", "example_pciedevice.bin",
+                  BEJ_STYLE_PRETTY);
+BENCHMARK_CAPTURE(BM_Decode_Example, pciedevice_compact, "PCIeDevice_v1.bin", "example_pciedevice.bin",
+                  BEJ_STYLE_COMPACT);
+
+static void
+BM_Decode_Synthetic(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load PCIeDevice_v1.bin");
+        return;
+    }
+
+    std::vector<uint8_t> bej_data = make_conditions_document(&dict, (size_t)state.range(0));
+    if (bej_data.empty())
+        state.SkipWithError("Failed to encode synthetic document");
+    else
+        run_decode(state, &dict, bej_data, (uint8_t)state.range(1));
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Decode_Synthetic)->ArgNames({"conditions", "compact"})
+    ->ArgsProduct({{100, 10000, 100000}, {BEJ_STYLE_PRETTY, BEJ_STYLE_COMPACT}});
+
+// compact JSON against transcoding the same document to CBOR and MessagePack
+static void
+BM_Decode_Encoding(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load PCIeDevice_v1.bin");
+        return;
+    }
+
+    std::vector<uint8_t> bej_data = make_conditions_document(&dict, (size_t)state.range(0));
+    if (bej_data.empty())
+        state.SkipWithError("Failed to encode synthetic document");
+    else
+        run_decode(state, &dict, bej_data, BEJ_STYLE_COMPACT, (uint8_t)state.range(1));
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Decode_Encoding)->ArgNames({"conditions", "encoding"})
+    ->ArgsProduct({{10000, 100000}, {BEJ_ENCODING_JSON, BEJ_ENCODING_CBOR, BEJ_ENCODING_MSGPACK}});
+
+/* scaling of bej_set_parallel() over Conditions arrays of about 1 and 10 MB, threads 1 is the sequential
+*  decode; wall time, the CPU time of the calling thread leaves out the others
+*/
+static void
+BM_Decode_Parallel(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load PCIeDevice_v1.bin");
+        return;
+    }
+
+    std::vector<uint8_t> bej_data = make_conditions_document(&dict, (size_t)state.range(0));
+    if (bej_data.empty())
+        state.SkipWithError("Failed to encode synthetic document");
+    else
+        run_decode(state, &dict, bej_data, BEJ_STYLE_COMPACT, BEJ_ENCODING_JSON, (unsigned)state.range(1));
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Decode_Parallel)->ArgNames({"conditions", "threads"})
+    ->ArgsProduct({{10000, 100000}, {1, 2, 4, 8}})->UseRealTime();
+
+// BEJ document of `depth` arrays nested in each other around an integer
+static std::vector<uint8_t>
+make_nested_document(size_t depth)
+{
+    std::vector<uint8_t> tuple = {0x01, 0x00, 0x30, 0x01, 0x01, 0x2A};
+    for (size_t i = 0; i < depth; i++) {
+        std::vector<uint8_t> value = {0x01, 0x01};  // count
+        value.insert(value.end(), tuple.begin(), tuple.end());
+
+        uint32_t len = (uint32_t)value.size();
+        uint8_t len_bytes = (len > 0xFFFF) ? 3 : (len > 0xFF) ? 2 : 1;
+        tuple = {0x01, 0x00, 0x10, len_bytes};
+        for (uint8_t b = 0; b < len_bytes; b++)
+            tuple.push_back((uint8_t)(len >> (8 * b)));
+        tuple.insert(tuple.end(), value.begin(), value.end());
+    }
+
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    doc.insert(doc.end(), tuple.begin(), tuple.end());
+    return doc;
+}
+
+// recursive decode_bej_sflv() vs the iterative loop bej_decode() runs, on nested arrays
+static void
+BM_Decode_Nested(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = make_nested_document((size_t)state.range(0));
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load Memory_v1.bin");
+        return;
+    }
+
+    bej_context_t ctx;
+    bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+    ctx.style = BEJ_STYLE_COMPACT;
+    ctx.max_depth = SIZE_MAX;
+    for (auto _ : state) {
+        ctx.offset = 0UL;
+        ctx.out.len = 0UL;
+        if (state.range(1)) {
+            benchmark::DoNotOptimize(bej_decode(&ctx));
+        } else {
+            ctx.offset = BEJ_HEADER_SIZE;
+            benchmark::DoNotOptimize(decode_bej_sflv(&ctx, &ctx.schema_dict, 0U));
+        }
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_context(&ctx);
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Decode_Nested)->ArgNames({"depth", "iterative"})
+    ->Args({4, 0})->Args({4, 1})->Args({15, 0})->Args({15, 1})->Args({1000, 1})->Args({20000, 1});
+
+// same document pushed through the streaming decoder in chunks of the given size
+static void
+BM_Decode_Stream(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    bej_dictionary_context_t dict;
+    FILE *sink = fopen("/dev/null", "w");
+    if (dict_data.empty() || bej_data.empty() || !sink
+        || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_memory.bin");
+        if (sink)
+            fclose(sink);
+        return;
+    }
+
+    size_t chunk = (size_t)state.range(0);
+    bej_stream_t s;
+    for (auto _ : state) {
+        bej_stream_init(&s, &dict, sink);
+        for (size_t off = 0; off < bej_data.size(); off += chunk) {
+            size_t n = (bej_data.size() - off < chunk) ? bej_data.size() - off : chunk;
+            benchmark::DoNotOptimize(bej_stream_feed(&s, bej_data.data() + off, n));
+        }
+        benchmark::DoNotOptimize(bej_stream_finish(&s));
+        bej_stream_free(&s);
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_dict(&dict);
+    fclose(sink);
+}
+BENCHMARK(BM_Decode_Stream)->ArgName("chunk")->Arg(1)->Arg(16)->Arg(64)->Arg(4096);
+
+// ============================================================================
+// JSON to BEJ encoding
+// ============================================================================
+
+static void
+BM_Encode_ExampleMemory(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_memory.bin");
+        return;
+    }
+
+    // the decoder's output is the input
+    bej_context_t ctx;
+    bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+    bej_decode(&ctx);
+    std::string json((const char *)ctx.out.data, ctx.out.len);
+    bej_free_context(&ctx);
+
+    bej_encoder_t enc;
+    bej_encoder_init(&enc, &dict);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bej_encode(&enc, json.data(), json.size()));
+    }
+    state.SetBytesProcessed((int64_t)json.size() * state.iterations());
+
+    bej_encoder_free(&enc);
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Encode_ExampleMemory);
+
+static void
+BM_EncoderInit(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load Memory_v1.bin");
+        return;
+    }
+
+    bej_encoder_t enc;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bej_encoder_init(&enc, &dict));
+        bej_encoder_free(&enc);
+    }
+
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_EncoderInit);
+
+// ============================================================================
+// Validate-only pass, compared against BM_Decode_ExampleMemory
+// ============================================================================
+
+static void
+BM_Validate_ExampleMemory(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_memory.bin");
+        return;
+    }
+
+    bej_context_t ctx;
+    bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bej_validate(&ctx));
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_context(&ctx);
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Validate_ExampleMemory);
+
+// ============================================================================
+// Path query, compared against BM_Decode_ExampleMemory
+// ============================================================================
+
+static void
+BM_Query_ExampleMemory(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_memory.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_memory.bin");
+        return;
+    }
+
+    // last member, everything in front of it is skipped
+    bej_query_t q;
+    bej_query_compile(&q, &dict, "/Name");
+    bej_context_t ctx;
+    uint8_t found = 0U;
+    for (auto _ : state) {
+        bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+        benchmark::DoNotOptimize(bej_query_run(&ctx, &q, &found));
+        bej_free_context(&ctx);
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Query_ExampleMemory);
+
+// ============================================================================
+// Document tree, compared to decoding to JSON text and parsing it back
+// ============================================================================
+
+static void
+BM_Tree_Decode(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_pciedevice.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_pciedevice.bin");
+        return;
+    }
+
+    bej_tree_t tree;
+    for (auto _ : state) {
+        bej_tree_decode(&tree, &dict, bej_data.data(), bej_data.size());
+        benchmark::DoNotOptimize(bej_node_find(tree.root, "Status/Conditions/0/Severity"));
+        bej_tree_free(&tree);
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Tree_Decode);
+
+#ifdef BEJ_BENCH_JSONCPP
+static void
+BM_Tree_JsonCppReparse(benchmark::State &state)
+{
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    std::vector<uint8_t> bej_data = load_example("example_pciedevice.bin");
+    bej_dictionary_context_t dict;
+    if (dict_data.empty() || bej_data.empty() || bej_parse_dict(&dict, dict_data.data(), dict_data.size())) {
+        state.SkipWithError("Failed to load example_pciedevice.bin");
+        return;
+    }
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    bej_context_t ctx;
+    for (auto _ : state) {
+        bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), NULL);
+        bej_decode(&ctx);
+        Json::Value root;
+        const char *json = (const char *)ctx.out.data;
+        reader->parse(json, json + ctx.out.len, &root, nullptr);
+        benchmark::DoNotOptimize(root["Status"]["Conditions"][0]["Severity"].asCString());
+        bej_free_context(&ctx);
+    }
+    state.SetBytesProcessed((int64_t)bej_data.size() * state.iterations());
+
+    bej_free_dict(&dict);
+}
+BENCHMARK(BM_Tree_JsonCppReparse);
+#endif
+
+// ============================================================================
+// JSON string escaping
+// ============================================================================
+
+// printable ASCII with an escape roughly every `gap` bytes, 0 for none
+static std::vector<uint8_t>
+make_string(size_t length, size_t gap)
+{
+    std::vector<uint8_t> s(length);
+    for (size_t i = 0; i < length; i++)
+        s[i] = (uint8_t)('A' + i % 26);
+    for (size_t i = gap; gap && i < length; i += gap)
+        s[i] = '"';
+    return s;
+}
+
+template <size_t (*Scan)(const uint8_t *, size_t)>
+static void
+BM_EscapeScan(benchmark::State &state)
+{
+    std::vector<uint8_t> s = make_string((size_t)state.range(0), 0);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Scan(s.data(), s.size()));
+    state.SetBytesProcessed((int64_t)s.size() * state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_EscapeScan, bej_escape_scan_scalar)->Arg(64)->Arg(4096);
+#ifdef BEJ_ESCAPE_X86
+BENCHMARK_TEMPLATE(BM_EscapeScan, bej_escape_scan_sse2)->Arg(64)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_EscapeScan, bej_escape_scan_avx2)->Arg(64)->Arg(4096);
+#endif
+
+static void
+BM_DecodeString(benchmark::State &state)
+{
+    std::vector<uint8_t> s = make_string((size_t)state.range(0), (size_t)state.range(1));
+    FILE *sink = fopen("/dev/null", "w");
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.output = sink;
+
+    for (auto _ : state) {
+        decode_string(&ctx, s.data(), (uint32_t)s.size());
+        ctx.out.len = 0;    // measure escaping, not the write to /dev/null
+    }
+    state.SetBytesProcessed((int64_t)s.size() * state.iterations());
+
+    bej_free_context(&ctx);
+    fclose(sink);
+}
+BENCHMARK(BM_DecodeString)->ArgNames({"len", "escape_every"})
+    ->Args({32, 0})->Args({4096, 0})->Args({4096, 64})->Args({65536, 0});
+
+// ============================================================================
+// Integer values
+// ============================================================================
+
+// 4096 integers of `bytes` bytes each, magnitudes spread over the whole width
+static std::vector<uint8_t>
+make_integers(size_t bytes)
+{
+    std::vector<uint8_t> values(4096 * bytes);
+    uint64_t state = 1ULL;
+    for (size_t i = 0; i < values.size(); i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        values[i] = (uint8_t)(state >> 56);
+    }
+    return values;
+}
+
+static void
+BM_DecodeInteger(benchmark::State &state)
+{
+    size_t bytes = (size_t)state.range(0);
+    std::vector<uint8_t> values = make_integers(bytes);
+
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    for (auto _ : state) {
+        for (size_t i = 0; i < values.size(); i += bytes)
+            decode_integer(&ctx, &values[i], (uint32_t)bytes);
+        ctx.out.len = 0UL;
+    }
+    state.SetItemsProcessed((int64_t)(values.size() / bytes) * state.iterations());
+    bej_free_context(&ctx);
+}
+BENCHMARK(BM_DecodeInteger)->ArgName("bytes")->DenseRange(1, 8);
+
+// what decode_integer() used to do: a byte loop and snprintf("%ld")
+static void
+BM_DecodeInteger_Printf(benchmark::State &state)
+{
+    size_t bytes = (size_t)state.range(0);
+    std::vector<uint8_t> values = make_integers(bytes);
+
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    for (auto _ : state) {
+        for (size_t i = 0; i < values.size(); i += bytes) {
+            uint64_t result = 0U;
+            for (size_t b = 0; b < bytes; b++)
+                result |= ((uint64_t)values[i + b]) << (8 * b);
+            if (bytes < 8 && (values[i + bytes - 1] & 0x80))
+                result |= ~0ULL << (8 * bytes);
+            char digits[24];
+            int n = snprintf(digits, sizeof(digits), "%ld", (int64_t)result);
+            bej_out_write(&ctx, digits, (size_t)n);
+        }
+        ctx.out.len = 0UL;
+    }
+    state.SetItemsProcessed((int64_t)(values.size() / bytes) * state.iterations());
+    bej_free_context(&ctx);
+}
+BENCHMARK(BM_DecodeInteger_Printf)->ArgName("bytes")->DenseRange(1, 8);
+
+// ============================================================================
+// Real values
+// ============================================================================
+
+/* sensor readings the way BMCs report them: a few hundred units with one to three
+*  decimals, every tenth one with an exponent
+*/
+static std::vector<bej_real_t>
+make_readings(size_t count)
+{
+    std::vector<bej_real_t> readings(count);
+    uint64_t state = 1ULL;
+    for (size_t i = 0; i < count; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t r = (uint32_t)(state >> 33);
+        uint64_t scale = (r % 3U == 0U) ? 10U : (r % 3U == 1U) ? 100U : 1000U;
+        readings[i].whole = (int64_t)(r % 400U) - ((r & 0x10000U) ? 40 : 0);
+        readings[i].fract = (r >> 9) % scale;
+        readings[i].leading_zeros = (readings[i].fract && readings[i].fract * 10U < scale) ? 1U : 0U;
+        readings[i].exponent = (i % 10U) ? 0 : -3;
+    }
+    return readings;
+}
+
+static void
+BM_RealFormat(benchmark::State &state)
+{
+    std::vector<bej_real_t> readings = make_readings((size_t)state.range(0));
+    char text[BEJ_REAL_MAX_LENGTH];
+
+    for (auto _ : state) {
+        for (const bej_real_t &real : readings)
+            benchmark::DoNotOptimize(bej_real_format(&real, text));
+    }
+    state.SetItemsProcessed((int64_t)readings.size() * state.iterations());
+}
+BENCHMARK(BM_RealFormat)->ArgName("readings")->Arg(4096);
+
+// printf() baseline, %.17g is what it takes to round-trip without a shortest search
+static void
+BM_RealPrintf(benchmark::State &state)
+{
+    std::vector<bej_real_t> readings = make_readings((size_t)state.range(0));
+    std::vector<double> values(readings.size());
+    for (size_t i = 0; i < readings.size(); i++)
+        bej_real_to_double(&readings[i], &values[i]);
+    char text[BEJ_REAL_MAX_LENGTH];
+
+    for (auto _ : state) {
+        for (double value : values)
+            benchmark::DoNotOptimize(snprintf(text, sizeof(text), "%.17g", value));
+    }
+    state.SetItemsProcessed((int64_t)values.size() * state.iterations());
+}
+BENCHMARK(BM_RealPrintf)->ArgName("readings")->Arg(4096);
+
+// value bytes to JSON through the decoder, parsing included
+static void
+BM_DecodeReal(benchmark::State &state)
+{
+    std::vector<bej_real_t> readings = make_readings((size_t)state.range(0));
+    std::vector<std::vector<uint8_t>> values;
+    for (const bej_real_t &real : readings) {
+        std::vector<uint8_t> v;
+        uint64_t whole = (uint64_t)real.whole;
+        uint64_t exponent = (uint64_t)real.exponent;
+        // two byte whole and one byte exponent, as in the sensor readings above
+        v.insert(v.end(), {0x01, 0x02, (uint8_t)whole, (uint8_t)(whole >> 8),
+                           0x01, (uint8_t)real.leading_zeros,
+                           0x02, (uint8_t)real.fract, (uint8_t)(real.fract >> 8),
+                           0x01, 0x01, (uint8_t)exponent});
+        values.push_back(v);
+    }
+
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    for (auto _ : state) {
+        for (std::vector<uint8_t> &v : values)
+            decode_real(&ctx, v.data(), (uint32_t)v.size());
+        ctx.out.len = 0UL;
+    }
+    state.SetItemsProcessed((int64_t)values.size() * state.iterations());
+    bej_free_context(&ctx);
+}
+BENCHMARK(BM_DecodeReal)->ArgName("readings")->Arg(4096);
+
+BENCHMARK_MAIN();
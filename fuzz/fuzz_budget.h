@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* Cost budget of the fuzz target. Decoding may take at most a fixed allowance plus a per byte
+* amount of time and output for every input, an input going over either is decoding
+* superlinearly in its size and is reported as a crash (abort()), so libFuzzer keeps it.
+* The per byte amounts can be changed through BEJ_FUZZ_NS_PER_BYTE and
+* BEJ_FUZZ_OUTPUT_PER_BYTE in the environment, BEJ_FUZZ_DICT selects the schema dictionary.
+*/
+
+#define BEJ_FUZZ_NS_FIXED 10000000ULL       // 10 ms, covers scheduling noise on tiny inputs
+#define BEJ_FUZZ_NS_PER_BYTE 2000ULL        // sanitized builds run ~100x below the release speed
+#define BEJ_FUZZ_OUTPUT_FIXED 4096ULL
+#define BEJ_FUZZ_OUTPUT_PER_BYTE 256ULL     // 3 byte tuples with long names and deep indentation
+#define BEJ_FUZZ_MAX_DEPTH 64UL             // indentation is O(depth) per line, so keep it sane
+
+/**
+ * Cost of the last input run through LLVMFuzzerTestOneInput()
+ */
+typedef struct {
+    size_t size;            // input bytes
+    uint64_t elapsed_ns;
+    uint64_t output;        // JSON bytes written
+} bej_fuzz_cost_t;
+
+extern bej_fuzz_cost_t bej_fuzz_last;
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
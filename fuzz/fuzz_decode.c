@@ -0,0 +1,125 @@
+/**
+ * @file fuzz_decode.c
+ * @brief libFuzzer target for bej_decode() that flags inputs decoding superlinearly in their size
+ */
+#define _GNU_SOURCE     // fopencookie()
+#include "../src/bej.h"
+#include "../src/bej_file.h"
+#include "fuzz_budget.h"
+#include <inttypes.h>
+#include <time.h>
+
+bej_fuzz_cost_t bej_fuzz_last;
+
+static bej_file_t dict_file;
+static bej_dictionary_context_t dict;
+static FILE *sink;
+static uint64_t ns_per_byte = BEJ_FUZZ_NS_PER_BYTE;
+static uint64_t output_per_byte = BEJ_FUZZ_OUTPUT_PER_BYTE;
+static uint64_t started_ns;
+
+static uint64_t
+bej_fuzz_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void
+bej_fuzz_check(void)
+{
+    uint64_t ns_budget = BEJ_FUZZ_NS_FIXED + ns_per_byte * bej_fuzz_last.size;
+    uint64_t output_budget = BEJ_FUZZ_OUTPUT_FIXED + output_per_byte * bej_fuzz_last.size;
+
+    bej_fuzz_last.elapsed_ns = bej_fuzz_now() - started_ns;
+    if (bej_fuzz_last.elapsed_ns > ns_budget) {
+        fprintf(stderr, "==bejfuzz== %zu byte input took %" PRIu64 " ns, budget is %" PRIu64 " ns\n",
+                bej_fuzz_last.size, bej_fuzz_last.elapsed_ns, ns_budget);
+        abort();
+    }
+    if (bej_fuzz_last.output > output_budget) {
+        fprintf(stderr, "==bejfuzz== %zu byte input wrote %" PRIu64 " bytes, budget is %" PRIu64 " bytes\n",
+                bej_fuzz_last.size, bej_fuzz_last.output, output_budget);
+        abort();
+    }
+}
+
+/* counts the decoder output instead of keeping it, checked as it flows so that a blowup is
+*  caught long before it runs out of memory or time
+*/
+static ssize_t
+bej_fuzz_write(void *cookie, const char *buf, size_t size)
+{
+    (void)cookie;
+    (void)buf;
+    bej_fuzz_last.output += size;
+    bej_fuzz_check();
+    return (ssize_t)size;
+}
+
+static void
+bej_fuzz_log(void *user, int level, const char *func, int line, const char *message)
+{
+    (void)user;
+    (void)level;
+    (void)func;
+    (void)line;
+    (void)message;
+}
+
+static uint64_t
+bej_fuzz_env(const char *name, uint64_t fallback)
+{
+    const char *value = getenv(name);
+    return (value && *value) ? strtoull(value, NULL, 0) : fallback;
+}
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+
+    const char *path = getenv("BEJ_FUZZ_DICT");
+    if (!path || !*path)
+        path = BEJ_FUZZ_DICT;
+    if (bej_file_open(&dict_file, path) || bej_parse_dict(&dict, dict_file.data, dict_file.size)) {
+        errmsg("Failed to load the schema dictionary %s", path);
+        exit(EXIT_FAILURE);
+    }
+    ns_per_byte = bej_fuzz_env("BEJ_FUZZ_NS_PER_BYTE", ns_per_byte);
+    output_per_byte = bej_fuzz_env("BEJ_FUZZ_OUTPUT_PER_BYTE", output_per_byte);
+
+    cookie_io_functions_t io = {.write = bej_fuzz_write};
+    sink = fopencookie(NULL, "w", io);
+    if (!sink) {
+        errmsg("Failed to open the output sink");
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(sink, NULL, _IONBF, 0);
+
+    // messages for every malformed tuple would be most of the time spent otherwise
+    bej_set_log_handler(bej_fuzz_log, NULL);
+
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    memset(&bej_fuzz_last, 0, sizeof(bej_fuzz_last));
+    bej_fuzz_last.size = size;
+    started_ns = bej_fuzz_now();
+
+    // the decoder never writes to its input
+    bej_context_t ctx;
+    if (!bej_init_context_with_dict(&ctx, &dict, (uint8_t *)data, size, sink)) {
+        ctx.max_depth = BEJ_FUZZ_MAX_DEPTH;
+        bej_decode(&ctx);
+        bej_free_context(&ctx);
+    }
+
+    bej_fuzz_check();
+    return 0;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file fuzz_driver.c
+ * @brief Stand-in for libFuzzer's main() when building with gcc
+ *
+ * Replays every file given, directories included, through LLVMFuzzerTestOneInput() and,
+ * with -runs=N, runs N random mutations of them. There is no coverage feedback, so the
+ * corpus never grows; it is meant for regression runs and quick smoke fuzzing. Takes the
+ * same -runs=, -seed= and -max_len= flags as libFuzzer and ignores its other flags.
+ */
+#include "fuzz_budget.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BEJ_FUZZ_CRASH_FILE "crash-bejfuzz.bin"
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} bej_fuzz_input_t;
+
+typedef struct {
+    bej_fuzz_input_t *inputs;
+    size_t count;
+    size_t cap;
+} bej_fuzz_corpus_t;
+
+// input being run, saved by the SIGABRT handler
+static const uint8_t *current_data;
+static size_t current_size;
+
+static void
+bej_fuzz_on_abort(int sig)
+{
+    static const char msg[] = "==bejfuzz== input saved to " BEJ_FUZZ_CRASH_FILE "\n";
+    int fd = open(BEJ_FUZZ_CRASH_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write(fd, current_data, current_size) == (ssize_t)current_size
+            && write(STDERR_FILENO, msg, sizeof(msg) - 1)) {}
+        close(fd);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static int
+bej_fuzz_add_file(bej_fuzz_corpus_t *corpus, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    bej_fuzz_input_t input = {NULL, 0};
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        uint8_t *data = realloc(input.data, input.size + n);
+        if (!data) {
+            free(input.data);
+            fclose(f);
+            return -1;
+        }
+        memcpy(data + input.size, chunk, n);
+        input.data = data;
+        input.size += n;
+    }
+    fclose(f);
+
+    if (corpus->count == corpus->cap) {
+        size_t cap = corpus->cap ? corpus->cap * 2 : 64;
+        bej_fuzz_input_t *inputs = realloc(corpus->inputs, cap * sizeof(bej_fuzz_input_t));
+        if (!inputs) {
+            free(input.data);
+            return -1;
+        }
+        corpus->inputs = inputs;
+        corpus->cap = cap;
+    }
+    corpus->inputs[corpus->count++] = input;
+    return 0;
+}
+
+static int
+bej_fuzz_add_path(bej_fuzz_corpus_t *corpus, const char *path)
+{
+    struct stat st;
+    if (stat(path, &st)) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return bej_fuzz_add_file(corpus, path);
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while (!result && (entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        char child[PATH_MAX];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (!stat(child, &st) && S_ISREG(st.st_mode))
+            result = bej_fuzz_add_file(corpus, child);
+    }
+    closedir(dir);
+    return result;
+}
+
+// worst cost per input byte seen so far
+static double worst_ns_per_byte, worst_output_per_byte;
+
+static void
+bej_fuzz_run(const uint8_t *data, size_t size)
+{
+    // LLVMFuzzerTestOneInput() never gets NULL, not even for empty inputs
+    static const uint8_t empty[1];
+    current_data = size ? data : empty;
+    current_size = size;
+    LLVMFuzzerTestOneInput(current_data, size);
+
+    double bytes = size ? (double)size : 1.0;
+    if (bej_fuzz_last.elapsed_ns / bytes > worst_ns_per_byte)
+        worst_ns_per_byte = bej_fuzz_last.elapsed_ns / bytes;
+    if (bej_fuzz_last.output / bytes > worst_output_per_byte)
+        worst_output_per_byte = bej_fuzz_last.output / bytes;
+}
+
+// splitmix64
+static uint64_t
+bej_fuzz_rand(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* a few byte level mutations, biased towards the values that matter to NNINTs and format
+*  bytes; returns the new size
+*/
+static size_t
+bej_fuzz_mutate(uint8_t *data, size_t size, size_t max_size, uint64_t *rng)
+{
+    static const uint8_t interesting[] = {0x00, 0x01, 0x02, 0x04, 0x05, 0x0F, 0x10, 0x7F, 0x80, 0xFF};
+
+    for (int mutations = 1 + (int)(bej_fuzz_rand(rng) % 4); mutations > 0; mutations--) {
+        uint64_t r = bej_fuzz_rand(rng);
+        size_t at = size ? (size_t)((r >> 8) % size) : 0;
+        switch (r % 5) {
+            case 0:     // flip a bit
+                if (size)
+                    data[at] ^= (uint8_t)(1U << ((r >> 40) % 8));
+                break;
+            case 1:     // interesting byte
+                if (size)
+                    data[at] = interesting[(r >> 40) % sizeof(interesting)];
+                break;
+            case 2:     // random byte
+                if (size)
+                    data[at] = (uint8_t)(r >> 40);
+                break;
+            case 3: {   // drop a chunk
+                size_t n = 1 + (size_t)((r >> 40) % 16);
+                if (at + n <= size) {
+                    memmove(data + at, data + at + n, size - at - n);
+                    size -= n;
+                }
+                break; }
+            default: {  // duplicate a chunk
+                size_t n = 1 + (size_t)((r >> 40) % 16);
+                if (at + n <= size && size + n <= max_size) {
+                    memmove(data + at + n, data + at, size - at);
+                    size += n;
+                }
+                break; }
+        }
+    }
+    return size;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned long long runs = 0ULL;
+    uint64_t rng = 1ULL;
+    size_t max_len = 4096UL;
+    bej_fuzz_corpus_t corpus = {NULL, 0, 0};
+
+    LLVMFuzzerInitialize(&argc, &argv);
+    signal(SIGABRT, bej_fuzz_on_abort);
+
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "-runs=", 6))
+            runs = strtoull(argv[i] + 6, NULL, 0);
+        else if (!strncmp(argv[i], "-seed=", 6))
+            rng = strtoull(argv[i] + 6, NULL, 0);
+        else if (!strncmp(argv[i], "-max_len=", 9))
+            max_len = strtoul(argv[i] + 9, NULL, 0);
+        else if (argv[i][0] == '-')
+            continue;   // a libFuzzer flag we have no use for
+        else if (bej_fuzz_add_path(&corpus, argv[i]))
+            return EXIT_FAILURE;
+    }
+    if (!corpus.count) {
+        fprintf(stderr, "Usage: %s [-runs=N] [-seed=N] [-max_len=N] <corpus file or directory>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < corpus.count; i++)
+        bej_fuzz_run(corpus.inputs[i].data, corpus.inputs[i].size);
+    fprintf(stderr, "Replayed %zu inputs\n", corpus.count);
+
+    uint8_t *buf = malloc(max_len ? max_len : 1);
+    for (unsigned long long run = 0; buf && run < runs; run++) {
+        bej_fuzz_input_t *seed = &corpus.inputs[bej_fuzz_rand(&rng) % corpus.count];
+        size_t size = (seed->size < max_len) ? seed->size : max_len;
+        memcpy(buf, seed->data, size);
+        bej_fuzz_run(buf, bej_fuzz_mutate(buf, size, max_len, &rng));
+    }
+    if (runs)
+        fprintf(stderr, "Ran %llu mutations\n", runs);
+
+    fprintf(stderr, "Worst cost per input byte: %.1f ns, %.1f output bytes\n",
+            worst_ns_per_byte, worst_output_per_byte);
+
+    free(buf);
+    for (size_t i = 0; i < corpus.count; i++)
+        free(corpus.inputs[i].data);
+    free(corpus.inputs);
+    return EXIT_SUCCESS;
+}
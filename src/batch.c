@@ -0,0 +1,332 @@
+/**
+ * @file batch.c
+ * @brief Multi-threaded batch decoding of many BEJ files sharing one dictionary
+ */
+#include "batch.h"
+#include "bej_file.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t cap;
+} path_list_t;
+
+typedef struct {
+    bej_dictionary_context_t *dict;
+    const bej_batch_options_t *opts;
+    path_list_t *list;
+    atomic_size_t next;
+    atomic_size_t failed;
+    atomic_size_t bytes;
+    pthread_mutex_t output_lock;
+} batch_state_t;
+
+static uint8_t
+path_list_add(path_list_t *list, const char *path, size_t length)
+{
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        char **paths = realloc(list->paths, cap * sizeof(char *));
+        if (!paths)
+            return FAILURE;
+        list->paths = paths;
+        list->cap = cap;
+    }
+
+    char *copy = malloc(length + 1);
+    if (!copy)
+        return FAILURE;
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    list->paths[list->count++] = copy;
+
+    return SUCCESS;
+}
+
+static void
+path_list_free(path_list_t *list)
+{
+    for (size_t i = 0; i < list->count; i++)
+        free(list->paths[i]);
+    free(list->paths);
+    memset(list, 0, sizeof(*list));
+}
+
+static int
+path_compare(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static uint8_t
+collect_directory(path_list_t *list, const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        errmsg("Failed to open directory %s: %s", dir, strerror(errno));
+        return FAILURE;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+
+        char path[4096];
+        int n = snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (n <= 0 || (size_t)n >= sizeof(path) || stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+
+        if (path_list_add(list, path, (size_t)n)) {
+            closedir(d);
+            errmsg("Failed to allocate file list");
+            return FAILURE;
+        }
+    }
+    closedir(d);
+
+    // readdir order is arbitrary, keep output reproducible
+    qsort(list->paths, list->count, sizeof(char *), path_compare);
+
+    return SUCCESS;
+}
+
+static uint8_t
+collect_list_file(path_list_t *list, const char *list_file)
+{
+    bej_file_t file;
+    if (bej_file_open(&file, list_file))
+        return FAILURE;
+
+    const char *p = (const char *)file.data;
+    const char *end = p + file.size;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = eol ? eol : end;
+        size_t length = (size_t)(line_end - p);
+        if (length && p[length - 1] == '\r')
+            length--;
+
+        if (length && path_list_add(list, p, length)) {
+            bej_file_close(&file);
+            errmsg("Failed to allocate file list");
+            return FAILURE;
+        }
+        p = line_end + 1;
+    }
+    bej_file_close(&file);
+
+    return SUCCESS;
+}
+
+static void
+write_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static uint8_t
+write_per_file(const batch_state_t *st, const char *path, const bej_output_t *doc)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char *dot = strrchr(base, '.');
+    int stem = dot && dot != base ? (int)(dot - base) : (int)strlen(base);
+
+    char out_path[4096];
+    int n = snprintf(out_path, sizeof(out_path), "%s/%.*s.json", st->opts->output_dir, stem, base);
+    if (n <= 0 || (size_t)n >= sizeof(out_path)) {
+        errmsg("Output path for %s is too long", path);
+        return FAILURE;
+    }
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        errmsg("Failed to open output file %s: %s", out_path, strerror(errno));
+        return FAILURE;
+    }
+    size_t written = fwrite(doc->data, 1, doc->len, out);
+    fputc('\n', out);
+    if (fclose(out) || written != doc->len) {
+        errmsg("Failed to write output file %s", out_path);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+static void
+write_ndjson(batch_state_t *st, const char *path, const bej_output_t *doc)
+{
+    FILE *out = st->opts->output;
+
+    pthread_mutex_lock(&st->output_lock);
+    fputs("{\"file\":", out);
+    write_json_string(out, path);
+    if (doc) {
+        fputs(",\"json\":", out);
+        fwrite(doc->data, 1, doc->len, out);
+    } else {
+        fputs(",\"error\":\"decode failed\"", out);
+    }
+    fputs("}\n", out);
+    pthread_mutex_unlock(&st->output_lock);
+}
+
+static uint8_t
+decode_one(batch_state_t *st, const char *path)
+{
+    bej_file_t bej;
+    if (bej_file_open(&bej, path))
+        return FAILURE;
+
+    bej_context_t ctx;
+    uint8_t result = bej_init_context_with_dict(&ctx, st->dict, bej.data, bej.size, NULL);
+    if (!result) {
+        // per-file documents stay readable, NDJSON needs one document per line
+        ctx.style = (st->opts->output_dir && !st->opts->compact) ? BEJ_STYLE_PRETTY : BEJ_STYLE_COMPACT;
+        result = bej_set_annotation_dict(&ctx, st->opts->anno_dict);
+        if (!result)
+            result = bej_decode(&ctx);
+        if (result)
+            errmsg("Failed to decode %s", path);
+        else if (st->opts->output_dir)
+            result = write_per_file(st, path, &ctx.out);
+        else
+            write_ndjson(st, path, &ctx.out);
+        bej_free_context(&ctx);
+    }
+
+    if (!result)
+        atomic_fetch_add_explicit(&st->bytes, bej.size, memory_order_relaxed);
+    bej_file_close(&bej);
+
+    return result;
+}
+
+static void *
+batch_worker(void *arg)
+{
+    batch_state_t *st = arg;
+
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&st->next, 1, memory_order_relaxed);
+        if (i >= st->list->count)
+            break;
+
+        if (decode_one(st, st->list->paths[i])) {
+            atomic_fetch_add_explicit(&st->failed, 1, memory_order_relaxed);
+            if (!st->opts->output_dir)
+                write_ndjson(st, st->list->paths[i], NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+uint8_t
+bej_batch_run(bej_dictionary_context_t *schema_dict, const bej_batch_options_t *opts)
+{
+    if (!schema_dict || !opts || !opts->input || (!opts->output_dir && !opts->output)) {
+        errmsg("Invalid batch parameters");
+        return FAILURE;
+    }
+
+    path_list_t list = {0};
+    struct stat st_input;
+    if (stat(opts->input, &st_input)) {
+        errmsg("Failed to open %s: %s", opts->input, strerror(errno));
+        return FAILURE;
+    }
+    if ((S_ISDIR(st_input.st_mode) ? collect_directory(&list, opts->input)
+                                   : collect_list_file(&list, opts->input))) {
+        path_list_free(&list);
+        return FAILURE;
+    }
+
+    unsigned jobs = opts->jobs;
+    if (!jobs) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (unsigned)cpus : 1U;
+    }
+    if (jobs > list.count)
+        jobs = list.count ? (unsigned)list.count : 1U;
+
+    batch_state_t st = {
+        .dict = schema_dict,
+        .opts = opts,
+        .list = &list,
+    };
+    atomic_init(&st.next, 0);
+    atomic_init(&st.failed, 0);
+    atomic_init(&st.bytes, 0);
+    pthread_mutex_init(&st.output_lock, NULL);
+
+    pthread_t *workers = calloc(jobs, sizeof(pthread_t));
+    if (!workers) {
+        errmsg("Failed to allocate worker pool");
+        pthread_mutex_destroy(&st.output_lock);
+        path_list_free(&list);
+        return FAILURE;
+    }
+
+    double start = now_seconds();
+
+    unsigned started = 0;
+    for (; started < jobs; started++) {
+        if (pthread_create(&workers[started], NULL, batch_worker, &st)) {
+            errmsg("Failed to start worker %u", started);
+            break;
+        }
+    }
+    if (!started)   // no pool at all, do the work on this thread
+        batch_worker(&st);
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+
+    double elapsed = now_seconds() - start;
+    if (elapsed <= 0.0)
+        elapsed = 1e-9;
+
+    if (opts->output)
+        fflush(opts->output);
+
+    size_t failed = atomic_load(&st.failed);
+    double mb = (double)atomic_load(&st.bytes) / (1024.0 * 1024.0);
+    fprintf(stderr, "Batch: %zu files (%zu failed) on %u threads, %.2f MiB in %.3f s: "
+            "%.1f files/s, %.2f MiB/s\n",
+            list.count, failed, started ? started : 1U, mb, elapsed,
+            (double)list.count / elapsed, mb / elapsed);
+
+    free(workers);
+    pthread_mutex_destroy(&st.output_lock);
+    path_list_free(&list);
+
+    return failed ? FAILURE : SUCCESS;
+}
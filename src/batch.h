@@ -0,0 +1,25 @@
+#pragma once
+#include "bej.h"
+
+/**
+ * Settings of the batch decode mode of the CLI
+ */
+typedef struct {
+    const char *input;      // directory of BEJ files or a file listing one path per line
+    const char *output_dir; // write <output_dir>/<name>.json per input, NULL for NDJSON
+    FILE *output;           // NDJSON stream, one {"file": ..., "json": ...} line per input
+    uint8_t compact;        // compact <name>.json files too, NDJSON lines are always compact
+    unsigned jobs;          // worker threads, 0 picks the number of online CPUs
+    bej_dictionary_context_t *anno_dict;    // parsed annotation dictionary shared like the schema one, or NULL
+} bej_batch_options_t;
+
+/**
+ * @brief Decode many BEJ files against one shared dictionary on a pool of worker threads
+ * 
+ * Aggregate throughput is reported on stderr once all files are done.
+ * 
+ * @param schema_dict Parsed schema dictionary, shared read-only by all workers
+ * @param opts Batch settings
+ * @return SUCCESS if every file decoded, FAILURE otherwise
+ */
+uint8_t bej_batch_run(bej_dictionary_context_t *schema_dict, const bej_batch_options_t *opts);
@@ -3,6 +3,11 @@
  * @brief Main BEJ decoder implementation
  */
 #include "bej.h"
+#include "bej_output.h"
+#include "bej_escape.h"
+#include "bej_compiled.h"
+#include "bej_real.h"
+#include "bej_parallel.h"
 
 uint8_t
 bej_read_nnint(uint8_t *data, size_t *offset, size_t size,
@@ -12,9 +17,12 @@ bej_read_nnint(uint8_t *data, size_t *offset, size_t size,
         return FAILURE;
 
     uint8_t nnint_bytes_length = data[*offset];
+    if (nnint_bytes_length >= size - *offset)
+        return FAILURE;     // value bytes run past the data
 
+    // bytes past the fourth don't fit the value and are dropped
     *value = 0U;
-    for (uint8_t i = 0U; i < nnint_bytes_length; i++) {
+    for (uint8_t i = 0U; i < nnint_bytes_length && i < sizeof(uint32_t); i++) {
         *value |= ((uint32_t)data[*offset + 1 + i]) << (8 * i);
     }
 
@@ -57,93 +65,341 @@ bej_read_format(uint8_t *data, size_t *offset, size_t size,
     return SUCCESS;
 }
 
+/* entries whose sequences are spread further apart than this are left to the linear scan,
+*  keeps a crafted dictionary from blowing the slot table up to 64k slots per range
+*/
+#define BEJ_DICT_INDEX_MAX_SPAN(count) ((uint32_t)(count) * 4U + 16U)
+
+static void
+bej_decode_dict_entry(bej_dictionary_context_t *dict, size_t offset, bej_dict_entry_t *entry)
+{
+    // a range scanned off the entry table, or off its entry boundaries, has no slot in the index
+    if (offset < BEJ_DICT_HEADER_SIZE || (offset - BEJ_DICT_HEADER_SIZE) % BEJ_DICT_ENTRY_SIZE
+        || (offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE >= dict->entry_count)
+        entry->index = BEJ_DICT_INDEX_NONE;
+    else
+        entry->index = (uint16_t)((offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE);
+    entry->format = READ_U8_AND_INC(dict->data, offset);
+    entry->sequence = READ_U16_LE(dict->data, offset);
+    offset += 2;
+    entry->child_offset = READ_U16_LE(dict->data, offset);
+    offset += 2;
+    entry->child_count = READ_U16_LE(dict->data, offset);
+    offset += 2;
+    uint8_t name_length = READ_U8_AND_INC(dict->data, offset);
+    uint16_t name_offset = READ_U16_LE(dict->data, offset);
+
+    if (name_offset > 0 && name_offset < dict->data_size) {
+        entry->name_length = name_length;
+        entry->name_offset = name_offset;
+    } else {
+        entry->name_length = 0u;
+        entry->name_offset = 0u;
+    }
+}
+
+/* maps child_offset of a range to the index of its first entry,
+*  returns FAILURE for offsets not landing on an entry boundary
+*/
+static uint8_t
+bej_dict_range_start(bej_dictionary_context_t *dict, uint16_t child_offset,
+                     uint16_t child_count, uint32_t *start)
+{
+    if (child_offset < BEJ_DICT_HEADER_SIZE
+        || (child_offset - BEJ_DICT_HEADER_SIZE) % BEJ_DICT_ENTRY_SIZE)
+        return FAILURE;
+
+    *start = (child_offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE;
+    if (*start + child_count > dict->entry_count)
+        return FAILURE;
+
+    return SUCCESS;
+}
+
+#define BEJ_ALIGN4(n) (((n) + 3UL) & ~3UL)
+
+/* length of the name as bej_get_entry_name() would return it, 0 if it can't be read
+*/
+static size_t
+bej_dict_name_length(bej_dictionary_context_t *dict, bej_dict_entry_t *entry)
+{
+    if (!entry->name_length || entry->name_offset + (size_t)entry->name_length > dict->data_size)
+        return 0UL;
+
+    const uint8_t *nul = memchr(&dict->data[entry->name_offset], '\0', entry->name_length);
+    return nul ? (size_t)(nul - &dict->data[entry->name_offset]) : entry->name_length;
+}
+
+static uint8_t
+bej_build_dict_index(bej_dictionary_context_t *dict)
+{
+    uint16_t n = dict->entry_count;
+
+    // truncated entry table, lookups will report the bounds error themselves
+    if (!n || BEJ_DICT_HEADER_SIZE + (size_t)n * BEJ_DICT_ENTRY_SIZE > dict->data_size)
+        return SUCCESS;
+
+    size_t fixed_size = BEJ_ALIGN4((size_t)n * sizeof(bej_dict_entry_t)) + (size_t)n * sizeof(bej_dict_range_t);
+    bej_dict_entry_t *entries = malloc(fixed_size);
+    if (!entries) {
+        errmsg("Failed to allocate dictionary index");
+        return FAILURE;
+    }
+    bej_dict_range_t *ranges = (bej_dict_range_t *)((uint8_t *)entries + fixed_size) - n;
+
+    size_t pool_size = 0UL;
+    for (uint16_t i = 0; i < n; i++) {
+        bej_decode_dict_entry(dict, BEJ_DICT_HEADER_SIZE + i * BEJ_DICT_ENTRY_SIZE, &entries[i]);
+        ranges[i].slot = BEJ_DICT_RANGE_NONE;
+        ranges[i].span = 0;
+        ranges[i].count = 0;
+
+        size_t name_length = bej_dict_name_length(dict, &entries[i]);
+        if (name_length)
+            pool_size += name_length + 4;   // "name": 
+    }
+
+    /* first pass sizes the slot tables of every distinct range,
+    *  the root range is the whole entry table as seen by bej_init_context()
+    */
+    uint32_t total_slots = 0U;
+    for (uint32_t i = 0; i <= n; i++) {
+        uint16_t child_offset = (i == n) ? BEJ_DICT_HEADER_SIZE : entries[i].child_offset;
+        uint16_t child_count = (i == n) ? n : entries[i].child_count;
+        uint32_t start = 0U;
+
+        if (!child_count || bej_dict_range_start(dict, child_offset, child_count, &start))
+            continue;
+        if (ranges[start].count)    // already sized, a differing count takes the scan path
+            continue;
+
+        uint32_t span = 0U;
+        for (uint32_t k = start; k < start + child_count; k++) {
+            if (entries[k].sequence >= span)
+                span = entries[k].sequence + 1U;
+        }
+
+        ranges[start].count = child_count;
+        if (span > BEJ_DICT_INDEX_MAX_SPAN(child_count) || span > UINT16_MAX)
+            continue;
+
+        ranges[start].slot = total_slots;
+        ranges[start].span = (uint16_t)span;
+        total_slots += span;
+    }
+
+    // slots and names go right after the fixed part so the whole index is a single allocation
+    size_t slots_size = BEJ_ALIGN4(total_slots * sizeof(uint16_t));
+    size_t names_size = (size_t)n * sizeof(bej_dict_name_t);
+    void *storage = realloc(entries, fixed_size + slots_size + names_size + pool_size);
+    if (!storage) {
+        errmsg("Failed to allocate dictionary index");
+        free(entries);
+        return FAILURE;
+    }
+    entries = storage;
+    ranges = (bej_dict_range_t *)((uint8_t *)storage + fixed_size) - n;
+    uint16_t *slots = (uint16_t *)((uint8_t *)storage + fixed_size);
+    bej_dict_name_t *names = (bej_dict_name_t *)((uint8_t *)slots + slots_size);
+    char *name_pool = (char *)(names + n);
+    memset(slots, 0xFF, total_slots * sizeof(uint16_t));
+
+    // second pass fills them, first entry wins the same way the linear scan does
+    for (uint32_t start = 0; start < n; start++) {
+        if (ranges[start].slot == BEJ_DICT_RANGE_NONE)
+            continue;
+        uint16_t *table = &slots[ranges[start].slot];
+        for (uint32_t k = start; k < start + ranges[start].count; k++) {
+            if (table[entries[k].sequence] == BEJ_DICT_INDEX_NONE)
+                table[entries[k].sequence] = (uint16_t)k;
+        }
+    }
+
+    // names pre-quoted the way the decoder writes them, saves copying them out per property
+    uint32_t pool_offset = 0U;
+    for (uint16_t i = 0; i < n; i++) {
+        size_t name_length = bej_dict_name_length(dict, &entries[i]);
+        names[i].offset = pool_offset;
+        names[i].length = 0;
+        if (!name_length)
+            continue;
+
+        char *q = &name_pool[pool_offset];
+        *q++ = '"';
+        memcpy(q, &dict->data[entries[i].name_offset], name_length);
+        q += name_length;
+        memcpy(q, "\": ", 3);
+        names[i].length = (uint16_t)(name_length + 4);
+        pool_offset += names[i].length;
+    }
+
+    dict->index.entries = entries;
+    dict->index.ranges = ranges;
+    dict->index.slots = slots;
+    dict->index.names = names;
+    dict->index.name_pool = name_pool;
+    dict->index.slot_count = total_slots;
+    dict->index.name_pool_size = pool_offset;
+    dict->index.storage = storage;
+
+    dbgmsg("Dictionary index built: %u entries, %u slots, %u bytes of names", n, total_slots, pool_offset);
+
+    return SUCCESS;
+}
+
 uint8_t
 bej_parse_dict(bej_dictionary_context_t *dict, uint8_t *data, size_t size)
 {
     if (!dict || !data || size < 12UL)
         return FAILURE;
 
+    // precompiled dictionaries carry their index already
+    if (bej_is_compiled_dict(data, size))
+        return bej_load_compiled_dict(dict, data, size);
+
     size_t offset = 0UL;
     
     dict->version_tag = READ_U8_AND_INC(data, offset);
     dict->truncation_flag = READ_U8_AND_INC(data, offset);
     dict->entry_count = READ_U16_LE(data, offset);
 
-    infomsg("Schema dictionary has %u entries", dict->entry_count);
+    dbgmsg("Schema dictionary has %u entries", dict->entry_count);
 
     offset += 2;
     
     dict->schema_version = READ_U32_LE(data, offset);
 
-    infomsg("Schema dictionary schema version: %#04x", dict->schema_version);
+    dbgmsg("Schema dictionary schema version: %#04x", dict->schema_version);
 
     offset += 4;
     
     dict->dictionary_size = size;
     dict->data = data;
     dict->data_size = size;
+    memset(&dict->index, 0, sizeof(dict->index));
     
-    return SUCCESS;
+    return bej_build_dict_index(dict);
 }
 
-uint8_t
-bej_find_dict_entry(bej_context_t *ctx, bej_dictionary_context_t *dict,
-                    uint32_t sequence, bej_dict_entry_t *entry)
+void
+bej_free_dict(bej_dictionary_context_t *dict)
 {
-    if (!dict || !entry || !dict->data) {
-        errmsg("Invalid parameters for dictionary lookup");
-        return FAILURE;
-    }
+    if (!dict)
+        return;
 
-    /* start from global data offset just after the header
-    *  unless parent entry has both entry->child_offset
-    *  and entry->child_count specified; exception is for the root
-    */
-    size_t offset = ctx->parent_child_offset[ctx->indent_level];
-    uint16_t count = ctx->parent_child_count[ctx->indent_level];
+    free(dict->index.storage);
+    memset(&dict->index, 0, sizeof(dict->index));
+}
 
-    for (uint16_t i = 0; i < count; i++) {
+static uint8_t
+bej_scan_dict_entry(bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count,
+                    uint32_t sequence, bej_dict_entry_t *entry, uint32_t *probes)
+{
+    size_t offset = child_offset;
+
+    for (uint16_t i = 0; i < child_count; i++) {
+        *probes = i + 1U;
         if (offset + 12UL > dict->data_size) {
             errmsg("Dictionary entry exceeds bounds");
             return FAILURE;
         }
         
-        uint8_t format = READ_U8_AND_INC(dict->data, offset);
-        uint16_t seq = READ_U16_LE(dict->data, offset);
-        offset += 2;
-        uint16_t child_off = READ_U16_LE(dict->data, offset);
-        offset += 2;
-        uint16_t child_count = READ_U16_LE(dict->data, offset);
-        offset += 2;
-        uint8_t name_length = READ_U8_AND_INC(dict->data, offset);
-        uint16_t name_offset = READ_U16_LE(dict->data, offset);
-        offset += 2;
-        
-        if (seq == sequence) {
-            entry->format = format;
-            entry->sequence = seq;
-            entry->child_offset = child_off;
-            entry->child_count = child_count;
-
-            if (name_offset > 0 && name_offset < dict->data_size) {
-                entry->name_length = name_length;
-                entry->name_offset = name_offset;
-            } else {
-                entry->name_length = 0u;
-                entry->name_offset = 0u;
-            }
-            
-            dbgmsg("Found entry: seq=%u, format=%u, children=%u, name_len=%u",
-                   seq, format, child_count, entry->name_length);
-            
+        if (READ_U16_LE(dict->data, offset + 1) == sequence) {
+            bej_decode_dict_entry(dict, offset, entry);
             return SUCCESS;
         }
+        offset += BEJ_DICT_ENTRY_SIZE;
     }
     
-    dbgmsg("Entry with sequence %u not found", sequence);
     return FAILURE;
 }
 
+/* bej_dict_lookup() that also tells how many entries it looked at, inlined into both callers
+*  so that the count costs nothing where nobody reads it
+*/
+static inline uint8_t
+bej_dict_find(bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count,
+              uint32_t sequence, bej_dict_entry_t *entry, uint32_t *probes)
+{
+    *probes = 0U;
+    if (!dict || !entry || !dict->data) {
+        errmsg("Invalid parameters for dictionary lookup");
+        return FAILURE;
+    }
+
+    uint32_t start = 0U;
+    if (dict->index.entries
+        && !bej_dict_range_start(dict, child_offset, child_count, &start)
+        && dict->index.ranges[start].count == child_count
+        && dict->index.ranges[start].slot != BEJ_DICT_RANGE_NONE) {
+        bej_dict_range_t *range = &dict->index.ranges[start];
+        *probes = 1U;
+        if (sequence >= range->span
+            || dict->index.slots[range->slot + sequence] == BEJ_DICT_INDEX_NONE) {
+            dbgmsg("Entry with sequence %u not found", sequence);
+            return FAILURE;
+        }
+        *entry = dict->index.entries[dict->index.slots[range->slot + sequence]];
+    } else if (bej_scan_dict_entry(dict, child_offset, child_count, sequence, entry, probes)) {
+        dbgmsg("Entry with sequence %u not found", sequence);
+        return FAILURE;
+    }
+
+    dbgmsg("Found entry: seq=%u, format=%u, children=%u, name_len=%u",
+           entry->sequence, entry->format, entry->child_count, entry->name_length);
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_dict_lookup(bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count,
+                uint32_t sequence, bej_dict_entry_t *entry)
+{
+    uint32_t probes;
+    return bej_dict_find(dict, child_offset, child_count, sequence, entry, &probes);
+}
+
+uint8_t
+bej_find_dict_entry(bej_context_t *ctx, bej_dictionary_context_t *dict,
+                    uint32_t sequence, bej_dict_entry_t *entry)
+{
+    /* start from global data offset just after the header
+    *  unless parent entry has both entry->child_offset
+    *  and entry->child_count specified; exception is for the root
+    */
+    return bej_dict_lookup(dict, ctx->parent_child_offset[ctx->indent_level],
+                           ctx->parent_child_count[ctx->indent_level], sequence, entry);
+}
+
+uint8_t
+bej_lookup_tuple(bej_context_t *ctx, uint16_t child_offset, uint16_t child_count,
+                 uint8_t range_selector, uint32_t sequence, uint8_t dict_selector,
+                 bej_dict_entry_t *entry, bej_dictionary_context_t **dict)
+{
+    *dict = &ctx->schema_dict;
+    if (dict_selector != range_selector) {
+        // schema members never appear inside annotations
+        if (dict_selector != BEJ_DICT_ANNOTATION)
+            return FAILURE;
+        child_offset = ctx->anno_child_offset;
+        child_count = ctx->anno_child_count;
+    }
+    if (dict_selector == BEJ_DICT_ANNOTATION) {
+        if (!ctx->anno_dict.data)
+            return FAILURE;
+        *dict = &ctx->anno_dict;
+    }
+
+    uint32_t probes;
+    uint8_t missing = bej_dict_find(*dict, child_offset, child_count, sequence, entry, &probes);
+    BEJ_STAT(ctx->stats.lookups++, ctx->stats.probes += probes, ctx->stats.unknown += missing);
+    if (missing) {
+        *dict = &ctx->schema_dict;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
 uint8_t
 bej_get_entry_name(bej_dictionary_context_t *dict, bej_dict_entry_t *entry,
                    char *name, size_t name_size)
@@ -166,45 +422,230 @@ bej_get_entry_name(bej_dictionary_context_t *dict, bej_dict_entry_t *entry,
     return SUCCESS;
 }
 
-static void
-write_indent(bej_context_t *ctx)
+uint8_t
+bej_output_reserve(bej_context_t *ctx, size_t n)
+{
+    if (ctx->out.error)
+        return FAILURE;
+
+    // without a stream the whole document stays in memory, grow geometrically
+    size_t cap = BEJ_OUTPUT_BUFFER_SIZE;
+    if (ctx->output) {
+        if (ctx->out.len && bej_flush(ctx))
+            return FAILURE;
+        if (n > cap)
+            cap = n;
+    } else {
+        if (ctx->out.cap * 2 > cap)
+            cap = ctx->out.cap * 2;
+        if (ctx->out.len + n > cap)
+            cap = ctx->out.len + n;
+    }
+
+    if (ctx->out.cap - ctx->out.len >= n)
+        return SUCCESS;
+
+    uint8_t *data = realloc(ctx->out.data, cap);
+    if (!data) {
+        errmsg_ctx(ctx, "Failed to allocate %zu bytes of output buffer", cap);
+        ctx->out.error = 1U;
+        return FAILURE;
+    }
+    ctx->out.data = data;
+    ctx->out.cap = cap;
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_flush(bej_context_t *ctx)
+{
+    if (!ctx)
+        return FAILURE;
+
+    if (ctx->output && ctx->out.len) {
+        if (fwrite(ctx->out.data, 1, ctx->out.len, ctx->output) != ctx->out.len) {
+            errmsg_ctx(ctx, "Failed to write %zu bytes of output", ctx->out.len);
+            ctx->out.error = 1U;
+        }
+        ctx->out.len = 0UL;
+    }
+
+    return ctx->out.error ? FAILURE : SUCCESS;
+}
+
+/* pre-quoted name of an entry, NULL without an index or for an entry that has no slot in it,
+*  bej_get_entry_name() reads the name then
+*/
+static inline const bej_dict_name_t *
+bej_dict_quoted_name(const bej_dictionary_context_t *dict, const bej_dict_entry_t *entry)
+{
+    if (!dict->index.names || entry->index >= dict->entry_count)
+        return NULL;
+    return &dict->index.names[entry->index];
+}
+
+/* writes "name": for set members, nothing for entries without a name
+*/
+void
+write_entry_name(bej_context_t *ctx, bej_dictionary_context_t *dict, bej_dict_entry_t *entry)
+{
+    if (ctx->encoding) {
+        // a map key even without a name, the pre-quoted one without its quotes and ": "
+        const bej_dict_name_t *quoted = bej_dict_quoted_name(dict, entry);
+        if (quoted) {
+            if (quoted->length)
+                write_binary_text(ctx, &dict->index.name_pool[quoted->offset + 1U], quoted->length - 4U);
+            else
+                write_binary_text(ctx, "", 0UL);
+            return;
+        }
+        char name[BEJ_DICT_ENTRY_NAME_LENGTH+1] = {0};
+        bej_get_entry_name(dict, entry, name, sizeof(name));
+        write_binary_text(ctx, name, strlen(name));
+        return;
+    }
+
+    size_t sep_length = (ctx->style == BEJ_STYLE_PRETTY) ? 2UL : 1UL;
+
+    const bej_dict_name_t *quoted = bej_dict_quoted_name(dict, entry);
+    if (quoted) {
+        if (quoted->length)
+            bej_out_write(ctx, &dict->index.name_pool[quoted->offset], quoted->length - 2U + sep_length);
+        return;
+    }
+
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1] = {0};
+    bej_get_entry_name(dict, entry, name, sizeof(name));
+    if (name[0] != '\0') {
+        bej_out_putc(ctx, '"');
+        bej_out_write(ctx, name, strlen(name));
+        bej_out_write(ctx, "\": ", sep_length + 1);
+    }
+}
+
+void
+write_member_name(bej_context_t *ctx, bej_dictionary_context_t *dict, bej_dict_entry_t *entry,
+                  uint32_t sequence)
 {
-    for (int i = 0; i < ctx->indent_level; i++) {
-        fputc('\t', ctx->output);
+    if (entry) {
+        write_entry_name(ctx, dict, entry);
+        return;
     }
+
+    if (ctx->encoding) {
+        char name[sizeof("unknown_") - 1 + BEJ_INT_MAX_LENGTH];
+        memcpy(name, "unknown_", sizeof("unknown_") - 1);
+        size_t n = sizeof("unknown_") - 1 + bej_u64_to_text(sequence, &name[sizeof("unknown_") - 1]);
+        write_binary_text(ctx, name, n);
+        return;
+    }
+
+    bej_out_literal(ctx, "\"unknown_");
+    write_uint(ctx, sequence);
+    if (ctx->style == BEJ_STYLE_PRETTY)
+        bej_out_literal(ctx, "\": ");
+    else
+        bej_out_literal(ctx, "\":");
 }
 
 uint8_t
 decode_integer(bej_context_t *ctx, uint8_t *value, uint32_t length)
 {
     if (length == 0 || length > 8) {
-        errmsg("Invalid integer length: %u", length);
+        errmsg_ctx(ctx, "Invalid integer length: %u", length);
         return FAILURE;
     }
 
-    int64_t result = 0l; // le signed format
-    
-    for (uint32_t i = 0; i < length; i++) {
-        result |= ((int64_t)value[i]) << (8 * i);
+    if (ctx->encoding)
+        write_binary_int(ctx, bej_load_int_le(value, length));
+    else
+        write_int(ctx, bej_load_int_le(value, length));
+    return SUCCESS;
+}
+
+uint8_t
+decode_real(bej_context_t *ctx, uint8_t *value, uint32_t length)
+{
+    bej_real_t real;
+    if (bej_real_parse(value, length, &real)) {
+        errmsg_ctx(ctx, "Invalid real value of %u bytes", length);
+        return FAILURE;
     }
-    
-    // sign extend if negative
-    if (length < 8 && (value[length - 1] & 0x80)) {
-        // fill upper bits with 1s
-        for (uint32_t i = length; i < 8; i++) {
-            result |= ((int64_t)0xFF) << (8 * i);
+
+    if (ctx->encoding) {
+        // infinities are fine here
+        double number;
+        if (bej_real_to_double(&real, &number))
+            warnmsg_ctx(ctx, "Real value out of the range of a double");
+        write_binary_double(ctx, number);
+        return SUCCESS;
+    }
+
+    char text[BEJ_REAL_MAX_LENGTH];
+    size_t n = bej_real_format(&real, text);
+    if (!n) {
+        // JSON has no infinities
+        warnmsg_ctx(ctx, "Real value out of the range of a double");
+        bej_out_literal(ctx, "null");
+        return SUCCESS;
+    }
+    bej_out_write(ctx, text, n);
+    return SUCCESS;
+}
+
+uint8_t
+write_escaped(bej_context_t *ctx, const uint8_t *value, size_t length)
+{
+    // worst case every byte becomes \uXXXX, reserve once and fill the buffer directly
+    uint8_t *out = bej_out_tail(ctx, length * 6);
+    if (!out)
+        return FAILURE;
+    uint8_t *p = out;
+
+    for (size_t i = 0; i < length; i++) {
+        // bulk-copy the run of bytes that go out verbatim
+        size_t clean = bej_escape_scan(&value[i], length - i);
+        memcpy(p, &value[i], clean);
+        p += clean;
+        i += clean;
+        if (i == length)
+            break;
+
+        char c = value[i];
+        switch (c) {
+            case '\"': *p++ = '\\'; *p++ = '"'; break;
+            case '\\': *p++ = '\\'; *p++ = '\\'; break;
+            case '\b': *p++ = '\\'; *p++ = 'b'; break;
+            case '\f': *p++ = '\\'; *p++ = 'f'; break;
+            case '\n': *p++ = '\\'; *p++ = 'n'; break;
+            case '\r': *p++ = '\\'; *p++ = 'r'; break;
+            case '\t': *p++ = '\\'; *p++ = 't'; break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                *p++ = hex[(unsigned char)c >> 4];
+                *p++ = hex[(unsigned char)c & 0x0F];
+            }
         }
     }
-    
-    fprintf(ctx->output, "%ld", result);
+
+    ctx->out.len += (size_t)(p - out);
     return SUCCESS;
 }
 
 uint8_t
 decode_string(bej_context_t *ctx, uint8_t *value, uint32_t length)
 {
+    if (ctx->encoding) {
+        // the terminator goes, nothing needs escaping
+        if (length > 0 && value[length - 1] == '\0')
+            length--;
+        write_binary_text(ctx, value, length);
+        return SUCCESS;
+    }
     if (length == 0) {
-        fprintf(ctx->output, "\"\"");
+        bej_out_literal(ctx, "\"\"");
         return SUCCESS;
     }
     /* last byte should be null terminator
@@ -213,102 +654,124 @@ decode_string(bej_context_t *ctx, uint8_t *value, uint32_t length)
         length--;
     }
     
-    fprintf(ctx->output, "\"");
-    for (uint32_t i = 0; i < length; i++) {
-        char c = value[i];
-        switch (c) {
-            case '\"': fprintf(ctx->output, "\\\""); break;
-            case '\\': fprintf(ctx->output, "\\\\"); break;
-            case '\b': fprintf(ctx->output, "\\b"); break;
-            case '\f': fprintf(ctx->output, "\\f"); break;
-            case '\n': fprintf(ctx->output, "\\n"); break;
-            case '\r': fprintf(ctx->output, "\\r"); break;
-            case '\t': fprintf(ctx->output, "\\t"); break;
-            default:
-                if (c >= 32 && c <= 126) {
-                    fputc(c, ctx->output);
-                } else {
-                    fprintf(ctx->output, "\\u%04x", (unsigned char)c);
-                }
-        }
-    }
-    fprintf(ctx->output, "\"");
+    // quotes and escaped body in one reservation
+    if (!bej_out_tail(ctx, (size_t)length * 6 + 2))
+        return FAILURE;
+    bej_out_putc(ctx, '"');
+    if (write_escaped(ctx, value, length))
+        return FAILURE;
+    bej_out_putc(ctx, '"');
+
     return SUCCESS;
 }
 
-uint8_t
-decode_enum(bej_context_t *ctx, uint8_t *value, uint32_t length,
-            bej_dictionary_context_t *dict)
+/* enum options are the children of the enum's dictionary entry
+*/
+static uint8_t
+decode_enum_in_range(bej_context_t *ctx, uint8_t *value, uint32_t length,
+                     bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count)
 {
     size_t offset = 0UL;
     uint32_t enum_value = 0U;
-    ctx->indent_level++;
     
     if (bej_read_nnint(value, &offset, length, &enum_value)) {
-        ctx->indent_level--;
-        errmsg("Failed to read enum value");
+        errmsg_ctx(ctx, "Failed to read enum value");
         return FAILURE;
     }
     
     // find enum string in child entries
     bej_dict_entry_t enum_entry;
-    if (!bej_find_dict_entry(ctx, dict, enum_value, &enum_entry)) {
-        char enum_name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
-        if (!bej_get_entry_name(dict, &enum_entry, enum_name, sizeof(enum_name))) {
-            fprintf(ctx->output, "\"%s\"", enum_name);
-            ctx->indent_level--;
-            return SUCCESS;
+    if (!bej_dict_lookup(dict, child_offset, child_count, enum_value, &enum_entry)) {
+        const bej_dict_name_t *quoted = bej_dict_quoted_name(dict, &enum_entry);
+        if (quoted) {
+            // the pre-quoted name minus its ": " tail
+            if (quoted->length) {
+                if (ctx->encoding)
+                    write_binary_text(ctx, &dict->index.name_pool[quoted->offset + 1U], quoted->length - 4U);
+                else
+                    bej_out_write(ctx, &dict->index.name_pool[quoted->offset], quoted->length - 2U);
+                return SUCCESS;
+            }
+        } else {
+            char enum_name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+            if (!bej_get_entry_name(dict, &enum_entry, enum_name, sizeof(enum_name))) {
+                if (ctx->encoding) {
+                    write_binary_text(ctx, enum_name, strlen(enum_name));
+                    return SUCCESS;
+                }
+                bej_out_putc(ctx, '"');
+                bej_out_write(ctx, enum_name, strlen(enum_name));
+                bej_out_putc(ctx, '"');
+                return SUCCESS;
+            }
         }
     }
 
     // print numeric then
-    fprintf(ctx->output, "%u", enum_value);
-    ctx->indent_level--;
+    if (ctx->encoding)
+        write_binary_int(ctx, enum_value);
+    else
+        write_uint(ctx, enum_value);
 
     return SUCCESS;
 }
 
+uint8_t
+decode_enum(bej_context_t *ctx, uint8_t *value, uint32_t length,
+            bej_dictionary_context_t *dict)
+{
+    return decode_enum_in_range(ctx, value, length, dict,
+                                ctx->parent_child_offset[ctx->indent_level+1],
+                                ctx->parent_child_count[ctx->indent_level+1]);
+}
+
 uint8_t
 decode_set(bej_context_t *ctx, uint32_t length,
            bej_dictionary_context_t *dict)
 {
-    fprintf(ctx->output, "{\n");
     ctx->indent_level++;
     
     size_t set_end = ctx->offset + length;
+    // elements are read within the set only, see decode_bej_iterative()
+    size_t size = ctx->bej_size;
+    ctx->bej_size = set_end;
     
     uint32_t count = 0U;    // reading elements count first
     if (bej_read_nnint(ctx->bej_data, &ctx->offset, ctx->bej_size, &count)) {
         ctx->indent_level--;
-        errmsg("Failed to read set count");
+        ctx->bej_size = size;
+        errmsg_ctx(ctx, "Failed to read set count");
         return FAILURE;
     }
+    write_open(ctx, BEJ_FORMAT_SET, count);
+    BEJ_STAT(if ((uint64_t)ctx->indent_level > ctx->stats.max_depth) ctx->stats.max_depth = ctx->indent_level);
     
-    dbgmsg("Decoding set with %u elements", count);
+    dbgmsg_ctx(ctx, "Decoding set with %u elements", count);
     // now decoding each element
-    for (uint32_t i = 0U; i < count && ctx->offset < set_end; i++) {
+    uint32_t i = 0U;
+    for (; i < count && ctx->offset < set_end; i++) {
         write_indent(ctx);
         
         // set elements have names from dictionary
         if (decode_bej_sflv(ctx, dict, 1U)) {
             ctx->indent_level--;
+            ctx->bej_size = size;
             return FAILURE;
         }
         
-        if (i < count - 1) {
-            fprintf(ctx->output, ",");
-        }
-        fprintf(ctx->output, "\n");
+        write_separator(ctx, i, count);
     }
     
     ctx->indent_level--;
-    write_indent(ctx);
-    fprintf(ctx->output, "}");
+    ctx->bej_size = size;
+    if (write_close(ctx, BEJ_FORMAT_SET, i, count))
+        return FAILURE;
     
     // check if length matches expectations
     if (ctx->offset != set_end) {
-        warnmsg("Set length mismatch: expected %zu, got %zu", 
+        warnmsg_ctx(ctx, "Set length mismatch: expected %zu, got %zu", 
                 set_end, ctx->offset);
+        BEJ_STAT(ctx->stats.length_mismatches++);
         ctx->offset = set_end;
     }
     
@@ -319,42 +782,48 @@ uint8_t
 decode_array(bej_context_t *ctx, uint32_t length,
              bej_dictionary_context_t *dict)
 {   // same things as for set here except for no names
-    fprintf(ctx->output, "[\n");
     ctx->indent_level++;
     
     size_t array_end = ctx->offset + length;
+    // elements are read within the array only, see decode_bej_iterative()
+    size_t size = ctx->bej_size;
+    ctx->bej_size = array_end;
     
     uint32_t count = 0U; 
     if (bej_read_nnint(ctx->bej_data, &ctx->offset, ctx->bej_size, &count)) {
         ctx->indent_level--;
-        errmsg("Failed to read array count");
+        ctx->bej_size = size;
+        errmsg_ctx(ctx, "Failed to read array count");
         return FAILURE;
     }
+    write_open(ctx, BEJ_FORMAT_ARRAY, count);
+    BEJ_STAT(if ((uint64_t)ctx->indent_level > ctx->stats.max_depth) ctx->stats.max_depth = ctx->indent_level);
     
-    dbgmsg("Decoding array with %u elements", count);
+    dbgmsg_ctx(ctx, "Decoding array with %u elements", count);
     
-    for (uint32_t i = 0; i < count && ctx->offset < array_end; i++) {
+    uint32_t i = 0U;
+    for (; i < count && ctx->offset < array_end; i++) {
         write_indent(ctx);
         
         // ...whereas arrays doesn't
         if (decode_bej_sflv(ctx, dict, 0U)) {
             ctx->indent_level--;
+            ctx->bej_size = size;
             return FAILURE;
         }
         
-        if (i < count - 1) {
-            fprintf(ctx->output, ",");
-        }
-        fprintf(ctx->output, "\n");
+        write_separator(ctx, i, count);
     }
     
     ctx->indent_level--;
-    write_indent(ctx);
-    fprintf(ctx->output, "]");
+    ctx->bej_size = size;
+    if (write_close(ctx, BEJ_FORMAT_ARRAY, i, count))
+        return FAILURE;
     
     if (ctx->offset != array_end) {
-        warnmsg("Array length mismatch: expected %zu, got %zu", 
+        warnmsg_ctx(ctx, "Array length mismatch: expected %zu, got %zu", 
                 array_end, ctx->offset);
+        BEJ_STAT(ctx->stats.length_mismatches++);
         ctx->offset = array_end;
     }
     
@@ -374,131 +843,410 @@ decode_bej_sflv(bej_context_t *ctx, bej_dictionary_context_t *dict,
 
     if (bej_read_sequence_number(ctx->bej_data, &ctx->offset, ctx->bej_size,
                                  &sequence, &dict_selector)) {
-        errmsg("Failed to read sequence number at offset %zu", ctx->offset);
+        errmsg_ctx(ctx, "Failed to read sequence number at offset %zu", ctx->offset);
         return FAILURE;
     }
     if (bej_read_format(ctx->bej_data, &ctx->offset, ctx->bej_size,
                         &format, &flags)) {
-        errmsg("Failed to read format at offset %zu", ctx->offset);
+        errmsg_ctx(ctx, "Failed to read format at offset %zu", ctx->offset);
         return FAILURE;
     }
     if (bej_read_nnint(ctx->bej_data, &ctx->offset, ctx->bej_size, &length)) {
-        errmsg("Failed to read length at offset %zu", ctx->offset);
+        errmsg_ctx(ctx, "Failed to read length at offset %zu", ctx->offset);
         return FAILURE;
     }
     if (ctx->offset + length > ctx->bej_size) {
-        errmsg("Value length %u exceeds buffer at offset %zu", length, ctx->offset);
+        errmsg_ctx(ctx, "Value length %u exceeds buffer at offset %zu", length, ctx->offset);
         return FAILURE;
     }
+    BEJ_STAT(ctx->stats.tuples++, ctx->stats.format_tuples[format & 0x0FU]++,
+             ctx->stats.format_bytes[format & 0x0FU] += length);
     
     uint8_t *value = &ctx->bej_data[ctx->offset];
     
-    // performing dict lookup
-    bej_dict_entry_t entry;
-    uint8_t found_entry = !bej_find_dict_entry(ctx, dict, sequence, &entry);
+    /* performing dict lookup, unknown entries have no children
+    *  array elements carry their index as sequence, the single child of the array
+    *  entry describes all of them
+    */
+    bej_dict_entry_t entry = {0};
+    bej_dictionary_context_t *entry_dict = dict;
+    uint8_t in_array = !add_name && ctx->indent_level;
+    uint8_t range_selector = ctx->parent_dict_selector[ctx->indent_level];
+    uint8_t found_entry = !bej_lookup_tuple(ctx, ctx->parent_child_offset[ctx->indent_level],
+                                            ctx->parent_child_count[ctx->indent_level], range_selector,
+                                            in_array ? 0U : sequence,
+                                            in_array ? range_selector : dict_selector,
+                                            &entry, &entry_dict);
     
     if (found_entry) {
-        char name[BEJ_DICT_ENTRY_NAME_LENGTH+1] = {0};
-        bej_get_entry_name(dict, &entry, name, sizeof(name));
-        
-        dbgmsg("Decoding entry: seq=%u, format=%u, name=\"%s\"", 
-            sequence, format, name);
-
-        if (add_name && name[0] != '\0') {
-            fprintf(ctx->output, "\"%s\": ", name);
-        }
+        dbgmsg_ctx(ctx, "Decoding entry: seq=%u, format=%u, entry=%u", 
+            sequence, format, entry.index);
     } else {    // this one unlikely, but let's the name based of seq
-        dbgmsg("Decoding unknown entry: seq=%u, format=%u", sequence, format);
-        if (add_name) {
-            fprintf(ctx->output, "\"unknown_%u\": ", sequence);
-        }
+        dbgmsg_ctx(ctx, "Decoding unknown entry: seq=%u, format=%u", sequence, format);
+    }
+    if (add_name) {
+        write_member_name(ctx, entry_dict, found_entry ? &entry : NULL, sequence);
     }
 
     switch (format) {
         case BEJ_FORMAT_SET:
         case BEJ_FORMAT_ARRAY: {
             if (ctx->indent_level + 1 >= BEJ_CONTEXT_STACK_MAX_DEPTH) {
-                errmsg("BEJ nesting too deep");
+                errmsg_ctx(ctx, "BEJ nesting too deep");
                 return FAILURE;
             }
             ctx->parent_child_offset[ctx->indent_level+1] = entry.child_offset;
             ctx->parent_child_count[ctx->indent_level+1] = entry.child_count;
+            ctx->parent_dict_selector[ctx->indent_level+1] = (entry_dict == &ctx->anno_dict);
 
             return (!format) ? decode_set(ctx, length, dict) :
                                decode_array(ctx, length, dict); }
-        case BEJ_FORMAT_INTEGER:
+        default:
             ctx->offset += length;  // move past value for recursive call
+            return decode_bej_leaf(ctx, entry_dict, format, &entry, value, length);
+    }
+}
+
+uint8_t
+decode_bej_leaf(bej_context_t *ctx, bej_dictionary_context_t *dict, uint8_t format,
+                bej_dict_entry_t *entry, uint8_t *value, uint32_t length)
+{
+    switch (format) {
+        case BEJ_FORMAT_INTEGER:
             return decode_integer(ctx, value, length);
+        case BEJ_FORMAT_REAL:
+            return decode_real(ctx, value, length);
         case BEJ_FORMAT_STRING:
-            ctx->offset += length;
             return decode_string(ctx, value, length);
         case BEJ_FORMAT_ENUM:
-            ctx->offset += length;
-            ctx->parent_child_offset[ctx->indent_level+1] = entry.child_offset;
-            ctx->parent_child_count[ctx->indent_level+1] = entry.child_count;
-            return decode_enum(ctx, value, length, dict);
+            return decode_enum_in_range(ctx, value, length, dict,
+                                        entry->child_offset, entry->child_count);
         case BEJ_FORMAT_BOOLEAN:
-            ctx->offset += length;
-            fprintf(ctx->output, (length > 0 && value[0]) ? "true" : "false");
+            if (ctx->encoding)
+                write_binary_bool(ctx, length > 0 && value[0]);
+            else if (length > 0 && value[0])
+                bej_out_literal(ctx, "true");
+            else
+                bej_out_literal(ctx, "false");
             return SUCCESS;
         case BEJ_FORMAT_NULL:
-            ctx->offset += length;
-            fprintf(ctx->output, "null");
-            return SUCCESS;
+            break;
         // todo: more types
         default:
-            warnmsg("Unknown format type: %u", format);
-            ctx->offset += length;
-            fprintf(ctx->output, "null");
+            warnmsg_ctx(ctx, "Unknown format type: %u", format);
     }
+
+    if (ctx->encoding)
+        write_binary_null(ctx);
+    else
+        bej_out_literal(ctx, "null");
     return SUCCESS;
 }
 
+void
+bej_set_frame_stack(bej_context_t *ctx, bej_frame_t *frames, size_t count)
+{
+    if (!ctx)
+        return;
+
+    if (ctx->owns_frames)
+        free(ctx->frames);
+    ctx->frames = frames;
+    ctx->frames_cap = frames ? count : 0UL;
+    ctx->owns_frames = 0U;
+}
+
 uint8_t
-bej_decode(bej_context_t *ctx)
+bej_set_style(bej_context_t *ctx, uint8_t style)
 {
-    if (!ctx || !ctx->bej_data || !ctx->output){
-        errmsg("Invalid context");
+    if (!ctx || (style != BEJ_STYLE_PRETTY && style != BEJ_STYLE_COMPACT)) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    ctx->style = style;
+    return SUCCESS;
+}
+
+uint8_t
+bej_set_log_callback(bej_context_t *ctx, bej_log_fn fn, void *user)
+{
+    if (!ctx) {
+        errmsg("Invalid parameters");
         return FAILURE;
     }
 
+    ctx->log = fn;
+    ctx->log_data = fn ? user : NULL;
+    return SUCCESS;
+}
+
+uint8_t
+bej_set_encoding(bej_context_t *ctx, uint8_t encoding)
+{
+    if (!ctx || encoding > BEJ_ENCODING_MSGPACK) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    ctx->encoding = encoding;
+    return SUCCESS;
+}
+
+bej_frame_t *
+bej_push_frame(bej_context_t *ctx)
+{
+    if (ctx->depth >= ctx->max_depth) {
+        errmsg_ctx(ctx, "BEJ nesting too deep: more than %zu levels", ctx->max_depth);
+        return NULL;
+    }
+
+    if (ctx->depth == ctx->frames_cap) {
+        if (ctx->frames && !ctx->owns_frames) {
+            errmsg_ctx(ctx, "BEJ nesting exceeds the %zu frames provided", ctx->frames_cap);
+            return NULL;
+        }
+        size_t cap = ctx->frames_cap ? ctx->frames_cap * 2 : 16UL;
+        bej_frame_t *frames = realloc(ctx->frames, cap * sizeof(bej_frame_t));
+        if (!frames) {
+            errmsg_ctx(ctx, "Failed to allocate %zu decoder frames", cap);
+            return NULL;
+        }
+        ctx->frames = frames;
+        ctx->frames_cap = cap;
+        ctx->owns_frames = 1U;
+    }
+
+    bej_frame_t *frame = &ctx->frames[ctx->depth++];
+    memset(frame, 0, sizeof(bej_frame_t));
+    return frame;
+}
+
+/* same output as decode_bej_sflv() from the root, but the open sets/arrays live in ctx->frames
+*  instead of on the call stack, so nesting is only limited by ctx->max_depth
+*  root_entry, if given, describes the first tuple instead of a lookup of its sequence
+*  parent, if given, is the set/array the first tuple is an element of, see bej_decode_element()
+*/
+static uint8_t
+decode_bej_iterative(bej_context_t *ctx, bej_dictionary_context_t *dict,
+                     const bej_dict_entry_t *root_entry, const bej_frame_t *parent)
+{
+    uint16_t child_offset = ctx->parent_child_offset[0];
+    uint16_t child_count = ctx->parent_child_count[0];
+    uint8_t range_selector = BEJ_DICT_SCHEMA;
+    uint8_t add_name = 0U;
+    size_t end = ctx->bej_size;     // of the innermost open set/array
+    if (parent) {
+        child_offset = parent->child_offset;
+        child_count = parent->child_count;
+        range_selector = parent->dict_selector;
+        add_name = (parent->format == BEJ_FORMAT_SET);
+        end = parent->end;
+    }
+
+    ctx->depth = 0UL;
+    for (;;) {
+        uint32_t sequence = 0U;
+        uint8_t dict_selector = 0U;
+        uint8_t format = 0U;
+        uint8_t flags = 0U;
+        uint32_t length = 0U;
+
+        if (bej_read_sequence_number(ctx->bej_data, &ctx->offset, end,
+                                     &sequence, &dict_selector)) {
+            errmsg_ctx(ctx, "Failed to read sequence number at offset %zu", ctx->offset);
+            return FAILURE;
+        }
+        if (bej_read_format(ctx->bej_data, &ctx->offset, end,
+                            &format, &flags)) {
+            errmsg_ctx(ctx, "Failed to read format at offset %zu", ctx->offset);
+            return FAILURE;
+        }
+        if (bej_read_nnint(ctx->bej_data, &ctx->offset, end, &length)) {
+            errmsg_ctx(ctx, "Failed to read length at offset %zu", ctx->offset);
+            return FAILURE;
+        }
+        /* a value running past its set/array would make the parent rewind to its own end
+        *  and decode the same bytes again, nested that is exponential
+        */
+        if (length > end - ctx->offset) {
+            errmsg_ctx(ctx, "Value length %u exceeds its enclosing value at offset %zu", length, ctx->offset);
+            return FAILURE;
+        }
+        BEJ_STAT(ctx->stats.tuples++, ctx->stats.format_tuples[format & 0x0FU]++,
+                 ctx->stats.format_bytes[format & 0x0FU] += length);
+
+        // performing dict lookup, unknown entries have no children
+        bej_dict_entry_t entry = {0};
+        bej_dictionary_context_t *entry_dict = dict;
+        uint8_t found_entry = 0U;
+        if (root_entry) {
+            entry = *root_entry;
+            found_entry = 1U;
+            root_entry = NULL;
+        } else {
+            // array elements carry their index as sequence, see decode_bej_sflv()
+            uint8_t in_array = (ctx->depth || parent) && !add_name;
+            found_entry = !bej_lookup_tuple(ctx, child_offset, child_count, range_selector,
+                                            in_array ? 0U : sequence,
+                                            in_array ? range_selector : dict_selector,
+                                            &entry, &entry_dict);
+        }
+        if (add_name) {
+            write_member_name(ctx, entry_dict, found_entry ? &entry : NULL, sequence);
+        }
+
+        uint8_t completed = 1U;
+        if (format == BEJ_FORMAT_SET || format == BEJ_FORMAT_ARRAY) {
+            bej_frame_t *frame = bej_push_frame(ctx);
+            if (!frame)
+                return FAILURE;
+            frame->end = ctx->offset + length;
+            frame->child_offset = entry.child_offset;
+            frame->child_count = entry.child_count;
+            frame->format = format;
+            frame->dict_selector = (entry_dict == &ctx->anno_dict);
+
+            if (bej_read_nnint(ctx->bej_data, &ctx->offset, frame->end, &frame->count)) {
+                errmsg_ctx(ctx, "Failed to read %s count", (format == BEJ_FORMAT_SET) ? "set" : "array");
+                return FAILURE;
+            }
+            write_open(ctx, format, frame->count);
+            ctx->indent_level++;
+            BEJ_STAT(if ((uint64_t)ctx->depth > ctx->stats.max_depth) ctx->stats.max_depth = ctx->depth);
+            completed = 0U;
+
+            // big enough to be worth threads: the elements are decoded at once, closing stays below
+            if (ctx->parallel_threads > 1U && length >= ctx->parallel_min_bytes && frame->count > 1U
+                && bej_decode_parallel(ctx, frame))
+                return FAILURE;
+        } else {
+            uint8_t *value = &ctx->bej_data[ctx->offset];
+            ctx->offset += length;
+            if (decode_bej_leaf(ctx, entry_dict, format, &entry, value, length))
+                return FAILURE;
+        }
+
+        // separators, then either the next element or closing of every finished set/array
+        while (ctx->depth) {
+            bej_frame_t *frame = &ctx->frames[ctx->depth - 1];
+
+            if (completed) {
+                write_separator(ctx, frame->index, frame->count);
+                frame->index++;
+            }
+            if (frame->index < frame->count && ctx->offset < frame->end) {
+                write_indent(ctx);
+                break;
+            }
+
+            ctx->indent_level--;
+            if (write_close(ctx, frame->format, frame->index, frame->count))
+                return FAILURE;
+
+            // check if length matches expectations
+            if (ctx->offset != frame->end) {
+                warnmsg_ctx(ctx, "%s length mismatch: expected %zu, got %zu",
+                        (frame->format == BEJ_FORMAT_SET) ? "Set" : "Array", frame->end, ctx->offset);
+                BEJ_STAT(ctx->stats.length_mismatches++);
+                ctx->offset = frame->end;
+            }
+            ctx->depth--;
+            completed = 1U;
+        }
+        if (!ctx->depth)
+            return SUCCESS;
+
+        bej_frame_t *parent = &ctx->frames[ctx->depth - 1];
+        child_offset = parent->child_offset;
+        child_count = parent->child_count;
+        range_selector = parent->dict_selector;
+        add_name = (parent->format == BEJ_FORMAT_SET);
+        end = parent->end;
+    }
+}
+
+uint8_t
+bej_check_header(const uint8_t *data, size_t size)
+{
     // check if we need to actually check anything here
-    if (ctx->bej_size < 7UL) {
+    if (size < BEJ_HEADER_SIZE) {
         errmsg("Not a valid BEJ data");
         return FAILURE;
     }
 
     // either 1.1.0 or 1.1.0 is supported
-    if (!(ctx->bej_data[0] == 0x00 && ctx->bej_data[1] == 0xF0
-        && (ctx->bej_data[2] == 0xF0 || ctx->bej_data[2] == 0xF1)
-        && ctx->bej_data[3] == 0xF1)) {
+    if (!(data[0] == 0x00 && data[1] == 0xF0
+        && (data[2] == 0xF0 || data[2] == 0xF1)
+        && data[3] == 0xF1)) {
         errmsg("Unsupported BEJ version field: %#x",
-               READ_U32_LE(ctx->bej_data, ctx->offset));
+               READ_U32_LE(data, 0));
         return FAILURE;
     }
 
-    if (!(ctx->bej_data[4] == 0x00 && ctx->bej_data[5] == 0x00)) {
+    if (!(data[4] == 0x00 && data[5] == 0x00)) {
         warnmsg("Non-zero BEJ flags: %#x",
-                READ_U16_LE(ctx->bej_data, ctx->offset));
+                READ_U16_LE(data, 4));
     }
 
-    if (!(ctx->bej_data[6] == 0x00 || ctx->bej_data[5] == 0x01)) {
-        if (ctx->bej_data[6] == 0x04) {
+    if (!(data[6] == 0x00 || data[5] == 0x01)) {
+        if (data[6] == 0x04) {
             warnmsg("The \"ERROR\" schema class (0x04) is not supported");
         }
         errmsg("Invalid BEJ schemaClass");
         return FAILURE;
     }
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_decode(bej_context_t *ctx)
+{
+    if (!ctx || !ctx->bej_data){
+        errmsg("Invalid context");
+        return FAILURE;
+    }
+
+    if (bej_check_header(ctx->bej_data, ctx->bej_size))
+        return FAILURE;
     
-    ctx->offset += 7;   // unevenly skipping both version and flags bytes
+    ctx->offset += BEJ_HEADER_SIZE;   // unevenly skipping both version and flags bytes
 
-    dbgmsg("Header is valid. Starting BEJ decode, data size: %zu bytes", ctx->bej_size);
+    dbgmsg_ctx(ctx, "Header is valid. Starting BEJ decode, data size: %zu bytes", ctx->bej_size);
 
     // decoding the root SFLV
-    return decode_bej_sflv(ctx, &ctx->schema_dict, 0U);
+    uint8_t result = decode_bej_iterative(ctx, &ctx->schema_dict, NULL, NULL);
+
+    if (bej_flush(ctx))
+        return FAILURE;
+
+    return result;
+}
+
+uint8_t
+bej_decode_value(bej_context_t *ctx, const bej_dict_entry_t *entry)
+{
+    if (!ctx || !ctx->bej_data) {
+        errmsg("Invalid context");
+        return FAILURE;
+    }
+
+    return decode_bej_iterative(ctx, &ctx->schema_dict, entry, NULL);
+}
+
+uint8_t
+bej_decode_element(bej_context_t *ctx, const bej_frame_t *parent)
+{
+    if (!ctx || !ctx->bej_data || !parent) {
+        errmsg("Invalid context");
+        return FAILURE;
+    }
+
+    return decode_bej_iterative(ctx, &ctx->schema_dict, NULL, parent);
 }
 
-#ifdef NDEBUG
+#if BEJ_LOG_LEVEL >= BEJ_LOG_DEBUG
 void
 bej_dump_dictionary(bej_dictionary_context_t *dict, uint16_t max_entries)
 {
@@ -507,7 +1255,7 @@ bej_dump_dictionary(bej_dictionary_context_t *dict, uint16_t max_entries)
         return;
     }
     
-    infomsg("\n=== Dictionary Dump ===\n"
+    dbgmsg("\n=== Dictionary Dump ===\n"
             "Version: %u, Truncation: %u\n"
             "Entry Count: %u\n"
             "Schema Version: %#08x\n"
@@ -520,7 +1268,7 @@ bej_dump_dictionary(bej_dictionary_context_t *dict, uint16_t max_entries)
                                ? dict->entry_count : max_entries;
     
     for (uint16_t i = 0; i < entries_to_show && offset < dict->data_size; i++) {
-        infomsg("\n--- Entry %u (offset %#zx) ---", i, offset);
+        dbgmsg("\n--- Entry %u (offset %#zx) ---", i, offset);
         
         uint8_t format = READ_U8_AND_INC(dict->data, offset);
         uint16_t seq = READ_U16_LE(dict->data, offset);
@@ -533,7 +1281,7 @@ bej_dump_dictionary(bej_dictionary_context_t *dict, uint16_t max_entries)
         uint16_t name_off = READ_U16_LE(dict->data, offset);
         offset += 2;
 
-        infomsg("\n\tFormat: %u"
+        dbgmsg("\n\tFormat: %u"
                 "\n\tSequence: %u"
                 "\n\tChild Pointer Offset: %#x"
                 "\n\tChild Count: %u"
@@ -542,23 +1290,78 @@ bej_dump_dictionary(bej_dictionary_context_t *dict, uint16_t max_entries)
                 format, seq, child_offset_ptr, child_count, name_length, name_off);
         
         if (name_off > 0 && name_off < dict->data_size) {            
-            if (name_length > 0 && name_off + 1 + name_length <= dict->data_size) {
+            if (name_length > 0 && (size_t)name_off + 1U + name_length <= dict->data_size) {
                 char name_buf[256];
                 size_t copy_len = (name_length < sizeof(name_buf) - 1) ? name_length : sizeof(name_buf) - 1;
                 memcpy(name_buf, &dict->data[name_off], copy_len);
                 name_buf[copy_len] = '\0';
-                infomsg("\tName: '%s'", name_buf);
+                dbgmsg("\tName: '%s'", name_buf);
             } else {
-                infomsg("\tName: <invalid length or offset>");
+                dbgmsg("\tName: <invalid length or offset>");
             }
         } else {
-            infomsg("\tName: <no name>");
+            dbgmsg("\tName: <no name>");
         }
     }
     
-    infomsg("\n=== End Dictionary Dump ===\n");
+    dbgmsg("\n=== End Dictionary Dump ===\n");
+}
+#endif /* BEJ_LOG_LEVEL */
+
+uint8_t
+bej_init_context_with_dict(bej_context_t *ctx, bej_dictionary_context_t *schema_dict,
+                           uint8_t *bej_data, size_t bej_size,
+                           FILE *output)
+{
+    if (!ctx || !schema_dict || !schema_dict->data || !bej_data) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(ctx, 0, sizeof(bej_context_t));
+
+    // borrowed: lookups only ever read the dictionary and its index
+    ctx->schema_dict = *schema_dict;
+    ctx->bej_data = bej_data;
+    ctx->bej_size = bej_size;
+    ctx->offset = 0UL;
+    ctx->output = output;
+    ctx->indent_level = 0;
+    ctx->parent_child_offset[0] = 12L;
+    ctx->parent_child_count[0] = ctx->schema_dict.entry_count;
+    ctx->max_depth = BEJ_DEFAULT_MAX_DEPTH;
+    ctx->parallel_min_bytes = BEJ_PARALLEL_MIN_BYTES;
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_set_annotation_dict(bej_context_t *ctx, bej_dictionary_context_t *anno_dict)
+{
+    if (!ctx) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(&ctx->anno_dict, 0, sizeof(ctx->anno_dict));
+    ctx->anno_child_offset = 0U;
+    ctx->anno_child_count = 0U;
+    if (!anno_dict)
+        return SUCCESS;
+
+    // the annotations themselves are the children of the root entry
+    bej_dict_entry_t root;
+    if (!anno_dict->data
+        || bej_dict_lookup(anno_dict, BEJ_DICT_HEADER_SIZE, anno_dict->entry_count, 0U, &root)) {
+        errmsg_ctx(ctx, "Annotation dictionary has no root entry");
+        return FAILURE;
+    }
+    ctx->anno_dict = *anno_dict;
+    ctx->anno_child_offset = root.child_offset;
+    ctx->anno_child_count = root.child_count;
+
+    return SUCCESS;
 }
-#endif /* NDEBUG */
 
 uint8_t
 bej_init_context(bej_context_t *ctx,
@@ -572,28 +1375,40 @@ bej_init_context(bej_context_t *ctx,
         return FAILURE;
     }
 
-    memset(ctx, 0, sizeof(bej_context_t));
-
-    if (bej_parse_dict(&ctx->schema_dict, schema_data, schema_size) != 0) {
+    bej_dictionary_context_t schema_dict;
+    if (bej_parse_dict(&schema_dict, schema_data, schema_size) != 0) {
         errmsg("Failed to parse schema dictionary");
         return FAILURE;
     }
 
-#ifdef NDEBUG
+    if (bej_init_context_with_dict(ctx, &schema_dict, bej_data, bej_size, output)) {
+        bej_free_dict(&schema_dict);
+        return FAILURE;
+    }
+    ctx->owns_schema_dict = 1U;
+
+#if BEJ_LOG_LEVEL >= BEJ_LOG_DEBUG
     bej_dump_dictionary(&ctx->schema_dict, bej_size);
-#endif /* NDEBUG */
+#endif /* BEJ_LOG_LEVEL */
     
     /*if (anno_data && anno_size > 0) {
         bej_parse_dict(&ctx->anno_dict, anno_data, anno_size);
     }*/
     
-    ctx->bej_data = bej_data;
-    ctx->bej_size = bej_size;
-    ctx->offset = 0UL;
-    ctx->output = output;
-    ctx->indent_level = 0;
-    ctx->parent_child_offset[0] = 12L;
-    ctx->parent_child_count[0] = ctx->schema_dict.entry_count;
-    
     return SUCCESS;
+}
+
+void
+bej_free_context(bej_context_t *ctx)
+{
+    if (!ctx)
+        return;
+
+    if (ctx->owns_schema_dict)
+        bej_free_dict(&ctx->schema_dict);
+    ctx->owns_schema_dict = 0U;
+    free(ctx->out.data);
+    memset(&ctx->out, 0, sizeof(ctx->out));
+    bej_set_frame_stack(ctx, NULL, 0UL);
+    ctx->depth = 0UL;
 }
\ No newline at end of file
@@ -28,6 +28,76 @@ enum eBEJflags {
     BEJ_FLAG_NESTED_TOP_LEVEL_ANNOTATION = 1 << 1
 };
 
+/**
+ * Dictionary a sequence number refers to, bit 0 of the encoded sequence
+ */
+enum eBEJdictSelector {
+    BEJ_DICT_SCHEMA = 0,
+    BEJ_DICT_ANNOTATION = 1
+};
+
+/**
+ * Layout of the JSON text written by the decoder
+ */
+enum eBEJstyle {
+    BEJ_STYLE_PRETTY = 0,   // one member per line, tab indented
+    BEJ_STYLE_COMPACT = 1   // no insignificant whitespace, e.g. for NDJSON
+};
+
+/**
+ * What the decoder writes, JSON text or the same document transcoded to a binary format
+ */
+enum eBEJencoding {
+    BEJ_ENCODING_JSON = 0,
+    BEJ_ENCODING_CBOR = 1,      // RFC 8949, definite lengths only
+    BEJ_ENCODING_MSGPACK = 2
+};
+
+/**
+ * Represents single dictionary entry
+ */
+typedef struct {
+    uint8_t format;
+    uint16_t sequence;
+    uint16_t child_offset;
+    uint16_t child_count;
+    uint8_t name_length;
+    uint16_t name_offset;
+    uint16_t index;     // position in the entry table
+} bej_dict_entry_t;
+
+/**
+ * Entry name quoted and followed by ": ", ready to be copied to the output
+ */
+typedef struct {
+    uint32_t offset;    // into bej_dict_index_t::name_pool
+    uint16_t length;    // 0 for entries without a (readable) name
+    uint16_t reserved;
+} bej_dict_name_t;
+
+/**
+ * Sequence lookup table of a single child range, keyed by the index of the range's first entry
+ */
+typedef struct {
+    uint32_t slot;      // first slot in bej_dict_index_t::slots, BEJ_DICT_RANGE_NONE if not indexed
+    uint16_t span;      // highest sequence in the range + 1
+    uint16_t count;     // child count the table was built for
+} bej_dict_range_t;
+
+/**
+ * One-time lookup index built by bej_parse_dict(), turns sequence lookups into O(1) table reads
+ */
+typedef struct {
+    bej_dict_entry_t *entries;  // decoded entries, entry_count long
+    bej_dict_range_t *ranges;   // per entry, describes the child range starting at it
+    uint16_t *slots;            // entry index by sequence, BEJ_DICT_INDEX_NONE for gaps
+    bej_dict_name_t *names;     // per entry, pre-quoted names
+    char *name_pool;
+    uint32_t slot_count;
+    uint32_t name_pool_size;
+    void *storage;              // owned allocation backing the tables above, NULL if mapped
+} bej_dict_index_t;
+
 /**
  * This one is a helper struct to store both header & data information as regards dictionary 
  */
@@ -39,34 +109,85 @@ typedef struct {
     uint32_t dictionary_size;
     uint8_t *data;
     size_t data_size;
+    bej_dict_index_t index;     // empty when the entry table doesn't fit the data
 } bej_dictionary_context_t;
 
 /**
- * Represents single dictionary entry
+ * Output buffer the decoder appends to, drained into the context's FILE by bej_flush()
  */
 typedef struct {
-    uint8_t format;
-    uint16_t sequence;
-    uint16_t child_offset;
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    uint8_t error;      // latched on allocation or write failure
+} bej_output_t;
+
+/**
+ * Set or array being decoded, one per nesting level of bej_decode() and the streaming decoder
+ */
+typedef struct {
+    size_t end;             // offset the value ends at
+    uint32_t count;
+    uint32_t index;         // elements completed so far
+    uint16_t child_offset;  // dictionary range the elements are looked up in
     uint16_t child_count;
-    uint8_t name_length;
-    uint16_t name_offset;
-} bej_dict_entry_t;
+    uint8_t format;         // BEJ_FORMAT_SET or BEJ_FORMAT_ARRAY
+    uint8_t dict_selector;  // dictionary the range belongs to, enum eBEJdictSelector
+} bej_frame_t;
+
+/**
+ * Counters of the decodes of one context, only collected when built with BEJ_STATS
+ *
+ * Part of bej_context_t either way, so the layout of the context doesn't depend on the option.
+ */
+typedef struct {
+    uint64_t tuples;            // SFLV tuples read
+    uint64_t lookups;           // dictionary lookups for those tuples
+    uint64_t probes;            // dictionary entries examined by them, one per lookup when indexed
+    uint64_t unknown;           // lookups that found no entry
+    uint64_t length_mismatches; // sets/arrays whose elements didn't end at their length, skipped to it
+    uint64_t max_depth;         // deepest set/array nesting reached
+    uint64_t format_tuples[BEJ_STATS_FORMATS];  // by enum eBEJtype
+    uint64_t format_bytes[BEJ_STATS_FORMATS];   // value bytes, a set or array includes its members
+} bej_stats_t;
+
+#ifdef BEJ_STATS
+#define BEJ_STAT(...) do { __VA_ARGS__; } while (0)
+#else
+#define BEJ_STAT(...) ((void)0)
+#endif /* BEJ_STATS */
 
 /**
  * This one is a helper struct to maintain decoder context and mainly reduce verbosity
- * @todo Implement and integrate annotation dictionary logic
  */
 typedef struct {
     bej_dictionary_context_t schema_dict;
-    //bej_dictionary_t anno_dict;
+    uint8_t owns_schema_dict;   // 0 when borrowed through bej_init_context_with_dict()
+    bej_dictionary_context_t anno_dict;     // borrowed, data is NULL without one
+    uint16_t anno_child_offset;             // top-level annotations, children of its root
+    uint16_t anno_child_count;
     uint8_t *bej_data;
     size_t bej_size;
     size_t offset;
     FILE *output;
+    bej_output_t out;
+    uint8_t style;      // enum eBEJstyle
+    uint8_t encoding;   // enum eBEJencoding
     int indent_level;
+    // only used by decode_bej_sflv() and friends, bej_decode() keeps the ranges in frames
     uint16_t parent_child_offset[BEJ_CONTEXT_STACK_MAX_DEPTH];
     uint16_t parent_child_count[BEJ_CONTEXT_STACK_MAX_DEPTH];
+    uint8_t parent_dict_selector[BEJ_CONTEXT_STACK_MAX_DEPTH];
+    bej_frame_t *frames;    // open sets/arrays, grown on demand unless set by bej_set_frame_stack()
+    size_t frames_cap;
+    size_t depth;
+    size_t max_depth;       // nesting limit, BEJ_DEFAULT_MAX_DEPTH unless changed after init
+    uint8_t owns_frames;
+    bej_log_fn log;         // NULL logs through bej_set_log_handler()
+    void *log_data;
+    unsigned parallel_threads;  // 0 or 1 decodes on the calling thread only, see bej_set_parallel()
+    size_t parallel_min_bytes;  // smallest set/array whose elements are decoded on threads
+    bej_stats_t stats;      // since bej_init_context*(), stays zero without BEJ_STATS, see bej_get_stats()
 } bej_context_t;
 
 
@@ -79,6 +200,51 @@ typedef struct {
 uint8_t bej_decode(bej_context_t *ctx);
 
 
+/**
+ * @brief Decode the single SFLV tuple at ctx->offset, without its member name
+ * 
+ * Unlike bej_decode() there is no header to check and output is not flushed.
+ * 
+ * @param ctx BEJ decoder context, ctx->offset at the start of the tuple
+ * @param entry Dictionary entry describing the tuple, NULL to look its sequence up
+ *              in the root range, ctx->parent_child_offset[0] / ctx->parent_child_count[0]
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_decode_value(bej_context_t *ctx, const bej_dict_entry_t *entry);
+
+
+/**
+ * @brief Counters collected by the decodes of a context since it was initialized
+ * 
+ * @param ctx BEJ decoder context
+ * @return Counters, NULL when the library is built without BEJ_STATS
+ */
+const bej_stats_t *bej_get_stats(const bej_context_t *ctx);
+
+
+/**
+ * @brief Write the counters of a context as one line of JSON, with decode time and throughput
+ * 
+ * Without BEJ_STATS only the time, the document size and the throughput in bytes are written.
+ * 
+ * @param ctx BEJ decoder context after bej_decode()
+ * @param seconds Time the decode took, as measured by the caller
+ * @param out Stream to write to
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_write_stats(const bej_context_t *ctx, double seconds, FILE *out);
+
+
+/**
+ * @brief Validate BEJ encoding header (version, flags, schema class)
+ * 
+ * @param data Start of BEJ encoded data
+ * @param size Size of data, at least BEJ_HEADER_SIZE bytes are needed
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_check_header(const uint8_t *data, size_t size);
+
+
 /**
  * @brief Initialize BEJ decoder context
  * 
@@ -97,7 +263,160 @@ uint8_t bej_init_context(bej_context_t *ctx,
 
 
 /**
- * @brief Parse BEJ dictionary
+ * @brief Decode into caller-provided frame storage instead of a heap-allocated one
+ * 
+ * Nesting deeper than the given storage fails instead of growing it. The storage must
+ * outlive the decoding, pass NULL to go back to the heap.
+ * 
+ * @param ctx BEJ decoder context
+ * @param frames Frame storage, one frame per nesting level
+ * @param count Number of frames
+ * @return nothing
+ */
+void bej_set_frame_stack(bej_context_t *ctx, bej_frame_t *frames, size_t count);
+
+
+/**
+ * @brief Choose how the JSON is laid out, pretty unless set otherwise
+ * 
+ * BEJ_STYLE_COMPACT leaves out every newline and indent, which is about half of the
+ * pretty output for typical Redfish resources.
+ * 
+ * @param ctx BEJ decoder context
+ * @param style Output style, enum eBEJstyle
+ * @return SUCCESS or FAILURE for an unknown style
+ */
+uint8_t bej_set_style(bej_context_t *ctx, uint8_t style);
+
+
+/**
+ * @brief Choose the output format, JSON unless set otherwise
+ * 
+ * CBOR and MessagePack are written straight from the BEJ tuples: sets become maps keyed by
+ * the dictionary names, arrays become arrays, integers, reals, booleans and nulls keep their
+ * native types. The style is ignored for them. Every map, array and string has a definite
+ * length, so a set or array holding fewer elements than its count fails the decode.
+ * 
+ * @param ctx BEJ decoder context
+ * @param encoding Output format, enum eBEJencoding
+ * @return SUCCESS or FAILURE for an unknown encoding
+ */
+uint8_t bej_set_encoding(bej_context_t *ctx, uint8_t encoding);
+
+/**
+ * @brief Send the messages of this context's decode to a callback of its own
+ * 
+ * Errors and warnings about the document (length mismatches, unreadable tuples, out of range
+ * reals) reach fn together with their level, for instance to tag them with a request id or to
+ * count them. Messages compiled out by BEJ_LOG_LEVEL never get here. Call it after the context
+ * is initialized, which resets it.
+ * 
+ * @param ctx BEJ decoder context
+ * @param fn Callback, NULL for the process-wide handler
+ * @param user Passed back to fn
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_set_log_callback(bej_context_t *ctx, bej_log_fn fn, void *user);
+
+
+/**
+ * @brief Decode the elements of big sets and arrays on several threads
+ * 
+ * Every element carries its length, so the ones of a set or array of at least min_bytes are
+ * found by a pre-scan that reads only their headers. Chunks of them are then decoded by a
+ * work-stealing pool of threads into buffers of their own, which are copied to the output in
+ * document order: the result is byte for byte the one of a decode on one thread. A set/array
+ * with an element bigger than 1 / threads of it is not split up, the decode goes on into that
+ * element, so the Members of a collection are split rather than the resource around them.
+ * Only bej_decode() does so, sets and arrays within an element that got split stay on its
+ * thread. The log callback may be called from the threads concurrently.
+ * 
+ * @param ctx BEJ decoder context
+ * @param threads Threads to decode on, the calling one included. 0 for one per online CPU,
+ *                1 to decode on the calling thread only, which is the default
+ * @param min_bytes Smallest set/array value to split up, 0 for BEJ_PARALLEL_MIN_BYTES
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_set_parallel(bej_context_t *ctx, unsigned threads, size_t min_bytes);
+
+
+/**
+ * @brief Write buffered output to the context's output stream
+ * 
+ * bej_decode() flushes on return, callers of the individual decode_* helpers have to do it themselves.
+ * Contexts without an output stream keep everything in ctx->out.
+ * 
+ * @param ctx BEJ decoder context
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_flush(bej_context_t *ctx);
+
+
+/**
+ * @brief Release resources held by BEJ decoder context
+ * 
+ * @param ctx Context to release, may be reused after bej_init_context()
+ * @return nothing
+ */
+void bej_free_context(bej_context_t *ctx);
+
+
+/**
+ * @brief Initialize BEJ decoder context around an already parsed dictionary
+ * 
+ * The dictionary is borrowed and only read, so one parsed dictionary can back any number of
+ * contexts, including ones decoding concurrently. It must outlive them.
+ * 
+ * @param ctx Context to initialize
+ * @param schema_dict Dictionary parsed with bej_parse_dict()
+ * @param bej_data BEJ encoded data
+ * @param bej_size Size of BEJ data
+ * @param output Output stream for JSON. NULL keeps the whole document in ctx->out
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_init_context_with_dict(bej_context_t *ctx, bej_dictionary_context_t *schema_dict,
+                                   uint8_t *bej_data, size_t bej_size,
+                                   FILE *output);
+
+
+/**
+ * @brief Resolve annotations (dictionary selector 1) through an annotation dictionary
+ * 
+ * Borrowed like the schema dictionary of bej_init_context_with_dict(), so one parsed and
+ * indexed annotation dictionary serves every document. Without one, annotations decode
+ * as unknown_N members.
+ * 
+ * @param ctx BEJ decoder context
+ * @param anno_dict Annotation dictionary parsed with bej_parse_dict(), NULL to drop it
+ * @return SUCCESS or FAILURE if the dictionary has no root entry
+ */
+uint8_t bej_set_annotation_dict(bej_context_t *ctx, bej_dictionary_context_t *anno_dict);
+
+
+/**
+ * @brief Find the dictionary entry of a tuple, following its dictionary selector
+ * 
+ * Within a range of the dictionary the selector names, the sequence is looked up in that
+ * range. An annotation inside a schema set or array is looked up among the top-level
+ * annotations instead.
+ * 
+ * @param ctx BEJ decoder context
+ * @param child_offset Byte offset of the first entry of the enclosing range
+ * @param child_count Number of entries in the enclosing range
+ * @param range_selector Dictionary the enclosing range belongs to
+ * @param sequence Sequence number of the tuple
+ * @param dict_selector Dictionary selector of the tuple
+ * @param entry Output entry structure
+ * @param dict Output, dictionary the entry belongs to, the schema dictionary when none is found
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_lookup_tuple(bej_context_t *ctx, uint16_t child_offset, uint16_t child_count,
+                         uint8_t range_selector, uint32_t sequence, uint8_t dict_selector,
+                         bej_dict_entry_t *entry, bej_dictionary_context_t **dict);
+
+
+/**
+ * @brief Parse BEJ dictionary and build its sequence lookup index
  * 
  * @param dict Dictionary structure to populate
  * @param data Dictionary binary data
@@ -107,6 +426,31 @@ uint8_t bej_init_context(bej_context_t *ctx,
 uint8_t bej_parse_dict(bej_dictionary_context_t *dict, uint8_t *data, size_t size);
 
 
+/**
+ * @brief Release lookup index built by bej_parse_dict()
+ * 
+ * @param dict Dictionary to release, the raw data is left untouched
+ * @return nothing
+ */
+void bej_free_dict(bej_dictionary_context_t *dict);
+
+
+/**
+ * @brief Find dictionary entry by sequence number within given child range
+ * 
+ * Uses the index when the range is covered by it, falls back to linear scan otherwise.
+ * 
+ * @param dict Dictionary to search
+ * @param child_offset Byte offset of the first entry of the range
+ * @param child_count Number of entries in the range
+ * @param sequence Sequence number to find
+ * @param entry Output entry structure
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_dict_lookup(bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count,
+                        uint32_t sequence, bej_dict_entry_t *entry);
+
+
 /**
  * @brief Read NNINT (Non-Negative Integer) from BEJ stream
  * 
@@ -177,6 +521,8 @@ uint8_t bej_read_format(uint8_t *data, size_t *offset, size_t size,
 /**
  * @brief Recursively decode SFLV blocks starting from root
  * 
+ * Nesting is limited to BEJ_CONTEXT_STACK_MAX_DEPTH, bej_decode() uses an iterative loop instead.
+ * 
  * @param ctx BEJ decoder context
  * @param dict Dictionary to search
  * @param add_name Whether entry name must be written to ctx->output. 1U - Write name; 0 - Don't
@@ -186,6 +532,21 @@ uint8_t decode_bej_sflv(bej_context_t *ctx, bej_dictionary_context_t *dict,
                         uint8_t add_name);
 
 
+/**
+ * @brief Decode any non-set, non-array value once all of its bytes are available
+ * 
+ * @param ctx BEJ decoder context
+ * @param dict Dictionary to search
+ * @param format Value format, enum eBEJtype
+ * @param entry Dictionary entry of the value, zeroed if unknown
+ * @param value Value bytes
+ * @param length Value length
+ * @return SUCCESS or FAILURE
+ */
+uint8_t decode_bej_leaf(bej_context_t *ctx, bej_dictionary_context_t *dict, uint8_t format,
+                        bej_dict_entry_t *entry, uint8_t *value, uint32_t length);
+
+
 /**
  * @brief Decode Integer enum object
  * 
@@ -197,6 +558,17 @@ uint8_t decode_bej_sflv(bej_context_t *ctx, bej_dictionary_context_t *dict,
 uint8_t decode_integer(bej_context_t *ctx, uint8_t *value, uint32_t length);
 
 
+/**
+ * @brief Decode Real object, printed as the shortest JSON number that reads back as the same double
+ * 
+ * @param ctx BEJ decoder context
+ * @param value Real value pointer
+ * @param length Value length
+ * @return SUCCESS or FAILURE
+ */
+uint8_t decode_real(bej_context_t *ctx, uint8_t *value, uint32_t length);
+
+
 /**
  * @brief Decode String enum object
  * 
@@ -243,7 +615,7 @@ uint8_t decode_set(bej_context_t *ctx, uint32_t length,
 uint8_t decode_array(bej_context_t *ctx, uint32_t length,
                      bej_dictionary_context_t *dict);
 
-#ifdef NDEBUG
+#if BEJ_LOG_LEVEL >= BEJ_LOG_DEBUG
 /**
  * @brief Dump dictionary contents for debugging
  * 
@@ -0,0 +1,162 @@
+/**
+ * @file bej_compiled.c
+ * @brief Compiled, mmap-able dictionary format
+ */
+#include "bej_compiled.h"
+
+#define BEJ_COMPILED_ALIGN_UP(n) (((n) + BEJ_COMPILED_ALIGN - 1) & ~(BEJ_COMPILED_ALIGN - 1))
+
+int
+bej_is_compiled_dict(const uint8_t *data, size_t size)
+{
+    return data && size >= sizeof(bej_compiled_header_t)
+        && !memcmp(data, BEJ_COMPILED_MAGIC, sizeof(((bej_compiled_header_t *)0)->magic));
+}
+
+uint8_t
+bej_compile_dict(bej_dictionary_context_t *dict, uint8_t **out, size_t *out_size)
+{
+    if (!dict || !dict->data || !dict->index.entries || !out || !out_size) {
+        errmsg("Dictionary has no index to compile");
+        return FAILURE;
+    }
+
+    bej_dict_index_t *index = &dict->index;
+    uint16_t n = dict->entry_count;
+    bej_compiled_header_t header = {
+        .version = BEJ_COMPILED_VERSION,
+        .byte_order = BEJ_COMPILED_BYTE_ORDER,
+        .entry_size = sizeof(bej_dict_entry_t),
+        .range_size = sizeof(bej_dict_range_t),
+        .name_size = sizeof(bej_dict_name_t),
+        .entry_count = n,
+        .slot_count = index->slot_count,
+        .name_pool_size = index->name_pool_size,
+    };
+    memcpy(header.magic, BEJ_COMPILED_MAGIC, sizeof(header.magic));
+
+    size_t size = BEJ_COMPILED_ALIGN_UP(sizeof(header));
+    header.source_offset = size;
+    header.source_size = dict->data_size;
+    size = BEJ_COMPILED_ALIGN_UP(size + dict->data_size);
+    header.entries_offset = size;
+    size = BEJ_COMPILED_ALIGN_UP(size + n * sizeof(bej_dict_entry_t));
+    header.ranges_offset = size;
+    size = BEJ_COMPILED_ALIGN_UP(size + n * sizeof(bej_dict_range_t));
+    header.slots_offset = size;
+    size = BEJ_COMPILED_ALIGN_UP(size + index->slot_count * sizeof(uint16_t));
+    header.names_offset = size;
+    size = BEJ_COMPILED_ALIGN_UP(size + n * sizeof(bej_dict_name_t));
+    header.name_pool_offset = size;
+    size += index->name_pool_size;
+
+    uint8_t *blob = calloc(1, size);
+    if (!blob) {
+        errmsg("Failed to allocate %zu bytes for compiled dictionary", size);
+        return FAILURE;
+    }
+
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + header.source_offset, dict->data, dict->data_size);
+    memcpy(blob + header.entries_offset, index->entries, n * sizeof(bej_dict_entry_t));
+    memcpy(blob + header.ranges_offset, index->ranges, n * sizeof(bej_dict_range_t));
+    memcpy(blob + header.slots_offset, index->slots, index->slot_count * sizeof(uint16_t));
+    memcpy(blob + header.names_offset, index->names, n * sizeof(bej_dict_name_t));
+    memcpy(blob + header.name_pool_offset, index->name_pool, index->name_pool_size);
+
+    *out = blob;
+    *out_size = size;
+
+    return SUCCESS;
+}
+
+static uint8_t
+section_fits(size_t size, uint64_t offset, uint64_t length)
+{
+    return offset <= size && length <= size - offset && !(offset & 3U);
+}
+
+uint8_t
+bej_load_compiled_dict(bej_dictionary_context_t *dict, uint8_t *data, size_t size)
+{
+    if (!dict || !bej_is_compiled_dict(data, size)) {
+        errmsg("Not a compiled dictionary");
+        return FAILURE;
+    }
+    if ((uintptr_t)data & 3U) {
+        errmsg("Compiled dictionary must be 4-byte aligned");
+        return FAILURE;
+    }
+
+    const bej_compiled_header_t *h = (const bej_compiled_header_t *)data;
+    if (h->version != BEJ_COMPILED_VERSION || h->byte_order != BEJ_COMPILED_BYTE_ORDER
+        || h->entry_size != sizeof(bej_dict_entry_t) || h->range_size != sizeof(bej_dict_range_t)
+        || h->name_size != sizeof(bej_dict_name_t)) {
+        errmsg("Compiled dictionary was built for another version or ABI, recompile it");
+        return FAILURE;
+    }
+
+    uint64_t n = h->entry_count;
+    if (!section_fits(size, h->source_offset, h->source_size)
+        || !section_fits(size, h->entries_offset, n * sizeof(bej_dict_entry_t))
+        || !section_fits(size, h->ranges_offset, n * sizeof(bej_dict_range_t))
+        || !section_fits(size, h->slots_offset, (uint64_t)h->slot_count * sizeof(uint16_t))
+        || !section_fits(size, h->names_offset, n * sizeof(bej_dict_name_t))
+        || !section_fits(size, h->name_pool_offset, h->name_pool_size)
+        || h->source_size < BEJ_DICT_HEADER_SIZE) {
+        errmsg("Compiled dictionary is truncated or corrupt");
+        return FAILURE;
+    }
+
+    uint8_t *source = data + h->source_offset;
+    if (READ_U16_LE(source, 2) != h->entry_count) {
+        errmsg("Compiled dictionary entry count doesn't match its source");
+        return FAILURE;
+    }
+
+    /* the tables are trusted once the header checks out, except for what the lookup
+    *  dereferences: slot and name references are validated here once instead of per lookup
+    */
+    bej_dict_entry_t *entries = (bej_dict_entry_t *)(data + h->entries_offset);
+    bej_dict_range_t *ranges = (bej_dict_range_t *)(data + h->ranges_offset);
+    uint16_t *slots = (uint16_t *)(data + h->slots_offset);
+    bej_dict_name_t *names = (bej_dict_name_t *)(data + h->names_offset);
+
+    for (uint64_t i = 0; i < n; i++) {
+        if (entries[i].index != i
+            || (ranges[i].slot != BEJ_DICT_RANGE_NONE
+                && ((uint64_t)ranges[i].slot + ranges[i].span > h->slot_count
+                    || i + ranges[i].count > n))
+            || (uint64_t)names[i].offset + names[i].length > h->name_pool_size
+            || (names[i].length && names[i].length < 4)) {
+            errmsg("Compiled dictionary index is corrupt at entry %lu", (unsigned long)i);
+            return FAILURE;
+        }
+    }
+    for (uint32_t i = 0; i < h->slot_count; i++) {
+        if (slots[i] != BEJ_DICT_INDEX_NONE && slots[i] >= n) {
+            errmsg("Compiled dictionary slot %u is out of range", i);
+            return FAILURE;
+        }
+    }
+
+    size_t offset = 0UL;
+    dict->version_tag = READ_U8_AND_INC(source, offset);
+    dict->truncation_flag = READ_U8_AND_INC(source, offset);
+    dict->entry_count = h->entry_count;
+    dict->schema_version = READ_U32_LE(source, 4);
+    dict->dictionary_size = h->source_size;
+    dict->data = source;
+    dict->data_size = h->source_size;
+
+    memset(&dict->index, 0, sizeof(dict->index));
+    dict->index.entries = entries;
+    dict->index.ranges = ranges;
+    dict->index.slots = slots;
+    dict->index.names = names;
+    dict->index.name_pool = (char *)(data + h->name_pool_offset);
+    dict->index.slot_count = h->slot_count;
+    dict->index.name_pool_size = h->name_pool_size;
+
+    return SUCCESS;
+}
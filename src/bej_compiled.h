@@ -0,0 +1,68 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Compiled dictionary: a DSP8010 dictionary together with its prebuilt lookup index,
+* laid out so the file can be mapped and used in place. All sections start on a cache line,
+* integers are in host byte order, files from a different ABI are rejected by the header check.
+*
+*   header | source dictionary | entries | ranges | slots | names | name pool
+*/
+
+#define BEJ_COMPILED_MAGIC "BEJDICTC"
+#define BEJ_COMPILED_VERSION 1U
+#define BEJ_COMPILED_ALIGN 64UL
+#define BEJ_COMPILED_BYTE_ORDER 0x01020304U
+
+/**
+ * On-disk header of a compiled dictionary, offsets are from the start of the file
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;    // BEJ_COMPILED_BYTE_ORDER as written by the compiling host
+    uint16_t entry_size;    // sizeof(bej_dict_entry_t)
+    uint16_t range_size;    // sizeof(bej_dict_range_t)
+    uint16_t name_size;     // sizeof(bej_dict_name_t)
+    uint16_t entry_count;
+    uint32_t slot_count;
+    uint32_t name_pool_size;
+    uint64_t source_offset;
+    uint64_t source_size;
+    uint64_t entries_offset;
+    uint64_t ranges_offset;
+    uint64_t slots_offset;
+    uint64_t names_offset;
+    uint64_t name_pool_offset;
+} bej_compiled_header_t;
+
+/**
+ * @brief Check whether a buffer starts with a compiled dictionary header
+ * 
+ * @param data Buffer to check
+ * @param size Size of the buffer
+ * @return 1 if compiled, 0 otherwise
+ */
+int bej_is_compiled_dict(const uint8_t *data, size_t size);
+
+/**
+ * @brief Serialize a parsed dictionary and its index into the compiled format
+ * 
+ * @param dict Dictionary parsed with bej_parse_dict(), must have an index
+ * @param out Output, heap allocated, release with free()
+ * @param out_size Size of the output
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_compile_dict(bej_dictionary_context_t *dict, uint8_t **out, size_t *out_size);
+
+/**
+ * @brief Use a compiled dictionary in place, nothing is copied or allocated
+ * 
+ * bej_parse_dict() calls this for buffers carrying the compiled magic.
+ * 
+ * @param dict Dictionary structure to populate, bej_free_dict() leaves the buffer alone
+ * @param data Compiled dictionary, at least 4-byte aligned, must outlive dict
+ * @param size Size of the compiled dictionary
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_load_compiled_dict(bej_dictionary_context_t *dict, uint8_t *data, size_t size);
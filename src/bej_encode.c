@@ -0,0 +1,727 @@
+/**
+ * @file bej_encode.c
+ * @brief JSON to BEJ encoder
+ */
+#include "bej_encode.h"
+
+static const uint8_t bej_encode_header[BEJ_HEADER_SIZE] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+
+// ============================================================================
+// Name index
+// ============================================================================
+
+static uint32_t
+bej_name_hash(uint16_t range, const char *name, size_t length)
+{
+    // FNV-1a over the range and the name
+    uint32_t hash = 2166136261U;
+    hash = (hash ^ (range & 0xFFU)) * 16777619U;
+    hash = (hash ^ (range >> 8)) * 16777619U;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t)name[i]) * 16777619U;
+    return hash;
+}
+
+/* maps child_offset/child_count to entry indexes, clipped to the entry table
+*/
+static uint8_t
+bej_name_range(bej_dictionary_context_t *dict, uint16_t child_offset, uint16_t child_count,
+               uint16_t *start, uint16_t *count)
+{
+    if (child_offset < BEJ_DICT_HEADER_SIZE
+        || (child_offset - BEJ_DICT_HEADER_SIZE) % BEJ_DICT_ENTRY_SIZE)
+        return FAILURE;
+
+    size_t first = (child_offset - BEJ_DICT_HEADER_SIZE) / BEJ_DICT_ENTRY_SIZE;
+    if (first >= dict->entry_count)
+        return FAILURE;
+
+    *start = (uint16_t)first;
+    *count = (child_count > dict->entry_count - first) ? (uint16_t)(dict->entry_count - first)
+                                                       : child_count;
+    return SUCCESS;
+}
+
+static const char *
+bej_name_of(bej_dictionary_context_t *dict, uint16_t index, size_t *length)
+{
+    bej_dict_name_t *quoted = &dict->index.names[index];
+    if (!quoted->length) {
+        *length = 0UL;
+        return NULL;
+    }
+    // pool holds "name": , skip the quotes and the separator
+    *length = quoted->length - 4U;
+    return &dict->index.name_pool[quoted->offset + 1];
+}
+
+static void
+bej_name_insert(bej_encoder_t *enc, uint16_t range, uint16_t index)
+{
+    bej_dictionary_context_t *dict = &enc->schema_dict;
+    size_t length;
+    const char *name = bej_name_of(dict, index, &length);
+    if (!name)
+        return;
+
+    uint32_t hash = bej_name_hash(range, name, length);
+    for (uint32_t i = hash & enc->names.mask; ; i = (i + 1) & enc->names.mask) {
+        bej_name_slot_t *slot = &enc->names.slots[i];
+        if (slot->entry == BEJ_DICT_INDEX_NONE) {
+            *slot = (bej_name_slot_t){ .hash = hash, .range = range, .entry = index };
+            return;
+        }
+
+        // first entry of the range with that name wins, same as the decoder's sequence lookup
+        size_t other_length;
+        const char *other = bej_name_of(dict, slot->entry, &other_length);
+        if (slot->hash == hash && slot->range == range
+            && other_length == length && !memcmp(other, name, length))
+            return;
+    }
+}
+
+/* one pass per child range reachable from an entry, ranges sharing a start are only walked
+*  as far as the widest of them
+*/
+static uint8_t
+bej_build_name_index(bej_encoder_t *enc)
+{
+    bej_dictionary_context_t *dict = &enc->schema_dict;
+    bej_dict_entry_t *entries = dict->index.entries;
+    uint16_t n = dict->entry_count;
+
+    if (!entries || !dict->index.names || !n) {
+        errmsg("Dictionary has no lookup index");
+        return FAILURE;
+    }
+
+    uint16_t *covered = calloc(n, sizeof(uint16_t));
+    if (!covered) {
+        errmsg("Failed to allocate name index");
+        return FAILURE;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        size_t pairs = n;   // the root range
+        memset(covered, 0, n * sizeof(uint16_t));
+        covered[0] = n;
+        if (pass)
+            for (uint16_t c = 0; c < n; c++)
+                bej_name_insert(enc, 0U, c);
+
+        for (uint16_t i = 0; i < n; i++) {
+            uint16_t start, count;
+            if (!entries[i].child_count
+                || bej_name_range(dict, entries[i].child_offset, entries[i].child_count, &start, &count)
+                || count <= covered[start])
+                continue;
+
+            pairs += count - covered[start];
+            if (pass)
+                for (uint16_t c = covered[start]; c < count; c++)
+                    bej_name_insert(enc, start, (uint16_t)(start + c));
+            covered[start] = count;
+        }
+
+        if (!pass) {
+            uint32_t cap = 16U;
+            while (cap < pairs * 2)
+                cap <<= 1;
+            enc->names.slots = malloc(cap * sizeof(bej_name_slot_t));
+            if (!enc->names.slots) {
+                errmsg("Failed to allocate %u name slots", cap);
+                free(covered);
+                return FAILURE;
+            }
+            for (uint32_t s = 0; s < cap; s++)
+                enc->names.slots[s].entry = BEJ_DICT_INDEX_NONE;
+            enc->names.mask = cap - 1;
+        }
+    }
+
+    free(covered);
+    return SUCCESS;
+}
+
+uint8_t
+bej_name_lookup(bej_encoder_t *enc, uint16_t child_offset, uint16_t child_count,
+                const char *name, size_t name_length, bej_dict_entry_t *entry)
+{
+    bej_dictionary_context_t *dict = &enc->schema_dict;
+    uint16_t start, count;
+
+    if (!enc->names.slots || bej_name_range(dict, child_offset, child_count, &start, &count))
+        return FAILURE;
+
+    uint32_t hash = bej_name_hash(start, name, name_length);
+    for (uint32_t i = hash & enc->names.mask; ; i = (i + 1) & enc->names.mask) {
+        bej_name_slot_t *slot = &enc->names.slots[i];
+        if (slot->entry == BEJ_DICT_INDEX_NONE)
+            return FAILURE;
+        if (slot->hash != hash || slot->range != start)
+            continue;
+
+        size_t length;
+        const char *candidate = bej_name_of(dict, slot->entry, &length);
+        if (length == name_length && !memcmp(candidate, name, length)) {
+            if (slot->entry >= start + count)
+                return FAILURE;
+            *entry = dict->index.entries[slot->entry];
+            return SUCCESS;
+        }
+    }
+}
+
+// ============================================================================
+// Output
+// ============================================================================
+
+static uint8_t *
+bej_enc_tail(bej_encoder_t *enc, size_t n)
+{
+    bej_output_t *out = &enc->out;
+    if (out->error)
+        return NULL;
+
+    if (out->cap - out->len < n) {
+        size_t cap = out->cap ? out->cap * 2 : 256UL;
+        if (cap < out->len + n)
+            cap = out->len + n;
+        uint8_t *data = realloc(out->data, cap);
+        if (!data) {
+            errmsg("Failed to allocate %zu bytes of output buffer", cap);
+            out->error = 1U;
+            return NULL;
+        }
+        out->data = data;
+        out->cap = cap;
+    }
+
+    return out->data + out->len;
+}
+
+static void
+bej_enc_write(bej_encoder_t *enc, const void *src, size_t n)
+{
+    uint8_t *dst = bej_enc_tail(enc, n);
+    if (!dst)
+        return;
+    memcpy(dst, src, n);
+    enc->out.len += n;
+}
+
+static uint8_t
+bej_nnint_size(uint32_t value)
+{
+    uint8_t n = 1U;
+    while (n < 4U && (value >> (8U * n)))
+        n++;
+    return n;
+}
+
+static void
+bej_enc_nnint(bej_encoder_t *enc, uint32_t value)
+{
+    uint8_t bytes[5];
+    uint8_t n = bej_nnint_size(value);
+    bytes[0] = n;
+    for (uint8_t i = 0; i < n; i++)
+        bytes[1 + i] = (uint8_t)(value >> (8U * i));
+    bej_enc_write(enc, bytes, 1U + n);
+}
+
+/* one-byte NNINT to be patched once the value it describes is complete
+*/
+static size_t
+bej_enc_placeholder(bej_encoder_t *enc)
+{
+    size_t pos = enc->out.len;
+    bej_enc_write(enc, "\x01\x00", 2);
+    return pos;
+}
+
+static void
+bej_enc_patch(bej_encoder_t *enc, size_t pos, uint32_t value)
+{
+    uint8_t n = bej_nnint_size(value);
+
+    if (n > 1U) {
+        // widen the placeholder, everything written after it moves up
+        if (!bej_enc_tail(enc, n - 1U))
+            return;
+        uint8_t *after = &enc->out.data[pos + 2];
+        memmove(after + (n - 1U), after, enc->out.len - (pos + 2));
+        enc->out.len += n - 1U;
+    }
+
+    enc->out.data[pos] = n;
+    for (uint8_t i = 0; i < n; i++)
+        enc->out.data[pos + 1 + i] = (uint8_t)(value >> (8U * i));
+}
+
+/* patches the length placeholder at pos with the size of everything written after it
+*/
+static void
+bej_enc_patch_length(bej_encoder_t *enc, size_t pos)
+{
+    size_t length = enc->out.len - (pos + 2);
+    if (length > UINT32_MAX) {
+        errmsg("Value of %zu bytes is too long for BEJ", length);
+        enc->out.error = 1U;
+        return;
+    }
+    bej_enc_patch(enc, pos, (uint32_t)length);
+}
+
+// ============================================================================
+// JSON input
+// ============================================================================
+
+static void
+bej_json_ws(bej_encoder_t *enc)
+{
+    while (enc->pos < enc->json_size) {
+        char c = enc->json[enc->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+        enc->pos++;
+    }
+}
+
+static int
+bej_json_peek(bej_encoder_t *enc)
+{
+    bej_json_ws(enc);
+    return (enc->pos < enc->json_size) ? (unsigned char)enc->json[enc->pos] : EOF;
+}
+
+static uint8_t
+bej_json_expect(bej_encoder_t *enc, char c)
+{
+    if (bej_json_peek(enc) != (unsigned char)c) {
+        errmsg("Expected '%c' at offset %zu", c, enc->pos);
+        return FAILURE;
+    }
+    enc->pos++;
+    return SUCCESS;
+}
+
+static uint8_t
+bej_json_literal(bej_encoder_t *enc, const char *literal)
+{
+    size_t n = strlen(literal);
+    if (enc->json_size - enc->pos < n || memcmp(&enc->json[enc->pos], literal, n)) {
+        errmsg("Invalid literal at offset %zu", enc->pos);
+        return FAILURE;
+    }
+    enc->pos += n;
+    return SUCCESS;
+}
+
+static int32_t
+bej_json_hex4(bej_encoder_t *enc)
+{
+    if (enc->json_size - enc->pos < 4)
+        return -1;
+
+    int32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = enc->json[enc->pos++];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return value;
+}
+
+static uint8_t *
+bej_utf8(uint8_t *p, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *p++ = (uint8_t)cp;
+    } else if (cp < 0x800) {
+        *p++ = (uint8_t)(0xC0 | (cp >> 6));
+        *p++ = (uint8_t)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *p++ = (uint8_t)(0xE0 | (cp >> 12));
+        *p++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        *p++ = (uint8_t)(0x80 | (cp & 0x3F));
+    } else {
+        *p++ = (uint8_t)(0xF0 | (cp >> 18));
+        *p++ = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+        *p++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        *p++ = (uint8_t)(0x80 | (cp & 0x3F));
+    }
+    return p;
+}
+
+/* unescapes a JSON string right behind the end of the output, it only becomes part of
+*  the output once the caller adds *length to out.len
+*  unescaping never grows the text, so the rest of the input is an upper bound for its size
+*/
+static uint8_t *
+bej_json_string(bej_encoder_t *enc, size_t *length)
+{
+    if (bej_json_expect(enc, '"'))
+        return NULL;
+
+    uint8_t *start = bej_enc_tail(enc, enc->json_size - enc->pos);
+    if (!start)
+        return NULL;
+    uint8_t *p = start;
+
+    while (enc->pos < enc->json_size) {
+        // bulk-copy the plain run
+        size_t run = enc->pos;
+        while (run < enc->json_size && enc->json[run] != '"' && enc->json[run] != '\\'
+               && (unsigned char)enc->json[run] >= 0x20)
+            run++;
+        memcpy(p, &enc->json[enc->pos], run - enc->pos);
+        p += run - enc->pos;
+        enc->pos = run;
+        if (enc->pos == enc->json_size)
+            break;
+
+        char c = enc->json[enc->pos++];
+        if (c == '"') {
+            *length = (size_t)(p - start);
+            return start;
+        }
+        if (c != '\\') {
+            errmsg("Unescaped control character in string at offset %zu", enc->pos - 1);
+            return NULL;
+        }
+        if (enc->pos == enc->json_size)
+            break;
+
+        switch (enc->json[enc->pos++]) {
+            case '"': *p++ = '"'; break;
+            case '\\': *p++ = '\\'; break;
+            case '/': *p++ = '/'; break;
+            case 'b': *p++ = '\b'; break;
+            case 'f': *p++ = '\f'; break;
+            case 'n': *p++ = '\n'; break;
+            case 'r': *p++ = '\r'; break;
+            case 't': *p++ = '\t'; break;
+            case 'u': {
+                int32_t cp = bej_json_hex4(enc);
+                if (cp >= 0xD800 && cp <= 0xDBFF) {     // surrogate pair
+                    int32_t low = -1;
+                    if (enc->json_size - enc->pos >= 2 && enc->json[enc->pos] == '\\'
+                        && enc->json[enc->pos + 1] == 'u') {
+                        enc->pos += 2;
+                        low = bej_json_hex4(enc);
+                    }
+                    if (low < 0xDC00 || low > 0xDFFF)
+                        cp = -1;
+                    else
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = -1;
+                }
+                if (cp < 0) {
+                    errmsg("Invalid \\u escape at offset %zu", enc->pos);
+                    return NULL;
+                }
+                p = bej_utf8(p, (uint32_t)cp);
+                break; }
+            default:
+                errmsg("Invalid escape at offset %zu", enc->pos - 1);
+                return NULL;
+        }
+    }
+
+    errmsg("Unterminated string");
+    return NULL;
+}
+
+static uint8_t
+bej_json_integer(bej_encoder_t *enc, int64_t *value)
+{
+    bej_json_ws(enc);
+    size_t start = enc->pos;
+    uint8_t negative = 0U;
+    if (enc->pos < enc->json_size && enc->json[enc->pos] == '-') {
+        negative = 1U;
+        enc->pos++;
+    }
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1U : (uint64_t)INT64_MAX;
+    uint64_t magnitude = 0U;
+    size_t digits = 0UL;
+    while (enc->pos < enc->json_size && enc->json[enc->pos] >= '0' && enc->json[enc->pos] <= '9') {
+        uint64_t d = (uint64_t)(enc->json[enc->pos++] - '0');
+        if (magnitude > (limit - d) / 10U) {
+            errmsg("Integer out of range at offset %zu", start);
+            return FAILURE;
+        }
+        magnitude = magnitude * 10U + d;
+        digits++;
+    }
+    if (!digits) {
+        errmsg("Expected integer at offset %zu", start);
+        return FAILURE;
+    }
+    if (enc->pos < enc->json_size && (enc->json[enc->pos] == '.' || enc->json[enc->pos] == 'e'
+                                      || enc->json[enc->pos] == 'E')) {
+        errmsg("Real values are not supported, offset %zu", start);
+        return FAILURE;
+    }
+
+    *value = negative ? (int64_t)(0U - magnitude) : (int64_t)magnitude;
+    return SUCCESS;
+}
+
+// ============================================================================
+// Encoding
+// ============================================================================
+
+static uint8_t bej_encode_value(bej_encoder_t *enc, bej_dict_entry_t *entry, uint32_t sequence);
+
+static uint8_t
+bej_encode_set(bej_encoder_t *enc, bej_dict_entry_t *entry)
+{
+    if (bej_json_expect(enc, '{'))
+        return FAILURE;
+
+    size_t count_pos = bej_enc_placeholder(enc);
+    uint32_t count = 0U;
+
+    if (bej_json_peek(enc) != '}') {
+        do {
+            size_t key_pos = enc->pos;
+            size_t key_length;
+            const uint8_t *key = bej_json_string(enc, &key_length);
+            if (!key)
+                return FAILURE;
+
+            bej_dict_entry_t member;
+            if (bej_name_lookup(enc, entry->child_offset, entry->child_count,
+                                (const char *)key, key_length, &member)) {
+                errmsg("Unknown member \"%.*s\" at offset %zu", (int)key_length, key, key_pos);
+                return FAILURE;
+            }
+            if (bej_json_expect(enc, ':') || bej_encode_value(enc, &member, member.sequence))
+                return FAILURE;
+            count++;
+        } while (bej_json_peek(enc) == ',' && ++enc->pos);
+    }
+    if (bej_json_expect(enc, '}'))
+        return FAILURE;
+
+    bej_enc_patch(enc, count_pos, count);
+    return SUCCESS;
+}
+
+static uint8_t
+bej_encode_array(bej_encoder_t *enc, bej_dict_entry_t *entry)
+{
+    if (bej_json_expect(enc, '['))
+        return FAILURE;
+
+    // elements are all described by the single child of the array entry, their sequence is the index
+    bej_dict_entry_t element;
+    uint16_t start, count;
+    if (!entry->child_count
+        || bej_name_range(&enc->schema_dict, entry->child_offset, entry->child_count, &start, &count)) {
+        errmsg("Array at offset %zu has no element entry", enc->pos);
+        return FAILURE;
+    }
+    element = enc->schema_dict.index.entries[start];
+
+    size_t count_pos = bej_enc_placeholder(enc);
+    uint32_t elements = 0U;
+
+    if (bej_json_peek(enc) != ']') {
+        do {
+            if (bej_encode_value(enc, &element, elements))
+                return FAILURE;
+            elements++;
+        } while (bej_json_peek(enc) == ',' && ++enc->pos);
+    }
+    if (bej_json_expect(enc, ']'))
+        return FAILURE;
+
+    bej_enc_patch(enc, count_pos, elements);
+    return SUCCESS;
+}
+
+static uint8_t
+bej_encode_integer(bej_encoder_t *enc)
+{
+    int64_t value;
+    if (bej_json_integer(enc, &value))
+        return FAILURE;
+
+    // shortest two's complement that keeps the sign
+    uint8_t bytes[8];
+    uint8_t n = 0U;
+    do {
+        bytes[n++] = (uint8_t)value;
+        value >>= 8;    // arithmetic
+    } while (n < 8U && !((value == 0 && !(bytes[n - 1] & 0x80)) || (value == -1 && (bytes[n - 1] & 0x80))));
+
+    bej_enc_nnint(enc, n);
+    bej_enc_write(enc, bytes, n);
+    return SUCCESS;
+}
+
+static uint8_t
+bej_encode_enum(bej_encoder_t *enc, bej_dict_entry_t *entry)
+{
+    size_t pos = enc->pos;
+    size_t length;
+    const uint8_t *name = bej_json_string(enc, &length);
+    if (!name)
+        return FAILURE;
+
+    bej_dict_entry_t option;
+    if (bej_name_lookup(enc, entry->child_offset, entry->child_count,
+                        (const char *)name, length, &option)) {
+        errmsg("Unknown enum value \"%.*s\" at offset %zu", (int)length, name, pos);
+        return FAILURE;
+    }
+
+    bej_enc_nnint(enc, 1U + bej_nnint_size(option.sequence));
+    bej_enc_nnint(enc, option.sequence);
+    return SUCCESS;
+}
+
+static uint8_t
+bej_encode_string(bej_encoder_t *enc)
+{
+    size_t length_pos = bej_enc_placeholder(enc);
+    size_t length;
+    if (!bej_json_string(enc, &length))
+        return FAILURE;
+    enc->out.len += length;
+    bej_enc_write(enc, "", 1);  // null terminator
+
+    bej_enc_patch_length(enc, length_pos);
+    return SUCCESS;
+}
+
+/* writes one SFLV tuple, the JSON value decides nothing but null, the rest is up to the entry
+*/
+static uint8_t
+bej_encode_value(bej_encoder_t *enc, bej_dict_entry_t *entry, uint32_t sequence)
+{
+    uint8_t format = entry->format >> 4;
+    uint8_t result = FAILURE;
+
+    if (sequence > UINT32_MAX >> 1) {
+        errmsg("Too many array elements at offset %zu", enc->pos);
+        return FAILURE;
+    }
+    bej_enc_nnint(enc, sequence << 1);     // schema dictionary selector
+
+    if (bej_json_peek(enc) == 'n') {
+        bej_enc_write(enc, "\x20\x01\x00", 3);
+        return bej_json_literal(enc, "null");
+    }
+
+    switch (format) {
+        case BEJ_FORMAT_SET:
+        case BEJ_FORMAT_ARRAY: {
+            if (++enc->depth > enc->max_depth) {
+                errmsg("JSON nesting too deep: more than %zu levels", enc->max_depth);
+                return FAILURE;
+            }
+            uint8_t format_byte = (uint8_t)(format << 4);
+            bej_enc_write(enc, &format_byte, 1);
+            size_t length_pos = bej_enc_placeholder(enc);
+            result = (format == BEJ_FORMAT_SET) ? bej_encode_set(enc, entry)
+                                                : bej_encode_array(enc, entry);
+            bej_enc_patch_length(enc, length_pos);
+            enc->depth--;
+            break; }
+        case BEJ_FORMAT_INTEGER:
+            bej_enc_write(enc, "\x30", 1);
+            result = bej_encode_integer(enc);
+            break;
+        case BEJ_FORMAT_ENUM:
+            bej_enc_write(enc, "\x40", 1);
+            result = bej_encode_enum(enc, entry);
+            break;
+        case BEJ_FORMAT_STRING:
+            bej_enc_write(enc, "\x50", 1);
+            result = bej_encode_string(enc);
+            break;
+        case BEJ_FORMAT_BOOLEAN: {
+            uint8_t truth = (bej_json_peek(enc) == 't');
+            bej_enc_write(enc, truth ? "\x70\x01\x01\x01" : "\x70\x01\x01\x00", 4);
+            result = bej_json_literal(enc, truth ? "true" : "false");
+            break; }
+        default:
+            errmsg("Format %u at offset %zu is not supported by the encoder", format, enc->pos);
+            return FAILURE;
+    }
+
+    return (result || enc->out.error) ? FAILURE : SUCCESS;
+}
+
+uint8_t
+bej_encode(bej_encoder_t *enc, const char *json, size_t size)
+{
+    if (!enc || !json) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    enc->json = json;
+    enc->json_size = size;
+    enc->pos = 0UL;
+    enc->depth = 0UL;
+    enc->out.len = 0UL;
+    enc->out.error = 0U;
+
+    bej_dict_entry_t root;
+    if (bej_dict_lookup(&enc->schema_dict, BEJ_DICT_HEADER_SIZE, enc->schema_dict.entry_count, 0U, &root)) {
+        errmsg("Dictionary has no root entry");
+        return FAILURE;
+    }
+
+    bej_enc_write(enc, bej_encode_header, sizeof(bej_encode_header));
+    if (bej_encode_value(enc, &root, root.sequence))
+        return FAILURE;
+
+    if (bej_json_peek(enc) != EOF) {
+        errmsg("Unexpected data after the document at offset %zu", enc->pos);
+        return FAILURE;
+    }
+
+    return enc->out.error ? FAILURE : SUCCESS;
+}
+
+uint8_t
+bej_encoder_init(bej_encoder_t *enc, bej_dictionary_context_t *schema_dict)
+{
+    if (!enc || !schema_dict || !schema_dict->data) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(enc, 0, sizeof(bej_encoder_t));
+    enc->schema_dict = *schema_dict;
+    enc->max_depth = BEJ_DEFAULT_MAX_DEPTH;
+
+    return bej_build_name_index(enc);
+}
+
+void
+bej_encoder_free(bej_encoder_t *enc)
+{
+    if (!enc)
+        return;
+
+    free(enc->names.slots);
+    free(enc->out.data);
+    memset(enc, 0, sizeof(bej_encoder_t));
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "bej.h"
+
+/*
+* JSON to BEJ encoder. Members are matched to dictionary entries through a hash index over
+* (child range, name) pairs, the JSON is encoded in a single pass: lengths and counts are
+* written as one-byte NNINT placeholders and patched once the value is complete, the rare
+* value that needs a wider NNINT shifts what follows it.
+*/
+
+/**
+ * Slot of the name index
+ */
+typedef struct {
+    uint32_t hash;
+    uint16_t range;     // entry index of the first entry of the child range
+    uint16_t entry;     // entry index, BEJ_DICT_INDEX_NONE for empty slots
+} bej_name_slot_t;
+
+/**
+ * Reverse lookup index, member name within a child range -> dictionary entry
+ */
+typedef struct {
+    bej_name_slot_t *slots;
+    uint32_t mask;      // slot count - 1, slot count is a power of two
+} bej_name_index_t;
+
+/**
+ * Encoder state, reusable for any number of documents
+ */
+typedef struct {
+    bej_dictionary_context_t schema_dict;   // borrowed
+    bej_name_index_t names;
+    bej_output_t out;       // encoded BEJ of the last bej_encode() call
+    const char *json;
+    size_t json_size;
+    size_t pos;             // parser position in json
+    size_t depth;
+    size_t max_depth;       // nesting limit, BEJ_DEFAULT_MAX_DEPTH unless changed after init
+} bej_encoder_t;
+
+
+/**
+ * @brief Initialize encoder and build the name index of the dictionary
+ *
+ * @param enc Encoder to initialize
+ * @param schema_dict Dictionary parsed with bej_parse_dict(), must outlive the encoder
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_encoder_init(bej_encoder_t *enc, bej_dictionary_context_t *schema_dict);
+
+
+/**
+ * @brief Encode a JSON document into BEJ
+ *
+ * Only members the dictionary knows are accepted, annotations and Real values are not supported.
+ *
+ * @param enc Encoder
+ * @param json JSON text, need not be NUL terminated
+ * @param size Size of json
+ * @return SUCCESS or FAILURE. On success enc->out holds the BEJ document
+ */
+uint8_t bej_encode(bej_encoder_t *enc, const char *json, size_t size);
+
+
+/**
+ * @brief Find dictionary entry by name within given child range
+ *
+ * @param enc Encoder
+ * @param child_offset Byte offset of the first entry of the range
+ * @param child_count Number of entries in the range
+ * @param name Name to find, not NUL terminated
+ * @param name_length Length of name
+ * @param entry Output entry structure
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_name_lookup(bej_encoder_t *enc, uint16_t child_offset, uint16_t child_count,
+                        const char *name, size_t name_length, bej_dict_entry_t *entry);
+
+
+/**
+ * @brief Release resources held by encoder
+ *
+ * @param enc Encoder to release
+ * @return nothing
+ */
+void bej_encoder_free(bej_encoder_t *enc);
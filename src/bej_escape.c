@@ -0,0 +1,112 @@
+/**
+ * @file bej_escape.c
+ * @brief Vectorized search for bytes that need JSON escaping
+ */
+#include "bej_escape.h"
+#include <stdatomic.h>
+
+#ifdef BEJ_ESCAPE_X86
+#include <immintrin.h>
+#endif
+
+size_t
+bej_escape_scan_scalar(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        if (BEJ_NEEDS_ESCAPE(data[i]))
+            return i;
+    }
+    return length;
+}
+
+#ifdef BEJ_ESCAPE_X86
+/* the signed compare against 0x20 catches both control characters and
+*  every byte >= 0x80 at once, leaving DEL, quote and backslash to equality checks
+*/
+__attribute__((target("sse2"))) size_t
+bej_escape_scan_sse2(const uint8_t *data, size_t length)
+{
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, quote)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, del)));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+
+    return i + bej_escape_scan_scalar(data + i, length - i);
+}
+
+__attribute__((target("avx2"))) size_t
+bej_escape_scan_avx2(const uint8_t *data, size_t length)
+{
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi8(space, v), _mm256_cmpeq_epi8(v, quote)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, backslash), _mm256_cmpeq_epi8(v, del)));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    // finish in this function: VEX-encoded 16-byte step, no transition into legacy SSE code
+    if (i + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, _mm256_castsi256_si128(space)),
+                                                _mm_cmpeq_epi8(v, _mm256_castsi256_si128(quote))),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(backslash)),
+                                                _mm_cmpeq_epi8(v, _mm256_castsi256_si128(del))));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return i + (size_t)__builtin_ctz((unsigned)mask);
+        i += 16;
+    }
+
+    return i + bej_escape_scan_scalar(data + i, length - i);
+}
+
+int
+bej_escape_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+}
+#endif /* BEJ_ESCAPE_X86 */
+
+typedef size_t (*bej_escape_scan_fn)(const uint8_t *, size_t);
+
+static size_t bej_escape_scan_resolve(const uint8_t *data, size_t length);
+
+// picked on first use, every thread resolves to the same function so relaxed ordering is enough
+static _Atomic(bej_escape_scan_fn) bej_escape_scan_impl = bej_escape_scan_resolve;
+
+static size_t
+bej_escape_scan_resolve(const uint8_t *data, size_t length)
+{
+    bej_escape_scan_fn fn = bej_escape_scan_scalar;
+#ifdef BEJ_ESCAPE_X86
+    fn = bej_escape_has_avx2() ? bej_escape_scan_avx2 : bej_escape_scan_sse2;
+#endif
+    atomic_store_explicit(&bej_escape_scan_impl, fn, memory_order_relaxed);
+
+    return fn(data, length);
+}
+
+size_t
+bej_escape_scan(const uint8_t *data, size_t length)
+{
+    return atomic_load_explicit(&bej_escape_scan_impl, memory_order_relaxed)(data, length);
+}
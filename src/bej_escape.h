@@ -0,0 +1,44 @@
+#pragma once
+#include "common.h"
+
+/*
+* JSON string escaping scanners. A byte needs escaping when it is a control character,
+* a quote, a backslash, DEL or anything outside of 7-bit ASCII (emitted as \u00XX).
+*/
+
+#define BEJ_NEEDS_ESCAPE(c) ((uint8_t)(c) < 0x20 || (c) == '"' || (c) == '\\' || (uint8_t)(c) >= 0x7F)
+
+/**
+ * @brief Find the first byte that needs escaping, using the widest vector unit the CPU has
+ * 
+ * @param data Input bytes
+ * @param length Number of bytes to scan
+ * @return Index of the first byte to escape, length if there is none
+ */
+size_t bej_escape_scan(const uint8_t *data, size_t length);
+
+/**
+ * @brief Portable byte-at-a-time version of bej_escape_scan()
+ */
+size_t bej_escape_scan_scalar(const uint8_t *data, size_t length);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BEJ_ESCAPE_X86 1
+
+/**
+ * @brief SSE2 version of bej_escape_scan(), 16 bytes per step
+ */
+size_t bej_escape_scan_sse2(const uint8_t *data, size_t length);
+
+/**
+ * @brief AVX2 version of bej_escape_scan(), 32 bytes per step. Only call when bej_escape_has_avx2()
+ */
+size_t bej_escape_scan_avx2(const uint8_t *data, size_t length);
+
+/**
+ * @brief Check whether the running CPU supports AVX2
+ * 
+ * @return 1 if supported, 0 otherwise
+ */
+int bej_escape_has_avx2(void);
+#endif /* __x86_64__ || __i386__ */
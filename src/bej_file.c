@@ -0,0 +1,112 @@
+/**
+ * @file bej_file.c
+ * @brief Zero-copy input file access
+ */
+#include "bej_file.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint8_t
+bej_file_read_fd(bej_file_t *file, int fd, const char *path)
+{
+    size_t cap = 1UL << 16;
+    uint8_t *data = malloc(cap);
+    size_t size = 0UL;
+
+    if (!data) {
+        errmsg("Failed to allocate read buffer for %s", path);
+        return FAILURE;
+    }
+
+    for (;;) {
+        if (size == cap) {
+            uint8_t *grown = realloc(data, cap * 2);
+            if (!grown) {
+                errmsg("Failed to grow read buffer for %s", path);
+                free(data);
+                return FAILURE;
+            }
+            data = grown;
+            cap *= 2;
+        }
+
+        ssize_t n = read(fd, data + size, cap - size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            errmsg("Failed to read %s: %s", path, strerror(errno));
+            free(data);
+            return FAILURE;
+        }
+        if (n == 0)
+            break;
+        size += (size_t)n;
+    }
+
+    file->data = data;
+    file->size = size;
+    file->mapped = 0U;
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_file_open(bej_file_t *file, const char *path)
+{
+    if (!file || !path)
+        return FAILURE;
+
+    memset(file, 0, sizeof(*file));
+
+    int is_stdin = !strcmp(path, "-");
+    int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        errmsg("Failed to open file %s: %s", path, strerror(errno));
+        return FAILURE;
+    }
+
+    struct stat st;
+    uint8_t result = FAILURE;
+
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            file->data = map;
+            file->size = (size_t)st.st_size;
+            file->mapped = 1U;
+            result = SUCCESS;
+        }
+    }
+
+    // pipes, sockets and filesystems refusing mmap
+    if (result != SUCCESS)
+        result = bej_file_read_fd(file, fd, path);
+
+    if (!is_stdin)
+        close(fd);
+
+    if (result == SUCCESS && !file->size) {
+        errmsg("File %s is empty", path);
+        bej_file_close(file);
+        return FAILURE;
+    }
+
+    return result;
+}
+
+void
+bej_file_close(bej_file_t *file)
+{
+    if (!file || !file->data)
+        return;
+
+    if (file->mapped)
+        munmap(file->data, file->size);
+    else
+        free(file->data);
+
+    memset(file, 0, sizeof(*file));
+}
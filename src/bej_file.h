@@ -0,0 +1,28 @@
+#pragma once
+#include "common.h"
+
+/**
+ * Read-only view of an input file, memory-mapped when possible
+ */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    uint8_t mapped;     // 1 - data is a mapping, 0 - data is a heap copy (pipes, stdin)
+} bej_file_t;
+
+/**
+ * @brief Map a file read-only, falling back to read() for anything that can't be mapped
+ * 
+ * @param file File view to populate
+ * @param path Path to the file, "-" stands for stdin
+ * @return SUCCESS or FAILURE. Empty files are rejected
+ */
+uint8_t bej_file_open(bej_file_t *file, const char *path);
+
+/**
+ * @brief Unmap or free the file contents
+ * 
+ * @param file File view to release
+ * @return nothing
+ */
+void bej_file_close(bej_file_t *file);
@@ -0,0 +1,348 @@
+/**
+ * @file bej_gen.c
+ * @brief Synthetic documents from a schema dictionary, as expected JSON plus BEJ
+ */
+#include "bej_gen.h"
+#include "bej_output.h"
+#include "bej_encode.h"
+
+// element counts multiply down nested arrays, their product below an outermost array is capped
+#define BEJ_GEN_MAX_ELEMENTS (1U << 16)
+// passes at growing the outermost arrays towards target_size before giving up
+#define BEJ_GEN_TARGET_PASSES 8U
+// elements in a row an array grown to target_size may come up empty on before it ends
+#define BEJ_GEN_TARGET_MISSES 64U
+
+/* the JSON is written with the decoder's own emitters into ctx.out, so names, escapes
+*  and indentation come out exactly as bej_decode() prints them
+*/
+typedef struct {
+    bej_context_t ctx;
+    bej_dictionary_context_t *dict;
+    const bej_gen_options_t *options;
+    size_t json_limit;  // outermost arrays take elements until the JSON is this long, 0 for array_length
+    uint64_t nesting;   // product of the element counts of the arrays around the current value
+    uint32_t open_arrays;
+    uint32_t arrays;    // arrays that made it into the document
+    uint64_t rng;
+    uint8_t *string;    // scratch for string values, options->string_length long
+} bej_gen_t;
+
+void
+bej_gen_default_options(bej_gen_options_t *options)
+{
+    if (!options)
+        return;
+
+    options->seed = 1U;
+    options->max_depth = 8UL;
+    options->array_length = 4U;
+    options->string_length = 32U;
+    options->target_size = 0UL;
+}
+
+// splitmix64, good enough and the same everywhere
+static uint64_t
+bej_gen_next(bej_gen_t *g)
+{
+    uint64_t z = (g->rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static uint32_t
+bej_gen_below(bej_gen_t *g, uint32_t n)
+{
+    return n ? (uint32_t)(bej_gen_next(g) % n) : 0U;
+}
+
+/* entry at the given position of a child range, resolved through its sequence so that it is
+*  the one the decoder finds too; FAILURE for entries without a usable name
+*/
+static uint8_t
+bej_gen_child(bej_gen_t *g, bej_dict_entry_t *parent, uint16_t position,
+              bej_dict_entry_t *entry, char *name, size_t name_size)
+{
+    size_t offset = parent->child_offset + (size_t)position * BEJ_DICT_ENTRY_SIZE;
+    if (offset + BEJ_DICT_ENTRY_SIZE > g->dict->data_size)
+        return FAILURE;
+
+    uint16_t sequence = READ_U16_LE(g->dict->data, offset + 1);
+    if (bej_dict_lookup(g->dict, parent->child_offset, parent->child_count, sequence, entry)
+        || bej_get_entry_name(g->dict, entry, name, name_size) || !name[0])
+        return FAILURE;
+
+    return SUCCESS;
+}
+
+static uint8_t bej_gen_value(bej_gen_t *g, bej_dict_entry_t *entry, size_t depth);
+
+static uint8_t
+bej_gen_set(bej_gen_t *g, bej_dict_entry_t *entry, size_t depth)
+{
+    bej_context_t *ctx = &g->ctx;
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH + 1];
+    size_t mark = ctx->out.len;
+    uint32_t members = 0U;
+
+    bej_out_putc(ctx, '{');
+    write_newline(ctx);
+    ctx->indent_level++;
+
+    for (uint16_t i = 0; i < entry->child_count; i++) {
+        bej_dict_entry_t member;
+        if (bej_gen_child(g, entry, i, &member, name, sizeof(name)))
+            continue;
+        // leave about a quarter of the members out
+        if (!bej_gen_below(g, 4U))
+            continue;
+
+        size_t member_mark = ctx->out.len;
+        if (members) {
+            bej_out_putc(ctx, ',');
+            write_newline(ctx);
+        }
+        write_indent(ctx);
+        write_entry_name(ctx, g->dict, &member);
+        if (!bej_gen_value(g, &member, depth + 1)) {
+            ctx->out.len = member_mark;
+            continue;
+        }
+        members++;
+    }
+    ctx->indent_level--;
+
+    // an empty set would only be noise
+    if (!members) {
+        ctx->out.len = mark;
+        return 0U;
+    }
+    write_newline(ctx);
+    write_indent(ctx);
+    bej_out_putc(ctx, '}');
+    return 1U;
+}
+
+static uint8_t
+bej_gen_array(bej_gen_t *g, bej_dict_entry_t *entry, size_t depth)
+{
+    bej_context_t *ctx = &g->ctx;
+
+    // elements are all described by the single child of the array entry
+    bej_dict_entry_t element;
+    if (bej_dict_lookup(g->dict, entry->child_offset, entry->child_count, 0U, &element))
+        return 0U;
+
+    size_t mark = ctx->out.len;
+    uint64_t nesting = g->nesting;
+    // drawn either way, so that a grown array starts out the same as without a target
+    uint32_t count = 1U + bej_gen_below(g, g->options->array_length);
+    uint8_t grow = !g->open_arrays && g->json_limit;
+    if (grow) {
+        count = UINT32_MAX;
+    } else {
+        if (count > BEJ_GEN_MAX_ELEMENTS / nesting)
+            count = (BEJ_GEN_MAX_ELEMENTS / nesting) ? (uint32_t)(BEJ_GEN_MAX_ELEMENTS / nesting) : 1U;
+        g->nesting *= count;
+    }
+    uint32_t elements = 0U;
+
+    bej_out_putc(ctx, '[');
+    write_newline(ctx);
+    ctx->indent_level++;
+    g->open_arrays++;
+
+    for (uint32_t misses = 0U; elements < count; ) {
+        // an array grown to the target size stops once the document is long enough
+        if (grow && elements && (ctx->out.len >= g->json_limit || ctx->out.error))
+            break;
+        size_t element_mark = ctx->out.len;
+        if (elements) {
+            bej_out_putc(ctx, ',');
+            write_newline(ctx);
+        }
+        write_indent(ctx);
+        if (!bej_gen_value(g, &element, depth + 1)) {
+            ctx->out.len = element_mark;
+            // an element left empty ends the array, unless it is grown to the target size
+            if (!grow || ++misses == BEJ_GEN_TARGET_MISSES)
+                break;
+            continue;
+        }
+        elements++;
+        misses = 0U;
+    }
+    ctx->indent_level--;
+    g->open_arrays--;
+    g->nesting = nesting;
+
+    if (!elements) {
+        ctx->out.len = mark;
+        return 0U;
+    }
+    g->arrays++;
+    write_newline(ctx);
+    write_indent(ctx);
+    bej_out_putc(ctx, ']');
+    return 1U;
+}
+
+static void
+bej_gen_string(bej_gen_t *g)
+{
+    static const char plain[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 ";
+    // bytes the decoder escapes, DEL and above are left out as the encoder reads \u0080+ as UTF-8
+    static const char special[] = "\"\\\t\n\x01/";
+
+    uint32_t length = bej_gen_below(g, g->options->string_length + 1U);
+    for (uint32_t i = 0; i < length; i++) {
+        uint64_t r = bej_gen_next(g);
+        g->string[i] = (r % 32U)
+            ? (uint8_t)plain[(r >> 8) % (sizeof(plain) - 1)]
+            : (uint8_t)special[(r >> 8) % (sizeof(special) - 1)];
+    }
+
+    bej_out_putc(&g->ctx, '"');
+    write_escaped(&g->ctx, g->string, length);
+    bej_out_putc(&g->ctx, '"');
+}
+
+static uint8_t
+bej_gen_value(bej_gen_t *g, bej_dict_entry_t *entry, size_t depth)
+{
+    bej_context_t *ctx = &g->ctx;
+
+    switch (entry->format >> 4) {
+        case BEJ_FORMAT_SET:
+        case BEJ_FORMAT_ARRAY:
+            if (depth >= g->options->max_depth || !entry->child_count)
+                return 0U;
+            return ((entry->format >> 4) == BEJ_FORMAT_SET) ? bej_gen_set(g, entry, depth)
+                                                            : bej_gen_array(g, entry, depth);
+        case BEJ_FORMAT_INTEGER: {
+            // magnitudes spread over every NNINT width
+            uint32_t bytes = 1U + bej_gen_below(g, 8U);
+            int64_t value = (int64_t)bej_gen_next(g) >> (64U - 8U * bytes);
+            if (value == INT64_MIN)
+                value++;
+            write_int(ctx, value);
+            return 1U; }
+        case BEJ_FORMAT_ENUM: {
+            if (!entry->child_count)
+                return 0U;
+            bej_dict_entry_t option;
+            char name[BEJ_DICT_ENTRY_NAME_LENGTH + 1];
+            if (bej_gen_child(g, entry, (uint16_t)bej_gen_below(g, entry->child_count),
+                              &option, name, sizeof(name)))
+                return 0U;
+            bej_out_putc(ctx, '"');
+            bej_out_write(ctx, name, strlen(name));
+            bej_out_putc(ctx, '"');
+            return 1U; }
+        case BEJ_FORMAT_STRING:
+            bej_gen_string(g);
+            return 1U;
+        case BEJ_FORMAT_BOOLEAN:
+            if (bej_gen_below(g, 2U))
+                bej_out_literal(ctx, "true");
+            else
+                bej_out_literal(ctx, "false");
+            return 1U;
+        default:
+            // nothing the encoder could turn back into BEJ
+            return 0U;
+    }
+}
+
+/* one document for the current json_limit, the JSON is left in g->ctx.out
+*/
+static uint8_t
+bej_gen_document(bej_gen_t *g, bej_encoder_t *enc)
+{
+    bej_dict_entry_t root;
+    if (bej_dict_lookup(g->dict, BEJ_DICT_HEADER_SIZE, g->dict->entry_count, 0U, &root)) {
+        errmsg("Dictionary has no root entry");
+        return FAILURE;
+    }
+
+    g->rng = g->options->seed;
+    g->arrays = 0U;
+    g->nesting = 1U;
+    g->open_arrays = 0U;
+    g->ctx.out.len = 0UL;
+    g->ctx.indent_level = 0;
+    if (!bej_gen_value(g, &root, 0UL)) {
+        errmsg("Dictionary root has no member the generator can fill in");
+        return FAILURE;
+    }
+    if (g->ctx.out.error)
+        return FAILURE;
+
+    return bej_encode(enc, (const char *)g->ctx.out.data, g->ctx.out.len);
+}
+
+uint8_t
+bej_generate(bej_dictionary_context_t *dict, const bej_gen_options_t *options,
+             bej_output_t *json, bej_output_t *bej)
+{
+    if (!dict || !dict->data || !options || !json || !bej || !options->array_length) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+    if (options->max_depth > BEJ_DEFAULT_MAX_DEPTH) {
+        errmsg("Depth %zu is above the decoder's limit of %zu", options->max_depth,
+               (size_t)BEJ_DEFAULT_MAX_DEPTH);
+        return FAILURE;
+    }
+
+    bej_gen_t g;
+    memset(&g, 0, sizeof(g));
+    g.ctx.schema_dict = *dict;
+    g.ctx.style = BEJ_STYLE_PRETTY;
+    g.dict = dict;
+    g.options = options;
+    g.string = malloc((size_t)options->string_length + 1U);
+
+    bej_encoder_t enc;
+    if (!g.string || bej_encoder_init(&enc, dict)) {
+        free(g.string);
+        return FAILURE;
+    }
+
+    uint8_t result = bej_gen_document(&g, &enc);
+    /* the outermost arrays take elements until the JSON reaches json_limit, nested arrays keep
+    *  their array_length, so the size grows linearly with it. JSON takes more bytes than its BEJ,
+    *  the first pass adds at most what is missing; later ones extrapolate from the last growth
+    */
+    size_t json_before = 0UL;
+    size_t bej_before = 0UL;
+    for (unsigned pass = 0; !result && enc.out.len < options->target_size; pass++) {
+        if (!g.arrays || pass == BEJ_GEN_TARGET_PASSES || (pass && enc.out.len <= bej_before)) {
+            errmsg("Document stops at %zu bytes, no arrays to make longer", enc.out.len);
+            result = FAILURE;
+            break;
+        }
+        size_t missing = options->target_size - enc.out.len;
+        if (pass) {
+            double json_per_byte = (double)(g.ctx.out.len - json_before) / (double)(enc.out.len - bej_before);
+            missing = (size_t)((double)missing * json_per_byte * 1.01) + 1U;
+        }
+        json_before = g.ctx.out.len;
+        bej_before = enc.out.len;
+        g.json_limit = json_before + missing;
+        result = bej_gen_document(&g, &enc);
+    }
+
+    if (!result) {
+        *json = g.ctx.out;
+        *bej = enc.out;
+        memset(&g.ctx.out, 0, sizeof(g.ctx.out));
+        memset(&enc.out, 0, sizeof(enc.out));
+    }
+
+    bej_encoder_free(&enc);
+    bej_free_context(&g.ctx);
+    free(g.string);
+    return result;
+}
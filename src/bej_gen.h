@@ -0,0 +1,45 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Synthetic document generator. Walks a schema dictionary from its root entry and makes up
+* values for a random selection of its members, producing the JSON the decoder is expected
+* to print for the document together with the BEJ encoding of it. The same seed and options
+* always give the same document.
+*/
+
+/**
+ * Shape of the generated document
+ */
+typedef struct {
+    uint64_t seed;
+    size_t max_depth;           // sets and arrays nested deeper than this are left out
+    uint32_t array_length;      // elements per array, at most, nested arrays are capped at 64k elements together
+    uint32_t string_length;     // bytes per string, at most
+    size_t target_size;         // outermost arrays get elements until the BEJ is at least this big, 0 to disable
+} bej_gen_options_t;
+
+
+/**
+ * @brief Fill options with the defaults: seed 1, depth 8, up to 4 array elements and 32 byte strings
+ *
+ * @param options Options to initialize
+ * @return nothing
+ */
+void bej_gen_default_options(bej_gen_options_t *options);
+
+
+/**
+ * @brief Generate a document from a schema dictionary
+ *
+ * Members of formats the encoder doesn't support are left out. The JSON matches what
+ * bej_decode() prints for the BEJ in the pretty style, byte for byte.
+ *
+ * @param dict Dictionary parsed with bej_parse_dict()
+ * @param options Document shape
+ * @param json Output, expected decoder output, release data with free()
+ * @param bej Output, encoded document, release data with free()
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_generate(bej_dictionary_context_t *dict, const bej_gen_options_t *options,
+                     bej_output_t *json, bej_output_t *bej);
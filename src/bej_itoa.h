@@ -0,0 +1,71 @@
+#pragma once
+#include "common.h"
+
+/*
+* Integer to decimal text without printf. The length is known up front from the bit
+* length, then the digits are written from the end two at a time out of a table of the
+* pairs 00..99.
+*/
+
+#define BEJ_INT_MAX_LENGTH 20UL     // "-9223372036854775808" and "18446744073709551615"
+
+static const char bej_digit_pairs[201] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+static const uint64_t bej_powers_of_ten[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// number of decimal digits, log10(2) ~ 1233 / 4096 gets within one of it
+static inline size_t
+bej_u64_length(uint64_t value)
+{
+    size_t t = ((size_t)(64 - __builtin_clzll(value | 1ULL)) * 1233U) >> 12;
+    return t + 1U - (size_t)((value | 1ULL) < bej_powers_of_ten[t]);
+}
+
+/**
+ * @brief Write value in decimal, not null terminated
+ *
+ * @param out Output, room for BEJ_INT_MAX_LENGTH bytes
+ * @return Number of bytes written
+ */
+static inline size_t
+bej_u64_to_text(uint64_t value, char *out)
+{
+    size_t n = bej_u64_length(value);
+    char *p = out + n;
+    while (value >= 100U) {
+        size_t pair = (size_t)(value % 100U) * 2U;
+        value /= 100U;
+        p -= 2;
+        memcpy(p, &bej_digit_pairs[pair], 2);
+    }
+    if (value >= 10U) {
+        memcpy(p - 2, &bej_digit_pairs[value * 2U], 2);
+    } else {
+        p[-1] = (char)('0' + value);
+    }
+    return n;
+}
+
+/**
+ * @brief Signed bej_u64_to_text()
+ */
+static inline size_t
+bej_i64_to_text(int64_t value, char *out)
+{
+    uint64_t magnitude = (uint64_t)value;
+    size_t sign = 0UL;
+    if (value < 0) {
+        *out = '-';
+        magnitude = 0ULL - magnitude;
+        sign = 1UL;
+    }
+    return sign + bej_u64_to_text(magnitude, out + sign);
+}
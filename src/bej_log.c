@@ -0,0 +1,56 @@
+/**
+ * @file bej_log.c
+ * @brief Log sink of the library, stderr unless the application plugs in its own
+ */
+#include "common.h"
+#include <stdarg.h>
+
+#define BEJ_LOG_MESSAGE_MAX 1024
+
+static void
+bej_log_stderr(void *user, int level, const char *func, int line, const char *message)
+{
+    (void)user;
+    switch (level) {
+    case BEJ_LOG_ERROR:
+        fprintf(stderr, "Error at %s():%d What: %s\n", func, line, message);
+        break;
+    case BEJ_LOG_WARNING:
+        fprintf(stderr, "Warning at %s():%d What: %s\n", func, line, message);
+        break;
+    case BEJ_LOG_DEBUG:
+        fprintf(stderr, "[DEBUG] %s():%d: %s\n", func, line, message);
+        break;
+    default:
+        fprintf(stderr, "%s\n", message);
+        break;
+    }
+}
+
+static bej_log_fn log_handler = bej_log_stderr;
+static void *log_handler_data;
+
+void
+bej_set_log_handler(bej_log_fn fn, void *user)
+{
+    log_handler = fn ? fn : bej_log_stderr;
+    log_handler_data = fn ? user : NULL;
+}
+
+void
+bej_log(bej_log_fn fn, void *user, int level, const char *func, int line, const char *fmt, ...)
+{
+    if (!fn) {
+        fn = log_handler;
+        user = log_handler_data;
+    }
+
+    // longer messages are cut, they are diagnostics and not data
+    char message[BEJ_LOG_MESSAGE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, sizeof(message), fmt, args);
+    va_end(args);
+
+    fn(user, level, func, line, message);
+}
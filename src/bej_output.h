@@ -0,0 +1,351 @@
+#pragma once
+#include "bej.h"
+#include "bej_itoa.h"
+
+/*
+* Output sink and JSON, CBOR and MessagePack emitters shared by bej_decode() and the streaming decoder. Everything
+* the decoder emits is appended to ctx->out and only reaches ctx->output on bej_flush()
+* or when the buffer fills up.
+*/
+
+#define bej_out_literal(ctx, str) bej_out_write((ctx), (str), sizeof(str) - 1)
+
+/**
+ * @brief Make room for at least n contiguous bytes in the output buffer
+ * 
+ * Flushes pending output to ctx->output and grows the buffer if n still doesn't fit.
+ * 
+ * @param ctx BEJ decoder context
+ * @param n Number of bytes the caller is about to append
+ * @return SUCCESS or FAILURE, failures are also latched in ctx->out.error
+ */
+uint8_t bej_output_reserve(bej_context_t *ctx, size_t n);
+
+static inline uint8_t *
+bej_out_tail(bej_context_t *ctx, size_t n)
+{
+    if (ctx->out.cap - ctx->out.len < n && bej_output_reserve(ctx, n))
+        return NULL;
+    return ctx->out.data + ctx->out.len;
+}
+
+static inline void
+bej_out_write(bej_context_t *ctx, const void *src, size_t n)
+{
+    uint8_t *dst = bej_out_tail(ctx, n);
+    if (!dst)
+        return;
+    memcpy(dst, src, n);
+    ctx->out.len += n;
+}
+
+static inline void
+bej_out_putc(bej_context_t *ctx, char c)
+{
+    uint8_t *dst = bej_out_tail(ctx, 1);
+    if (!dst)
+        return;
+    *dst = (uint8_t)c;
+    ctx->out.len++;
+}
+
+static inline void
+write_int(bej_context_t *ctx, int64_t value)
+{
+    uint8_t *dst = bej_out_tail(ctx, BEJ_INT_MAX_LENGTH);
+    if (!dst)
+        return;
+    ctx->out.len += bej_i64_to_text(value, (char *)dst);
+}
+
+static inline void
+write_uint(bej_context_t *ctx, uint64_t value)
+{
+    uint8_t *dst = bej_out_tail(ctx, BEJ_INT_MAX_LENGTH);
+    if (!dst)
+        return;
+    ctx->out.len += bej_u64_to_text(value, (char *)dst);
+}
+
+static inline void
+write_newline(bej_context_t *ctx)
+{
+    if (ctx->style == BEJ_STYLE_PRETTY && !ctx->encoding)
+        bej_out_putc(ctx, '\n');
+}
+
+#define BEJ_INDENT_TABS 64
+
+static const char bej_indent_tabs[BEJ_INDENT_TABS + 1] =
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+    "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+// one copy out of a ready-made run of tabs, deeper documents take one per 64 levels
+static inline void
+write_indent(bej_context_t *ctx)
+{
+    if (ctx->style != BEJ_STYLE_PRETTY || ctx->encoding)
+        return;
+    for (size_t left = (ctx->indent_level > 0) ? (size_t)ctx->indent_level : 0UL; left; ) {
+        size_t n = (left < BEJ_INDENT_TABS) ? left : BEJ_INDENT_TABS;
+        bej_out_write(ctx, bej_indent_tabs, n);
+        left -= n;
+    }
+}
+
+/*
+* CBOR (RFC 8949) and MessagePack emitters for the binary encodings, see bej_set_encoding().
+* Both put a big-endian argument after a type byte, BEJ gives every count and length up front
+* so nothing is ever written with an indefinite length.
+*/
+
+#define BEJ_BINARY_HEAD_MAX 9UL     // type byte and a 64 bit argument
+
+// CBOR major types in the top three bits of the initial byte
+#define CBOR_UINT 0x00U
+#define CBOR_NEGINT 0x20U
+#define CBOR_TEXT 0x60U
+#define CBOR_ARRAY 0x80U
+#define CBOR_MAP 0xA0U
+#define CBOR_FALSE 0xF4U
+#define CBOR_TRUE 0xF5U
+#define CBOR_NULL 0xF6U
+#define CBOR_FLOAT64 0xFBU
+
+#define MSGPACK_NIL 0xC0U
+#define MSGPACK_FALSE 0xC2U
+#define MSGPACK_TRUE 0xC3U
+#define MSGPACK_FLOAT64 0xCBU
+
+static inline size_t
+bej_put_be(uint8_t *p, uint64_t value, size_t n)
+{
+    for (size_t i = n; i > 0; i--) {
+        p[i - 1] = (uint8_t)value;
+        value >>= 8;
+    }
+    return n;
+}
+
+static inline void
+write_cbor_head(bej_context_t *ctx, uint8_t major, uint64_t value)
+{
+    uint8_t *p = bej_out_tail(ctx, BEJ_BINARY_HEAD_MAX);
+    if (!p)
+        return;
+
+    size_t n = 1UL;
+    if (value < 24U) {
+        p[0] = (uint8_t)(major | value);
+    } else if (value <= UINT8_MAX) {
+        p[0] = major | 24U;
+        n += bej_put_be(p + 1, value, 1);
+    } else if (value <= UINT16_MAX) {
+        p[0] = major | 25U;
+        n += bej_put_be(p + 1, value, 2);
+    } else if (value <= UINT32_MAX) {
+        p[0] = major | 26U;
+        n += bej_put_be(p + 1, value, 4);
+    } else {
+        p[0] = major | 27U;
+        n += bej_put_be(p + 1, value, 8);
+    }
+    ctx->out.len += n;
+}
+
+/* MessagePack str/array/map header: the fix form below fix_limit, then the 8 (code8, if the
+*  type has one), 16 and 32 bit forms, code16 + 1 is the 32 bit one
+*/
+static inline void
+write_msgpack_head(bej_context_t *ctx, uint8_t fix, uint32_t fix_limit, uint8_t code8,
+                   uint8_t code16, uint32_t value)
+{
+    uint8_t *p = bej_out_tail(ctx, BEJ_BINARY_HEAD_MAX);
+    if (!p)
+        return;
+
+    size_t n = 1UL;
+    if (value < fix_limit) {
+        p[0] = (uint8_t)(fix | value);
+    } else if (code8 && value <= UINT8_MAX) {
+        p[0] = code8;
+        n += bej_put_be(p + 1, value, 1);
+    } else if (value <= UINT16_MAX) {
+        p[0] = code16;
+        n += bej_put_be(p + 1, value, 2);
+    } else {
+        p[0] = code16 + 1U;
+        n += bej_put_be(p + 1, value, 4);
+    }
+    ctx->out.len += n;
+}
+
+static inline void
+write_msgpack_int(bej_context_t *ctx, int64_t value)
+{
+    uint8_t *p = bej_out_tail(ctx, BEJ_BINARY_HEAD_MAX);
+    if (!p)
+        return;
+
+    size_t n = 1UL;
+    if (value >= -32 && value < 128) {
+        p[0] = (uint8_t)value;      // positive and negative fixint
+    } else if (value > 0) {
+        uint64_t u = (uint64_t)value;
+        size_t width = (u <= UINT8_MAX) ? 1UL : (u <= UINT16_MAX) ? 2UL : (u <= UINT32_MAX) ? 4UL : 8UL;
+        p[0] = (uint8_t)(0xCCU + __builtin_ctzll(width));      // uint 8/16/32/64
+        n += bej_put_be(p + 1, u, width);
+    } else {
+        size_t width = (value >= INT8_MIN) ? 1UL : (value >= INT16_MIN) ? 2UL
+                     : (value >= INT32_MIN) ? 4UL : 8UL;
+        p[0] = (uint8_t)(0xD0U + __builtin_ctzll(width));      // int 8/16/32/64
+        n += bej_put_be(p + 1, (uint64_t)value, width);
+    }
+    ctx->out.len += n;
+}
+
+static inline void
+write_binary_int(bej_context_t *ctx, int64_t value)
+{
+    if (ctx->encoding == BEJ_ENCODING_MSGPACK)
+        write_msgpack_int(ctx, value);
+    else if (value >= 0)
+        write_cbor_head(ctx, CBOR_UINT, (uint64_t)value);
+    else
+        write_cbor_head(ctx, CBOR_NEGINT, ~(uint64_t)value);   // -1 - value
+}
+
+static inline void
+write_binary_text(bej_context_t *ctx, const void *text, size_t length)
+{
+    if (ctx->encoding == BEJ_ENCODING_MSGPACK)
+        write_msgpack_head(ctx, 0xA0U, 32U, 0xD9U, 0xDAU, (uint32_t)length);
+    else
+        write_cbor_head(ctx, CBOR_TEXT, length);
+    bej_out_write(ctx, text, length);
+}
+
+// map for BEJ_FORMAT_SET, array for BEJ_FORMAT_ARRAY
+static inline void
+write_binary_container(bej_context_t *ctx, uint8_t format, uint32_t count)
+{
+    if (ctx->encoding == BEJ_ENCODING_MSGPACK) {
+        if (format == BEJ_FORMAT_SET)
+            write_msgpack_head(ctx, 0x80U, 16U, 0U, 0xDEU, count);
+        else
+            write_msgpack_head(ctx, 0x90U, 16U, 0U, 0xDCU, count);
+    } else {
+        write_cbor_head(ctx, (format == BEJ_FORMAT_SET) ? CBOR_MAP : CBOR_ARRAY, count);
+    }
+}
+
+static inline void
+write_binary_double(bej_context_t *ctx, double value)
+{
+    uint8_t *p = bej_out_tail(ctx, BEJ_BINARY_HEAD_MAX);
+    if (!p)
+        return;
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    p[0] = (ctx->encoding == BEJ_ENCODING_MSGPACK) ? MSGPACK_FLOAT64 : CBOR_FLOAT64;
+    ctx->out.len += 1U + bej_put_be(p + 1, bits, 8);
+}
+
+static inline void
+write_binary_bool(bej_context_t *ctx, uint8_t value)
+{
+    if (ctx->encoding == BEJ_ENCODING_MSGPACK)
+        bej_out_putc(ctx, (char)(value ? MSGPACK_TRUE : MSGPACK_FALSE));
+    else
+        bej_out_putc(ctx, (char)(value ? CBOR_TRUE : CBOR_FALSE));
+}
+
+static inline void
+write_binary_null(bej_context_t *ctx)
+{
+    bej_out_putc(ctx, (char)((ctx->encoding == BEJ_ENCODING_MSGPACK) ? MSGPACK_NIL : CBOR_NULL));
+}
+
+/* set/array delimiters for every encoding, the caller keeps ctx->indent_level
+*  opening needs the element count, a map or array header can't be patched afterwards
+*/
+static inline void
+write_open(bej_context_t *ctx, uint8_t format, uint32_t count)
+{
+    if (ctx->encoding) {
+        write_binary_container(ctx, format, count);
+        return;
+    }
+    bej_out_putc(ctx, (format == BEJ_FORMAT_SET) ? '{' : '[');
+    write_newline(ctx);
+}
+
+// after element index of count
+static inline void
+write_separator(bej_context_t *ctx, uint32_t index, uint32_t count)
+{
+    if (ctx->encoding)
+        return;
+    if (index + 1 < count)
+        bej_out_putc(ctx, ',');
+    write_newline(ctx);
+}
+
+/**
+ * @brief Close a set/array after done of its count elements
+ * 
+ * @return SUCCESS, or FAILURE for a binary encoding that already promised more elements
+ */
+static inline uint8_t
+write_close(bej_context_t *ctx, uint8_t format, uint32_t done, uint32_t count)
+{
+    if (ctx->encoding) {
+        if (done < count) {
+            errmsg_ctx(ctx, "%s ends after %u of its %u elements", (format == BEJ_FORMAT_SET) ? "Set" : "Array",
+                   done, count);
+            return FAILURE;
+        }
+        return SUCCESS;
+    }
+    write_indent(ctx);
+    bej_out_putc(ctx, (format == BEJ_FORMAT_SET) ? '}' : ']');
+    return SUCCESS;
+}
+
+/**
+ * @brief Write "name": of a dictionary entry, nothing for entries without a name
+ */
+void write_entry_name(bej_context_t *ctx, bej_dictionary_context_t *dict, bej_dict_entry_t *entry);
+
+/**
+ * @brief Write set member name, "unknown_<seq>": when the entry is not in the dictionary
+ * 
+ * @param entry Dictionary entry, NULL if the sequence was not found
+ */
+void write_member_name(bej_context_t *ctx, bej_dictionary_context_t *dict, bej_dict_entry_t *entry,
+                       uint32_t sequence);
+
+/**
+ * @brief Write JSON-escaped bytes without the surrounding quotes
+ * 
+ * @return SUCCESS or FAILURE
+ */
+uint8_t write_escaped(bej_context_t *ctx, const uint8_t *value, size_t length);
+
+/**
+ * @brief Open a new nesting level in ctx->frames, growing it unless it was caller-provided
+ * 
+ * @return Zeroed frame, NULL when ctx->max_depth or the provided storage is exhausted
+ */
+bej_frame_t *bej_push_frame(bej_context_t *ctx);
+
+/**
+ * @brief Decode one element of a set or array, at ctx->offset and bounded by parent->end
+ * 
+ * Writes what the element takes within its parent: the member name for a set, then the value.
+ * 
+ * @param parent Set/array the element belongs to, ctx->depth is 0 within the element
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_decode_element(bej_context_t *ctx, const bej_frame_t *parent);
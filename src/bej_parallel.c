@@ -0,0 +1,312 @@
+/**
+ * @file bej_parallel.c
+ * @brief Decoding of big sets and arrays on a work-stealing pool of threads
+ */
+#include "bej_parallel.h"
+#include "bej_output.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/**
+ * Consecutive elements [first, last) and the output written for them
+ */
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    bej_output_t out;
+} bej_chunk_t;
+
+typedef struct bej_pool bej_pool_t;
+
+/**
+ * Deque of chunks [head, tail) of one worker, the owner takes the head and thieves the tail
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t head;
+    uint32_t tail;
+    unsigned id;
+    bej_pool_t *pool;
+    bej_context_t sub;      // copy of the context the worker decodes with
+    pthread_t thread;
+} bej_worker_t;
+
+struct bej_pool {
+    const bej_frame_t *frame;
+    const size_t *starts;   // element offsets, one past the last element at the end
+    bej_chunk_t *chunks;
+    bej_worker_t *workers;
+    unsigned count;
+    atomic_uint failed;
+};
+
+uint8_t
+bej_set_parallel(bej_context_t *ctx, unsigned threads, size_t min_bytes)
+{
+    if (!ctx) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    if (!threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned)cpus : 1U;
+    }
+    ctx->parallel_threads = threads;
+    ctx->parallel_min_bytes = min_bytes ? min_bytes : BEJ_PARALLEL_MIN_BYTES;
+
+    return SUCCESS;
+}
+
+/* offsets of the elements of frame from ctx->offset on, reading headers only
+*  returns the number of elements, 0 when a header doesn't read and the elements are left
+*  to the sequential decode. The lengths are checked the way decode_bej_iterative() does,
+*  so every element it decodes ends exactly where the next one starts here
+*/
+static uint32_t
+bej_prescan(bej_context_t *ctx, const bej_frame_t *frame, size_t **starts)
+{
+    size_t offset = ctx->offset;
+    size_t end = frame->end;
+
+    // a tuple takes at least three bytes: sequence, format and length
+    size_t cap = (end - offset) / 3UL;
+    if (cap > frame->count)
+        cap = frame->count;
+    *starts = malloc((cap + 1UL) * sizeof(size_t));
+    if (!*starts) {
+        errmsg_ctx(ctx, "Failed to allocate %zu element offsets", cap + 1UL);
+        return 0U;
+    }
+
+    uint32_t n = 0U;
+    while (n < frame->count && offset < end) {
+        uint32_t sequence = 0U;
+        uint8_t dict_selector = 0U;
+        uint8_t format = 0U;
+        uint8_t flags = 0U;
+        uint32_t length = 0U;
+
+        (*starts)[n] = offset;
+        if (bej_read_sequence_number(ctx->bej_data, &offset, end, &sequence, &dict_selector)
+            || bej_read_format(ctx->bej_data, &offset, end, &format, &flags)
+            || bej_read_nnint(ctx->bej_data, &offset, end, &length)
+            || length > end - offset)
+            return 0U;
+        offset += length;
+        n++;
+    }
+    (*starts)[n] = offset;
+
+    return n;
+}
+
+// next chunk for worker self, its own first and then one stolen from the others
+static uint8_t
+bej_pool_take(bej_pool_t *pool, unsigned self, uint32_t *chunk)
+{
+    for (unsigned i = 0; i < pool->count; i++) {
+        bej_worker_t *w = &pool->workers[(self + i) % pool->count];
+
+        pthread_mutex_lock(&w->lock);
+        uint8_t found = w->head < w->tail;
+        if (found)
+            *chunk = i ? --w->tail : w->head++;
+        pthread_mutex_unlock(&w->lock);
+        if (found)
+            return SUCCESS;
+    }
+
+    return FAILURE;
+}
+
+static uint8_t
+bej_decode_chunk(bej_pool_t *pool, bej_context_t *sub, bej_chunk_t *chunk)
+{
+    uint8_t result = SUCCESS;
+
+    sub->out = chunk->out;
+    for (uint32_t i = chunk->first; i < chunk->last; i++) {
+        sub->offset = pool->starts[i];
+        write_indent(sub);
+        result = bej_decode_element(sub, pool->frame);
+        if (result)
+            break;
+        write_separator(sub, i, pool->frame->count);
+    }
+    chunk->out = sub->out;
+    memset(&sub->out, 0, sizeof(sub->out));
+
+    return (result || chunk->out.error) ? FAILURE : SUCCESS;
+}
+
+static void *
+bej_pool_worker(void *arg)
+{
+    bej_worker_t *w = arg;
+    bej_pool_t *pool = w->pool;
+    uint32_t chunk = 0U;
+
+    while (!atomic_load_explicit(&pool->failed, memory_order_relaxed)
+           && !bej_pool_take(pool, w->id, &chunk)) {
+        if (bej_decode_chunk(pool, &w->sub, &pool->chunks[chunk]))
+            atomic_store_explicit(&pool->failed, 1U, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+/* chunks of consecutive elements with about the same number of bytes each, at least one
+*  element per chunk
+*/
+static void
+bej_split_chunks(const size_t *starts, uint32_t n, bej_chunk_t *chunks, uint32_t count)
+{
+    size_t total = starts[n] - starts[0];
+    uint32_t i = 0U;
+
+    for (uint32_t c = 0; c < count; c++) {
+        size_t target = starts[0] + total * (c + 1U) / count;
+        uint32_t last = n - (count - c - 1U);     // leaves one element for every later chunk
+
+        chunks[c].first = i++;
+        while (i < last && starts[i] < target)
+            i++;
+        chunks[c].last = (c + 1U == count) ? n : i;
+    }
+}
+
+// context of a worker, same document and dictionaries, output and frames of its own
+static void
+bej_init_worker_context(bej_context_t *sub, const bej_context_t *ctx)
+{
+    *sub = *ctx;
+    sub->owns_schema_dict = 0U;
+    sub->output = NULL;
+    memset(&sub->out, 0, sizeof(sub->out));
+    sub->frames = NULL;
+    sub->frames_cap = 0UL;
+    sub->owns_frames = 0U;
+    sub->depth = 0UL;
+    sub->max_depth = ctx->max_depth - ctx->depth;
+    sub->parallel_threads = 0U;
+    memset(&sub->stats, 0, sizeof(sub->stats));
+}
+
+#ifdef BEJ_STATS
+// depths of the worker count from the set/array its elements belong to
+static void
+bej_merge_stats(bej_context_t *ctx, const bej_stats_t *sub)
+{
+    ctx->stats.tuples += sub->tuples;
+    ctx->stats.lookups += sub->lookups;
+    ctx->stats.probes += sub->probes;
+    ctx->stats.unknown += sub->unknown;
+    ctx->stats.length_mismatches += sub->length_mismatches;
+    if (sub->max_depth && ctx->depth + sub->max_depth > ctx->stats.max_depth)
+        ctx->stats.max_depth = ctx->depth + sub->max_depth;
+    for (unsigned i = 0; i < BEJ_STATS_FORMATS; i++) {
+        ctx->stats.format_tuples[i] += sub->format_tuples[i];
+        ctx->stats.format_bytes[i] += sub->format_bytes[i];
+    }
+}
+#endif /* BEJ_STATS */
+
+uint8_t
+bej_decode_parallel(bej_context_t *ctx, bej_frame_t *frame)
+{
+    // frames provided by the caller mean no allocations, workers would need frames of their own
+    if (!ctx->owns_frames)
+        return SUCCESS;
+
+    size_t *starts = NULL;
+    uint32_t n = bej_prescan(ctx, frame, &starts);
+    if (n < 2U) {
+        free(starts);
+        return SUCCESS;
+    }
+
+    /* an element bigger than a thread's share would keep the others waiting, typically the
+    *  one array of a resource: left to the caller, which then gets to split that one up
+    */
+    unsigned threads = ctx->parallel_threads;
+    if (threads > n)
+        threads = n;
+    size_t share = (starts[n] - starts[0]) / threads;
+    for (uint32_t i = 0; i < n; i++) {
+        if (starts[i + 1] - starts[i] > share) {
+            free(starts);
+            return SUCCESS;
+        }
+    }
+
+    uint32_t chunk_count = threads * BEJ_PARALLEL_CHUNKS_PER_THREAD;
+    if (chunk_count > n)
+        chunk_count = n;
+
+    bej_pool_t pool = {
+        .frame = frame,
+        .starts = starts,
+        .chunks = calloc(chunk_count, sizeof(bej_chunk_t)),
+        .workers = calloc(threads, sizeof(bej_worker_t)),
+        .count = threads,
+    };
+    atomic_init(&pool.failed, 0U);
+    if (!pool.chunks || !pool.workers) {
+        errmsg_ctx(ctx, "Failed to allocate a pool of %u threads", threads);
+        free(pool.chunks);
+        free(pool.workers);
+        free(starts);
+        return FAILURE;
+    }
+    bej_split_chunks(starts, n, pool.chunks, chunk_count);
+
+    // every worker starts with a contiguous run of chunks, stealing evens out the rest
+    for (unsigned w = 0; w < threads; w++) {
+        bej_worker_t *worker = &pool.workers[w];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->head = (uint32_t)((uint64_t)chunk_count * w / threads);
+        worker->tail = (uint32_t)((uint64_t)chunk_count * (w + 1U) / threads);
+        worker->id = w;
+        worker->pool = &pool;
+        bej_init_worker_context(&worker->sub, ctx);
+    }
+
+    // this thread is worker 0, chunks of workers that fail to start get stolen
+    unsigned started = 1U;
+    for (; started < threads; started++) {
+        if (pthread_create(&pool.workers[started].thread, NULL, bej_pool_worker, &pool.workers[started])) {
+            warnmsg_ctx(ctx, "Failed to start decoder thread %u", started);
+            break;
+        }
+    }
+    bej_pool_worker(&pool.workers[0]);
+    for (unsigned w = 1; w < started; w++)
+        pthread_join(pool.workers[w].thread, NULL);
+
+    uint8_t result = atomic_load(&pool.failed) ? FAILURE : SUCCESS;
+    for (uint32_t c = 0; c < chunk_count; c++) {
+        if (!result && pool.chunks[c].out.len)
+            bej_out_write(ctx, pool.chunks[c].out.data, pool.chunks[c].out.len);
+        free(pool.chunks[c].out.data);
+    }
+    for (unsigned w = 0; w < threads; w++) {
+        bej_worker_t *worker = &pool.workers[w];
+#ifdef BEJ_STATS
+        bej_merge_stats(ctx, &worker->sub.stats);
+#endif /* BEJ_STATS */
+        bej_set_frame_stack(&worker->sub, NULL, 0UL);
+        pthread_mutex_destroy(&worker->lock);
+    }
+
+    if (!result && !ctx->out.error) {
+        frame->index = n;
+        ctx->offset = starts[n];
+    }
+    free(pool.chunks);
+    free(pool.workers);
+    free(starts);
+
+    return (result || ctx->out.error) ? FAILURE : SUCCESS;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Parallel decoding of the elements of one big set or array, see bej_set_parallel(). Each SFLV
+* tuple carries its length, so a pre-scan of the element headers finds every element without
+* decoding it. Byte-balanced chunks of consecutive elements are spread over the deques of a
+* work-stealing pool: a worker takes chunks from the front of its own deque and, once that is
+* empty, steals from the back of the others. Every chunk is written to a buffer of its own, the
+* buffers are appended to ctx->out in document order once all are done.
+*/
+
+/**
+ * @brief Decode the elements of an open set/array on ctx->parallel_threads threads
+ *
+ * Called by bej_decode() right after the set/array is opened, with ctx->offset at its first
+ * element. On return the elements and their separators are written as the decode on one
+ * thread would write them, frame->index counts them and ctx->offset is past the last one.
+ * Elements whose headers don't pre-scan are all left to the caller, so that it reports them,
+ * and so are the elements of a set/array one of which is bigger than 1 / threads of them all:
+ * the caller descends into it instead and may split up a set/array within.
+ *
+ * @param ctx BEJ decoder context
+ * @param frame Innermost frame of ctx, the set/array
+ * @return SUCCESS, or FAILURE if an element fails to decode
+ */
+uint8_t bej_decode_parallel(bej_context_t *ctx, bej_frame_t *frame);
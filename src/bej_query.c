@@ -0,0 +1,171 @@
+/**
+ * @file bej_query.c
+ * @brief Path queries that skip everything off the path by length
+ */
+#include "bej_query.h"
+
+/* finds a member of a set entry by name, a plain scan of the child range as it only
+*  runs once per path component when the query is compiled
+*/
+static uint8_t
+bej_query_member(bej_dictionary_context_t *dict, bej_dict_entry_t *parent,
+                 const char *name, size_t length, bej_dict_entry_t *entry)
+{
+    char entry_name[BEJ_DICT_ENTRY_NAME_LENGTH + 1];
+
+    for (uint16_t i = 0; i < parent->child_count; i++) {
+        size_t offset = parent->child_offset + (size_t)i * BEJ_DICT_ENTRY_SIZE;
+        if (offset + BEJ_DICT_ENTRY_SIZE > dict->data_size)
+            break;
+
+        uint16_t sequence = READ_U16_LE(dict->data, offset + 1);
+        if (bej_dict_lookup(dict, parent->child_offset, parent->child_count, sequence, entry))
+            continue;
+        if (bej_get_entry_name(dict, entry, entry_name, sizeof(entry_name)))
+            continue;
+        if (strlen(entry_name) == length && !memcmp(entry_name, name, length))
+            return SUCCESS;
+    }
+
+    return FAILURE;
+}
+
+uint8_t
+bej_query_compile(bej_query_t *q, bej_dictionary_context_t *dict, const char *path)
+{
+    if (!q || !dict || !dict->data || !path) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(q, 0, sizeof(bej_query_t));
+    if (bej_dict_lookup(dict, BEJ_DICT_HEADER_SIZE, dict->entry_count, 0U, &q->root)) {
+        errmsg("Dictionary has no root entry");
+        return FAILURE;
+    }
+
+    bej_dict_entry_t *parent = &q->root;
+    while (*path) {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
+        size_t length = strcspn(path, "/");
+
+        if (q->count == BEJ_QUERY_MAX_STEPS) {
+            errmsg("Query path is longer than %d components", BEJ_QUERY_MAX_STEPS);
+            return FAILURE;
+        }
+        bej_query_step_t *step = &q->steps[q->count];
+
+        switch (parent->format >> 4) {
+            case BEJ_FORMAT_SET:
+                if (bej_query_member(dict, parent, path, length, &step->entry)) {
+                    errmsg("No member %.*s in the dictionary", (int)length, path);
+                    return FAILURE;
+                }
+                step->sequence = step->entry.sequence;
+                break;
+            case BEJ_FORMAT_ARRAY: {
+                char *end = NULL;
+                unsigned long index = strtoul(path, &end, 10);
+                if (*path < '0' || *path > '9' || end != path + length || index > UINT32_MAX) {
+                    errmsg("Invalid array index %.*s", (int)length, path);
+                    return FAILURE;
+                }
+                // all elements are described by the single child of the array entry
+                if (bej_dict_lookup(dict, parent->child_offset, parent->child_count, 0U, &step->entry)) {
+                    errmsg("Array before %.*s has no element entry", (int)length, path);
+                    return FAILURE;
+                }
+                step->sequence = (uint32_t)index;
+                break; }
+            default:
+                errmsg("Path goes on past a value at %.*s", (int)length, path);
+                return FAILURE;
+        }
+
+        parent = &step->entry;
+        q->count++;
+        path += length;
+    }
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_query_run(bej_context_t *ctx, const bej_query_t *q, uint8_t *found)
+{
+    if (!ctx || !ctx->bej_data || !q || !found) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    *found = 0U;
+    if (bej_check_header(ctx->bej_data, ctx->bej_size))
+        return FAILURE;
+    ctx->offset = BEJ_HEADER_SIZE;
+
+    size_t end = ctx->bej_size;
+    uint8_t container = BEJ_FORMAT_SET;
+
+    // level 0 is the root tuple, level n the tuple matching steps[n - 1]
+    for (size_t level = 0; level <= q->count; level++) {
+        uint32_t count = 1U;
+        if (level && bej_read_nnint(ctx->bej_data, &ctx->offset, end, &count)) {
+            errmsg_ctx(ctx, "Failed to read %s count", (container == BEJ_FORMAT_SET) ? "set" : "array");
+            return FAILURE;
+        }
+        const bej_query_step_t *step = level ? &q->steps[level - 1] : NULL;
+
+        uint8_t matched = 0U;
+        for (uint32_t i = 0; i < count && ctx->offset < end; i++) {
+            size_t start = ctx->offset;
+            uint32_t sequence = 0U;
+            uint8_t dict_selector = 0U;
+            uint8_t format = 0U;
+            uint8_t flags = 0U;
+            uint32_t length = 0U;
+
+            if (bej_read_sequence_number(ctx->bej_data, &ctx->offset, end, &sequence, &dict_selector)
+                || bej_read_format(ctx->bej_data, &ctx->offset, end, &format, &flags)
+                || bej_read_nnint(ctx->bej_data, &ctx->offset, end, &length)) {
+                errmsg_ctx(ctx, "Failed to read tuple header at offset %zu", ctx->offset);
+                return FAILURE;
+            }
+            if (ctx->offset + length > end) {
+                errmsg_ctx(ctx, "Value length %u exceeds enclosing value at offset %zu", length, ctx->offset);
+                return FAILURE;
+            }
+
+            /* array elements are matched by position, their sequence is the index anyway,
+            *  annotations never match as paths only name schema members
+            */
+            if (step && ((container == BEJ_FORMAT_ARRAY) ? i != step->sequence
+                                                         : (sequence != step->sequence || dict_selector))) {
+                ctx->offset += length;  // skipped without looking at the value
+                continue;
+            }
+
+            if (level == q->count) {
+                ctx->offset = start;
+                uint8_t result = bej_decode_value(ctx, step ? &step->entry : &q->root);
+                if (bej_flush(ctx))
+                    return FAILURE;
+                *found = !result;
+                return result;
+            }
+            if (format != BEJ_FORMAT_SET && format != BEJ_FORMAT_ARRAY)
+                return SUCCESS;     // path goes on, the document has a plain value here
+
+            end = ctx->offset + length;
+            container = format;
+            matched = 1U;
+            break;
+        }
+        if (!matched)
+            return SUCCESS;
+    }
+
+    return SUCCESS;
+}
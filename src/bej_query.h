@@ -0,0 +1,54 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Path queries: the path is resolved to sequence numbers through the dictionary once, the BEJ
+* document is then walked tuple by tuple and every value not on the path is stepped over by
+* its encoded length instead of being decoded. Only the matched value is written as JSON.
+*/
+
+#define BEJ_QUERY_MAX_STEPS 32
+
+/**
+ * Path component resolved against the dictionary
+ */
+typedef struct {
+    uint32_t sequence;          // member sequence, or element index inside arrays
+    bej_dict_entry_t entry;     // entry the matched tuple is decoded as
+} bej_query_step_t;
+
+/**
+ * Compiled path, reusable for any number of documents sharing the dictionary
+ */
+typedef struct {
+    bej_query_step_t steps[BEJ_QUERY_MAX_STEPS];
+    size_t count;               // 0 selects the whole document
+    bej_dict_entry_t root;
+} bej_query_t;
+
+
+/**
+ * @brief Resolve a /-separated path, e.g. "/Status/Conditions/0/Severity", to sequence numbers
+ *
+ * Member names are matched within the child range of their parent, array elements are given by index.
+ *
+ * @param q Query to populate
+ * @param dict Dictionary parsed with bej_parse_dict()
+ * @param path Path from the document root, leading / is optional
+ * @return SUCCESS or FAILURE if a member is not in the dictionary or the path is too long
+ */
+uint8_t bej_query_compile(bej_query_t *q, bej_dictionary_context_t *dict, const char *path);
+
+
+/**
+ * @brief Find the value a compiled query selects and write it as JSON
+ *
+ * The document is taken from ctx, initialized with bej_init_context() or bej_init_context_with_dict()
+ * using the dictionary the query was compiled with. Output is flushed on return.
+ *
+ * @param ctx BEJ decoder context
+ * @param q Compiled query
+ * @param found Output, 1 if the value is present in the document, nothing is written otherwise
+ * @return SUCCESS or FAILURE if the document is malformed along the path
+ */
+uint8_t bej_query_run(bej_context_t *ctx, const bej_query_t *q, uint8_t *found);
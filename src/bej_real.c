@@ -0,0 +1,247 @@
+/**
+ * @file bej_real.c
+ * @brief BEJ Real values, parsed and printed as the shortest round-trip JSON number
+ */
+#include "bej_real.h"
+#include "bej_itoa.h"
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+
+#define BEJ_REAL_EXACT_DIGITS 15U       // any decimal this short reads back to the same digits
+#define BEJ_REAL_MAX_DIGITS 800U        // past this only a sticky digit matters for rounding
+#define BEJ_REAL_MAX_EXPONENT 100000LL  // far beyond double range either way
+
+/**
+ * Value as significant digits, 0.<digits> * 10^point, no leading or trailing zeros
+ */
+typedef struct {
+    char digits[BEJ_REAL_MAX_DIGITS];
+    size_t count;
+    int64_t point;
+} bej_real_digits_t;
+
+static uint8_t
+bej_real_nnint(const uint8_t *value, size_t *offset, size_t size, uint64_t *result)
+{
+    if (*offset >= size)
+        return FAILURE;
+
+    uint8_t length = value[(*offset)++];
+    if (length > 8 || length > size - *offset)
+        return FAILURE;
+
+    *result = 0ULL;
+    for (uint8_t i = 0; i < length; i++)
+        *result |= ((uint64_t)value[*offset + i]) << (8 * i);
+    *offset += length;
+    return SUCCESS;
+}
+
+// bejInteger of a length given separately, an empty one is 0
+static uint8_t
+bej_real_integer(const uint8_t *value, size_t *offset, size_t size, uint64_t length, int64_t *result)
+{
+    if (length > 8 || length > size - *offset)
+        return FAILURE;
+
+    uint64_t bits = 0ULL;
+    for (uint64_t i = 0; i < length; i++)
+        bits |= ((uint64_t)value[*offset + i]) << (8 * i);
+    // sign extend if negative
+    if (length && length < 8 && (value[*offset + length - 1] & 0x80))
+        bits |= ~0ULL << (8 * length);
+    *result = (int64_t)bits;
+    *offset += length;
+    return SUCCESS;
+}
+
+uint8_t
+bej_real_parse(const uint8_t *value, uint32_t length, bej_real_t *real)
+{
+    if (!value || !real)
+        return FAILURE;
+
+    size_t offset = 0UL;
+    uint64_t whole_length, leading_zeros, exponent_length;
+    if (bej_real_nnint(value, &offset, length, &whole_length)
+        || bej_real_integer(value, &offset, length, whole_length, &real->whole)
+        || bej_real_nnint(value, &offset, length, &leading_zeros)
+        || leading_zeros > UINT32_MAX
+        || bej_real_nnint(value, &offset, length, &real->fract)
+        || bej_real_nnint(value, &offset, length, &exponent_length)
+        || bej_real_integer(value, &offset, length, exponent_length, &real->exponent))
+        return FAILURE;
+    real->leading_zeros = (uint32_t)leading_zeros;
+
+    return (offset == length) ? SUCCESS : FAILURE;
+}
+
+static void
+bej_real_decimal(const bej_real_t *real, bej_real_digits_t *d)
+{
+    uint64_t whole = (real->whole < 0) ? 0ULL - (uint64_t)real->whole : (uint64_t)real->whole;
+    d->count = whole ? bej_u64_to_text(whole, d->digits) : 0UL;
+    d->point = (int64_t)d->count;
+
+    if (real->fract) {
+        char fract[BEJ_INT_MAX_LENGTH];
+        size_t n = bej_u64_to_text(real->fract, fract);
+        if (!d->count) {
+            // leading zeros of a value below 1 only move the point
+            d->point -= real->leading_zeros;
+        } else if (d->count + real->leading_zeros + n > BEJ_REAL_MAX_DIGITS) {
+            // the fraction is too far down to show, but it still breaks rounding ties upwards
+            memset(&d->digits[d->count], '0', BEJ_REAL_MAX_DIGITS - 1 - d->count);
+            d->digits[BEJ_REAL_MAX_DIGITS - 1] = '1';
+            d->count = BEJ_REAL_MAX_DIGITS;
+            n = 0UL;
+        } else {
+            memset(&d->digits[d->count], '0', real->leading_zeros);
+            d->count += real->leading_zeros;
+        }
+        memcpy(&d->digits[d->count], fract, n);
+        d->count += n;
+    }
+
+    int64_t exponent = real->exponent;
+    if (exponent > BEJ_REAL_MAX_EXPONENT)
+        exponent = BEJ_REAL_MAX_EXPONENT;
+    else if (exponent < -BEJ_REAL_MAX_EXPONENT)
+        exponent = -BEJ_REAL_MAX_EXPONENT;
+    d->point += exponent;
+
+    while (d->count && d->digits[d->count - 1] == '0')
+        d->count--;
+}
+
+// correctly rounded, strtod() does the hard part
+static uint8_t
+bej_real_strtod(const bej_real_digits_t *d, double *value)
+{
+    if (!d->count) {
+        *value = 0.0;
+        return SUCCESS;
+    }
+
+    char text[BEJ_REAL_MAX_DIGITS + 32];
+    snprintf(text, sizeof(text), "0.%.*se%" PRId64, (int)d->count, d->digits, d->point);
+    *value = strtod(text, NULL);
+    return isfinite(*value) ? SUCCESS : FAILURE;
+}
+
+/* fewest digits that read back as value, value is not negative. Rounding a normal double
+*  to 15 digits leaves the shorter forms with trailing zeros, subnormals have fewer bits
+*  and need the full search
+*/
+static void
+bej_real_shortest(double value, bej_real_digits_t *d)
+{
+    char text[32];
+    int precision = (value < DBL_MIN) ? 1 : (int)BEJ_REAL_EXACT_DIGITS;
+    for (; precision <= 17; precision++) {
+        snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+        if (precision == 17 || strtod(text, NULL) == value)
+            break;
+    }
+
+    // d.ddddde[+-]x
+    char *e = strchr(text, 'e');
+    d->count = 0UL;
+    for (const char *p = text; p < e; p++) {
+        if (*p != '.')
+            d->digits[d->count++] = *p;
+    }
+    d->point = strtoll(e + 1, NULL, 10) + 1;
+
+    while (d->count && d->digits[d->count - 1] == '0')
+        d->count--;
+}
+
+static size_t
+bej_real_layout(const bej_real_digits_t *d, uint8_t negative, char *out)
+{
+    char *p = out;
+    if (negative)
+        *p++ = '-';
+
+    size_t count = d->count;
+    int64_t point = d->point;
+    if (!count) {
+        memcpy(p, "0.0", 3);
+        p += 3;
+    } else if (point > 0 && point <= 21) {
+        if ((size_t)point >= count) {
+            memcpy(p, d->digits, count);
+            memset(p + count, '0', (size_t)point - count);
+            p += point;
+            *p++ = '.';
+            *p++ = '0';
+        } else {
+            memcpy(p, d->digits, (size_t)point);
+            p += point;
+            *p++ = '.';
+            memcpy(p, &d->digits[point], count - (size_t)point);
+            p += count - (size_t)point;
+        }
+    } else if (point <= 0 && point > -6) {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', (size_t)-point);
+        p += -point;
+        memcpy(p, d->digits, count);
+        p += count;
+    } else {
+        *p++ = d->digits[0];
+        if (count > 1) {
+            *p++ = '.';
+            memcpy(p, &d->digits[1], count - 1);
+            p += count - 1;
+        }
+        *p++ = 'e';
+        int64_t exponent = point - 1;
+        if (exponent < 0)
+            *p++ = '-';
+        p += bej_u64_to_text((exponent < 0) ? (uint64_t)-exponent : (uint64_t)exponent, p);
+    }
+
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+size_t
+bej_real_format(const bej_real_t *real, char *out)
+{
+    if (!real || !out)
+        return 0UL;
+    *out = '\0';
+
+    bej_real_digits_t d;
+    bej_real_decimal(real, &d);
+
+    // short and well inside the normal range: the digits sent are the shortest already
+    if (d.count > BEJ_REAL_EXACT_DIGITS || d.point < -306 || d.point > 308) {
+        double value;
+        if (bej_real_strtod(&d, &value))
+            return 0UL;
+        bej_real_shortest(value, &d);
+    }
+
+    return bej_real_layout(&d, real->whole < 0, out);
+}
+
+uint8_t
+bej_real_to_double(const bej_real_t *real, double *value)
+{
+    if (!real || !value)
+        return FAILURE;
+
+    bej_real_digits_t d;
+    bej_real_decimal(real, &d);
+    uint8_t result = bej_real_strtod(&d, value);
+    if (result)
+        *value = HUGE_VAL;
+    if (real->whole < 0)
+        *value = -*value;
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "common.h"
+
+/*
+* BEJ Real values (DSP0218 5.3.9). The value bytes are
+*
+*   length of whole (nnint) | whole (bejInteger) | leading zero count (nnint) |
+*   fract (nnint) | length of exp (nnint) | exp (bejInteger)
+*
+* standing for whole.<leading zeros><fract> * 10^exp. The digits are decimal already, so
+* the text is the shortest one that reads back as the same double: the significant digits
+* as sent when there are at most 15 of them, otherwise the shortest of 15 to 17 digits
+* that round-trips.
+*/
+
+#define BEJ_REAL_MAX_LENGTH 32UL    // longest text bej_real_format() writes, terminator included
+
+/**
+ * Parts of a Real value
+ */
+typedef struct {
+    int64_t whole;              // carries the sign of the value
+    uint32_t leading_zeros;     // zeros between the decimal point and fract
+    uint64_t fract;
+    int64_t exponent;           // power of ten
+} bej_real_t;
+
+
+/**
+ * @brief Split the value bytes of a Real into its parts
+ *
+ * @param value Value bytes
+ * @param length Value length, every byte has to be used
+ * @param real Output, parts of the value
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_real_parse(const uint8_t *value, uint32_t length, bej_real_t *real);
+
+
+/**
+ * @brief Print a Real as a JSON number, the shortest text that reads back as the same double
+ *
+ * Integral values keep a ".0" so that they stay apart from Integer values, exponents are
+ * used below 1e-6 and from 1e21 on.
+ *
+ * @param real Parts of the value
+ * @param out Output, at least BEJ_REAL_MAX_LENGTH bytes, null terminated
+ * @return Length of the text, 0 if the value is out of the range of a double
+ */
+size_t bej_real_format(const bej_real_t *real, char *out);
+
+
+/**
+ * @brief Nearest double to a Real
+ *
+ * @param real Parts of the value
+ * @param value Output, +-HUGE_VAL if out of range
+ * @return SUCCESS, FAILURE if the value is out of the range of a double
+ */
+uint8_t bej_real_to_double(const bej_real_t *real, double *value);
@@ -0,0 +1,254 @@
+/**
+ * @file bej_registry.c
+ * @brief Shared dictionaries keyed by schema name and version, replaceable while in use
+ */
+#include "bej_registry.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+uint8_t
+bej_registry_init(bej_registry_t *reg, size_t capacity)
+{
+    if (!reg)
+        return FAILURE;
+
+    memset(reg, 0, sizeof(*reg));
+    reg->capacity = capacity ? capacity : BEJ_REGISTRY_DEFAULT_CAPACITY;
+    reg->slots = calloc(reg->capacity, sizeof(bej_registry_slot_t));
+    if (!reg->slots) {
+        errmsg("Failed to allocate %zu registry slots", reg->capacity);
+        return FAILURE;
+    }
+    atomic_init(&reg->count, 0UL);
+    if (pthread_mutex_init(&reg->lock, NULL)) {
+        free(reg->slots);
+        reg->slots = NULL;
+        errmsg("Failed to initialize registry lock");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+void
+bej_registry_release(bej_registry_dict_t *dict)
+{
+    if (!dict)
+        return;
+
+    // the last reference frees, acq_rel so every borrower's reads happen before that
+    if (atomic_fetch_sub_explicit(&dict->refs, 1U, memory_order_acq_rel) != 1U)
+        return;
+    bej_free_dict(&dict->dict);
+    bej_file_close(&dict->file);
+    free(dict);
+}
+
+void
+bej_registry_free(bej_registry_t *reg)
+{
+    if (!reg || !reg->slots)
+        return;
+
+    size_t count = atomic_load(&reg->count);
+    for (size_t i = 0; i < count; i++) {
+        bej_registry_release(atomic_load(&reg->slots[i].current));
+        pthread_mutex_destroy(&reg->slots[i].replace);
+    }
+    free(reg->slots);
+    pthread_mutex_destroy(&reg->lock);
+    memset(reg, 0, sizeof(*reg));
+}
+
+// key of the dictionary is the name of its root entry, sequence 0 of the top-level range
+static uint8_t
+bej_registry_name(bej_dictionary_context_t *dict, char *name, size_t size)
+{
+    bej_dict_entry_t root;
+    if (bej_dict_lookup(dict, BEJ_DICT_HEADER_SIZE, dict->entry_count, 0, &root)
+        || bej_get_entry_name(dict, &root, name, size) || name[0] == '\0') {
+        errmsg("Dictionary has no named root entry");
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/* takes over file, installs it as the current dictionary of its name/version, name receives the key
+*  borrowers only ever see a fully built dictionary through the slot's current pointer
+*/
+static uint8_t
+bej_registry_install(bej_registry_t *reg, bej_file_t *file, char name[BEJ_DICT_ENTRY_NAME_LENGTH+1])
+{
+    bej_registry_dict_t *dict = calloc(1, sizeof(bej_registry_dict_t));
+    if (!dict) {
+        errmsg("Failed to allocate registry dictionary");
+        bej_file_close(file);
+        return FAILURE;
+    }
+    dict->file = *file;
+    atomic_init(&dict->refs, 1U);     // the registry's own reference
+
+    if (bej_parse_dict(&dict->dict, dict->file.data, dict->file.size)
+        || bej_registry_name(&dict->dict, name, BEJ_DICT_ENTRY_NAME_LENGTH+1)) {
+        bej_registry_release(dict);
+        return FAILURE;
+    }
+
+    pthread_mutex_lock(&reg->lock);
+    size_t count = atomic_load_explicit(&reg->count, memory_order_relaxed);
+    bej_registry_slot_t *slot = NULL;
+    for (size_t i = 0; i < count; i++) {
+        if (reg->slots[i].schema_version == dict->dict.schema_version && !strcmp(reg->slots[i].name, name)) {
+            slot = &reg->slots[i];
+            break;
+        }
+    }
+
+    if (!slot) {
+        if (count == reg->capacity) {
+            pthread_mutex_unlock(&reg->lock);
+            errmsg("Registry is full, %zu dictionaries", reg->capacity);
+            bej_registry_release(dict);
+            return FAILURE;
+        }
+        // filled in before the count publishes it
+        slot = &reg->slots[count];
+        memcpy(slot->name, name, sizeof(slot->name));
+        slot->schema_version = dict->dict.schema_version;
+        atomic_init(&slot->epoch, 0U);
+        atomic_init(&slot->acquiring[0], 0U);
+        atomic_init(&slot->acquiring[1], 0U);
+        pthread_mutex_init(&slot->replace, NULL);
+        atomic_init(&slot->current, dict);
+        atomic_store_explicit(&reg->count, count + 1, memory_order_release);
+        pthread_mutex_unlock(&reg->lock);
+        return SUCCESS;
+    }
+
+    /* slots are never removed, so loads of other dictionaries can go on while this one drains
+    *  a borrower that may have loaded the old pointer counts itself in the epoch it started
+    *  in until it has its reference. New borrowers count in the next epoch, so only the ones
+    *  already under way are waited for, however busy the slot is
+    */
+    pthread_mutex_unlock(&reg->lock);
+    pthread_mutex_lock(&slot->replace);
+    bej_registry_dict_t *old = atomic_exchange(&slot->current, dict);
+    unsigned epoch = atomic_fetch_add(&slot->epoch, 1U);
+    while (atomic_load(&slot->acquiring[epoch & 1U]))
+        sched_yield();
+    pthread_mutex_unlock(&slot->replace);
+
+    bej_registry_release(old);
+    return SUCCESS;
+}
+
+uint8_t
+bej_registry_load(bej_registry_t *reg, const char *path)
+{
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+    return bej_registry_load_named(reg, path, name);
+}
+
+uint8_t
+bej_registry_load_named(bej_registry_t *reg, const char *path, char name[BEJ_DICT_ENTRY_NAME_LENGTH+1])
+{
+    if (!reg || !reg->slots || !path || !name)
+        return FAILURE;
+
+    bej_file_t file;
+    if (bej_file_open(&file, path))
+        return FAILURE;
+    if (bej_registry_install(reg, &file, name)) {
+        errmsg("Failed to load dictionary %s", path);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+uint8_t
+bej_registry_load_buffer(bej_registry_t *reg, const uint8_t *data, size_t size)
+{
+    if (!reg || !reg->slots || !data || !size)
+        return FAILURE;
+
+    // heap copies are aligned well enough for compiled dictionaries
+    bej_file_t file = {malloc(size), size, 0U};
+    if (!file.data) {
+        errmsg("Failed to allocate %zu bytes for a dictionary", size);
+        return FAILURE;
+    }
+    memcpy(file.data, data, size);
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+    return bej_registry_install(reg, &file, name);
+}
+
+uint8_t
+bej_registry_load_dir(bej_registry_t *reg, const char *dir)
+{
+    if (!reg || !dir)
+        return FAILURE;
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        errmsg("Failed to open directory %s: %s", dir, strerror(errno));
+        return FAILURE;
+    }
+
+    uint8_t result = SUCCESS;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+
+        char path[4096];
+        int n = snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        struct stat st;
+        if (n <= 0 || (size_t)n >= sizeof(path) || stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+        if (bej_registry_load(reg, path))
+            result = FAILURE;
+    }
+    closedir(d);
+
+    return result;
+}
+
+bej_registry_dict_t *
+bej_registry_acquire(bej_registry_t *reg, const char *name, uint32_t schema_version)
+{
+    if (!reg || !reg->slots || !name)
+        return NULL;
+
+    // a handful of schemas, a scan over the published slots is as quick as hashing the name
+    size_t count = atomic_load_explicit(&reg->count, memory_order_acquire);
+    bej_registry_slot_t *slot = NULL;
+    for (size_t i = 0; i < count; i++) {
+        bej_registry_slot_t *s = &reg->slots[i];
+        if (schema_version != BEJ_REGISTRY_ANY_VERSION && s->schema_version != schema_version)
+            continue;
+        if (strcmp(s->name, name))
+            continue;
+        if (!slot || s->schema_version > slot->schema_version)
+            slot = s;
+    }
+    if (!slot)
+        return NULL;
+
+    /* seq_cst pairs with the exchange and the epoch bump in bej_registry_install(), see there
+    *  counted in an epoch that has already ended, the replacement may not wait for us: retry
+    */
+    unsigned epoch = atomic_load(&slot->epoch);
+    atomic_fetch_add(&slot->acquiring[epoch & 1U], 1U);
+    while (atomic_load(&slot->epoch) != epoch) {
+        atomic_fetch_sub(&slot->acquiring[epoch & 1U], 1U);
+        epoch = atomic_load(&slot->epoch);
+        atomic_fetch_add(&slot->acquiring[epoch & 1U], 1U);
+    }
+    bej_registry_dict_t *dict = atomic_load(&slot->current);
+    atomic_fetch_add_explicit(&dict->refs, 1U, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&slot->acquiring[epoch & 1U], 1U, memory_order_release);
+
+    return dict;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "bej.h"
+#include "bej_file.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*
+* Resident dictionaries for long-running decoders. Each one is loaded, indexed and kept once,
+* keyed by the name of its root entry (e.g. "Memory") and its schema_version. Decoders borrow
+* them without taking a lock, loading a dictionary with a key that is already present replaces
+* it for new borrowers while the ones in flight keep the old copy until they release it.
+*/
+
+#define BEJ_REGISTRY_DEFAULT_CAPACITY 256UL
+#define BEJ_REGISTRY_ANY_VERSION UINT32_MAX
+
+/**
+ * Dictionary owned by the registry, reference counted
+ */
+typedef struct {
+    bej_dictionary_context_t dict;  // pass to bej_init_context_with_dict()
+    bej_file_t file;                // backing bytes, mapped or a heap copy
+    atomic_uint refs;
+} bej_registry_dict_t;
+
+/**
+ * Key of the registry and the dictionary currently installed for it
+ */
+typedef struct {
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+    uint32_t schema_version;
+    _Atomic(bej_registry_dict_t *) current;
+    atomic_uint epoch;              // bumped by every replacement, its parity picks the counter below
+    atomic_uint acquiring[2];       // borrowers between loading current and taking a reference
+    pthread_mutex_t replace;        // serializes replacements while the old borrowers drain
+} bej_registry_slot_t;
+
+/**
+ * Slots are only ever appended, so borrowers can scan the published ones while a writer adds more
+ */
+typedef struct {
+    bej_registry_slot_t *slots;
+    size_t capacity;
+    atomic_size_t count;
+    pthread_mutex_t lock;           // serializes loads, borrowers never take it
+} bej_registry_t;
+
+
+/**
+ * @brief Initialize an empty registry
+ *
+ * @param reg Registry to initialize
+ * @param capacity Most distinct name/version pairs it will hold, 0 for BEJ_REGISTRY_DEFAULT_CAPACITY
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_registry_init(bej_registry_t *reg, size_t capacity);
+
+/**
+ * @brief Drop the registry's references, dictionaries still borrowed are freed on their last release
+ *
+ * @param reg Registry, no loads or borrows may be running
+ * @return nothing
+ */
+void bej_registry_free(bej_registry_t *reg);
+
+/**
+ * @brief Map and index a dictionary file (plain DSP8010 or compiled) and install it
+ *
+ * @param reg Registry
+ * @param path Dictionary file
+ * @return SUCCESS or FAILURE, nothing changes on failure
+ */
+uint8_t bej_registry_load(bej_registry_t *reg, const char *path);
+
+/**
+ * @brief bej_registry_load() that also tells the name the dictionary was installed under
+ *
+ * @param reg Registry
+ * @param path Dictionary file
+ * @param name Output, name of the root entry, the key for bej_registry_acquire()
+ * @return SUCCESS or FAILURE, nothing changes on failure
+ */
+uint8_t bej_registry_load_named(bej_registry_t *reg, const char *path, char name[BEJ_DICT_ENTRY_NAME_LENGTH+1]);
+
+/**
+ * @brief Install a copy of a dictionary held in memory
+ *
+ * @param reg Registry
+ * @param data Dictionary bytes, need not outlive the call
+ * @param size Size of data
+ * @return SUCCESS or FAILURE, nothing changes on failure
+ */
+uint8_t bej_registry_load_buffer(bej_registry_t *reg, const uint8_t *data, size_t size);
+
+/**
+ * @brief Load every dictionary of a directory, e.g. an unpacked DSP8010 bundle
+ *
+ * Hidden files are skipped. Files that fail to load are reported and left out, the rest
+ * are installed regardless.
+ *
+ * @param reg Registry
+ * @param dir Directory to scan, not recursively
+ * @return SUCCESS if every file loaded, FAILURE otherwise
+ */
+uint8_t bej_registry_load_dir(bej_registry_t *reg, const char *dir);
+
+/**
+ * @brief Borrow a dictionary, lock-free and safe against concurrent loads
+ *
+ * @param reg Registry
+ * @param name Name of the dictionary's root entry
+ * @param schema_version Exact version, or BEJ_REGISTRY_ANY_VERSION for the highest one loaded
+ * @return Dictionary to hand back with bej_registry_release(), NULL if there is none
+ */
+bej_registry_dict_t *bej_registry_acquire(bej_registry_t *reg, const char *name, uint32_t schema_version);
+
+/**
+ * @brief Return a borrowed dictionary, frees it if it was replaced in the meantime
+ *
+ * @param dict Dictionary from bej_registry_acquire(), may be NULL
+ * @return nothing
+ */
+void bej_registry_release(bej_registry_dict_t *dict);
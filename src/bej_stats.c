@@ -0,0 +1,71 @@
+/**
+ * @file bej_stats.c
+ * @brief Decode counters of a context and their JSON form
+ */
+#include "bej.h"
+#include <inttypes.h>
+
+const bej_stats_t *
+bej_get_stats(const bej_context_t *ctx)
+{
+#ifdef BEJ_STATS
+    return ctx ? &ctx->stats : NULL;
+#else
+    (void)ctx;
+    return NULL;
+#endif /* BEJ_STATS */
+}
+
+#ifdef BEJ_STATS
+// keys of the per-format counters, enum eBEJtype; reserved formats are reported by number
+static const char *const bej_format_names[BEJ_STATS_FORMATS] = {
+    "set", "array", "null", "integer", "enum", "string", "real", "boolean",
+    "byte_string", "choice", "property_annotation", NULL, NULL, NULL,
+    "resource_link", "resource_link_expansion"
+};
+
+static void
+bej_write_counters(const bej_stats_t *stats, double seconds, FILE *out)
+{
+    fprintf(out, ",\"tuples\":%" PRIu64 ",\"tuples_per_second\":%.0f"
+                 ",\"lookups\":%" PRIu64 ",\"probes\":%" PRIu64 ",\"probes_per_lookup\":%.2f"
+                 ",\"unknown\":%" PRIu64 ",\"length_mismatches\":%" PRIu64 ",\"max_depth\":%" PRIu64,
+            stats->tuples, seconds > 0.0 ? (double)stats->tuples / seconds : 0.0,
+            stats->lookups, stats->probes,
+            stats->lookups ? (double)stats->probes / (double)stats->lookups : 0.0,
+            stats->unknown, stats->length_mismatches, stats->max_depth);
+
+    fprintf(out, ",\"formats\":{");
+    const char *separator = "";
+    for (unsigned i = 0; i < BEJ_STATS_FORMATS; i++) {
+        if (!stats->format_tuples[i])
+            continue;
+        if (bej_format_names[i])
+            fprintf(out, "%s\"%s\":", separator, bej_format_names[i]);
+        else
+            fprintf(out, "%s\"format_%u\":", separator, i);
+        fprintf(out, "{\"tuples\":%" PRIu64 ",\"bytes\":%" PRIu64 "}",
+                stats->format_tuples[i], stats->format_bytes[i]);
+        separator = ",";
+    }
+    fprintf(out, "}");
+}
+#endif /* BEJ_STATS */
+
+uint8_t
+bej_write_stats(const bej_context_t *ctx, double seconds, FILE *out)
+{
+    if (!ctx || !out) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    fprintf(out, "{\"seconds\":%.6f,\"bytes\":%zu,\"bytes_per_second\":%.0f",
+            seconds, ctx->bej_size, seconds > 0.0 ? (double)ctx->bej_size / seconds : 0.0);
+#ifdef BEJ_STATS
+    bej_write_counters(&ctx->stats, seconds, out);
+#endif /* BEJ_STATS */
+    fprintf(out, "}\n");
+
+    return ferror(out) ? FAILURE : SUCCESS;
+}
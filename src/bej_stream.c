@@ -0,0 +1,339 @@
+/**
+ * @file bej_stream.c
+ * @brief Resumable push decoder, same JSON as bej_decode() without needing the whole document
+ */
+#include "bej_stream.h"
+#include "bej_output.h"
+
+uint8_t
+bej_stream_init(bej_stream_t *s, bej_dictionary_context_t *schema_dict, FILE *output)
+{
+    if (!s || !schema_dict || !schema_dict->data) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(s, 0, sizeof(bej_stream_t));
+
+    s->ctx.schema_dict = *schema_dict;
+    s->ctx.output = output;
+    s->ctx.parent_child_offset[0] = BEJ_DICT_HEADER_SIZE;
+    s->ctx.parent_child_count[0] = schema_dict->entry_count;
+    s->ctx.max_depth = BEJ_DEFAULT_MAX_DEPTH;
+    s->state = BEJ_STREAM_HEADER;
+    s->nnint_left = -1;
+
+    return SUCCESS;
+}
+
+void
+bej_stream_free(bej_stream_t *s)
+{
+    if (!s)
+        return;
+
+    bej_free_context(&s->ctx);
+}
+
+/* accumulates an NNINT across chunks, returns 1 once it is complete
+*  bytes past the fourth don't fit the value and are dropped, same as bej_read_nnint()
+*/
+static uint8_t
+bej_stream_nnint(bej_stream_t *s, const uint8_t **p, const uint8_t *end)
+{
+    if (s->nnint_left < 0) {
+        s->nnint_left = *(*p)++;
+        s->offset++;
+        s->nnint = 0U;
+        s->nnint_shift = 0U;
+    }
+
+    while (s->nnint_left > 0 && *p < end) {
+        if (s->nnint_shift < 32U)
+            s->nnint |= ((uint32_t)**p) << s->nnint_shift;
+        s->nnint_shift += 8U;
+        s->nnint_left--;
+        (*p)++;
+        s->offset++;
+    }
+    if (s->nnint_left)
+        return 0U;
+
+    s->nnint_left = -1;
+    return 1U;
+}
+
+/* called whenever a value is complete (completed = 1) or a set/array just got its count,
+*  writes the separators and either starts the next element or closes finished sets/arrays
+*/
+static uint8_t
+bej_stream_next(bej_stream_t *s, uint8_t completed)
+{
+    bej_context_t *ctx = &s->ctx;
+
+    while (ctx->depth) {
+        bej_frame_t *frame = &ctx->frames[ctx->depth - 1];
+
+        if (completed) {
+            write_separator(ctx, frame->index, frame->count);
+            frame->index++;
+        }
+
+        if (frame->index < frame->count && s->offset < frame->end) {
+            write_indent(ctx);
+            s->state = BEJ_STREAM_SEQUENCE;
+            return SUCCESS;
+        }
+
+        ctx->indent_level--;
+        if (write_close(ctx, frame->format, frame->index, frame->count))
+            return FAILURE;
+
+        size_t frame_end = frame->end;
+        const char *kind = (frame->format == BEJ_FORMAT_SET) ? "Set" : "Array";
+        ctx->depth--;
+
+        // bej_decode() rewinds here, the bytes are gone already
+        if (s->offset > frame_end) {
+            errmsg_ctx(&s->ctx, "%s elements overrun its length: expected %zu, got %zu", kind, frame_end, s->offset);
+            return FAILURE;
+        }
+        if (s->offset < frame_end) {
+            warnmsg_ctx(&s->ctx, "%s length mismatch: expected %zu, got %zu", kind, frame_end, s->offset);
+            s->skip = frame_end - s->offset;
+            s->state = BEJ_STREAM_SKIP;
+            return SUCCESS;
+        }
+        completed = 1U;
+    }
+
+    s->state = BEJ_STREAM_DONE;
+    return SUCCESS;
+}
+
+/* header of the tuple is complete: write the member name and open the value
+*/
+static uint8_t
+bej_stream_begin_value(bej_stream_t *s)
+{
+    bej_context_t *ctx = &s->ctx;
+    bej_frame_t *parent = ctx->depth ? &ctx->frames[ctx->depth - 1] : NULL;
+
+    if (parent && s->offset + s->length > parent->end) {
+        errmsg_ctx(&s->ctx, "Value length %u exceeds enclosing value at offset %zu", s->length, s->offset);
+        return FAILURE;
+    }
+
+    // performing dict lookup, unknown entries have no children, array elements see decode_bej_sflv()
+    memset(&s->entry, 0, sizeof(s->entry));
+    uint8_t found_entry = 0U;
+    if (!parent) {
+        found_entry = !bej_lookup_tuple(ctx, ctx->parent_child_offset[0], ctx->parent_child_count[0],
+                                        BEJ_DICT_SCHEMA, s->sequence, s->dict_selector,
+                                        &s->entry, &s->entry_dict);
+    } else if (parent->format == BEJ_FORMAT_ARRAY) {
+        found_entry = !bej_lookup_tuple(ctx, parent->child_offset, parent->child_count,
+                                        parent->dict_selector, 0U, parent->dict_selector,
+                                        &s->entry, &s->entry_dict);
+    } else {
+        found_entry = !bej_lookup_tuple(ctx, parent->child_offset, parent->child_count,
+                                        parent->dict_selector, s->sequence, s->dict_selector,
+                                        &s->entry, &s->entry_dict);
+        write_member_name(ctx, s->entry_dict, found_entry ? &s->entry : NULL, s->sequence);
+    }
+
+    s->got = 0U;
+    switch (s->format) {
+        case BEJ_FORMAT_SET:
+        case BEJ_FORMAT_ARRAY: {
+            bej_frame_t *frame = bej_push_frame(ctx);
+            if (!frame)
+                return FAILURE;
+            frame->end = s->offset + s->length;
+            frame->child_offset = s->entry.child_offset;
+            frame->child_count = s->entry.child_count;
+            frame->format = s->format;
+            frame->dict_selector = (s->entry_dict == &ctx->anno_dict);
+
+            // an empty value has no room for the count
+            if (!s->length) {
+                write_open(ctx, s->format, 0U);
+                ctx->indent_level++;
+                return bej_stream_next(s, 0U);
+            }
+            s->state = BEJ_STREAM_COUNT;
+            return SUCCESS; }
+        case BEJ_FORMAT_STRING:
+            if (!s->length) {
+                if (ctx->encoding)
+                    write_binary_text(ctx, "", 0UL);
+                else
+                    bej_out_literal(ctx, "\"\"");
+                return bej_stream_next(s, 1U);
+            }
+            /* the text length goes first in CBOR/MessagePack, BEJ strings end with a null
+            *  terminator that is left out, checked once the last byte arrives
+            */
+            if (ctx->encoding == BEJ_ENCODING_MSGPACK)
+                write_msgpack_head(ctx, 0xA0U, 32U, 0xD9U, 0xDAU, s->length - 1U);
+            else if (ctx->encoding)
+                write_cbor_head(ctx, CBOR_TEXT, s->length - 1U);
+            else
+                bej_out_putc(ctx, '"');
+            s->state = BEJ_STREAM_STRING;
+            return SUCCESS;
+        default:
+            if (!s->length) {
+                if (decode_bej_leaf(ctx, s->entry_dict, s->format, &s->entry, s->value, 0U))
+                    return FAILURE;
+                return bej_stream_next(s, 1U);
+            }
+            s->state = BEJ_STREAM_VALUE;
+            return SUCCESS;
+    }
+}
+
+static uint8_t
+bej_stream_step(bej_stream_t *s, const uint8_t **p, const uint8_t *end)
+{
+    bej_context_t *ctx = &s->ctx;
+    size_t avail = (size_t)(end - *p);
+
+    switch (s->state) {
+        case BEJ_STREAM_HEADER: {
+            size_t n = BEJ_HEADER_SIZE - s->got;
+            if (n > avail)
+                n = avail;
+            memcpy(&s->value[s->got], *p, n);
+            *p += n;
+            s->offset += n;
+            s->got += (uint32_t)n;
+            if (s->got < BEJ_HEADER_SIZE)
+                return SUCCESS;
+            if (bej_check_header(s->value, BEJ_HEADER_SIZE))
+                return FAILURE;
+            s->state = BEJ_STREAM_SEQUENCE;
+            return SUCCESS; }
+        case BEJ_STREAM_SEQUENCE:
+            if (!bej_stream_nnint(s, p, end))
+                return SUCCESS;
+            s->sequence = s->nnint >> 1;
+            s->dict_selector = (uint8_t)(s->nnint & 0x01);
+            s->state = BEJ_STREAM_FORMAT;
+            return SUCCESS;
+        case BEJ_STREAM_FORMAT:
+            s->format = (**p >> 4) & 0x0F;
+            s->flags = **p & 0x0F;
+            (*p)++;
+            s->offset++;
+            s->state = BEJ_STREAM_LENGTH;
+            return SUCCESS;
+        case BEJ_STREAM_LENGTH:
+            if (!bej_stream_nnint(s, p, end))
+                return SUCCESS;
+            s->length = s->nnint;
+            return bej_stream_begin_value(s);
+        case BEJ_STREAM_COUNT:
+            if (!bej_stream_nnint(s, p, end))
+                return SUCCESS;
+            ctx->frames[ctx->depth - 1].count = s->nnint;
+            write_open(ctx, ctx->frames[ctx->depth - 1].format, s->nnint);
+            ctx->indent_level++;
+            return bej_stream_next(s, 0U);
+        case BEJ_STREAM_STRING: {
+            size_t n = s->length - s->got;
+            if (n > avail)
+                n = avail;
+            size_t out = n;
+            // last byte should be null terminator, we don't need it
+            if (s->got + n == s->length && (*p)[n - 1] == '\0') {
+                out--;
+            } else if (s->got + n == s->length && ctx->encoding) {
+                errmsg_ctx(&s->ctx, "String at offset %zu has no null terminator", s->offset);
+                return FAILURE;
+            }
+            if (ctx->encoding)
+                bej_out_write(ctx, *p, out);
+            else if (write_escaped(ctx, *p, out))
+                return FAILURE;
+            *p += n;
+            s->offset += n;
+            s->got += (uint32_t)n;
+            if (s->got < s->length)
+                return SUCCESS;
+            if (!ctx->encoding)
+                bej_out_putc(ctx, '"');
+            return bej_stream_next(s, 1U);
+        }
+        case BEJ_STREAM_VALUE: {
+            size_t n = s->length - s->got;
+            if (n > avail)
+                n = avail;
+            if (s->got < sizeof(s->value)) {
+                size_t keep = sizeof(s->value) - s->got;
+                memcpy(&s->value[s->got], *p, (n < keep) ? n : keep);
+            }
+            *p += n;
+            s->offset += n;
+            s->got += (uint32_t)n;
+            if (s->got < s->length)
+                return SUCCESS;
+            if (decode_bej_leaf(ctx, s->entry_dict, s->format, &s->entry, s->value, s->length))
+                return FAILURE;
+            return bej_stream_next(s, 1U);
+        }
+        case BEJ_STREAM_SKIP: {
+            size_t n = (s->skip < avail) ? s->skip : avail;
+            *p += n;
+            s->offset += n;
+            s->skip -= n;
+            if (s->skip)
+                return SUCCESS;
+            return bej_stream_next(s, 1U);
+        }
+        default:
+            return FAILURE;
+    }
+}
+
+uint8_t
+bej_stream_feed(bej_stream_t *s, const uint8_t *chunk, size_t len)
+{
+    if (!s || (!chunk && len)) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+    if (s->state == BEJ_STREAM_ERROR)
+        return FAILURE;
+
+    const uint8_t *p = chunk;
+    const uint8_t *end = chunk + len;
+
+    while (p < end && s->state != BEJ_STREAM_DONE) {
+        if (bej_stream_step(s, &p, end) || s->ctx.out.error) {
+            errmsg_ctx(&s->ctx, "Stream decoding failed at offset %zu", s->offset);
+            s->state = BEJ_STREAM_ERROR;
+            bej_flush(&s->ctx);
+            return FAILURE;
+        }
+    }
+    s->offset += (size_t)(end - p);     // anything after the root tuple
+
+    return bej_flush(&s->ctx);
+}
+
+uint8_t
+bej_stream_finish(bej_stream_t *s)
+{
+    if (!s)
+        return FAILURE;
+
+    if (s->state != BEJ_STREAM_DONE) {
+        if (s->state != BEJ_STREAM_ERROR)
+            errmsg_ctx(&s->ctx, "BEJ stream truncated at offset %zu", s->offset);
+        s->state = BEJ_STREAM_ERROR;
+        return FAILURE;
+    }
+
+    return bej_flush(&s->ctx);
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Push-style BEJ decoder for input that arrives in chunks, e.g. RDE multipart transfers.
+* JSON is emitted as soon as each SFLV tuple is complete, the decoder can suspend anywhere,
+* including in the middle of an NNINT or a string value. Output is byte-identical to bej_decode(),
+* except that CBOR/MessagePack output needs every string to end with its null terminator.
+*/
+
+/**
+ * Decoder states, each one waits for the part of the stream it is named after
+ */
+enum eBEJstreamState {
+    BEJ_STREAM_HEADER = 0,
+    BEJ_STREAM_SEQUENCE,
+    BEJ_STREAM_FORMAT,
+    BEJ_STREAM_LENGTH,
+    BEJ_STREAM_COUNT,       // set/array element count
+    BEJ_STREAM_STRING,      // string bytes, escaped and written as they come
+    BEJ_STREAM_VALUE,       // any other leaf value, buffered until complete
+    BEJ_STREAM_SKIP,        // trailing bytes of a set/array that its elements didn't cover
+    BEJ_STREAM_DONE,
+    BEJ_STREAM_ERROR
+};
+
+/**
+ * Streaming decoder state, ctx carries the dictionary, output, indentation and open sets/arrays
+ * like for bej_decode()
+ */
+typedef struct {
+    bej_context_t ctx;
+    uint8_t state;          // enum eBEJstreamState
+    size_t offset;          // bytes consumed so far
+
+    // NNINT being read, nnint_left is -1 until its length byte arrives
+    int nnint_left;
+    uint16_t nnint_shift;
+    uint32_t nnint;
+
+    // current SFLV tuple
+    uint32_t sequence;
+    uint8_t dict_selector;
+    uint8_t format;
+    uint8_t flags;
+    uint32_t length;
+    uint32_t got;           // value bytes consumed
+    bej_dict_entry_t entry;
+    bej_dictionary_context_t *entry_dict;   // schema or annotation dictionary of entry
+    size_t skip;
+
+    // leaf values (and the header) are small, longer ones only need their first bytes
+    uint8_t value[256];
+} bej_stream_t;
+
+
+/**
+ * @brief Initialize streaming decoder
+ *
+ * Nesting limit and frame storage are set on s->ctx the same way as for bej_decode().
+ *
+ * @param s Decoder to initialize
+ * @param schema_dict Dictionary parsed with bej_parse_dict(), borrowed
+ * @param output Output stream for JSON, written to on every feed. NULL keeps everything in s->ctx.out
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_stream_init(bej_stream_t *s, bej_dictionary_context_t *schema_dict, FILE *output);
+
+
+/**
+ * @brief Decode next chunk of BEJ data
+ *
+ * Bytes after the root tuple are ignored. Once a chunk fails every following call fails too.
+ *
+ * @param s Streaming decoder
+ * @param chunk Next bytes of the document, need not outlive the call
+ * @param len Size of chunk
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_stream_feed(bej_stream_t *s, const uint8_t *chunk, size_t len);
+
+
+/**
+ * @brief Finish decoding, fails if the document is incomplete
+ *
+ * @param s Streaming decoder
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_stream_finish(bej_stream_t *s);
+
+
+/**
+ * @brief Release resources held by streaming decoder
+ *
+ * @param s Decoder to release, may be reused after bej_stream_init()
+ * @return nothing
+ */
+void bej_stream_free(bej_stream_t *s);
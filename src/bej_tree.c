@@ -0,0 +1,387 @@
+/**
+ * @file bej_tree.c
+ * @brief BEJ to arena-allocated document tree
+ */
+#include "bej_tree.h"
+#include "bej_real.h"
+
+#define BEJ_ARENA_MIN_BLOCK ((size_t)4096)
+
+// smallest possible tuple: one-byte sequence NNINT of length 0, format, zero length
+#define BEJ_MIN_TUPLE_SIZE 3UL
+
+static void *
+bej_arena_alloc(bej_arena_t *arena, size_t size)
+{
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+
+    bej_arena_block_t *block = arena->head;
+    if (!block || block->cap - block->used < size) {
+        size_t cap = (arena->block_size < BEJ_ARENA_MIN_BLOCK) ? BEJ_ARENA_MIN_BLOCK : arena->block_size;
+        if (cap < size)
+            cap = size;     // oversized request, gets a block of its own
+        else
+            arena->block_size = cap * 2;
+
+        block = malloc(sizeof(bej_arena_block_t) + cap);
+        if (!block) {
+            errmsg("Failed to allocate %zu byte arena block", cap);
+            return NULL;
+        }
+        block->used = 0UL;
+        block->cap = cap;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *p = (uint8_t *)block->data + block->used;
+    block->used += size;
+    return p;
+}
+
+static void
+bej_arena_release(bej_arena_t *arena)
+{
+    bej_arena_block_t *block = arena->head;
+    while (block) {
+        bej_arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+typedef struct {
+    bej_tree_t *tree;
+    bej_dictionary_context_t *dict;
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+} bej_tree_builder_t;
+
+static void
+bej_tree_name(bej_dictionary_context_t *dict, bej_dict_entry_t *entry, const char **name, uint8_t *length)
+{
+    *name = NULL;
+    *length = 0U;
+    if (!entry->name_length || entry->name_offset + (size_t)entry->name_length > dict->data_size)
+        return;
+
+    const char *p = (const char *)&dict->data[entry->name_offset];
+    const char *nul = memchr(p, '\0', entry->name_length);
+    *length = nul ? (uint8_t)(nul - p) : entry->name_length;
+    if (*length)
+        *name = p;
+}
+
+static uint8_t
+bej_tree_leaf(bej_tree_builder_t *b, bej_node_t *node, bej_dict_entry_t *entry,
+              uint8_t *value, uint32_t length)
+{
+    switch (node->format) {
+        case BEJ_FORMAT_INTEGER: {
+            if (length == 0 || length > 8) {
+                errmsg("Invalid integer length: %u", length);
+                return FAILURE;
+            }
+            node->value.integer = bej_load_int_le(value, length);
+            return SUCCESS; }
+        case BEJ_FORMAT_REAL: {
+            bej_real_t real;
+            if (bej_real_parse(value, length, &real)) {
+                errmsg("Invalid real value of %u bytes", length);
+                return FAILURE;
+            }
+            // out of range only loses the digits, the infinity keeps the sign
+            bej_real_to_double(&real, &node->value.real);
+            return SUCCESS; }
+        case BEJ_FORMAT_STRING:
+            // last byte should be null terminator, not part of the view
+            if (length > 0 && value[length - 1] == '\0')
+                length--;
+            node->value.string.data = (const char *)value;
+            node->value.string.length = length;
+            return SUCCESS;
+        case BEJ_FORMAT_ENUM: {
+            size_t offset = 0UL;
+            if (bej_read_nnint(value, &offset, length, &node->value.enumeration.value)) {
+                errmsg("Failed to read enum value");
+                return FAILURE;
+            }
+            bej_dict_entry_t option;
+            if (!bej_dict_lookup(b->dict, entry->child_offset, entry->child_count,
+                                 node->value.enumeration.value, &option))
+                bej_tree_name(b->dict, &option, &node->value.enumeration.name,
+                              &node->value.enumeration.name_length);
+            return SUCCESS; }
+        case BEJ_FORMAT_BOOLEAN:
+            node->value.boolean = (length > 0 && value[0]);
+            return SUCCESS;
+        case BEJ_FORMAT_NULL:
+            return SUCCESS;
+        default:
+            node->value.raw.data = value;
+            node->value.raw.length = length;
+            return SUCCESS;
+    }
+}
+
+/* decodes the tuple at b->offset into node, its entry is either given (array elements)
+*  or looked up by sequence in the range of the parent set
+*/
+static uint8_t
+bej_tree_node(bej_tree_builder_t *b, bej_node_t *node, const bej_dict_entry_t *element,
+              uint16_t child_offset, uint16_t child_count, size_t depth)
+{
+    uint32_t sequence = 0U;
+    uint8_t dict_selector = 0U;
+    uint32_t length = 0U;
+
+    if (bej_read_sequence_number(b->data, &b->offset, b->size, &sequence, &dict_selector)
+        || bej_read_format(b->data, &b->offset, b->size, &node->format, &node->flags)
+        || bej_read_nnint(b->data, &b->offset, b->size, &length)) {
+        errmsg("Failed to read tuple header at offset %zu", b->offset);
+        return FAILURE;
+    }
+    if (b->offset + length > b->size) {
+        errmsg("Value length %u exceeds buffer at offset %zu", length, b->offset);
+        return FAILURE;
+    }
+    node->sequence = sequence;
+
+    // unknown entries have no children
+    bej_dict_entry_t entry = {0};
+    uint8_t found_entry = 0U;
+    if (element) {
+        entry = *element;
+    } else if (dict_selector == BEJ_DICT_SCHEMA) {
+        // annotations stay unnamed, there is no annotation dictionary to resolve them
+        found_entry = !bej_dict_lookup(b->dict, child_offset, child_count, sequence, &entry);
+        // set members only, the root has no name in the document either
+        if (found_entry && depth)
+            bej_tree_name(b->dict, &entry, &node->name, &node->name_length);
+    }
+
+    uint8_t *value = &b->data[b->offset];
+    size_t end = b->offset + length;
+    if (node->format != BEJ_FORMAT_SET && node->format != BEJ_FORMAT_ARRAY) {
+        b->offset = end;
+        return bej_tree_leaf(b, node, &entry, value, length);
+    }
+
+    if (depth >= BEJ_DEFAULT_MAX_DEPTH) {
+        errmsg("BEJ nesting too deep: more than %zu levels", (size_t)BEJ_DEFAULT_MAX_DEPTH);
+        return FAILURE;
+    }
+
+    uint32_t count = 0U;
+    if (bej_read_nnint(b->data, &b->offset, end, &count)) {
+        errmsg("Failed to read %s count", (node->format == BEJ_FORMAT_SET) ? "set" : "array");
+        return FAILURE;
+    }
+    // a crafted count can't make us allocate more nodes than the value has room for
+    if (b->offset < end && count > (end - b->offset) / BEJ_MIN_TUPLE_SIZE)
+        count = (uint32_t)((end - b->offset) / BEJ_MIN_TUPLE_SIZE);
+    else if (b->offset >= end)
+        count = 0U;
+
+    bej_node_t *children = NULL;
+    if (count) {
+        children = bej_arena_alloc(&b->tree->arena, (size_t)count * sizeof(bej_node_t));
+        if (!children)
+            return FAILURE;
+        memset(children, 0, (size_t)count * sizeof(bej_node_t));
+    }
+
+    /* array elements carry their index as sequence but are all described by the single
+    *  child of the array entry
+    */
+    bej_dict_entry_t array_element = {0};
+    const bej_dict_entry_t *elements = NULL;
+    if (node->format == BEJ_FORMAT_ARRAY)
+        elements = &array_element;
+    if (elements && entry.child_count)
+        bej_dict_lookup(b->dict, entry.child_offset, entry.child_count, 0U, &array_element);
+
+    /* children are read within this value only, one running past it would have us rewind
+    *  to end below and build the same bytes again
+    */
+    size_t size = b->size;
+    b->size = end;
+    uint32_t decoded = 0U;
+    for (; decoded < count && b->offset < end; decoded++) {
+        if (bej_tree_node(b, &children[decoded], elements, entry.child_offset, entry.child_count, depth + 1)) {
+            b->size = size;
+            return FAILURE;
+        }
+    }
+    b->size = size;
+    node->value.children.nodes = children;
+    node->value.children.count = decoded;
+
+    if (b->offset != end) {
+        warnmsg("%s length mismatch: expected %zu, got %zu",
+                (node->format == BEJ_FORMAT_SET) ? "Set" : "Array", end, b->offset);
+        b->offset = end;
+    }
+
+    return SUCCESS;
+}
+
+uint8_t
+bej_tree_decode(bej_tree_t *tree, bej_dictionary_context_t *dict,
+                const uint8_t *bej_data, size_t bej_size)
+{
+    if (!tree || !dict || !dict->data || !bej_data) {
+        errmsg("Invalid parameters");
+        return FAILURE;
+    }
+
+    memset(tree, 0, sizeof(bej_tree_t));
+    // first block sized for a quarter of the tuples the document could hold at most
+    tree->arena.block_size = bej_size / BEJ_MIN_TUPLE_SIZE / 4 * sizeof(bej_node_t);
+
+    if (bej_check_header(bej_data, bej_size))
+        return FAILURE;
+
+    bej_tree_builder_t b = {
+        .tree = tree,
+        .dict = dict,
+        .data = (uint8_t *)bej_data,    // only ever read
+        .size = bej_size,
+        .offset = BEJ_HEADER_SIZE,
+    };
+
+    bej_node_t *root = bej_arena_alloc(&tree->arena, sizeof(bej_node_t));
+    if (!root)
+        return FAILURE;
+    memset(root, 0, sizeof(bej_node_t));
+
+    if (bej_tree_node(&b, root, NULL, BEJ_DICT_HEADER_SIZE, dict->entry_count, 0UL))
+        return FAILURE;
+
+    tree->root = root;
+    return SUCCESS;
+}
+
+void
+bej_tree_free(bej_tree_t *tree)
+{
+    if (!tree)
+        return;
+
+    bej_arena_release(&tree->arena);
+    tree->root = NULL;
+}
+
+size_t
+bej_node_count(const bej_node_t *node)
+{
+    if (!node || (node->format != BEJ_FORMAT_SET && node->format != BEJ_FORMAT_ARRAY))
+        return 0UL;
+    return node->value.children.count;
+}
+
+const bej_node_t *
+bej_node_at(const bej_node_t *node, size_t index)
+{
+    if (index >= bej_node_count(node))
+        return NULL;
+    return &node->value.children.nodes[index];
+}
+
+static const bej_node_t *
+bej_node_member_n(const bej_node_t *node, const char *name, size_t length)
+{
+    if (!node || node->format != BEJ_FORMAT_SET)
+        return NULL;
+
+    for (uint32_t i = 0; i < node->value.children.count; i++) {
+        const bej_node_t *child = &node->value.children.nodes[i];
+        if (child->name_length == length && !memcmp(child->name, name, length))
+            return child;
+    }
+    return NULL;
+}
+
+const bej_node_t *
+bej_node_member(const bej_node_t *node, const char *name)
+{
+    if (!name)
+        return NULL;
+    return bej_node_member_n(node, name, strlen(name));
+}
+
+const bej_node_t *
+bej_node_find(const bej_node_t *node, const char *path)
+{
+    if (!path)
+        return NULL;
+
+    while (node && *path) {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
+        size_t length = strcspn(path, "/");
+
+        if (node->format == BEJ_FORMAT_ARRAY) {
+            char *end = NULL;
+            unsigned long index = strtoul(path, &end, 10);
+            if (end != path + length)
+                return NULL;
+            node = bej_node_at(node, index);
+        } else {
+            node = bej_node_member_n(node, path, length);
+        }
+        path += length;
+    }
+
+    return node;
+}
+
+uint8_t
+bej_node_get_int(const bej_node_t *node, int64_t *value)
+{
+    if (!node || !value || node->format != BEJ_FORMAT_INTEGER)
+        return FAILURE;
+    *value = node->value.integer;
+    return SUCCESS;
+}
+
+uint8_t
+bej_node_get_real(const bej_node_t *node, double *value)
+{
+    if (!node || !value || node->format != BEJ_FORMAT_REAL)
+        return FAILURE;
+    *value = node->value.real;
+    return SUCCESS;
+}
+
+uint8_t
+bej_node_get_bool(const bej_node_t *node, uint8_t *value)
+{
+    if (!node || !value || node->format != BEJ_FORMAT_BOOLEAN)
+        return FAILURE;
+    *value = node->value.boolean;
+    return SUCCESS;
+}
+
+uint8_t
+bej_node_get_string(const bej_node_t *node, const char **data, size_t *length)
+{
+    if (!node || !data || !length)
+        return FAILURE;
+
+    if (node->format == BEJ_FORMAT_STRING) {
+        *data = node->value.string.data;
+        *length = node->value.string.length;
+        return SUCCESS;
+    }
+    if (node->format == BEJ_FORMAT_ENUM && node->value.enumeration.name) {
+        *data = node->value.enumeration.name;
+        *length = node->value.enumeration.name_length;
+        return SUCCESS;
+    }
+    return FAILURE;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Document tree API: decodes BEJ into nodes carved out of an arena instead of into JSON text.
+* Names point into the dictionary data and string values into the BEJ buffer, neither is
+* copied or NUL terminated, so both buffers have to outlive the tree.
+*/
+
+/**
+ * Arena block, nodes are bump-allocated from data
+ */
+typedef struct bej_arena_block {
+    struct bej_arena_block *next;
+    size_t used;
+    size_t cap;
+    max_align_t data[];
+} bej_arena_block_t;
+
+/**
+ * Bump allocator backing a tree, released all at once
+ */
+typedef struct {
+    bej_arena_block_t *head;    // block being filled, older ones follow
+    size_t block_size;          // size of the next regular block
+} bej_arena_t;
+
+/**
+ * Decoded SFLV tuple
+ */
+typedef struct bej_node {
+    uint8_t format;         // enum eBEJtype
+    uint8_t flags;
+    uint8_t name_length;
+    const char *name;       // dictionary name, NULL for array elements and unknown entries
+    uint32_t sequence;
+    union {
+        int64_t integer;
+        double real;            // nearest double, +-HUGE_VAL past the range
+        uint8_t boolean;
+        struct {
+            const char *data;   // without the null terminator
+            uint32_t length;
+        } string;
+        struct {
+            const char *name;   // selected option, NULL if not in the dictionary
+            uint8_t name_length;
+            uint32_t value;
+        } enumeration;
+        struct {
+            struct bej_node *nodes;
+            uint32_t count;
+        } children;             // sets and arrays
+        struct {
+            const uint8_t *data;
+            uint32_t length;
+        } raw;                  // formats without a decoder
+    } value;
+} bej_node_t;
+
+/**
+ * Decoded document
+ */
+typedef struct {
+    bej_arena_t arena;
+    bej_node_t *root;
+} bej_tree_t;
+
+
+/**
+ * @brief Decode a BEJ document into a tree
+ *
+ * Nesting is limited to BEJ_DEFAULT_MAX_DEPTH levels.
+ *
+ * @param tree Tree to populate, release it with bej_tree_free() even on failure
+ * @param dict Dictionary parsed with bej_parse_dict()
+ * @param bej_data BEJ encoded data, must outlive the tree
+ * @param bej_size Size of BEJ data
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_tree_decode(bej_tree_t *tree, bej_dictionary_context_t *dict,
+                        const uint8_t *bej_data, size_t bej_size);
+
+
+/**
+ * @brief Release every node of the tree
+ *
+ * @param tree Tree to release
+ * @return nothing
+ */
+void bej_tree_free(bej_tree_t *tree);
+
+
+/**
+ * @brief Find set member by name
+ *
+ * @param node Set node
+ * @param name Member name, NUL terminated
+ * @return Member node, NULL if not found or node is not a set
+ */
+const bej_node_t *bej_node_member(const bej_node_t *node, const char *name);
+
+
+/**
+ * @brief Find node by a /-separated path of member names and array indexes, e.g. "Status/Conditions/0"
+ *
+ * @param node Node to start from
+ * @param path Path relative to node, leading / is optional
+ * @return Node, NULL if the path does not resolve
+ */
+const bej_node_t *bej_node_find(const bej_node_t *node, const char *path);
+
+
+/**
+ * @brief Get set member or array element by position
+ *
+ * @param node Set or array node
+ * @param index Position of the child
+ * @return Child node, NULL if out of range or node has no children
+ */
+const bej_node_t *bej_node_at(const bej_node_t *node, size_t index);
+
+
+/**
+ * @brief Number of set members or array elements, 0 for other nodes
+ */
+size_t bej_node_count(const bej_node_t *node);
+
+
+/**
+ * @brief Get value of an Integer node
+ *
+ * @return SUCCESS or FAILURE if node is NULL or not an Integer
+ */
+uint8_t bej_node_get_int(const bej_node_t *node, int64_t *value);
+
+
+/**
+ * @brief Get value of a Real node
+ *
+ * @return SUCCESS or FAILURE if node is NULL or not a Real
+ */
+uint8_t bej_node_get_real(const bej_node_t *node, double *value);
+
+
+/**
+ * @brief Get value of a Boolean node
+ *
+ * @return SUCCESS or FAILURE if node is NULL or not a Boolean
+ */
+uint8_t bej_node_get_bool(const bej_node_t *node, uint8_t *value);
+
+
+/**
+ * @brief Get text of a String node, or the option name of an Enum node
+ *
+ * @param data Output text, not NUL terminated
+ * @param length Output text length
+ * @return SUCCESS or FAILURE if node is NULL, not text, or an enum option missing from the dictionary
+ */
+uint8_t bej_node_get_string(const bej_node_t *node, const char **data, size_t *length);
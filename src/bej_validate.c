@@ -0,0 +1,222 @@
+/**
+ * @file bej_validate.c
+ * @brief Structural validation of BEJ documents without producing any output
+ */
+#include "bej_validate.h"
+#include "bej_output.h"
+#include "bej_real.h"
+
+/* bej_read_nnint() bounded by the enclosing value, wider NNINTs are fine as long as
+*  the bytes that don't fit the value are zero
+*/
+static uint8_t
+bej_validate_nnint(bej_context_t *ctx, size_t end, uint32_t *value, const char *what)
+{
+    size_t start = ctx->offset;
+    if (bej_read_nnint(ctx->bej_data, &ctx->offset, end, value)) {
+        ctx->offset = start;
+        errmsg_ctx(ctx, "%s NNINT at offset %zu exceeds its enclosing value", what, start);
+        return FAILURE;
+    }
+
+    for (size_t i = start + 1 + sizeof(uint32_t); i < ctx->offset; i++) {
+        if (ctx->bej_data[i]) {
+            ctx->offset = start;
+            errmsg_ctx(ctx, "%s NNINT at offset %zu does not fit 32 bits", what, start);
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+static uint8_t
+bej_validate_leaf(bej_context_t *ctx, bej_dictionary_context_t *dict, uint8_t format,
+                  bej_dict_entry_t *entry, uint8_t *value, uint32_t length)
+{
+    switch (format) {
+        case BEJ_FORMAT_INTEGER:
+            if (length == 0 || length > 8) {
+                errmsg_ctx(ctx, "Invalid integer length %u at offset %zu", length, ctx->offset);
+                return FAILURE;
+            }
+            return SUCCESS;
+        case BEJ_FORMAT_REAL: {
+            bej_real_t real;
+            if (bej_real_parse(value, length, &real)) {
+                errmsg_ctx(ctx, "Invalid real at offset %zu", ctx->offset);
+                return FAILURE;
+            }
+            return SUCCESS; }
+        case BEJ_FORMAT_STRING:
+            if (!length || value[length - 1] != '\0') {
+                errmsg_ctx(ctx, "String at offset %zu is not null terminated", ctx->offset);
+                return FAILURE;
+            }
+            return SUCCESS;
+        case BEJ_FORMAT_ENUM: {
+            size_t start = ctx->offset;
+            uint32_t option = 0U;
+            if (bej_validate_nnint(ctx, start + length, &option, "Enum"))
+                return FAILURE;
+            size_t used = ctx->offset - start;
+            ctx->offset = start;
+            if (used != length) {
+                errmsg_ctx(ctx, "Enum at offset %zu has %zu bytes past its value", start, length - used);
+                return FAILURE;
+            }
+            bej_dict_entry_t selected;
+            if (bej_dict_lookup(dict, entry->child_offset, entry->child_count, option, &selected)) {
+                errmsg_ctx(ctx, "Enum value %u at offset %zu not in dictionary", option, ctx->offset);
+                return FAILURE;
+            }
+            return SUCCESS; }
+        case BEJ_FORMAT_BOOLEAN:
+            if (length != 1) {
+                errmsg_ctx(ctx, "Invalid boolean length %u at offset %zu", length, ctx->offset);
+                return FAILURE;
+            }
+            return SUCCESS;
+        case BEJ_FORMAT_NULL:
+            if (length) {
+                errmsg_ctx(ctx, "Null at offset %zu has a %u byte value", ctx->offset, length);
+                return FAILURE;
+            }
+            return SUCCESS;
+        default:
+            // no decoder for these yet, the length is all there is to check
+            return SUCCESS;
+    }
+}
+
+uint8_t
+bej_validate(bej_context_t *ctx)
+{
+    if (!ctx || !ctx->bej_data || !ctx->schema_dict.data) {
+        errmsg("Invalid context");
+        return FAILURE;
+    }
+
+    ctx->offset = 0UL;
+    if (bej_check_header(ctx->bej_data, ctx->bej_size))
+        return FAILURE;
+    ctx->offset = BEJ_HEADER_SIZE;
+
+    uint16_t child_offset = ctx->parent_child_offset[0];
+    uint16_t child_count = ctx->parent_child_count[0];
+    uint8_t container = BEJ_FORMAT_SET;
+    uint8_t range_selector = BEJ_DICT_SCHEMA;
+    size_t end = ctx->bej_size;
+
+    ctx->depth = 0UL;
+    for (;;) {
+        size_t start = ctx->offset;
+        uint32_t sequence = 0U;
+        uint8_t format = 0U;
+        uint8_t flags = 0U;
+        uint32_t length = 0U;
+
+        if (bej_validate_nnint(ctx, end, &sequence, "Sequence"))
+            return FAILURE;
+        if (bej_read_format(ctx->bej_data, &ctx->offset, end, &format, &flags)) {
+            errmsg_ctx(ctx, "Format at offset %zu exceeds its enclosing value", ctx->offset);
+            return FAILURE;
+        }
+        if (bej_validate_nnint(ctx, end, &length, "Length"))
+            return FAILURE;
+        if (length > end - ctx->offset) {
+            errmsg_ctx(ctx, "Value length %u at offset %zu exceeds its enclosing value", length, ctx->offset);
+            return FAILURE;
+        }
+
+        uint8_t dict_selector = (uint8_t)(sequence & 0x01);
+        if (dict_selector && !ctx->anno_dict.data) {
+            ctx->offset = start;
+            errmsg_ctx(ctx, "Annotation at offset %zu, no annotation dictionary to resolve it", start);
+            return FAILURE;
+        }
+        sequence >>= 1;
+        if (container == BEJ_FORMAT_ARRAY && dict_selector != range_selector) {
+            ctx->offset = start;
+            errmsg_ctx(ctx, "Array element at offset %zu and its array select different dictionaries", start);
+            return FAILURE;
+        }
+
+        // array elements are all described by the single child of the array entry
+        bej_dict_entry_t entry;
+        bej_dictionary_context_t *dict = NULL;
+        if (bej_lookup_tuple(ctx, child_offset, child_count, range_selector,
+                             (container == BEJ_FORMAT_ARRAY) ? 0U : sequence, dict_selector,
+                             &entry, &dict)) {
+            ctx->offset = start;
+            errmsg_ctx(ctx, "Sequence %u at offset %zu not in %s dictionary", sequence, start,
+                   dict_selector ? "annotation" : "schema");
+            return FAILURE;
+        }
+        // any property may be sent as null
+        if (format != BEJ_FORMAT_NULL && format != (entry.format >> 4)) {
+            ctx->offset = start;
+            errmsg_ctx(ctx, "Format %u at offset %zu, dictionary expects %u", format, start, entry.format >> 4);
+            return FAILURE;
+        }
+
+        uint8_t completed = 1U;
+        if (format == BEJ_FORMAT_SET || format == BEJ_FORMAT_ARRAY) {
+            bej_frame_t *frame = bej_push_frame(ctx);
+            if (!frame)
+                return FAILURE;
+            frame->end = ctx->offset + length;
+            frame->child_offset = entry.child_offset;
+            frame->child_count = entry.child_count;
+            frame->format = format;
+            frame->dict_selector = dict_selector;
+
+            if (bej_validate_nnint(ctx, frame->end, &frame->count, "Count"))
+                return FAILURE;
+            completed = 0U;
+        } else {
+            if (bej_validate_leaf(ctx, dict, format, &entry, &ctx->bej_data[ctx->offset], length))
+                return FAILURE;
+            ctx->offset += length;
+        }
+
+        // close every set/array that got all of its elements
+        while (ctx->depth) {
+            bej_frame_t *frame = &ctx->frames[ctx->depth - 1];
+            if (completed)
+                frame->index++;
+            if (frame->index < frame->count) {
+                if (ctx->offset >= frame->end) {
+                    errmsg_ctx(ctx, "%s ending at offset %zu has %u of its %u elements",
+                           (frame->format == BEJ_FORMAT_SET) ? "Set" : "Array",
+                           frame->end, frame->index, frame->count);
+                    return FAILURE;
+                }
+                break;
+            }
+            if (ctx->offset != frame->end) {
+                errmsg_ctx(ctx, "%s length mismatch: expected %zu, got %zu",
+                       (frame->format == BEJ_FORMAT_SET) ? "Set" : "Array", frame->end, ctx->offset);
+                return FAILURE;
+            }
+            ctx->depth--;
+            completed = 1U;
+        }
+        if (!ctx->depth)
+            break;
+
+        bej_frame_t *parent = &ctx->frames[ctx->depth - 1];
+        child_offset = parent->child_offset;
+        child_count = parent->child_count;
+        container = parent->format;
+        range_selector = parent->dict_selector;
+        end = parent->end;
+    }
+
+    if (ctx->offset != ctx->bej_size) {
+        errmsg_ctx(ctx, "%zu trailing bytes after the root value at offset %zu",
+               ctx->bej_size - ctx->offset, ctx->offset);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Validate-only pass: walks the document exactly like bej_decode() but formats nothing.
+* Everything the decoder tolerates (length mismatches, unknown sequences, trailing bytes)
+* is an error here.
+*/
+
+
+/**
+ * @brief Check that a BEJ document is structurally sound against its dictionary
+ *
+ * Checks the header, that every NNINT and value lies within its enclosing value, that
+ * sets and arrays hold exactly their count of elements and end exactly at their length,
+ * that every sequence and enum value resolves through the dictionary, and that leaf
+ * values have a length their format allows.
+ *
+ * @param ctx BEJ decoder context, its output is never touched.
+ *            On failure ctx->offset is where the problem was found
+ * @return SUCCESS or FAILURE
+ */
+uint8_t bej_validate(bej_context_t *ctx);
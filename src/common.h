@@ -9,25 +9,99 @@
 #define FAILURE 1
 
 #define BEJ_CONTEXT_STACK_MAX_DEPTH ((uint8_t)16)
+#define BEJ_DEFAULT_MAX_DEPTH 1024UL
 #define BEJ_DICT_ENTRY_NAME_LENGTH ((uint8_t)255)
+#define BEJ_HEADER_SIZE 7UL
+#define BEJ_DICT_HEADER_SIZE 12UL
+#define BEJ_DICT_ENTRY_SIZE 10UL
+#define BEJ_DICT_INDEX_NONE 0xFFFFU
+#define BEJ_DICT_RANGE_NONE UINT32_MAX
+#define BEJ_OUTPUT_BUFFER_SIZE ((size_t)1 << 16)
+#define BEJ_STATS_FORMATS 16U
+#define BEJ_PARALLEL_MIN_BYTES ((size_t)1 << 20)
+#define BEJ_PARALLEL_CHUNKS_PER_THREAD 8U
 
 #define READ_U8_AND_INC(ptr, off) ((uint8_t)(ptr[off++]))
 #define READ_U16_LE(ptr, off) ((uint16_t)(ptr[off + 1] << 8) | (uint16_t)(ptr[off]))
-#define READ_U32_LE(ptr, off) ((uint32_t)(ptr[off + 3] << 24) | ((uint32_t)(ptr[off + 2] << 16)) | \
-                              ((uint32_t)(ptr[off + 1] << 8)) | (uint32_t)(ptr[off]))
+#define READ_U32_LE(ptr, off) (((uint32_t)ptr[off + 3] << 24) | ((uint32_t)ptr[off + 2] << 16) | \
+                              ((uint32_t)ptr[off + 1] << 8) | (uint32_t)ptr[off])
 
-#define errmsg(fmt, ...) \
-    fprintf(stderr, "Error at %s():%d What: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+/* little-endian two's complement integer of 1 to 8 bytes, sign extended; two overlapping
+*  loads instead of a loop over the bytes
+*/
+static inline int64_t
+bej_load_int_le(const uint8_t *value, uint32_t length)
+{
+    uint64_t bits;
+    if (length >= 4U) {
+        bits = (uint64_t)READ_U32_LE(value, 0U)
+             | ((uint64_t)READ_U32_LE(value, length - 4U) << (8U * (length - 4U)));
+    } else {
+        bits = (uint64_t)value[0]
+             | ((uint64_t)value[length / 2U] << (8U * (length / 2U)))
+             | ((uint64_t)value[length - 1U] << (8U * (length - 1U)));
+    }
+    unsigned shift = 64U - 8U * length;
+    return (int64_t)(bits << shift) >> shift;
+}
 
-#define warnmsg(fmt, ...) \
-    fprintf(stdout, "Warning at %s():%d What: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
-    
-#define infomsg(fmt, ...) \
-    fprintf(stdout, fmt "\n", ##__VA_ARGS__)
+/*
+* Logging. Messages at or below BEJ_LOG_LEVEL are formatted and handed to a log callback, the ones
+* above it compile to nothing. The level defaults to warnings for NDEBUG builds and to everything
+* otherwise, -DBEJ_LOG_LEVEL=... overrides it. Nothing is ever written to stdout, the callback of
+* last resort prints to stderr.
+*/
+#define BEJ_LOG_NONE (-1)
+#define BEJ_LOG_ERROR 0
+#define BEJ_LOG_WARNING 1
+#define BEJ_LOG_INFO 2
+#define BEJ_LOG_DEBUG 3
 
+#ifndef BEJ_LOG_LEVEL
 #ifdef NDEBUG
-#define dbgmsg(fmt, ...) \
-    fprintf(stdout, "[DEBUG] %s():%d: " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+#define BEJ_LOG_LEVEL BEJ_LOG_WARNING
 #else
-#define dbgmsg(fmt, ...) ((void)0)
-#endif /* NDEBUG */
\ No newline at end of file
+#define BEJ_LOG_LEVEL BEJ_LOG_DEBUG
+#endif /* NDEBUG */
+#endif /* BEJ_LOG_LEVEL */
+
+/**
+ * Log callback, message is formatted already and has no trailing newline of its own
+ */
+typedef void (*bej_log_fn)(void *user, int level, const char *func, int line, const char *message);
+
+/**
+ * @brief Format a message and pass it to fn, or to the handler of bej_set_log_handler() without one
+ *
+ * Called through the macros below, which leave it out entirely for levels above BEJ_LOG_LEVEL.
+ */
+void bej_log(bej_log_fn fn, void *user, int level, const char *func, int line, const char *fmt, ...)
+    __attribute__((format(printf, 6, 7)));
+
+/**
+ * @brief Replace the process-wide handler, NULL restores the one printing to stderr
+ *
+ * It receives every message not logged through a context with its own callback. Set it before
+ * decoding starts on other threads.
+ *
+ * @param fn Callback or NULL
+ * @param user Passed back to fn
+ * @return nothing
+ */
+void bej_set_log_handler(bej_log_fn fn, void *user);
+
+#define BEJ_LOG(fn, user, level, fmt, ...) \
+    do { \
+        if ((level) <= BEJ_LOG_LEVEL) \
+            bej_log(fn, user, level, __func__, __LINE__, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define errmsg(fmt, ...) BEJ_LOG(NULL, NULL, BEJ_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define warnmsg(fmt, ...) BEJ_LOG(NULL, NULL, BEJ_LOG_WARNING, fmt, ##__VA_ARGS__)
+#define infomsg(fmt, ...) BEJ_LOG(NULL, NULL, BEJ_LOG_INFO, fmt, ##__VA_ARGS__)
+#define dbgmsg(fmt, ...) BEJ_LOG(NULL, NULL, BEJ_LOG_DEBUG, fmt, ##__VA_ARGS__)
+
+// same for code holding a decoder context, its callback (see bej_set_log_callback()) goes first
+#define errmsg_ctx(ctx, fmt, ...) BEJ_LOG((ctx)->log, (ctx)->log_data, BEJ_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define warnmsg_ctx(ctx, fmt, ...) BEJ_LOG((ctx)->log, (ctx)->log_data, BEJ_LOG_WARNING, fmt, ##__VA_ARGS__)
+#define dbgmsg_ctx(ctx, fmt, ...) BEJ_LOG((ctx)->log, (ctx)->log_data, BEJ_LOG_DEBUG, fmt, ##__VA_ARGS__)
@@ -0,0 +1,520 @@
+/**
+ * @file daemon.c
+ * @brief Decoder daemon: resident dictionaries, BEJ in and JSON out over a Unix domain socket
+ */
+#include "daemon.h"
+#include "bej_registry.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define BEJ_DAEMON_MAX_CONNECTIONS 1024U  // open at once, idle ones included
+#define BEJ_DAEMON_POLL_MS 200      // how often the accept loop looks at the signal flags
+#define BEJ_DAEMON_READ_TIMEOUT_S 5 // a frame that stops arriving halfway gives its worker back
+
+typedef struct {
+    const bej_daemon_options_t *opts;
+    bej_registry_t registry;
+    char default_name[BEJ_DICT_ENTRY_NAME_LENGTH+1];    // root of the -s file, empty for a directory, under lock
+
+    /* a connection is in exactly one place: idle, polled by the accept loop until a request
+    *  arrives on it, queued, served by a worker for one request, or returned by the worker
+    *  to be polled again. Idle clients never hold a worker
+    */
+    int idle[BEJ_DAEMON_MAX_CONNECTIONS];       // accept loop only
+    size_t idle_count;
+    int queue[BEJ_DAEMON_MAX_CONNECTIONS];      // with a request ready, waiting for a worker
+    size_t head;
+    size_t queued;
+    int returned[BEJ_DAEMON_MAX_CONNECTIONS];
+    size_t returned_count;
+    size_t open;
+    int *active;            // per worker, connection being served or -1
+    uint8_t stopping;
+    pthread_mutex_t lock;   // everything above but idle
+    pthread_cond_t ready;
+    int wake[2];            // pipe, a worker returning a connection interrupts the accept loop's poll
+
+    atomic_size_t requests;
+    atomic_size_t failed;
+} daemon_state_t;
+
+typedef struct {
+    daemon_state_t *st;
+    unsigned index;
+    pthread_t thread;
+} daemon_worker_t;
+
+static volatile sig_atomic_t daemon_stop;
+static volatile sig_atomic_t daemon_reload;
+
+static void
+daemon_signal(int sig)
+{
+    if (sig == SIGHUP)
+        daemon_reload = 1;
+    else
+        daemon_stop = 1;
+}
+
+static uint8_t
+read_full(int fd, void *buf, size_t n)
+{
+    uint8_t *p = buf;
+    while (n) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return FAILURE;
+        p += r;
+        n -= (size_t)r;
+    }
+    return SUCCESS;
+}
+
+// header and body in one go where the socket takes them, no SIGPIPE from a vanished client
+static uint8_t
+send_response(int fd, uint8_t status, const void *body, size_t length)
+{
+    uint32_t frame = (uint32_t)length + 1U;
+    uint8_t head[5] = {(uint8_t)frame, (uint8_t)(frame >> 8), (uint8_t)(frame >> 16),
+                       (uint8_t)(frame >> 24), status};
+    struct iovec iov[2] = {{head, sizeof(head)}, {(void *)body, length}};
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = 2};
+
+    while (msg.msg_iovlen) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return FAILURE;
+        while (msg.msg_iovlen && (size_t)n >= msg.msg_iov->iov_len) {
+            n -= (ssize_t)msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen) {
+            msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= (size_t)n;
+        }
+    }
+    return SUCCESS;
+}
+
+static uint8_t
+send_error(int fd, uint8_t status, const char *message)
+{
+    return send_response(fd, status, message, strlen(message));
+}
+
+/* decodes into out, which is kept from one request to the next so that a worker
+*  stops allocating once its buffer has grown to the largest document it has seen
+*/
+static uint8_t
+daemon_decode(daemon_state_t *st, bej_dictionary_context_t *dict, uint8_t *bej, size_t size,
+              bej_output_t *out)
+{
+    bej_context_t ctx;
+    if (bej_init_context_with_dict(&ctx, dict, bej, size, NULL))
+        return FAILURE;
+
+    ctx.out = *out;
+    ctx.out.len = 0UL;
+    ctx.out.error = 0U;
+    uint8_t result = bej_set_style(&ctx, st->opts->style);
+    if (!result)
+        result = bej_set_encoding(&ctx, st->opts->encoding);
+    if (!result)
+        result = bej_set_annotation_dict(&ctx, st->opts->anno_dict);
+    if (!result)
+        result = bej_decode(&ctx);
+
+    *out = ctx.out;
+    memset(&ctx.out, 0, sizeof(ctx.out));
+    bej_free_context(&ctx);
+    return result || out->error;
+}
+
+/* one request of a connection the accept loop saw readable
+*  FAILURE when the client hung up or broke the framing and the connection is to be closed
+*/
+static uint8_t
+daemon_serve(daemon_state_t *st, int fd, bej_output_t *out, uint8_t **buf, size_t *cap)
+{
+    uint8_t head[4];
+    if (read_full(fd, head, sizeof(head)))
+        return FAILURE;
+    uint32_t length = READ_U32_LE(head, 0);
+    if (!length || length > BEJ_DAEMON_MAX_FRAME) {
+        send_error(fd, BEJ_DAEMON_BAD_REQUEST, "Frame length out of range");
+        return FAILURE;
+    }
+
+    if (length > *cap) {
+        uint8_t *grown = realloc(*buf, length);
+        if (!grown) {
+            errmsg("Failed to allocate %u bytes for a request", length);
+            return FAILURE;
+        }
+        *buf = grown;
+        *cap = length;
+    }
+    if (read_full(fd, *buf, length))
+        return FAILURE;
+
+    size_t name_length = (*buf)[0];
+    if (1U + name_length > length) {
+        send_error(fd, BEJ_DAEMON_BAD_REQUEST, "Schema name runs past the frame");
+        return FAILURE;
+    }
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+    memcpy(name, &(*buf)[1], name_length);
+    name[name_length] = '\0';
+    if (!name_length) {
+        pthread_mutex_lock(&st->lock);
+        memcpy(name, st->default_name, sizeof(name));
+        pthread_mutex_unlock(&st->lock);
+    }
+
+    atomic_fetch_add_explicit(&st->requests, 1, memory_order_relaxed);
+    bej_registry_dict_t *dict = bej_registry_acquire(&st->registry, name, BEJ_REGISTRY_ANY_VERSION);
+    if (!dict) {
+        atomic_fetch_add_explicit(&st->failed, 1, memory_order_relaxed);
+        return send_error(fd, BEJ_DAEMON_NO_DICTIONARY, "No dictionary loaded for this schema");
+    }
+    if (daemon_decode(st, &dict->dict, &(*buf)[1 + name_length], length - 1U - name_length, out)) {
+        bej_registry_release(dict);
+        atomic_fetch_add_explicit(&st->failed, 1, memory_order_relaxed);
+        return send_error(fd, BEJ_DAEMON_DECODE_FAILED, "Failed to decode BEJ data");
+    }
+    bej_registry_release(dict);
+    return send_response(fd, BEJ_DAEMON_OK, out->data, out->len);
+}
+
+static void *
+daemon_worker(void *arg)
+{
+    daemon_worker_t *w = arg;
+    daemon_state_t *st = w->st;
+    bej_output_t out = {0};
+    uint8_t *buf = NULL;
+    size_t cap = 0UL;
+
+    for (;;) {
+        pthread_mutex_lock(&st->lock);
+        while (!st->queued && !st->stopping)
+            pthread_cond_wait(&st->ready, &st->lock);
+        if (st->stopping) {
+            pthread_mutex_unlock(&st->lock);
+            break;
+        }
+        int fd = st->queue[st->head];
+        st->head = (st->head + 1) % BEJ_DAEMON_MAX_CONNECTIONS;
+        st->queued--;
+        // published under the lock so that shutdown can always reach it
+        st->active[w->index] = fd;
+        pthread_mutex_unlock(&st->lock);
+
+        uint8_t keep = !daemon_serve(st, fd, &out, &buf, &cap);
+
+        pthread_mutex_lock(&st->lock);
+        st->active[w->index] = -1;
+        keep = keep && !st->stopping;
+        if (keep) {
+            st->returned[st->returned_count++] = fd;
+        } else {
+            close(fd);
+            st->open--;
+        }
+        pthread_mutex_unlock(&st->lock);
+        // a full pipe already has a wakeup pending
+        if (keep && write(st->wake[1], "", 1) < 0 && errno != EAGAIN)
+            errmsg("Failed to wake the accept loop: %s", strerror(errno));
+    }
+
+    free(out.data);
+    free(buf);
+    return NULL;
+}
+
+static uint8_t
+daemon_load(daemon_state_t *st)
+{
+    struct stat sb;
+    if (stat(st->opts->schema_path, &sb)) {
+        errmsg("Failed to open %s: %s", st->opts->schema_path, strerror(errno));
+        return FAILURE;
+    }
+    if (S_ISDIR(sb.st_mode))
+        return bej_registry_load_dir(&st->registry, st->opts->schema_path);
+
+    // a reload may bring a different root, requests without a name follow it
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH+1];
+    if (bej_registry_load_named(&st->registry, st->opts->schema_path, name))
+        return FAILURE;
+    pthread_mutex_lock(&st->lock);
+    memcpy(st->default_name, name, sizeof(name));
+    pthread_mutex_unlock(&st->lock);
+    return SUCCESS;
+}
+
+static int
+daemon_listen(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errmsg("Socket path %s is too long", path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    // a socket left behind by a previous run, anything else at the path stays
+    struct stat sb;
+    if (!stat(path, &sb) && S_ISSOCK(sb.st_mode))
+        unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        errmsg("Failed to create socket: %s", strerror(errno));
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, BEJ_DAEMON_BACKLOG)) {
+        errmsg("Failed to listen on %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// new connections start out idle, waiting for their first request
+static void
+daemon_accept(daemon_state_t *st, int listen_fd)
+{
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+            errmsg("Failed to accept a connection: %s", strerror(errno));
+        return;
+    }
+
+    pthread_mutex_lock(&st->lock);
+    if (st->open == BEJ_DAEMON_MAX_CONNECTIONS) {
+        pthread_mutex_unlock(&st->lock);
+        errmsg("%u connections already open, refusing another", BEJ_DAEMON_MAX_CONNECTIONS);
+        close(fd);
+        return;
+    }
+    st->open++;
+    pthread_mutex_unlock(&st->lock);
+
+    struct timeval timeout = {.tv_sec = BEJ_DAEMON_READ_TIMEOUT_S};
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)))
+        warnmsg("Failed to set a receive timeout: %s", strerror(errno));
+    st->idle[st->idle_count++] = fd;
+}
+
+/* idle connections that became readable, with a request or a hangup, go to the workers
+*  pfds holds the idle connections in the order of st->idle
+*/
+static void
+daemon_dispatch(daemon_state_t *st, const struct pollfd *pfds)
+{
+    size_t kept = 0UL;
+
+    pthread_mutex_lock(&st->lock);
+    for (size_t i = 0; i < st->idle_count; i++) {
+        if (pfds[i].revents) {
+            st->queue[(st->head + st->queued) % BEJ_DAEMON_MAX_CONNECTIONS] = st->idle[i];
+            st->queued++;
+            pthread_cond_signal(&st->ready);
+        } else {
+            st->idle[kept++] = st->idle[i];
+        }
+    }
+    st->idle_count = kept;
+    pthread_mutex_unlock(&st->lock);
+}
+
+// connections workers are done with, polled again for their next request
+static void
+daemon_take_returned(daemon_state_t *st)
+{
+    char drain[64];
+    while (read(st->wake[0], drain, sizeof(drain)) > 0)
+        ;
+
+    pthread_mutex_lock(&st->lock);
+    memcpy(&st->idle[st->idle_count], st->returned, st->returned_count * sizeof(int));
+    st->idle_count += st->returned_count;
+    st->returned_count = 0UL;
+    pthread_mutex_unlock(&st->lock);
+}
+
+static uint8_t
+daemon_wake_pipe(int wake[2])
+{
+    if (pipe(wake)) {
+        errmsg("Failed to create a pipe: %s", strerror(errno));
+        return FAILURE;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (fcntl(wake[i], F_SETFL, O_NONBLOCK) || fcntl(wake[i], F_SETFD, FD_CLOEXEC)) {
+            errmsg("Failed to set up the wake pipe: %s", strerror(errno));
+            close(wake[0]);
+            close(wake[1]);
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+uint8_t
+bej_daemon_run(const bej_daemon_options_t *opts)
+{
+    if (!opts || !opts->socket_path || !opts->schema_path) {
+        errmsg("Invalid daemon parameters");
+        return FAILURE;
+    }
+
+    daemon_state_t *st = calloc(1, sizeof(daemon_state_t));
+    if (!st || bej_registry_init(&st->registry, 0)) {
+        errmsg("Failed to allocate daemon state");
+        free(st);
+        return FAILURE;
+    }
+    st->opts = opts;
+    atomic_init(&st->requests, 0);
+    atomic_init(&st->failed, 0);
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->ready, NULL);
+
+    struct stat sb;
+    uint8_t single = !stat(opts->schema_path, &sb) && !S_ISDIR(sb.st_mode);
+    if (daemon_load(st) && (single || !atomic_load(&st->registry.count))) {
+        pthread_cond_destroy(&st->ready);
+        pthread_mutex_destroy(&st->lock);
+        bej_registry_free(&st->registry);
+        free(st);
+        return FAILURE;
+    }
+
+    unsigned jobs = opts->jobs;
+    if (!jobs) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (unsigned)cpus : 1U;
+    }
+
+    int listen_fd = daemon_listen(opts->socket_path);
+    daemon_worker_t *workers = calloc(jobs, sizeof(daemon_worker_t));
+    st->active = malloc(jobs * sizeof(int));
+    // listening socket, wake pipe and every idle connection
+    struct pollfd *pfds = malloc((2UL + BEJ_DAEMON_MAX_CONNECTIONS) * sizeof(struct pollfd));
+    if (listen_fd < 0 || !workers || !st->active || !pfds || daemon_wake_pipe(st->wake)) {
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(opts->socket_path);
+        }
+        free(pfds);
+        free(workers);
+        free(st->active);
+        pthread_cond_destroy(&st->ready);
+        pthread_mutex_destroy(&st->lock);
+        bej_registry_free(&st->registry);
+        free(st);
+        return FAILURE;
+    }
+    for (unsigned i = 0; i < jobs; i++)
+        st->active[i] = -1;
+
+    struct sigaction sa = {0};
+    sa.sa_handler = daemon_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    daemon_stop = 0;
+    daemon_reload = 0;
+
+    unsigned started = 0;
+    for (; started < jobs; started++) {
+        workers[started].st = st;
+        workers[started].index = started;
+        if (pthread_create(&workers[started].thread, NULL, daemon_worker, &workers[started])) {
+            errmsg("Failed to start worker %u", started);
+            break;
+        }
+    }
+
+    uint8_t result = started ? SUCCESS : FAILURE;
+    if (started)
+        fprintf(stderr, "Daemon: listening on %s, %zu dictionaries, %u workers\n", opts->socket_path,
+                atomic_load(&st->registry.count), started);
+
+    while (started && !daemon_stop) {
+        pfds[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        pfds[1] = (struct pollfd){.fd = st->wake[0], .events = POLLIN};
+        for (size_t i = 0; i < st->idle_count; i++)
+            pfds[2 + i] = (struct pollfd){.fd = st->idle[i], .events = POLLIN};
+        int ready = poll(pfds, 2 + st->idle_count, BEJ_DAEMON_POLL_MS);
+        if (daemon_reload) {
+            // same name and version replace what is loaded, decodes in flight keep their copy
+            daemon_reload = 0;
+            if (daemon_load(st))
+                errmsg("Reload of %s was incomplete", opts->schema_path);
+            else
+                fprintf(stderr, "Daemon: reloaded %s\n", opts->schema_path);
+        }
+        if (ready <= 0)
+            continue;
+        daemon_dispatch(st, &pfds[2]);
+        if (pfds[1].revents)
+            daemon_take_returned(st);
+        if (pfds[0].revents)
+            daemon_accept(st, listen_fd);
+    }
+
+    close(listen_fd);
+    unlink(opts->socket_path);
+
+    // wake idle workers and end the connections that are being served
+    pthread_mutex_lock(&st->lock);
+    st->stopping = 1U;
+    for (unsigned i = 0; i < started; i++) {
+        if (st->active[i] >= 0)
+            shutdown(st->active[i], SHUT_RDWR);
+    }
+    for (; st->queued; st->queued--, st->head = (st->head + 1) % BEJ_DAEMON_MAX_CONNECTIONS)
+        close(st->queue[st->head]);
+    for (size_t i = 0; i < st->idle_count; i++)
+        close(st->idle[i]);
+    for (size_t i = 0; i < st->returned_count; i++)
+        close(st->returned[i]);
+    pthread_cond_broadcast(&st->ready);
+    pthread_mutex_unlock(&st->lock);
+    for (unsigned i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    fprintf(stderr, "Daemon: %zu requests (%zu failed)\n",
+            atomic_load(&st->requests), atomic_load(&st->failed));
+
+    close(st->wake[0]);
+    close(st->wake[1]);
+    free(pfds);
+    free(workers);
+    free(st->active);
+    pthread_cond_destroy(&st->ready);
+    pthread_mutex_destroy(&st->lock);
+    bej_registry_free(&st->registry);
+    free(st);
+    return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "bej.h"
+
+/*
+* Framing of the decoder daemon, integers are little-endian like in BEJ itself
+*
+*   request:  u32 length | u8 name_length | schema name | BEJ document
+*   response: u32 length | u8 status | JSON, or an error message unless status is BEJ_DAEMON_OK
+*
+* length counts the bytes following it. A connection carries any number of requests, answered
+* in order. The schema name is the root entry name of a loaded dictionary (e.g. "Memory"), its
+* highest loaded version decodes the document. An empty name picks the dictionary given with -s.
+*/
+
+#define BEJ_DAEMON_MAX_FRAME (64UL << 20)
+#define BEJ_DAEMON_BACKLOG 128
+
+/**
+ * Response status byte
+ */
+enum eBEJdaemonStatus {
+    BEJ_DAEMON_OK = 0,
+    BEJ_DAEMON_BAD_REQUEST = 1,     // frame too short or too long, the connection is closed after it
+    BEJ_DAEMON_NO_DICTIONARY = 2,
+    BEJ_DAEMON_DECODE_FAILED = 3
+};
+
+/**
+ * Settings of the daemon mode of the CLI
+ */
+typedef struct {
+    const char *socket_path;
+    const char *schema_path;    // dictionary file or directory of them, loaded again on SIGHUP
+    unsigned jobs;              // worker threads, 0 picks the number of online CPUs
+    uint8_t style;              // enum eBEJstyle
+    uint8_t encoding;           // enum eBEJencoding
+    bej_dictionary_context_t *anno_dict;    // parsed annotation dictionary shared by all workers, or NULL
+} bej_daemon_options_t;
+
+/**
+ * @brief Serve decode requests on a Unix domain socket until SIGINT or SIGTERM
+ *
+ * Dictionaries stay resident in a registry, SIGHUP reloads them without interrupting requests
+ * in flight. Idle connections are polled by the accept loop, a worker of a fixed pool takes one
+ * request at a time, so open connections don't tie up workers. A request that stops arriving
+ * halfway times out and closes its connection.
+ *
+ * @param opts Daemon settings
+ * @return SUCCESS on a clean shutdown, FAILURE if the daemon could not start
+ */
+uint8_t bej_daemon_run(const bej_daemon_options_t *opts);
@@ -1,5 +1,14 @@
 #include "bej.h"
+#include "bej_file.h"
+#include "batch.h"
+#include "daemon.h"
+#include "bej_encode.h"
+#include "bej_query.h"
+#include "bej_validate.h"
 #include <getopt.h>
+#include <time.h>
+
+#define MAX_QUERIES 16
 
 /*
  * Prints help information.
@@ -9,77 +18,305 @@ print_usage(const char *program_name)
 {
 	fprintf(stdout,
 		"Overview: A Redfish binary encoded json decoder to UTF-8 json format. Copyleft 🄯 2025 aeaeo.\n\n"
-		"Usage: %s "/*[-a <annotation_dictionary_file>]*/"-s <schema_dictionary_file> -b <bej_file> [-o <output_file>]\n\n"
+		"Usage: %s [-a <annotation_dictionary_file>] -s <schema_dictionary_file> -b <bej_file> [-j <jobs>] [-c | -F <format>] [-o <output_file>] [--stats]\n"
+		"       %s -s <schema_dictionary_file> -B <dir|list_file> [-j <jobs>] [-c] [-O <output_dir> | -o <output_file>]\n"
+		"       %s -s <schema_dictionary_file|dir> -D <socket_path> [-j <jobs>] [-c | -F <format>]\n"
+		"       %s -s <schema_dictionary_file> -E <json_file> [-o <output_file>]\n"
+		"       %s -s <schema_dictionary_file> -b <bej_file> -q <path> [-q <path>...] [-c | -F <format>] [-o <output_file>]\n"
+		"       %s -s <schema_dictionary_file> -b <bej_file> --validate\n\n"
 		"Options:\n\n"
-			//"\t-a\tSpecify the annotation dictionary file (optional)\n"
-			"\t-b\tSpecify the BEJ binary file to decode. Required.\n"
-			"\t-h\tShow help message.\n"
+			"\t-a\tSpecify the annotation dictionary file. Optional, annotations decode as unknown_N without it.\n"
+			"\t-b\tSpecify the BEJ binary file to decode, - for stdin. Required unless -B is given.\n"
+			"\t-c, --compact\tPrint compact JSON without newlines and indentation.\n"
+			"\t-F, --format\tOutput format: json (default), cbor or msgpack. Binary output is the same\n"
+			"\t  \tdocument with native types, several -q values are written back to back.\n"
+			"\t-D\tDaemon mode: serve decode requests on this Unix socket until SIGINT/SIGTERM.\n"
+			"\t  \tDictionaries stay loaded, -s may be a directory of them, SIGHUP reloads it.\n"
+			"\t  \tFraming is described in src/daemon.h, tools/bejload.c is a client.\n"
+			"\t-E\tEncode a JSON file to BEJ instead of decoding, - for stdin.\n"
+			"\t-B\tBatch mode: decode every file of a directory, or every path listed in a file.\n"
+			"\t  \tOutput is NDJSON, one {\"file\": ..., \"json\": ...} line per input.\n"
+			"\t-h, --help\tShow help message.\n"
+			"\t-j\tNumber of batch or daemon worker threads. Optional, default is one per CPU\n"
+			"\t  \tWith -b, decode the elements of sets and arrays of 1 MiB or more on this many\n"
+			"\t  \tthreads, 0 for one per CPU. Output is the same as without.\n"
 			"\t-o\tSpecify output JSON file. Optional, default is stdout\n"
-			"\t-s\tSpecify the schema dictionary file. Required.\n",
-		program_name);
+			"\t-q\tPrint only the value at this path, e.g. /Status/Health or /Conditions/0.\n"
+			"\t  \tMay be repeated, one value per query in order. Fails if a path is absent.\n"
+			"\t-O\tWrite one <name>.json per batch input into this directory instead of NDJSON\n"
+			"\t-s\tSpecify the schema dictionary file, - for stdin. Required.\n"
+			"\t--stats\tAfter decoding, print decode time, throughput and decoder counters (tuples,\n"
+			"\t  \tdictionary probes, bytes per format, depth, length mismatches) as JSON to stderr.\n"
+			"\t--validate\tOnly check that the BEJ file is well-formed against the dictionary,\n"
+			"\t  \tnothing is decoded. Exits with failure on the first problem found.\n",
+		program_name, program_name, program_name, program_name, program_name, program_name);
+}
+
+/*
+ * Maps and parses the annotation dictionary given with -a, *anno stays NULL without one.
+ */
+static int
+load_annotations(const char *anno_file, bej_file_t *file, bej_dictionary_context_t *dict,
+				 bej_dictionary_context_t **anno)
+{
+	*anno = NULL;
+	if (!anno_file)
+		return SUCCESS;
+
+	if (bej_file_open(file, anno_file))
+		return FAILURE;
+	if (bej_parse_dict(dict, file->data, file->size)) {
+		errmsg("Failed to parse annotation dictionary %s\n", anno_file);
+		bej_file_close(file);
+		return FAILURE;
+	}
+	*anno = dict;
+	return SUCCESS;
+}
+
+static void
+unload_annotations(bej_file_t *file, bej_dictionary_context_t *anno)
+{
+	if (!anno)
+		return;
+	bej_free_dict(anno);
+	bej_file_close(file);
+}
+
+/*
+ * Loads the dictionary once and hands it to the batch worker pool.
+ */
+static int
+run_batch(const char *schema_file, bej_batch_options_t *batch, FILE *output)
+{
+	bej_file_t schema_dict_file;
+	bej_dictionary_context_t schema_dict;
+	uint8_t result = FAILURE;
+
+	batch->output = output;
+
+	if (!bej_file_open(&schema_dict_file, schema_file)) {
+		if (!bej_parse_dict(&schema_dict, schema_dict_file.data, schema_dict_file.size)) {
+			result = bej_batch_run(&schema_dict, batch);
+			bej_free_dict(&schema_dict);
+		} else {
+			errmsg("Failed to parse schema dictionary %s\n", schema_file);
+		}
+		bej_file_close(&schema_dict_file);
+	}
+
+	if (output != stdout)
+		fclose(output);
+
+	return result;
+}
+
+/*
+ * Encodes a JSON file into BEJ written to output.
+ */
+static int
+run_encode(const char *schema_file, const char *json_file, FILE *output)
+{
+	bej_file_t schema_dict_file = {0};
+	bej_file_t json = {0};
+	bej_dictionary_context_t schema_dict;
+	bej_encoder_t enc;
+	uint8_t result = FAILURE;
+
+	if (!bej_file_open(&schema_dict_file, schema_file) && !bej_file_open(&json, json_file)) {
+		if (!bej_parse_dict(&schema_dict, schema_dict_file.data, schema_dict_file.size)) {
+			if (!bej_encoder_init(&enc, &schema_dict)) {
+				result = bej_encode(&enc, (const char *)json.data, json.size);
+				if (result)
+					errmsg("Failed to encode %s\n", json_file);
+				else if (fwrite(enc.out.data, 1, enc.out.len, output) != enc.out.len)
+					result = FAILURE;
+				bej_encoder_free(&enc);
+			}
+			bej_free_dict(&schema_dict);
+		} else {
+			errmsg("Failed to parse schema dictionary %s\n", schema_file);
+		}
+	}
+	bej_file_close(&json);
+	bej_file_close(&schema_dict_file);
+
+	if (output != stdout && fclose(output))
+		result = FAILURE;
+
+	return result;
+}
+
+/*
+ * Prints the values selected by the queries, the dictionary is parsed once for all of them.
+ */
+static int
+run_queries(const bej_file_t *schema_dict_file, bej_dictionary_context_t *anno, const bej_file_t *bej,
+			const char **queries, size_t query_count, uint8_t style, uint8_t encoding, FILE *output)
+{
+	bej_dictionary_context_t schema_dict;
+	uint8_t result = SUCCESS;
+
+	if (bej_parse_dict(&schema_dict, schema_dict_file->data, schema_dict_file->size)) {
+		errmsg("Failed to parse schema dictionary\n");
+		return FAILURE;
+	}
+
+	for (size_t i = 0; i < query_count; i++) {
+		bej_query_t query;
+		bej_context_t ctx;
+		uint8_t found = 0U;
+
+		if (bej_query_compile(&query, &schema_dict, queries[i])) {
+			errmsg("Invalid query %s\n", queries[i]);
+			result = FAILURE;
+			continue;
+		}
+		if (bej_init_context_with_dict(&ctx, &schema_dict, bej->data, bej->size, output)) {
+			result = FAILURE;
+			break;
+		}
+		if (bej_set_annotation_dict(&ctx, anno) || bej_set_style(&ctx, style)
+			|| bej_set_encoding(&ctx, encoding)) {
+			bej_free_context(&ctx);
+			result = FAILURE;
+			break;
+		}
+		if (bej_query_run(&ctx, &query, &found)) {
+			errmsg("Failed to decode BEJ data\n");
+			result = FAILURE;
+		} else if (!found) {
+			errmsg("%s not present in the document\n", queries[i]);
+			result = FAILURE;
+		} else if (encoding == BEJ_ENCODING_JSON) {
+			fprintf(output, "\n");
+		}
+		bej_free_context(&ctx);
+	}
+
+	bej_free_dict(&schema_dict);
+	return result;
 }
 
 /*
- * General function to read the entire content of a file into a buffer.
+ * Checks the document without decoding it.
  */
-static size_t
-read_file(const char *filename, uint8_t *buffer, size_t max_size)
+static int
+run_validate(const bej_file_t *schema_dict_file, bej_dictionary_context_t *anno, const bej_file_t *bej,
+			 const char *bej_file)
 {
-    FILE *f = fopen(filename, "rb");
-    if (!f) {
-		errmsg("Failed to open file %s\n", filename);
-        return 0;
-    }
-    
-    fseek(f, 0, SEEK_END);
-    size_t file_size = (size_t)ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    if (!file_size || file_size > max_size) {
-        errmsg("File %s is too large or invalid\n", filename);
-        fclose(f);
-        return 0;
-    }
-    
-    size_t bytes_read = fread(buffer, 1, file_size, f);
-    fclose(f);
-    
-    if (bytes_read != file_size) {
-        errmsg("Error: Failed to read complete file %s\n", filename);
-        return 0;
-    }
-    
-    return bytes_read;
+	bej_dictionary_context_t schema_dict;
+	bej_context_t ctx;
+	uint8_t result = FAILURE;
+
+	if (bej_parse_dict(&schema_dict, schema_dict_file->data, schema_dict_file->size)) {
+		errmsg("Failed to parse schema dictionary\n");
+		return FAILURE;
+	}
+
+	if (!bej_init_context_with_dict(&ctx, &schema_dict, bej->data, bej->size, NULL)) {
+		result = bej_set_annotation_dict(&ctx, anno);
+		if (!result)
+			result = bej_validate(&ctx);
+		if (result)
+			errmsg("%s is not valid BEJ\n", bej_file);
+		else
+			printf("%s is valid\n", bej_file);
+		bej_free_context(&ctx);
+	}
+
+	bej_free_dict(&schema_dict);
+	return result;
 }
 
 int
 main(int argc, char** argv)
 {
-	uint8_t schema_dict_data[65536] = {0};
-	//uint8_t anno_dict_data[65536] = {0};
-	uint8_t bej_data[65536] = {0};
-	size_t schema_dict_size = 0UL;
-	//size_t anno_dict_size = 0UL;
-	size_t bej_size = 0UL;
+	bej_file_t schema_dict = {0};
+	bej_file_t anno_dict_file = {0};
+	bej_dictionary_context_t anno_dict;
+	bej_dictionary_context_t *anno = NULL;
+	bej_file_t bej = {0};
+	const char *schema_file = NULL;
+	const char *anno_file = NULL;
+	const char *bej_file = NULL;
+	const char *json_file = NULL;
+	const char *socket_path = NULL;
 	char* output_file = NULL;
 	FILE *output = stdout;
+	bej_batch_options_t batch = {0};
+	const char *queries[MAX_QUERIES];
+	size_t query_count = 0;
+	int validate = 0;
+	int stats = 0;
+	int parallel = 0;
+	uint8_t style = BEJ_STYLE_PRETTY;
+	uint8_t encoding = BEJ_ENCODING_JSON;
+
+	static const struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"validate", no_argument, NULL, 'V'},
+		{"compact", no_argument, NULL, 'c'},
+		{"format", required_argument, NULL, 'F'},
+		{"stats", no_argument, NULL, 'T'},
+		{NULL, 0, NULL, 0}
+	};
 
 	int option = EOF;
-	while ((option = getopt(argc, argv, "h"/*a:*/"b:s:o:")) != EOF) {
+	while ((option = getopt_long(argc, argv, "hca:b:s:o:B:j:O:E:q:F:D:", long_options, NULL)) != EOF) {
 		switch (option) {
-		//case 'a':
-			/* todo: annotation dict */
-		//	anno_file = optarg;
-		//	break;
+		case 'a':
+			anno_file = optarg;
+			break;
 		case 'b':
-			bej_size = read_file(optarg, bej_data, sizeof(bej_data));
-			if (!bej_size)
-				return FAILURE;
+			bej_file = optarg;
 			break;
 		case 's':
-			schema_dict_size = read_file(optarg, schema_dict_data, sizeof(schema_dict_data));
-			if (!schema_dict_size)
+			schema_file = optarg;
+			break;
+		case 'E':
+			json_file = optarg;
+			break;
+		case 'V':
+			validate = 1;
+			break;
+		case 'T':
+			stats = 1;
+			break;
+		case 'c':
+			style = BEJ_STYLE_COMPACT;
+			break;
+		case 'F':
+			if (!strcmp(optarg, "json")) {
+				encoding = BEJ_ENCODING_JSON;
+			} else if (!strcmp(optarg, "cbor")) {
+				encoding = BEJ_ENCODING_CBOR;
+			} else if (!strcmp(optarg, "msgpack")) {
+				encoding = BEJ_ENCODING_MSGPACK;
+			} else {
+				errmsg("Unknown output format %s, expected json, cbor or msgpack\n", optarg);
+				return FAILURE;
+			}
+			break;
+		case 'q':
+			if (query_count == MAX_QUERIES) {
+				errmsg("At most %d -q options are supported\n", MAX_QUERIES);
 				return FAILURE;
+			}
+			queries[query_count++] = optarg;
+			break;
+		case 'B':
+			batch.input = optarg;
+			break;
+		case 'D':
+			socket_path = optarg;
+			break;
+		case 'j':
+			batch.jobs = (unsigned)strtoul(optarg, NULL, 10);
+			parallel = 1;
+			break;
+		case 'O':
+			batch.output_dir = optarg;
 			break;
 		case 'o':
 			output_file = optarg;
@@ -98,38 +335,152 @@ main(int argc, char** argv)
 		}
 	}
 
-	if (!bej_size || !schema_dict_size) {
+	if (stats && (socket_path || batch.input || json_file || validate || query_count)) {
+		errmsg("--stats only applies to decoding a single document\n");
+		return FAILURE;
+	}
+
+	if (socket_path) {
+		if (!schema_file) {
+			errmsg("-s option is required\n");
+			print_usage(argv[0]);
+			return FAILURE;
+		}
+		bej_daemon_options_t daemon = {
+			.socket_path = socket_path,
+			.schema_path = schema_file,
+			.jobs = batch.jobs,
+			.style = style,
+			.encoding = encoding,
+		};
+		if (load_annotations(anno_file, &anno_dict_file, &anno_dict, &daemon.anno_dict))
+			return FAILURE;
+		int result = bej_daemon_run(&daemon);
+		unload_annotations(&anno_dict_file, daemon.anno_dict);
+		return result;
+	}
+
+	if (batch.input) {
+		if (encoding != BEJ_ENCODING_JSON) {
+			errmsg("Batch output is JSON only, -F is not supported with -B\n");
+			return FAILURE;
+		}
+		if (!schema_file) {
+			errmsg("-s option is required\n");
+			print_usage(argv[0]);
+			return FAILURE;
+		}
+		if (load_annotations(anno_file, &anno_dict_file, &anno_dict, &batch.anno_dict))
+			return FAILURE;
+		batch.compact = (style == BEJ_STYLE_COMPACT);
+		int result = run_batch(schema_file, &batch, output);
+		unload_annotations(&anno_dict_file, batch.anno_dict);
+		return result;
+	}
+
+	if (json_file) {
+		if (!schema_file) {
+			errmsg("-s option is required\n");
+			print_usage(argv[0]);
+			return FAILURE;
+		}
+		if (!strcmp(json_file, "-") && !strcmp(schema_file, "-")) {
+			errmsg("Only one of -s and -E can read from stdin\n");
+			return FAILURE;
+		}
+		if (run_encode(schema_file, json_file, output))
+			return FAILURE;
+		if (output_file)
+			printf("Successfully encoded JSON to %s\n", output_file);
+		return SUCCESS;
+	}
+
+	if (!bej_file || !schema_file) {
 		errmsg("Both -s and -b options are required\n");
 		print_usage(argv[0]);
 		return FAILURE;
 	}
 
+	if (!strcmp(bej_file, "-") && !strcmp(schema_file, "-")) {
+		errmsg("Only one of -s and -b can read from stdin\n");
+		return FAILURE;
+	}
+
+	// both inputs are mapped and handed to the decoder as is, no copies
+	if (bej_file_open(&schema_dict, schema_file) || bej_file_open(&bej, bej_file)
+		|| load_annotations(anno_file, &anno_dict_file, &anno_dict, &anno)) {
+		bej_file_close(&bej);
+		bej_file_close(&schema_dict);
+		if (output != stdout)
+			fclose(output);
+		return FAILURE;
+	}
+
+	if (validate) {
+		uint8_t result = run_validate(&schema_dict, anno, &bej, bej_file);
+		unload_annotations(&anno_dict_file, anno);
+		bej_file_close(&bej);
+		bej_file_close(&schema_dict);
+		if (output != stdout)
+			fclose(output);
+		return result;
+	}
+
+	if (query_count) {
+		uint8_t result = run_queries(&schema_dict, anno, &bej, queries, query_count, style, encoding, output);
+		unload_annotations(&anno_dict_file, anno);
+		bej_file_close(&bej);
+		bej_file_close(&schema_dict);
+		if (output != stdout && fclose(output))
+			result = FAILURE;
+		return result;
+	}
+
 	bej_context_t ctx;
-    if (bej_init_context(&ctx,
-						 schema_dict_data, schema_dict_size,
-						 //anno_dict_data, anno_dict_size,
-						 bej_data, bej_size,
-						 output)) {
+	uint8_t result = bej_init_context(&ctx,
+									  schema_dict.data, schema_dict.size,
+									  bej.data, bej.size,
+									  output);
+	if (result) {
 		errmsg("Failed to initialize BEJ context\n");
-        if (output != stdout)
-            fclose(output);
-        return FAILURE;
-    }
-    
-    uint8_t result = bej_decode(&ctx);
-    if (result) {
-		errmsg("Failed to decode BEJ data\n");
-        if (output != stdout)
-            fclose(output);
-        return FAILURE;
-    }
-    
-    fprintf(output, "\n");
-
-    if (output != stdout) {
-        fclose(output);
-        printf("Successfully decoded BEJ to %s\n", output_file);
-    }
+	} else {
+		result = bej_set_annotation_dict(&ctx, anno);
+		if (!result)
+			result = bej_set_style(&ctx, style);
+		if (!result)
+			result = bej_set_encoding(&ctx, encoding);
+		if (!result && parallel)
+			result = bej_set_parallel(&ctx, batch.jobs, 0);
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (!result)
+			result = bej_decode(&ctx);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (result)
+			errmsg("Failed to decode BEJ data\n");
+		else if (stats)
+			bej_write_stats(&ctx, (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9,
+							stderr);
+		bej_free_context(&ctx);
+	}
+
+	unload_annotations(&anno_dict_file, anno);
+	bej_file_close(&bej);
+	bej_file_close(&schema_dict);
+
+	if (result) {
+		if (output != stdout)
+			fclose(output);
+		return FAILURE;
+	}
+
+	if (encoding == BEJ_ENCODING_JSON)
+		fprintf(output, "\n");
+
+	if (output != stdout) {
+		fclose(output);
+		printf("Successfully decoded BEJ to %s\n", output_file);
+	}
 
 	return 0;
 }
\ No newline at end of file
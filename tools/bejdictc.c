@@ -0,0 +1,86 @@
+/**
+ * @file bejdictc.c
+ * @brief Compiles a DSP8010 schema dictionary into the mmap-able indexed format
+ */
+#include "../src/bej.h"
+#include "../src/bej_compiled.h"
+#include "../src/bej_file.h"
+#include <getopt.h>
+
+static void
+print_usage(const char *program_name)
+{
+	fprintf(stdout,
+		"Overview: Compiles a Redfish schema dictionary into a pre-indexed binary for BEJparser.\n\n"
+		"Usage: %s -s <schema_dictionary_file> -o <compiled_file>\n\n"
+		"Options:\n\n"
+			"\t-h\tShow help message.\n"
+			"\t-o\tSpecify the compiled dictionary file to write. Required.\n"
+			"\t-s\tSpecify the schema dictionary file. Required.\n",
+		program_name);
+}
+
+int
+main(int argc, char** argv)
+{
+	const char *schema_file = NULL;
+	const char *output_file = NULL;
+
+	int option = EOF;
+	while ((option = getopt(argc, argv, "hs:o:")) != EOF) {
+		switch (option) {
+		case 's':
+			schema_file = optarg;
+			break;
+		case 'o':
+			output_file = optarg;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return SUCCESS;
+		}
+	}
+
+	if (!schema_file || !output_file) {
+		errmsg("Both -s and -o options are required\n");
+		print_usage(argv[0]);
+		return FAILURE;
+	}
+
+	bej_file_t source;
+	if (bej_file_open(&source, schema_file))
+		return FAILURE;
+
+	bej_dictionary_context_t dict;
+	uint8_t *compiled = NULL;
+	size_t compiled_size = 0UL;
+	uint8_t result = bej_parse_dict(&dict, source.data, source.size);
+	if (!result && !dict.index.storage) {
+		errmsg("%s is already compiled or its entry table is truncated\n", schema_file);
+		result = FAILURE;
+	}
+	if (!result)
+		result = bej_compile_dict(&dict, &compiled, &compiled_size);
+
+	if (!result) {
+		FILE *out = fopen(output_file, "wb");
+		if (!out || fwrite(compiled, 1, compiled_size, out) != compiled_size) {
+			errmsg("Failed to write %s\n", output_file);
+			result = FAILURE;
+		}
+		if (out && fclose(out))
+			result = FAILURE;
+	}
+
+	if (!result)
+		printf("Compiled %u entries (%u index slots, %u bytes of names) into %s, %zu bytes\n",
+			   dict.entry_count, dict.index.slot_count, dict.index.name_pool_size,
+			   output_file, compiled_size);
+
+	free(compiled);
+	bej_free_dict(&dict);
+	bej_file_close(&source);
+
+	return result;
+}
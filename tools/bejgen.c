@@ -0,0 +1,159 @@
+/**
+ * @file bejgen.c
+ * @brief Generates synthetic BEJ documents and their expected JSON from a schema dictionary
+ */
+#include "../src/bej.h"
+#include "../src/bej_gen.h"
+#include "../src/bej_file.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+
+static void
+print_usage(const char *program_name)
+{
+	fprintf(stdout,
+		"Overview: Generates BEJ documents for a Redfish schema dictionary, together with the JSON BEJparser prints for them.\n\n"
+		"Usage: %s -s <schema_dictionary_file> -o <bej_file> [-j <json_file>] [options]\n"
+		"       %s -s <schema_dictionary_file> -n <count> -O <directory> [options]\n\n"
+		"Options:\n\n"
+			"\t-a\tMaximum elements per array, nested arrays are capped at 64k elements together. Default is 4.\n"
+			"\t-d\tMaximum nesting depth. Default is 8.\n"
+			"\t-h\tShow help message.\n"
+			"\t-j\tSpecify the expected JSON file to write.\n"
+			"\t-l\tMaximum string length in bytes. Default is 32.\n"
+			"\t-n\tNumber of documents to write into the -O directory, seeds counting up from -S.\n"
+			"\t-o\tSpecify the BEJ file to write.\n"
+			"\t-O\tSpecify the corpus directory, documents are written as <seed>.bej and <seed>.json.\n"
+			"\t-S\tRandom seed. Default is 1.\n"
+			"\t-s\tSpecify the schema dictionary file. Required.\n"
+			"\t-z\tAdd elements to the outermost arrays until the BEJ document is at least this many bytes.\n",
+		program_name, program_name);
+}
+
+static uint8_t
+write_file(const char *path, const bej_output_t *data)
+{
+	FILE *out = fopen(path, "wb");
+	uint8_t result = SUCCESS;
+	if (!out || fwrite(data->data, 1, data->len, out) != data->len) {
+		errmsg("Failed to write %s\n", path);
+		result = FAILURE;
+	}
+	if (out && fclose(out))
+		result = FAILURE;
+	return result;
+}
+
+static uint8_t
+generate(bej_dictionary_context_t *dict, const bej_gen_options_t *options,
+		 const char *bej_file, const char *json_file)
+{
+	bej_output_t json, bej;
+	if (bej_generate(dict, options, &json, &bej))
+		return FAILURE;
+
+	// same trailing newline BEJparser puts at the end of its output file
+	bej_output_t text = json;
+	uint8_t result = SUCCESS;
+	if (json.len + 1 > json.cap) {
+		text.data = realloc(json.data, json.len + 1);
+		if (!text.data) {
+			errmsg("Out of memory\n");
+			free(json.data);
+			free(bej.data);
+			return FAILURE;
+		}
+	}
+	text.data[text.len++] = '\n';
+
+	result = write_file(bej_file, &bej);
+	if (!result && json_file)
+		result = write_file(json_file, &text);
+	if (!result)
+		printf("Seed %" PRIu64 ": %zu bytes of BEJ, %zu bytes of JSON\n", options->seed, bej.len, text.len);
+
+	free(text.data);
+	free(bej.data);
+	return result;
+}
+
+int
+main(int argc, char** argv)
+{
+	const char *schema_file = NULL;
+	const char *output_file = NULL;
+	const char *json_file = NULL;
+	const char *corpus_dir = NULL;
+	unsigned long count = 0UL;
+
+	bej_gen_options_t options;
+	bej_gen_default_options(&options);
+
+	int option = EOF;
+	while ((option = getopt(argc, argv, "hs:o:j:O:n:S:d:a:l:z:")) != EOF) {
+		switch (option) {
+		case 's':
+			schema_file = optarg;
+			break;
+		case 'o':
+			output_file = optarg;
+			break;
+		case 'j':
+			json_file = optarg;
+			break;
+		case 'O':
+			corpus_dir = optarg;
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			options.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'd':
+			options.max_depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			options.array_length = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			options.string_length = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'z':
+			options.target_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return SUCCESS;
+		}
+	}
+
+	if (!schema_file || (!output_file && !(corpus_dir && count))) {
+		errmsg("-s and either -o or -n with -O are required\n");
+		print_usage(argv[0]);
+		return FAILURE;
+	}
+
+	bej_file_t source;
+	if (bej_file_open(&source, schema_file))
+		return FAILURE;
+
+	bej_dictionary_context_t dict;
+	uint8_t result = bej_parse_dict(&dict, source.data, source.size);
+
+	if (!result && output_file)
+		result = generate(&dict, &options, output_file, json_file);
+
+	for (unsigned long i = 0; !result && corpus_dir && i < count; i++, options.seed++) {
+		char bej_path[PATH_MAX], json_path[PATH_MAX];
+		snprintf(bej_path, sizeof(bej_path), "%s/%" PRIu64 ".bej", corpus_dir, options.seed);
+		snprintf(json_path, sizeof(json_path), "%s/%" PRIu64 ".json", corpus_dir, options.seed);
+		result = generate(&dict, &options, bej_path, json_path);
+	}
+
+	bej_free_dict(&dict);
+	bej_file_close(&source);
+	return result;
+}
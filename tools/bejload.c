@@ -0,0 +1,282 @@
+/**
+ * @file bejload.c
+ * @brief Load generator for the decoder daemon, reports latency percentiles and throughput
+ */
+#include "../src/daemon.h"
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+	const char *socket_path;
+	const uint8_t *request;		// framed once, sent as is every time
+	size_t request_len;
+	unsigned long count;		// requests on this connection
+	uint64_t *latency;			// nanoseconds, one per request
+	unsigned long failed;
+	pthread_t thread;
+} load_conn_t;
+
+static void
+print_usage(const char *program_name)
+{
+	fprintf(stdout,
+		"Overview: Sends one BEJ document to a BEJparser daemon (-D) over and over and reports latency and throughput.\n\n"
+		"Usage: %s -S <socket_path> -b <bej_file> [-N <schema_name>] [-n <requests>] [-c <connections>]\n\n"
+		"Options:\n\n"
+			"\t-b\tSpecify the BEJ file to send. Required.\n"
+			"\t-c\tConcurrent connections, one thread each. Default is 1.\n"
+			"\t-h\tShow help message.\n"
+			"\t-N\tSchema name of the document, e.g. Memory. Default is the daemon's -s dictionary.\n"
+			"\t-n\tTotal number of requests, split over the connections. Default is 10000.\n"
+			"\t-S\tSpecify the daemon's socket. Required.\n",
+		program_name);
+}
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint8_t
+io_full(int fd, void *buf, size_t n, uint8_t write_side)
+{
+	uint8_t *p = buf;
+	while (n) {
+		ssize_t r = write_side ? send(fd, p, n, MSG_NOSIGNAL) : read(fd, p, n);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return FAILURE;
+		p += r;
+		n -= (size_t)r;
+	}
+	return SUCCESS;
+}
+
+static int
+connect_daemon(const char *path)
+{
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errmsg("Socket path %s is too long", path);
+		return -1;
+	}
+	memcpy(addr.sun_path, path, strlen(path) + 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		errmsg("Failed to connect to %s: %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// one request at a time, the latency is the full round trip as a client sees it
+static void *
+load_connection(void *arg)
+{
+	load_conn_t *c = arg;
+	int fd = connect_daemon(c->socket_path);
+	if (fd < 0) {
+		c->failed = c->count;
+		c->count = 0;
+		return NULL;
+	}
+
+	uint8_t *body = NULL;
+	size_t cap = 0UL;
+	unsigned long done = 0UL;
+	for (; done < c->count; done++) {
+		uint64_t start = now_ns();
+		uint8_t head[4];
+		if (io_full(fd, (void *)c->request, c->request_len, 1U) || io_full(fd, head, sizeof(head), 0U))
+			break;
+		uint32_t length = READ_U32_LE(head, 0);
+		if (!length || length > BEJ_DAEMON_MAX_FRAME)
+			break;
+		if (length > cap) {
+			uint8_t *grown = realloc(body, length);
+			if (!grown)
+				break;
+			body = grown;
+			cap = length;
+		}
+		if (io_full(fd, body, length, 0U))
+			break;
+		c->latency[done] = now_ns() - start;
+		if (body[0] != BEJ_DAEMON_OK)
+			c->failed++;
+	}
+
+	// a broken connection fails what it had left
+	if (done < c->count) {
+		errmsg("Connection lost after %lu requests", done);
+		c->failed += c->count - done;
+		c->count = done;
+	}
+	free(body);
+	close(fd);
+	return NULL;
+}
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static uint8_t
+read_file(const char *path, uint8_t **data, size_t *size)
+{
+	FILE *in = fopen(path, "rb");
+	if (!in) {
+		errmsg("Failed to open %s: %s", path, strerror(errno));
+		return FAILURE;
+	}
+	uint8_t result = FAILURE;
+	long length = -1;
+	if (!fseek(in, 0, SEEK_END) && (length = ftell(in)) > 0 && !fseek(in, 0, SEEK_SET)) {
+		*data = malloc((size_t)length);
+		if (*data && fread(*data, 1, (size_t)length, in) == (size_t)length) {
+			*size = (size_t)length;
+			result = SUCCESS;
+		}
+	}
+	if (result)
+		errmsg("Failed to read %s", path);
+	fclose(in);
+	return result;
+}
+
+int
+main(int argc, char** argv)
+{
+	const char *socket_path = NULL;
+	const char *bej_file = NULL;
+	const char *schema_name = "";
+	unsigned long requests = 10000UL;
+	unsigned long connections = 1UL;
+
+	int option = EOF;
+	while ((option = getopt(argc, argv, "hS:b:N:n:c:")) != EOF) {
+		switch (option) {
+		case 'S':
+			socket_path = optarg;
+			break;
+		case 'b':
+			bej_file = optarg;
+			break;
+		case 'N':
+			schema_name = optarg;
+			break;
+		case 'n':
+			requests = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			connections = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return SUCCESS;
+		}
+	}
+
+	if (!socket_path || !bej_file || !requests || !connections) {
+		errmsg("-S and -b are required, -n and -c must be positive\n");
+		print_usage(argv[0]);
+		return FAILURE;
+	}
+	size_t name_length = strlen(schema_name);
+	if (name_length > BEJ_DICT_ENTRY_NAME_LENGTH) {
+		errmsg("Schema name %s is too long", schema_name);
+		return FAILURE;
+	}
+	if (connections > requests)
+		connections = requests;
+
+	uint8_t *bej = NULL;
+	size_t bej_size = 0UL;
+	if (read_file(bej_file, &bej, &bej_size))
+		return FAILURE;
+	if (bej_size + 1U + name_length > BEJ_DAEMON_MAX_FRAME) {
+		errmsg("%s is too large for a request", bej_file);
+		free(bej);
+		return FAILURE;
+	}
+
+	uint32_t frame = (uint32_t)(1U + name_length + bej_size);
+	size_t request_len = 4U + frame;
+	uint8_t *request = malloc(request_len);
+	uint64_t *latency = malloc(requests * sizeof(uint64_t));
+	load_conn_t *conns = calloc(connections, sizeof(load_conn_t));
+	if (!request || !latency || !conns) {
+		errmsg("Failed to allocate %lu requests", requests);
+		free(bej);
+		free(request);
+		free(latency);
+		free(conns);
+		return FAILURE;
+	}
+	for (int i = 0; i < 4; i++)
+		request[i] = (uint8_t)(frame >> (8 * i));
+	request[4] = (uint8_t)name_length;
+	memcpy(&request[5], schema_name, name_length);
+	memcpy(&request[5 + name_length], bej, bej_size);
+	free(bej);
+
+	uint64_t start = now_ns();
+	unsigned long offset = 0UL, started = 0UL;
+	for (; started < connections; started++) {
+		load_conn_t *c = &conns[started];
+		c->socket_path = socket_path;
+		c->request = request;
+		c->request_len = request_len;
+		c->count = requests / connections + (started < requests % connections);
+		c->latency = &latency[offset];
+		offset += c->count;
+		if (pthread_create(&c->thread, NULL, load_connection, c)) {
+			errmsg("Failed to start connection %lu", started);
+			break;
+		}
+	}
+
+	// latencies of each connection are packed to the front of the array
+	unsigned long measured = 0UL, failed = 0UL;
+	for (unsigned long i = 0; i < started; i++) {
+		pthread_join(conns[i].thread, NULL);
+		memmove(&latency[measured], conns[i].latency, conns[i].count * sizeof(uint64_t));
+		measured += conns[i].count;
+		failed += conns[i].failed;
+	}
+	double seconds = (double)(now_ns() - start) / 1e9;
+
+	uint8_t result = SUCCESS;
+	if (measured) {
+		qsort(latency, measured, sizeof(uint64_t), compare_u64);
+		fprintf(stdout, "Requests:     %lu over %lu connections in %.3f s\n", measured, started, seconds);
+		fprintf(stdout, "Throughput:   %.0f requests/s\n", (double)measured / seconds);
+		fprintf(stdout, "Latency p50:  %.1f us\n", (double)latency[(measured - 1) / 2] / 1e3);
+		fprintf(stdout, "Latency p99:  %.1f us\n", (double)latency[(measured - 1) * 99 / 100] / 1e3);
+		fprintf(stdout, "Latency max:  %.1f us\n", (double)latency[measured - 1] / 1e3);
+	}
+	fprintf(stdout, "Failed:       %lu\n", failed);
+	if (!measured || failed)
+		result = FAILURE;
+
+	free(request);
+	free(latency);
+	free(conns);
+	return result;
+}
@@ -0,0 +1,183 @@
+/**
+ * @file test_annotation.cpp
+ * @brief Unit tests for annotation dictionary support
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_query.h"
+#include "../src/bej_stream.h"
+#include "../src/bej_validate.h"
+}
+
+static std::vector<uint8_t>
+string_value(const char *s)
+{
+    return std::vector<uint8_t>(s, s + strlen(s) + 1);
+}
+
+class BejAnnotationTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> schema_data;
+    std::vector<uint8_t> anno_data;
+    bej_dictionary_context_t schema;
+    bej_dictionary_context_t anno;
+    uint32_t capacity;      // sequence of CapacityMiB
+    uint32_t shared;        // string member whose sequence an annotation uses as well
+    std::string member;     // and its name
+    std::vector<uint8_t> bej;
+
+    void SetUp() override {
+        schema_data = load_example("Memory_v1.bin");
+        ASSERT_FALSE(schema_data.empty());
+        ASSERT_EQ(bej_parse_dict(&schema, schema_data.data(), schema_data.size()), SUCCESS);
+
+        bej_dict_entry_t root, entry;
+        ASSERT_EQ(bej_dict_lookup(&schema, BEJ_DICT_HEADER_SIZE, schema.entry_count, 0, &root), SUCCESS);
+        char name[256];
+        capacity = shared = UINT32_MAX;
+        for (uint16_t seq = 0; seq < root.child_count; seq++) {
+            if (bej_dict_lookup(&schema, root.child_offset, root.child_count, seq, &entry)
+                || bej_get_entry_name(&schema, &entry, name, sizeof(name)))
+                continue;
+            if (shared == UINT32_MAX && (entry.format >> 4) == BEJ_FORMAT_STRING) {
+                shared = seq;
+                member = name;
+            }
+            if (!strcmp(name, "CapacityMiB"))
+                capacity = seq;
+        }
+        ASSERT_NE(capacity, UINT32_MAX);
+        ASSERT_NE(shared, UINT32_MAX);
+
+        // annotation sequences are arbitrary, line them up with the schema member
+        anno_data = make_dictionary({
+            {BEJ_FORMAT_SET, 0, 1, 3, "Annotation"},
+            {BEJ_FORMAT_STRING, (uint16_t)shared, 0, 0, "@odata.id"},
+            {BEJ_FORMAT_STRING, (uint16_t)(shared + 1), 0, 0, "@odata.type"},
+            {BEJ_FORMAT_ARRAY, (uint16_t)(shared + 2), 4, 1, "@Message.ExtendedInfo"},
+            {BEJ_FORMAT_SET, 0, 5, 2, ""},
+            {BEJ_FORMAT_STRING, 0, 0, 0, "MessageId"},
+            {BEJ_FORMAT_ENUM, 1, 7, 2, "Severity"},
+            {BEJ_FORMAT_ENUM, 0, 0, 0, "OK"},
+            {BEJ_FORMAT_ENUM, 1, 0, 0, "Warning"},
+        });
+        ASSERT_EQ(bej_parse_dict(&anno, anno_data.data(), anno_data.size()), SUCCESS);
+
+        // an annotation sharing its sequence with a schema member, which follows it
+        std::vector<uint8_t> info = members({
+            tuple(0, 1, BEJ_FORMAT_STRING, string_value("Base.1.0.Success")),
+            tuple(1, 1, BEJ_FORMAT_ENUM, {0x01, 0x01}),
+        });
+        std::vector<uint8_t> root_value = members({
+            tuple(shared, 1, BEJ_FORMAT_STRING, string_value("/redfish/v1/Systems/1/Memory/1")),
+            tuple(shared, 0, BEJ_FORMAT_STRING, string_value("DIMM0")),
+            tuple(capacity, 0, BEJ_FORMAT_INTEGER, {0x00, 0x40}),
+            tuple(shared + 2, 1, BEJ_FORMAT_ARRAY, members({tuple(0, 1, BEJ_FORMAT_SET, info)})),
+        });
+        bej = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+        std::vector<uint8_t> root_tuple = tuple(0, 0, BEJ_FORMAT_SET, root_value);
+        bej.insert(bej.end(), root_tuple.begin(), root_tuple.end());
+    }
+
+    void TearDown() override {
+        bej_free_dict(&anno);
+        bej_free_dict(&schema);
+    }
+
+    std::string Decode(bej_dictionary_context_t *annotations) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &schema, bej.data(), bej.size(), nullptr), SUCCESS);
+        EXPECT_EQ(bej_set_annotation_dict(&ctx, annotations), SUCCESS);
+        EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string json((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+        return json;
+    }
+
+    std::string Expected() {
+        return "{\n"
+               "\t\"@odata.id\": \"/redfish/v1/Systems/1/Memory/1\",\n"
+               "\t\"" + member + "\": \"DIMM0\",\n"
+               "\t\"CapacityMiB\": 16384,\n"
+               "\t\"@Message.ExtendedInfo\": [\n"
+               "\t\t{\n"
+               "\t\t\t\"MessageId\": \"Base.1.0.Success\",\n"
+               "\t\t\t\"Severity\": \"Warning\"\n"
+               "\t\t}\n"
+               "\t]\n"
+               "}";
+    }
+};
+
+TEST_F(BejAnnotationTest, DecodesThroughAnnotationDictionary) {
+    EXPECT_EQ(Decode(&anno), Expected());
+}
+
+TEST_F(BejAnnotationTest, UnknownWithoutAnnotationDictionary) {
+    std::string json = Decode(nullptr);
+    EXPECT_NE(json.find("\"unknown_" + std::to_string(shared) + "\": \"/redfish/v1/Systems/1/Memory/1\""),
+              std::string::npos);
+    EXPECT_NE(json.find("\"" + member + "\": \"DIMM0\""), std::string::npos);
+    EXPECT_NE(json.find("\"unknown_" + std::to_string(shared + 2) + "\": ["), std::string::npos);
+    EXPECT_EQ(json.find("@odata"), std::string::npos);
+}
+
+TEST_F(BejAnnotationTest, DictionaryWithoutRootIsRejected) {
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &schema, bej.data(), bej.size(), nullptr), SUCCESS);
+    std::vector<uint8_t> empty = make_dictionary({{BEJ_FORMAT_STRING, 1, 0, 0, "@odata.id"}});
+    bej_dictionary_context_t broken;
+    ASSERT_EQ(bej_parse_dict(&broken, empty.data(), empty.size()), SUCCESS);
+    EXPECT_EQ(bej_set_annotation_dict(&ctx, &broken), FAILURE);
+    EXPECT_EQ(ctx.anno_dict.data, nullptr);
+    bej_free_dict(&broken);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejAnnotationTest, StreamMatchesDecode) {
+    bej_stream_t s;
+    ASSERT_EQ(bej_stream_init(&s, &schema, nullptr), SUCCESS);
+    ASSERT_EQ(bej_set_annotation_dict(&s.ctx, &anno), SUCCESS);
+    // byte by byte, every tuple header straddles a chunk boundary
+    for (uint8_t byte : bej)
+        ASSERT_EQ(bej_stream_feed(&s, &byte, 1), SUCCESS);
+    ASSERT_EQ(bej_stream_finish(&s), SUCCESS);
+    EXPECT_EQ(std::string((const char *)s.ctx.out.data, s.ctx.out.len), Expected());
+    bej_stream_free(&s);
+}
+
+TEST_F(BejAnnotationTest, Validate) {
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &schema, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_validate(&ctx), FAILURE);
+    ASSERT_EQ(bej_set_annotation_dict(&ctx, &anno), SUCCESS);
+    EXPECT_EQ(bej_validate(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+
+    // Severity option the annotation dictionary doesn't have
+    bej[bej.size() - 1] = 0x05;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &schema, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_set_annotation_dict(&ctx, &anno), SUCCESS);
+    EXPECT_EQ(bej_validate(&ctx), FAILURE);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejAnnotationTest, QuerySkipsAnnotationWithSameSequence) {
+    bej_query_t query;
+    ASSERT_EQ(bej_query_compile(&query, &schema, ("/" + member).c_str()), SUCCESS);
+
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &schema, bej.data(), bej.size(), nullptr), SUCCESS);
+    uint8_t found = 0;
+    ASSERT_EQ(bej_query_run(&ctx, &query, &found), SUCCESS);
+    EXPECT_TRUE(found);
+    EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len), "\"DIMM0\"");
+    bej_free_context(&ctx);
+}
@@ -7,9 +7,14 @@
 #include <gtest/gtest.h>
 #include <cstring>
 #include <cstdio>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
 
 extern "C" {
 #include "../src/bej.h"
+#include "../src/bej_itoa.h"
 }
 
 // ============================================================================
@@ -94,7 +99,7 @@ TEST_F(BejNNINTTest, ReadAtOffset) {
 }
 
 TEST_F(BejNNINTTest, ReadOutOfBounds) {
-    buffer[0] = 0x05;  // claims 5 bytes
+    buffer[254] = 0x05;  // claims 5 bytes
     offset = 254;      // only 2 bytes available
     
     EXPECT_EQ(bej_read_nnint(buffer, &offset, sizeof(buffer), &value), FAILURE);
@@ -202,6 +207,10 @@ protected:
         memset(&dict, 0, sizeof(dict));
         memset(dict_data, 0, sizeof(dict_data));
     }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
 };
 
 TEST_F(BejDictionaryTest, ParseValidDictionary) {
@@ -242,9 +251,175 @@ TEST_F(BejDictionaryTest, ParseDictionary_NullPointer) {
 }
 
 // ============================================================================
-// Dictionary Entry Lookup Tests: TODO
+// Dictionary Entry Lookup Tests
 // ============================================================================
 
+class BejDictLookupTest : public ::testing::Test {
+protected:
+    bej_dictionary_context_t dict;
+    uint8_t dict_data[256];
+
+    void SetEntry(int i, uint8_t format, uint16_t seq, uint16_t child_off,
+                  uint16_t child_count, uint8_t name_len, uint16_t name_off) {
+        uint8_t *e = &dict_data[12 + i * 10];
+        e[0] = format;
+        e[1] = seq & 0xFF;          e[2] = seq >> 8;
+        e[3] = child_off & 0xFF;    e[4] = child_off >> 8;
+        e[5] = child_count & 0xFF;  e[6] = child_count >> 8;
+        e[7] = name_len;
+        e[8] = name_off & 0xFF;     e[9] = name_off >> 8;
+    }
+
+    void SetUp() override {
+        memset(&dict, 0, sizeof(dict));
+        memset(dict_data, 0, sizeof(dict_data));
+        dict_data[2] = 0x06;  // entry count = 6
+
+        // root set with 3 dense children at offset 22
+        SetEntry(0, 0x00, 0, 22, 3, 5, 200);
+        SetEntry(1, 0x30, 0, 0, 0, 2, 205);
+        SetEntry(2, 0x50, 1, 0, 0, 2, 207);
+        // sparse child range at offset 52 (entry 4): sequences 1 and 1000
+        SetEntry(3, 0x00, 2, 52, 2, 2, 209);
+        SetEntry(4, 0x30, 1, 0, 0, 2, 211);
+        SetEntry(5, 0x30, 1000, 0, 0, 2, 213);
+        memcpy(&dict_data[200], "Root\0A\0B\0C\0D\0E\0", 16);
+
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data, sizeof(dict_data)), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+};
+
+TEST_F(BejDictLookupTest, IndexIsBuilt) {
+    EXPECT_NE(dict.index.entries, nullptr);
+    EXPECT_NE(dict.index.slots, nullptr);
+}
+
+TEST_F(BejDictLookupTest, FindRootEntry) {
+    bej_dict_entry_t entry;
+    ASSERT_EQ(bej_dict_lookup(&dict, 12, 6, 0, &entry), SUCCESS);
+    EXPECT_EQ(entry.child_offset, 22);
+    EXPECT_EQ(entry.child_count, 3);
+    EXPECT_EQ(entry.name_offset, 200);
+}
+
+TEST_F(BejDictLookupTest, FindChildBySequence) {
+    bej_dict_entry_t entry;
+    ASSERT_EQ(bej_dict_lookup(&dict, 22, 3, 1, &entry), SUCCESS);
+    EXPECT_EQ(entry.format, 0x50);
+    EXPECT_EQ(entry.sequence, 1);
+    EXPECT_EQ(entry.name_offset, 207);
+
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH + 1];
+    ASSERT_EQ(bej_get_entry_name(&dict, &entry, name, sizeof(name)), SUCCESS);
+    EXPECT_STREQ(name, "B");
+}
+
+TEST_F(BejDictLookupTest, MissingSequence) {
+    bej_dict_entry_t entry;
+    EXPECT_EQ(bej_dict_lookup(&dict, 22, 3, 3, &entry), FAILURE);
+    EXPECT_EQ(bej_dict_lookup(&dict, 22, 3, 0x7FFFFFFF, &entry), FAILURE);
+}
+
+TEST_F(BejDictLookupTest, SparseRangeFallsBackToScan) {
+    bej_dict_entry_t entry;
+    ASSERT_EQ(bej_dict_lookup(&dict, 52, 2, 1000, &entry), SUCCESS);
+    EXPECT_EQ(entry.name_offset, 213);
+    EXPECT_EQ(bej_dict_lookup(&dict, 52, 2, 2, &entry), FAILURE);
+}
+
+TEST_F(BejDictLookupTest, IndexMatchesLinearScan) {
+    bej_dictionary_context_t plain = dict;
+    memset(&plain.index, 0, sizeof(plain.index));
+
+    const uint16_t ranges[][2] = {{12, 6}, {22, 3}, {52, 2}};
+    for (const auto &r : ranges) {
+        for (uint32_t seq = 0; seq < 8; seq++) {
+            bej_dict_entry_t a, b;
+            uint8_t ra = bej_dict_lookup(&dict, r[0], r[1], seq, &a);
+            uint8_t rb = bej_dict_lookup(&plain, r[0], r[1], seq, &b);
+            ASSERT_EQ(ra, rb) << "range " << r[0] << " seq " << seq;
+            if (ra == SUCCESS) {
+                EXPECT_EQ(a.format, b.format);
+                EXPECT_EQ(a.sequence, b.sequence);
+                EXPECT_EQ(a.child_offset, b.child_offset);
+                EXPECT_EQ(a.child_count, b.child_count);
+                EXPECT_EQ(a.name_length, b.name_length);
+                EXPECT_EQ(a.name_offset, b.name_offset);
+            }
+        }
+    }
+}
+
+TEST_F(BejDictLookupTest, FindThroughContextRange) {
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.indent_level = 1;
+    ctx.parent_child_offset[1] = 22;
+    ctx.parent_child_count[1] = 3;
+
+    bej_dict_entry_t entry;
+    ASSERT_EQ(bej_find_dict_entry(&ctx, &dict, 2, &entry), SUCCESS);
+    EXPECT_EQ(entry.name_offset, 209);
+}
+
+TEST(BejDictLookupTruncatedTest, NoIndexForTruncatedTable) {
+    uint8_t dict_data[16] = {0};
+    dict_data[2] = 0x03;  // three entries claimed, none fit
+    bej_dictionary_context_t dict;
+
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data, sizeof(dict_data)), SUCCESS);
+    EXPECT_EQ(dict.index.entries, nullptr);
+
+    bej_dict_entry_t entry;
+    EXPECT_EQ(bej_dict_lookup(&dict, 12, 3, 0, &entry), FAILURE);
+    bej_free_dict(&dict);
+}
+
+TEST(BejDictLookupOffTableTest, RangePastTheTableHasNoIndexSlot) {
+    // two entries, the root's child range at offset 32 is past the table and gets scanned
+    uint8_t dict_data[70] = {0};
+    dict_data[2] = 0x02;
+    dict_data[8] = sizeof(dict_data);
+    const uint8_t entries[][10] = {
+        {0x00, 0x00, 0x00, 32, 0x00, 0x01, 0x00, 5, 60, 0x00},     // Root
+        {0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 2, 65, 0x00},   // A
+        {0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 2, 67, 0x00},   // B, at offset 32
+    };
+    memcpy(&dict_data[12], entries, sizeof(entries));
+    memcpy(&dict_data[60], "Root\0A\0B\0", 9);
+
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data, sizeof(dict_data)), SUCCESS);
+    ASSERT_NE(dict.index.names, nullptr);
+    bej_dict_entry_t entry;
+    ASSERT_EQ(bej_dict_lookup(&dict, 32, 1, 0, &entry), SUCCESS);
+    EXPECT_EQ(entry.index, BEJ_DICT_INDEX_NONE);
+    EXPECT_EQ(entry.name_offset, 67);
+
+    std::vector<uint8_t> bej = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    std::vector<uint8_t> root = tuple(0, 0, BEJ_FORMAT_SET, members({tuple(0, 0, BEJ_FORMAT_INTEGER, {0x07})}));
+    bej.insert(bej.end(), root.begin(), root.end());
+
+    for (uint8_t encoding : {BEJ_ENCODING_JSON, BEJ_ENCODING_CBOR}) {
+        bej_context_t ctx;
+        ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        ASSERT_EQ(bej_set_style(&ctx, BEJ_STYLE_COMPACT), SUCCESS);
+        ASSERT_EQ(bej_set_encoding(&ctx, encoding), SUCCESS);
+        ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string out((const char *)ctx.out.data, ctx.out.len);
+        if (encoding == BEJ_ENCODING_JSON)
+            EXPECT_EQ(out, "{\"B\":7}");
+        else
+            EXPECT_EQ(out, std::string("\xA1\x61" "B\x07", 4));
+        bej_free_context(&ctx);
+    }
+    bej_free_dict(&dict);
+}
+
 
 // ============================================================================
 // Integer Decoding Tests
@@ -263,10 +438,12 @@ protected:
     }
     
     void TearDown() override {
+        bej_free_context(&ctx);
         if (output) fclose(output);
     }
     
     std::string GetOutput() {
+        bej_flush(&ctx);
         fflush(output);
         return std::string(output_buf);
     }
@@ -312,6 +489,42 @@ TEST_F(BejIntegerTest, DecodeInvalidLength_TooLarge) {
     EXPECT_EQ(decode_integer(&ctx, value, 9), FAILURE);
 }
 
+TEST_F(BejIntegerTest, DecodeEveryLength_Extremes) {
+    for (uint32_t length = 1; length <= 8; length++) {
+        // largest, smallest, -1 and +1 of each width
+        int64_t max = (length == 8) ? INT64_MAX : (int64_t)((1ULL << (8 * length - 1)) - 1);
+        for (int64_t expected : {max, -max - 1, (int64_t)-1, (int64_t)1}) {
+            uint8_t value[8];
+            for (uint32_t i = 0; i < length; i++)
+                value[i] = (uint8_t)((uint64_t)expected >> (8 * i));
+
+            memset(&ctx, 0, sizeof(ctx));
+            ASSERT_EQ(decode_integer(&ctx, value, length), SUCCESS);
+            EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len), std::to_string(expected))
+                << length << " bytes";
+            bej_free_context(&ctx);
+        }
+    }
+    memset(&ctx, 0, sizeof(ctx));
+}
+
+TEST(BejIntegerTextTest, MatchesPrintfAroundPowersOfTen) {
+    char text[BEJ_INT_MAX_LENGTH];
+    std::vector<uint64_t> values = {0ULL, UINT64_MAX};
+    for (uint64_t power = 1ULL; power <= 1000000000000000000ULL; power *= 10ULL) {
+        values.push_back(power - 1ULL);
+        values.push_back(power);
+        values.push_back(power * 10ULL - 1ULL);
+    }
+    values.push_back(10000000000000000000ULL);
+    for (uint64_t value : values) {
+        EXPECT_EQ(std::string(text, bej_u64_to_text(value, text)), std::to_string(value));
+        int64_t negative = -(int64_t)(value >> 1);
+        EXPECT_EQ(std::string(text, bej_i64_to_text(negative, text)), std::to_string(negative));
+    }
+    EXPECT_EQ(std::string(text, bej_i64_to_text(INT64_MIN, text)), std::to_string(INT64_MIN));
+}
+
 // ============================================================================
 // String Decoding Tests
 // ============================================================================
@@ -329,10 +542,12 @@ protected:
     }
     
     void TearDown() override {
+        bej_free_context(&ctx);
         if (output) fclose(output);
     }
     
     std::string GetOutput() {
+        bej_flush(&ctx);
         fflush(output);
         return std::string(output_buf);
     }
@@ -368,6 +583,42 @@ TEST_F(BejStringTest, DecodeStringZeroLength) {
     EXPECT_EQ(GetOutput(), "\"\"");
 }
 
+TEST_F(BejStringTest, DecodeStringControlAndHighBytes) {
+    uint8_t value[] = {'a', 0x01, '\r', 0xE9, '\0'};
+    ASSERT_EQ(decode_string(&ctx, value, 5), SUCCESS);
+    EXPECT_EQ(GetOutput(), "\"a\\u0001\\r\\u00e9\"");
+}
+
+// ============================================================================
+// Output Buffer Tests
+// ============================================================================
+
+TEST(BejOutputTest, StringLargerThanBuffer) {
+    std::string text(BEJ_OUTPUT_BUFFER_SIZE * 2 + 17, 'x');
+    text[100] = '"';
+    std::string expected = "\"" + text.substr(0, 100) + "\\\"" + text.substr(101) + "\"";
+
+    bej_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.output = tmpfile();
+    ASSERT_NE(ctx.output, nullptr);
+
+    ASSERT_EQ(decode_string(&ctx, (uint8_t *)text.data(), (uint32_t)text.size()), SUCCESS);
+    ASSERT_EQ(decode_string(&ctx, (uint8_t *)text.data(), (uint32_t)text.size()), SUCCESS);
+    ASSERT_EQ(bej_flush(&ctx), SUCCESS);
+
+    rewind(ctx.output);
+    std::string written;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), ctx.output)) > 0)
+        written.append(chunk, n);
+    EXPECT_EQ(written, expected + expected);
+
+    fclose(ctx.output);
+    bej_free_context(&ctx);
+}
+
 // ============================================================================
 // BEJ Header Validation Tests
 // ============================================================================
@@ -388,6 +639,7 @@ protected:
     }
     
     void TearDown() override {
+        bej_free_context(&ctx);
         if (output) fclose(output);
     }
 };
@@ -501,6 +753,163 @@ TEST(BejIntegrationTest, DecodeSimpleInteger) {
     fclose(output);
 }
 
+// ============================================================================
+// Shared Dictionary Tests
+// ============================================================================
+
+class BejSharedDictTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    std::vector<uint8_t> bej_data;
+    bej_dictionary_context_t dict;
+
+    void SetUp() override {
+        dict_data = load_example("Memory_v1.bin");
+        bej_data = load_example("example_memory.bin");
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej_data.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+};
+
+TEST_F(BejSharedDictTest, CompactDocumentInMemory) {
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), nullptr), SUCCESS);
+    ctx.style = BEJ_STYLE_COMPACT;
+
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len),
+              "{\"CapacityMiB\":65536,\"DataWidthBits\":64,\"AllowedSpeedsMHz\":[2400,3200],"
+              "\"ErrorCorrection\":\"NoECC\",\"MemoryLocation\":{\"Channel\":0,\"Slot\":0},"
+              "\"Name\":\"testname\"}");
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejSharedDictTest, SetStyle) {
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), nullptr), SUCCESS);
+    EXPECT_EQ(ctx.style, BEJ_STYLE_PRETTY);
+    EXPECT_EQ(bej_set_style(&ctx, 2U), FAILURE);
+    EXPECT_EQ(ctx.style, BEJ_STYLE_PRETTY);
+    ASSERT_EQ(bej_set_style(&ctx, BEJ_STYLE_COMPACT), SUCCESS);
+
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len).rfind("{\"CapacityMiB\":65536,", 0), 0u);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejSharedDictTest, ContextsDoNotFreeBorrowedDictionary) {
+    std::string first;
+    for (int i = 0; i < 2; i++) {
+        bej_context_t ctx;
+        ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej_data.data(), bej_data.size(), nullptr), SUCCESS);
+        ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string doc((const char *)ctx.out.data, ctx.out.len);
+        if (i == 0)
+            first = doc;
+        else
+            EXPECT_EQ(doc, first);
+        bej_free_context(&ctx);
+    }
+    EXPECT_NE(dict.index.entries, nullptr);
+    EXPECT_EQ(first.rfind("{\n\t\"CapacityMiB\": 65536,\n", 0), 0u);
+}
+
+// ============================================================================
+// Deep Nesting Tests
+// ============================================================================
+
+class BejDeepNestingTest : public BejSharedDictTest {
+protected:
+    std::string Recursive(std::vector<uint8_t> &doc) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+        ctx.offset = BEJ_HEADER_SIZE;
+        EXPECT_EQ(decode_bej_sflv(&ctx, &ctx.schema_dict, 0U), SUCCESS);
+        std::string out((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+        return out;
+    }
+};
+
+TEST_F(BejDeepNestingTest, MatchesRecursiveDecoder) {
+    for (size_t depth = 1; depth < BEJ_CONTEXT_STACK_MAX_DEPTH; depth++) {
+        std::vector<uint8_t> doc = make_nested_document(depth);
+        bej_context_t ctx;
+        ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+        ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+        EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len), Recursive(doc)) << "depth " << depth;
+        bej_free_context(&ctx);
+    }
+}
+
+TEST_F(BejDeepNestingTest, BeyondRecursionLimit) {
+    std::vector<uint8_t> doc = make_nested_document(500);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    ctx.style = BEJ_STYLE_COMPACT;
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+
+    std::string expected = std::string(500, '[') + "42" + std::string(500, ']');
+    EXPECT_EQ(std::string((const char *)ctx.out.data, ctx.out.len), expected);
+    EXPECT_EQ(ctx.depth, 0u);
+    EXPECT_GE(ctx.frames_cap, 500u);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejDeepNestingTest, PrettyIndentPastTabBuffer) {
+    std::vector<uint8_t> doc = make_nested_document(150);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    std::string pretty((const char *)ctx.out.data, ctx.out.len);
+    bej_free_context(&ctx);
+
+    EXPECT_NE(pretty.find("\n" + std::string(150, '\t') + "42\n" + std::string(149, '\t') + "]"),
+              std::string::npos);
+    std::string stripped;
+    for (char c : pretty)
+        if (c != '\n' && c != '\t')
+            stripped += c;
+    EXPECT_EQ(stripped, std::string(150, '[') + "42" + std::string(150, ']'));
+}
+
+TEST_F(BejDeepNestingTest, MaxDepthEnforced) {
+    std::vector<uint8_t> doc = make_nested_document(40);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    ctx.max_depth = 39;
+    EXPECT_EQ(bej_decode(&ctx), FAILURE);
+    bej_free_context(&ctx);
+
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    ctx.max_depth = 40;
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejDeepNestingTest, CallerProvidedFrames) {
+    std::vector<uint8_t> doc = make_nested_document(64);
+    bej_frame_t frames[64];
+    bej_context_t ctx;
+
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    bej_set_frame_stack(&ctx, frames, 64);
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    EXPECT_EQ(ctx.frames, frames);      // never reallocated
+    bej_free_context(&ctx);
+    EXPECT_EQ(ctx.frames, nullptr);
+
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+    bej_set_frame_stack(&ctx, frames, 63);
+    EXPECT_EQ(bej_decode(&ctx), FAILURE);
+    bej_free_context(&ctx);
+}
+
 // ============================================================================
 // Main
 // ============================================================================
@@ -0,0 +1,357 @@
+/**
+ * @file test_binary.cpp
+ * @brief Unit tests for CBOR and MessagePack output
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_query.h"
+#include "../src/bej_stream.h"
+}
+
+typedef std::vector<uint8_t> bytes;
+
+// short text with its one byte head, both formats have one below 24 bytes
+static bytes
+text(uint8_t head, const char *s)
+{
+    bytes out = {(uint8_t)(head | strlen(s))};
+    for (const char *c = s; *c; c++)
+        out.push_back((uint8_t)*c);
+    return out;
+}
+
+static bytes
+concat(const std::vector<bytes> &parts)
+{
+    bytes out;
+    for (const auto &p : parts)
+        out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+// skips one well-formed item, false if it runs past end or uses anything the decoder doesn't write
+static bool
+cbor_skip(const uint8_t *&p, const uint8_t *end)
+{
+    if (p >= end)
+        return false;
+    uint8_t major = *p >> 5, info = *p & 0x1F;
+    p++;
+    if (major == 7)
+        return (info >= 20 && info <= 22) || (info == 27 && (p += 8) <= end);
+    if (info > 27)
+        return false;
+    uint64_t arg = info;
+    if (info >= 24) {
+        size_t n = (size_t)1 << (info - 24);
+        if ((size_t)(end - p) < n)
+            return false;
+        arg = 0;
+        for (size_t i = 0; i < n; i++)
+            arg = (arg << 8) | *p++;
+    }
+    switch (major) {
+        case 0: case 1: return true;
+        case 3: return arg <= (uint64_t)(end - p) && (p += arg, true);
+        case 4: case 5:
+            for (uint64_t i = 0; i < arg * (major == 5 ? 2 : 1); i++)
+                if (!cbor_skip(p, end))
+                    return false;
+            return true;
+        default: return false;
+    }
+}
+
+static bool
+msgpack_skip(const uint8_t *&p, const uint8_t *end)
+{
+    if (p >= end)
+        return false;
+    uint8_t b = *p++;
+    auto be = [&](size_t n, uint64_t *v) {
+        if ((size_t)(end - p) < n)
+            return false;
+        *v = 0;
+        for (size_t i = 0; i < n; i++)
+            *v = (*v << 8) | *p++;
+        return true;
+    };
+    uint64_t n = 0, items = 0;
+    if (b <= 0x7F || b >= 0xE0 || b == 0xC0 || b == 0xC2 || b == 0xC3)
+        return true;
+    if (b >= 0xCC && b <= 0xD3)
+        return be((size_t)1 << ((b - 0xCC) & 3), &n);
+    if (b == 0xCB)
+        return be(8, &n);
+    if ((b & 0xE0) == 0xA0 || (b >= 0xD9 && b <= 0xDB)) {
+        if ((b & 0xE0) == 0xA0)
+            n = b & 0x1F;
+        else if (!be((size_t)1 << (b - 0xD9), &n))
+            return false;
+        return n <= (uint64_t)(end - p) && (p += n, true);
+    }
+    if ((b & 0xF0) == 0x90 || (b & 0xF0) == 0x80)
+        items = (b & 0x0F) * ((b & 0xF0) == 0x80 ? 2 : 1);
+    else if (b >= 0xDC && b <= 0xDF) {
+        if (!be((b & 1) ? 4 : 2, &items))
+            return false;
+        items *= (b >= 0xDE) ? 2 : 1;
+    } else {
+        return false;
+    }
+    for (uint64_t i = 0; i < items; i++)
+        if (!msgpack_skip(p, end))
+            return false;
+    return true;
+}
+
+class BejBinaryTest : public ::testing::Test {
+protected:
+    bytes dict_data;
+    bej_dictionary_context_t dict;
+    bytes bej;
+
+    void SetUp() override {
+        dict_data = make_dictionary({
+            {BEJ_FORMAT_SET, 0, 1, 7, "Sensor"},
+            {BEJ_FORMAT_STRING, 0, 0, 0, "Name"},
+            {BEJ_FORMAT_INTEGER, 1, 0, 0, "Count"},
+            {BEJ_FORMAT_BOOLEAN, 2, 0, 0, "Enabled"},
+            {BEJ_FORMAT_ENUM, 3, 8, 2, "Health"},
+            {BEJ_FORMAT_ARRAY, 4, 10, 1, "Readings"},
+            {BEJ_FORMAT_REAL, 5, 0, 0, "Reading"},
+            {BEJ_FORMAT_STRING, 6, 0, 0, "Location"},
+            {BEJ_FORMAT_ENUM, 0, 0, 0, "OK"},
+            {BEJ_FORMAT_ENUM, 1, 0, 0, "Warning"},
+            {BEJ_FORMAT_INTEGER, 0, 0, 0, ""},
+        });
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+        bytes root = members({
+            tuple(0, 0, BEJ_FORMAT_STRING, {'F', 'a', 'n', '1', 0}),
+            tuple(1, 0, BEJ_FORMAT_INTEGER, {0x2C, 0x01}),
+            tuple(2, 0, BEJ_FORMAT_BOOLEAN, {0x01}),
+            tuple(3, 0, BEJ_FORMAT_ENUM, {0x01, 0x01}),
+            tuple(4, 0, BEJ_FORMAT_ARRAY, members({
+                tuple(0, 0, BEJ_FORMAT_INTEGER, {0x01}),
+                tuple(1, 0, BEJ_FORMAT_INTEGER, {0xFE}),
+            })),
+            // 23.5: whole 23, no leading zeros, fract 5, exponent 0
+            tuple(5, 0, BEJ_FORMAT_REAL, {0x01, 0x01, 0x17, 0x01, 0x00, 0x01, 0x05, 0x01, 0x01, 0x00}),
+            tuple(6, 0, BEJ_FORMAT_NULL, {}),
+            tuple(9, 0, BEJ_FORMAT_INTEGER, {0x07}),
+        });
+        bej = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+        bytes root_tuple = tuple(0, 0, BEJ_FORMAT_SET, root);
+        bej.insert(bej.end(), root_tuple.begin(), root_tuple.end());
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    bytes Decode(uint8_t encoding, uint8_t expect = SUCCESS) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        EXPECT_EQ(bej_set_encoding(&ctx, encoding), SUCCESS);
+        EXPECT_EQ(bej_decode(&ctx), expect);
+        bytes out(ctx.out.data, ctx.out.data + ctx.out.len);
+        bej_free_context(&ctx);
+        return out;
+    }
+
+    bytes Stream(uint8_t encoding, uint8_t expect = SUCCESS) {
+        bej_stream_t s;
+        EXPECT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+        EXPECT_EQ(bej_set_encoding(&s.ctx, encoding), SUCCESS);
+        uint8_t result = SUCCESS;
+        for (uint8_t byte : bej)
+            result |= bej_stream_feed(&s, &byte, 1);
+        result |= bej_stream_finish(&s);
+        EXPECT_EQ(result, expect);
+        bytes out(s.ctx.out.data, s.ctx.out.data + s.ctx.out.len);
+        bej_stream_free(&s);
+        return out;
+    }
+};
+
+TEST_F(BejBinaryTest, Cbor) {
+    bytes expected = concat({
+        {0xA8},
+        text(0x60, "Name"), text(0x60, "Fan1"),
+        text(0x60, "Count"), {0x19, 0x01, 0x2C},
+        text(0x60, "Enabled"), {0xF5},
+        text(0x60, "Health"), text(0x60, "Warning"),
+        text(0x60, "Readings"), {0x82, 0x01, 0x21},
+        text(0x60, "Reading"), {0xFB, 0x40, 0x37, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00},
+        text(0x60, "Location"), {0xF6},
+        text(0x60, "unknown_9"), {0x07},
+    });
+    EXPECT_EQ(Decode(BEJ_ENCODING_CBOR), expected);
+    EXPECT_EQ(Stream(BEJ_ENCODING_CBOR), expected);
+}
+
+TEST_F(BejBinaryTest, MessagePack) {
+    bytes expected = concat({
+        {0x88},
+        text(0xA0, "Name"), text(0xA0, "Fan1"),
+        text(0xA0, "Count"), {0xCD, 0x01, 0x2C},
+        text(0xA0, "Enabled"), {0xC3},
+        text(0xA0, "Health"), text(0xA0, "Warning"),
+        text(0xA0, "Readings"), {0x92, 0x01, 0xFE},
+        text(0xA0, "Reading"), {0xCB, 0x40, 0x37, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00},
+        text(0xA0, "Location"), {0xC0},
+        text(0xA0, "unknown_9"), {0x07},
+    });
+    EXPECT_EQ(Decode(BEJ_ENCODING_MSGPACK), expected);
+    EXPECT_EQ(Stream(BEJ_ENCODING_MSGPACK), expected);
+}
+
+TEST_F(BejBinaryTest, JsonUnchanged) {
+    bytes json = Decode(BEJ_ENCODING_JSON);
+    EXPECT_EQ(std::string(json.begin(), json.end()),
+              "{\n\t\"Name\": \"Fan1\",\n\t\"Count\": 300,\n\t\"Enabled\": true,\n\t\"Health\": \"Warning\",\n"
+              "\t\"Readings\": [\n\t\t1,\n\t\t-2\n\t],\n\t\"Reading\": 23.5,\n\t\"Location\": null,\n"
+              "\t\"unknown_9\": 7\n}");
+}
+
+TEST_F(BejBinaryTest, FewerElementsThanCountFails) {
+    // the root claims a ninth member, a map header can't take that back
+    bej[13] = 0x09;
+    Decode(BEJ_ENCODING_CBOR, FAILURE);
+    Stream(BEJ_ENCODING_MSGPACK, FAILURE);
+    Decode(BEJ_ENCODING_JSON, SUCCESS);
+}
+
+TEST_F(BejBinaryTest, QueryValue) {
+    bej_query_t query;
+    ASSERT_EQ(bej_query_compile(&query, &dict, "/Readings"), SUCCESS);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_CBOR), SUCCESS);
+    uint8_t found = 0;
+    ASSERT_EQ(bej_query_run(&ctx, &query, &found), SUCCESS);
+    EXPECT_TRUE(found);
+    EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + ctx.out.len), bytes({0x82, 0x01, 0x21}));
+    bej_free_context(&ctx);
+}
+
+TEST(BejBinaryEncodingTest, SetEncoding) {
+    bej_context_t ctx = {};
+    EXPECT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_MSGPACK), SUCCESS);
+    EXPECT_EQ(ctx.encoding, BEJ_ENCODING_MSGPACK);
+    EXPECT_EQ(bej_set_encoding(&ctx, 3), FAILURE);
+    EXPECT_EQ(bej_set_encoding(nullptr, BEJ_ENCODING_CBOR), FAILURE);
+}
+
+// smallest head for each integer, at both sides of every width boundary
+TEST(BejBinaryEncodingTest, Integers) {
+    struct { int64_t value; bytes cbor; bytes msgpack; } cases[] = {
+        {0, {0x00}, {0x00}},
+        {23, {0x17}, {0x17}},
+        {24, {0x18, 0x18}, {0x18}},
+        {127, {0x18, 0x7F}, {0x7F}},
+        {128, {0x18, 0x80}, {0xCC, 0x80}},
+        {255, {0x18, 0xFF}, {0xCC, 0xFF}},
+        {256, {0x19, 0x01, 0x00}, {0xCD, 0x01, 0x00}},
+        {65536, {0x1A, 0x00, 0x01, 0x00, 0x00}, {0xCE, 0x00, 0x01, 0x00, 0x00}},
+        {4294967296LL, {0x1B, 0, 0, 0, 1, 0, 0, 0, 0}, {0xCF, 0, 0, 0, 1, 0, 0, 0, 0}},
+        {-1, {0x20}, {0xFF}},
+        {-24, {0x37}, {0xE8}},
+        {-25, {0x38, 0x18}, {0xE7}},
+        {-32, {0x38, 0x1F}, {0xE0}},
+        {-33, {0x38, 0x20}, {0xD0, 0xDF}},
+        {-129, {0x38, 0x80}, {0xD1, 0xFF, 0x7F}},
+        {-257, {0x39, 0x01, 0x00}, {0xD1, 0xFE, 0xFF}},
+        {INT32_MIN, {0x3A, 0x7F, 0xFF, 0xFF, 0xFF}, {0xD2, 0x80, 0x00, 0x00, 0x00}},
+        {INT64_MIN, {0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+                    {0xD3, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    };
+    for (const auto &c : cases) {
+        uint8_t value[8];
+        for (int i = 0; i < 8; i++)
+            value[i] = (uint8_t)((uint64_t)c.value >> (8 * i));
+
+        bej_context_t ctx = {};
+        ASSERT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_CBOR), SUCCESS);
+        ASSERT_EQ(decode_integer(&ctx, value, 8), SUCCESS);
+        EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + ctx.out.len), c.cbor) << c.value;
+        ctx.out.len = 0;
+        ASSERT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_MSGPACK), SUCCESS);
+        ASSERT_EQ(decode_integer(&ctx, value, 8), SUCCESS);
+        EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + ctx.out.len), c.msgpack) << c.value;
+        bej_free_context(&ctx);
+    }
+}
+
+TEST(BejBinaryEncodingTest, LongStrings) {
+    std::string s(300, 'x');
+    bytes value(s.begin(), s.end());
+    value.push_back(0);
+
+    bej_context_t ctx = {};
+    ASSERT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_CBOR), SUCCESS);
+    ASSERT_EQ(decode_string(&ctx, value.data(), 32), SUCCESS);
+    EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + 2), bytes({0x78, 0x20}));
+    ctx.out.len = 0;
+    ASSERT_EQ(decode_string(&ctx, value.data(), (uint32_t)value.size()), SUCCESS);
+    EXPECT_EQ(ctx.out.len, 303U);
+    EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + 3), bytes({0x79, 0x01, 0x2C}));
+
+    ctx.out.len = 0;
+    ASSERT_EQ(bej_set_encoding(&ctx, BEJ_ENCODING_MSGPACK), SUCCESS);
+    ASSERT_EQ(decode_string(&ctx, value.data(), 32), SUCCESS);
+    EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + 2), bytes({0xD9, 0x20}));
+    ctx.out.len = 0;
+    ASSERT_EQ(decode_string(&ctx, value.data(), (uint32_t)value.size()), SUCCESS);
+    EXPECT_EQ(bytes(ctx.out.data, ctx.out.data + 3), bytes({0xDA, 0x01, 0x2C}));
+    bej_free_context(&ctx);
+}
+
+// the example documents come out as exactly one well-formed item, the same from both decoders
+TEST(BejBinaryEncodingTest, ExamplesAreWellFormed) {
+    const char *docs[][2] = {
+        {"Memory_v1.bin", "example_memory.bin"},
+        {"PCIeDevice_v1.bin", "example_pciedevice.bin"},
+    };
+    for (const auto &doc : docs) {
+        bytes dict_data = load_example(doc[0]);
+        bytes bej = load_example(doc[1]);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        bej_dictionary_context_t dict;
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+        for (uint8_t encoding : {BEJ_ENCODING_CBOR, BEJ_ENCODING_MSGPACK}) {
+            bej_context_t ctx;
+            ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+            ASSERT_EQ(bej_set_encoding(&ctx, encoding), SUCCESS);
+            ASSERT_EQ(bej_decode(&ctx), SUCCESS) << doc[1];
+            bytes out(ctx.out.data, ctx.out.data + ctx.out.len);
+            bej_free_context(&ctx);
+
+            const uint8_t *p = out.data();
+            bool ok = (encoding == BEJ_ENCODING_CBOR) ? cbor_skip(p, out.data() + out.size())
+                                                      : msgpack_skip(p, out.data() + out.size());
+            EXPECT_TRUE(ok) << doc[1];
+            EXPECT_EQ(p, out.data() + out.size()) << doc[1];
+
+            bej_stream_t s;
+            ASSERT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+            ASSERT_EQ(bej_set_encoding(&s.ctx, encoding), SUCCESS);
+            ASSERT_EQ(bej_stream_feed(&s, bej.data(), bej.size()), SUCCESS);
+            ASSERT_EQ(bej_stream_finish(&s), SUCCESS);
+            EXPECT_EQ(bytes(s.ctx.out.data, s.ctx.out.data + s.ctx.out.len), out) << doc[1];
+            bej_stream_free(&s);
+        }
+        bej_free_dict(&dict);
+    }
+}
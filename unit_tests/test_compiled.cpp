@@ -0,0 +1,143 @@
+/**
+ * @file test_compiled.cpp
+ * @brief Unit tests for the compiled dictionary format
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_compiled.h"
+}
+
+class BejCompiledDictTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> source;
+    bej_dictionary_context_t parsed;
+    uint8_t *blob = nullptr;
+    size_t blob_size = 0;
+
+    void SetUp() override {
+        source = load_example("Memory_v1.bin");
+        ASSERT_FALSE(source.empty());
+        ASSERT_EQ(bej_parse_dict(&parsed, source.data(), source.size()), SUCCESS);
+        ASSERT_EQ(bej_compile_dict(&parsed, &blob, &blob_size), SUCCESS);
+    }
+
+    void TearDown() override {
+        free(blob);
+        bej_free_dict(&parsed);
+    }
+
+    std::string Decode(bej_dictionary_context_t *dict, const char *example) {
+        std::vector<uint8_t> bej = load_example(example);
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string doc((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+        return doc;
+    }
+};
+
+TEST_F(BejCompiledDictTest, HeaderAndAlignment) {
+    ASSERT_TRUE(bej_is_compiled_dict(blob, blob_size));
+    EXPECT_FALSE(bej_is_compiled_dict(source.data(), source.size()));
+
+    const bej_compiled_header_t *h = (const bej_compiled_header_t *)blob;
+    EXPECT_EQ(h->entry_count, parsed.entry_count);
+    EXPECT_EQ(h->source_size, source.size());
+    for (uint64_t off : {h->source_offset, h->entries_offset, h->ranges_offset,
+                         h->slots_offset, h->names_offset, h->name_pool_offset})
+        EXPECT_EQ(off % BEJ_COMPILED_ALIGN, 0u);
+}
+
+TEST_F(BejCompiledDictTest, LoadsInPlace) {
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), SUCCESS);
+
+    EXPECT_EQ(dict.entry_count, parsed.entry_count);
+    EXPECT_EQ(dict.schema_version, parsed.schema_version);
+    EXPECT_EQ(dict.data_size, source.size());
+    EXPECT_EQ(memcmp(dict.data, source.data(), source.size()), 0);
+    EXPECT_EQ(dict.index.storage, nullptr);
+    EXPECT_GE((uint8_t *)dict.index.entries, blob);
+    EXPECT_LT((uint8_t *)dict.index.name_pool, blob + blob_size);
+
+    bej_free_dict(&dict);   // must not touch the blob
+    EXPECT_TRUE(bej_is_compiled_dict(blob, blob_size));
+}
+
+TEST_F(BejCompiledDictTest, ParseDictDetectsCompiledFormat) {
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, blob, blob_size), SUCCESS);
+    EXPECT_EQ(dict.index.storage, nullptr);
+    EXPECT_EQ(dict.entry_count, parsed.entry_count);
+}
+
+TEST_F(BejCompiledDictTest, LookupsMatchParsedDictionary) {
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), SUCCESS);
+
+    for (uint16_t i = 0; i < parsed.entry_count; i++) {
+        bej_dict_entry_t parent = parsed.index.entries[i];
+        for (uint32_t seq = 0; seq < parent.child_count + 2u; seq++) {
+            bej_dict_entry_t a, b;
+            uint8_t ra = bej_dict_lookup(&parsed, parent.child_offset, parent.child_count, seq, &a);
+            uint8_t rb = bej_dict_lookup(&dict, parent.child_offset, parent.child_count, seq, &b);
+            ASSERT_EQ(ra, rb);
+            if (ra == SUCCESS) {
+                EXPECT_EQ(a.index, b.index);
+                EXPECT_EQ(a.child_offset, b.child_offset);
+                EXPECT_EQ(a.name_offset, b.name_offset);
+            }
+        }
+    }
+}
+
+TEST_F(BejCompiledDictTest, DecodesLikeParsedDictionary) {
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), SUCCESS);
+    std::string expected = Decode(&parsed, "example_memory.bin");
+    EXPECT_EQ(Decode(&dict, "example_memory.bin"), expected);
+    EXPECT_NE(expected.find("\"ErrorCorrection\": \"NoECC\""), std::string::npos);
+}
+
+TEST_F(BejCompiledDictTest, RejectsTruncated) {
+    bej_dictionary_context_t dict;
+    const bej_compiled_header_t *h = (const bej_compiled_header_t *)blob;
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, h->name_pool_offset), FAILURE);
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, sizeof(bej_compiled_header_t) - 1), FAILURE);
+}
+
+TEST_F(BejCompiledDictTest, RejectsForeignAbi) {
+    bej_dictionary_context_t dict;
+    bej_compiled_header_t *h = (bej_compiled_header_t *)blob;
+    h->byte_order = 0x04030201U;
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), FAILURE);
+    h->byte_order = BEJ_COMPILED_BYTE_ORDER;
+    h->version++;
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), FAILURE);
+}
+
+TEST_F(BejCompiledDictTest, RejectsCorruptSlots) {
+    bej_dictionary_context_t dict;
+    const bej_compiled_header_t *h = (const bej_compiled_header_t *)blob;
+    uint16_t *slots = (uint16_t *)(blob + h->slots_offset);
+    slots[0] = (uint16_t)(h->entry_count + 5);
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), FAILURE);
+}
+
+TEST_F(BejCompiledDictTest, RejectsCorruptNames) {
+    bej_dictionary_context_t dict;
+    const bej_compiled_header_t *h = (const bej_compiled_header_t *)blob;
+    bej_dict_name_t *names = (bej_dict_name_t *)(blob + h->names_offset);
+    names[3].offset = h->name_pool_size;
+    EXPECT_EQ(bej_load_compiled_dict(&dict, blob, blob_size), FAILURE);
+}
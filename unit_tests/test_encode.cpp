@@ -0,0 +1,165 @@
+/**
+ * @file test_encode.cpp
+ * @brief Unit tests for the JSON to BEJ encoder
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_encode.h"
+}
+
+class BejEncodeTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    bej_dictionary_context_t dict;
+    bej_encoder_t enc;
+
+    void SetUp() override {
+        dict_data = load_example("Memory_v1.bin");
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        ASSERT_EQ(bej_encoder_init(&enc, &dict), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_encoder_free(&enc);
+        bej_free_dict(&dict);
+    }
+
+    std::string Decode(const uint8_t *bej, size_t size, uint8_t style = BEJ_STYLE_PRETTY) {
+        std::vector<uint8_t> copy(bej, bej + size);
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, copy.data(), copy.size(), nullptr), SUCCESS);
+        ctx.style = style;
+        EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string json((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+        return json;
+    }
+
+    uint8_t Encode(const std::string &json) {
+        return bej_encode(&enc, json.data(), json.size());
+    }
+};
+
+TEST_F(BejEncodeTest, RoundTripExampleMemory) {
+    std::vector<uint8_t> bej = load_example("example_memory.bin");
+    for (uint8_t style : {BEJ_STYLE_PRETTY, BEJ_STYLE_COMPACT}) {
+        ASSERT_EQ(Encode(Decode(bej.data(), bej.size(), style)), SUCCESS);
+        EXPECT_EQ(std::vector<uint8_t>(enc.out.data, enc.out.data + enc.out.len), bej);
+    }
+}
+
+TEST_F(BejEncodeTest, RoundTripExamplePCIeDevice) {
+    std::vector<uint8_t> pcie_dict_data = load_example("PCIeDevice_v1.bin");
+    std::vector<uint8_t> bej = load_example("example_pciedevice.bin");
+    bej_dictionary_context_t pcie_dict;
+    ASSERT_EQ(bej_parse_dict(&pcie_dict, pcie_dict_data.data(), pcie_dict_data.size()), SUCCESS);
+
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &pcie_dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+
+    bej_encoder_t pcie;
+    ASSERT_EQ(bej_encoder_init(&pcie, &pcie_dict), SUCCESS);
+    ASSERT_EQ(bej_encode(&pcie, (const char *)ctx.out.data, ctx.out.len), SUCCESS);
+    EXPECT_EQ(std::vector<uint8_t>(pcie.out.data, pcie.out.data + pcie.out.len), bej);
+
+    bej_encoder_free(&pcie);
+    bej_free_context(&ctx);
+    bej_free_dict(&pcie_dict);
+}
+
+TEST_F(BejEncodeTest, NameLookup) {
+    bej_dict_entry_t root, member, option;
+    ASSERT_EQ(bej_dict_lookup(&dict, BEJ_DICT_HEADER_SIZE, dict.entry_count, 0, &root), SUCCESS);
+
+    ASSERT_EQ(bej_name_lookup(&enc, root.child_offset, root.child_count, "ErrorCorrection", 15, &member), SUCCESS);
+    EXPECT_EQ(member.sequence, 9);
+    EXPECT_EQ(member.format >> 4, BEJ_FORMAT_ENUM);
+
+    ASSERT_EQ(bej_name_lookup(&enc, member.child_offset, member.child_count, "NoECC", 5, &option), SUCCESS);
+    EXPECT_EQ(option.sequence, 2);
+
+    // a prefix, another range's member and a name outside a narrower range all miss
+    EXPECT_EQ(bej_name_lookup(&enc, root.child_offset, root.child_count, "ErrorCorr", 9, &member), FAILURE);
+    EXPECT_EQ(bej_name_lookup(&enc, root.child_offset, root.child_count, "NoECC", 5, &member), FAILURE);
+    EXPECT_EQ(bej_name_lookup(&enc, root.child_offset, 2, "CapacityMiB", 11, &member), FAILURE);
+}
+
+TEST_F(BejEncodeTest, StringEscapesRoundTrip) {
+    std::string json = "{\"Name\": \"q\\\"b\\\\s\\/ \\n\\t\\u0001 \\u00e9 \\ud83d\\ude00\"}";
+    ASSERT_EQ(Encode(json), SUCCESS);
+    // stored as UTF-8, the decoder escapes every byte outside of ASCII
+    EXPECT_EQ(Decode(enc.out.data, enc.out.len, BEJ_STYLE_COMPACT),
+              "{\"Name\":\"q\\\"b\\\\s/ \\n\\t\\u0001 \\u00c3\\u00a9 \\u00f0\\u009f\\u0098\\u0080\"}");
+}
+
+TEST_F(BejEncodeTest, IntegersUseShortestEncoding) {
+    struct { const char *json; std::vector<uint8_t> value; } cases[] = {
+        {"0", {0x00}},
+        {"127", {0x7F}},
+        {"128", {0x80, 0x00}},
+        {"-1", {0xFF}},
+        {"-128", {0x80}},
+        {"-129", {0x7F, 0xFF}},
+        {"65536", {0x00, 0x00, 0x01}},
+        {"-9223372036854775808", {0, 0, 0, 0, 0, 0, 0, 0x80}},
+    };
+    for (auto &c : cases) {
+        ASSERT_EQ(Encode(std::string("{\"CapacityMiB\": ") + c.json + "}"), SUCCESS) << c.json;
+        // header, root tuple (seq, format, length, count), member (seq, format, length)
+        std::vector<uint8_t> tail(enc.out.data + enc.out.len - c.value.size(), enc.out.data + enc.out.len);
+        EXPECT_EQ(tail, c.value) << c.json;
+        EXPECT_EQ(enc.out.data[enc.out.len - c.value.size() - 1], c.value.size()) << c.json;
+        EXPECT_EQ(Decode(enc.out.data, enc.out.len, BEJ_STYLE_COMPACT),
+                  std::string("{\"CapacityMiB\":") + c.json + "}");
+    }
+}
+
+TEST_F(BejEncodeTest, LongValuesWidenLengths) {
+    std::string name(300, 'x');
+    std::string json = "{\"Name\": \"" + name + "\", \"AllowedSpeedsMHz\": [";
+    for (int i = 0; i < 300; i++)
+        json += (i ? ", " : "") + std::to_string(i * 1000);
+    json += "], \"Name\": null}";
+
+    ASSERT_EQ(Encode(json), SUCCESS);
+    std::string decoded = Decode(enc.out.data, enc.out.len, BEJ_STYLE_COMPACT);
+    std::string expected = json;
+    expected.erase(std::remove(expected.begin(), expected.end(), ' '), expected.end());
+    EXPECT_EQ(decoded, expected);
+}
+
+TEST_F(BejEncodeTest, RejectsInvalidInput) {
+    EXPECT_EQ(Encode("{\"NoSuchMember\": 1}"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": \"1\"}"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": 1.5}"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": 9223372036854775808}"), FAILURE);
+    EXPECT_EQ(Encode("{\"ErrorCorrection\": \"Sometimes\"}"), FAILURE);
+    EXPECT_EQ(Encode("{\"Name\": \"unterminated}"), FAILURE);
+    EXPECT_EQ(Encode("{\"Name\": \"bad \\x escape\"}"), FAILURE);
+    EXPECT_EQ(Encode("{\"Name\": \"lone \\ud83d surrogate\"}"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": 1,}"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": 1} trailing"), FAILURE);
+    EXPECT_EQ(Encode("{\"CapacityMiB\": 1"), FAILURE);
+    EXPECT_EQ(Encode(""), FAILURE);
+
+    // the encoder stays usable after errors
+    EXPECT_EQ(Encode("{}"), SUCCESS);
+    EXPECT_EQ(Decode(enc.out.data, enc.out.len, BEJ_STYLE_COMPACT), "{}");
+}
+
+TEST_F(BejEncodeTest, MaxDepthEnforced) {
+    enc.max_depth = 2;
+    EXPECT_EQ(Encode("{\"MemoryLocation\": {\"Channel\": 1}}"), SUCCESS);
+    enc.max_depth = 1;
+    EXPECT_EQ(Encode("{\"MemoryLocation\": {\"Channel\": 1}}"), FAILURE);
+}
@@ -0,0 +1,179 @@
+/**
+ * @file test_escape.cpp
+ * @brief Unit tests for the vectorized JSON escaping scanners
+ */
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_escape.h"
+}
+
+// ============================================================================
+// Reference escaping, mirrors the decode_string table byte by byte
+// ============================================================================
+
+static std::string
+reference_escape(const std::string &in)
+{
+    std::string out = "\"";
+    for (unsigned char c : in) {
+        switch (c) {
+            case '\"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c >= 32 && c <= 126) {
+                    out += (char)c;
+                } else {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+// ============================================================================
+// Scanner Tests
+// ============================================================================
+
+typedef size_t (*scan_fn)(const uint8_t *, size_t);
+
+static std::vector<std::pair<const char *, scan_fn>>
+available_scanners()
+{
+    std::vector<std::pair<const char *, scan_fn>> scanners = {
+        {"dispatch", bej_escape_scan},
+        {"scalar", bej_escape_scan_scalar},
+    };
+#ifdef BEJ_ESCAPE_X86
+    scanners.push_back({"sse2", bej_escape_scan_sse2});
+    if (bej_escape_has_avx2())
+        scanners.push_back({"avx2", bej_escape_scan_avx2});
+#endif
+    return scanners;
+}
+
+TEST(BejEscapeScanTest, ScalarMatchesEscapeTable) {
+    for (int b = 0; b < 256; b++) {
+        uint8_t c = (uint8_t)b;
+        bool expected = !(b >= 32 && b <= 126) || b == '"' || b == '\\';
+        EXPECT_EQ(bej_escape_scan_scalar(&c, 1) == 0, expected) << "byte " << b;
+    }
+}
+
+TEST(BejEscapeScanTest, CleanBufferScansToEnd) {
+    std::vector<uint8_t> data(200, 'a');
+    for (auto &s : available_scanners()) {
+        for (size_t len = 0; len <= data.size(); len++)
+            ASSERT_EQ(s.second(data.data(), len), len) << s.first << " len " << len;
+    }
+}
+
+TEST(BejEscapeScanTest, EveryByteAtEveryPosition) {
+    std::vector<uint8_t> data(80);
+    for (auto &s : available_scanners()) {
+        for (int b = 0; b < 256; b++) {
+            for (size_t pos = 0; pos < data.size(); pos++) {
+                std::fill(data.begin(), data.end(), 'x');
+                data[pos] = (uint8_t)b;
+                ASSERT_EQ(s.second(data.data(), data.size()),
+                          bej_escape_scan_scalar(data.data(), data.size()))
+                    << s.first << " byte " << b << " pos " << pos;
+            }
+        }
+    }
+}
+
+TEST(BejEscapeScanTest, ReportsFirstOfSeveral) {
+    std::vector<uint8_t> data(100, 'z');
+    data[70] = '"';
+    data[40] = 0x01;
+    data[90] = 0xC3;
+    for (auto &s : available_scanners()) {
+        EXPECT_EQ(s.second(data.data(), data.size()), 40u) << s.first;
+        EXPECT_EQ(s.second(data.data() + 41, data.size() - 41), 29u) << s.first;
+    }
+}
+
+TEST(BejEscapeScanTest, UnalignedStart) {
+    std::vector<uint8_t> data(128, 'q');
+    data[100] = '\\';
+    for (auto &s : available_scanners()) {
+        for (size_t start = 0; start < 40; start++)
+            EXPECT_EQ(s.second(data.data() + start, data.size() - start), 100 - start) << s.first;
+    }
+}
+
+// ============================================================================
+// decode_string against the reference table
+// ============================================================================
+
+class BejEscapeDecodeTest : public ::testing::Test {
+protected:
+    bej_context_t ctx;
+
+    void SetUp() override {
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.output = tmpfile();
+        ASSERT_NE(ctx.output, nullptr);
+    }
+
+    void TearDown() override {
+        fclose(ctx.output);
+        bej_free_context(&ctx);
+    }
+
+    std::string Decode(const std::string &value) {
+        rewind(ctx.output);
+        EXPECT_EQ(ftruncate(fileno(ctx.output), 0), 0);
+        EXPECT_EQ(decode_string(&ctx, (uint8_t *)value.data(), (uint32_t)value.size()), SUCCESS);
+        EXPECT_EQ(bej_flush(&ctx), SUCCESS);
+        fflush(ctx.output);
+
+        std::string written;
+        rewind(ctx.output);
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), ctx.output)) > 0)
+            written.append(chunk, n);
+        return written;
+    }
+};
+
+TEST_F(BejEscapeDecodeTest, EveryByteInsideLongString) {
+    for (int b = 1; b < 256; b++) {
+        for (size_t pos : {0, 15, 16, 31, 33, 63}) {
+            std::string value(70, 'm');
+            value[pos] = (char)b;
+            ASSERT_EQ(Decode(value), reference_escape(value)) << "byte " << b << " pos " << pos;
+        }
+    }
+}
+
+TEST_F(BejEscapeDecodeTest, MixedRuns) {
+    std::string value;
+    for (int i = 0; i < 500; i++) {
+        value += "SerialNumber-";
+        value += (char)(i % 256 ? i % 256 : 1);
+    }
+    EXPECT_EQ(Decode(value), reference_escape(value));
+}
+
+TEST_F(BejEscapeDecodeTest, TrailingNullDropped) {
+    std::string value = std::string(40, 'p') + "\"end";
+    std::string with_null = value + '\0';
+    EXPECT_EQ(Decode(with_null), reference_escape(value));
+}
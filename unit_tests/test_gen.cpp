@@ -0,0 +1,137 @@
+/**
+ * @file test_gen.cpp
+ * @brief Unit tests for the synthetic document generator
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_gen.h"
+#include "../src/bej_validate.h"
+}
+
+class BejGenTest : public ::testing::TestWithParam<const char *> {
+protected:
+    std::vector<uint8_t> dict_data;
+    bej_dictionary_context_t dict;
+    bej_gen_options_t options;
+
+    void SetUp() override {
+        dict_data = load_example(GetParam());
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        bej_gen_default_options(&options);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    // generated BEJ and JSON as strings, BEJ empty on failure
+    void Generate(std::string &json, std::vector<uint8_t> &bej) {
+        bej_output_t json_out, bej_out;
+        bej.clear();
+        ASSERT_EQ(bej_generate(&dict, &options, &json_out, &bej_out), SUCCESS);
+        json.assign((const char *)json_out.data, json_out.len);
+        bej.assign(bej_out.data, bej_out.data + bej_out.len);
+        free(json_out.data);
+        free(bej_out.data);
+    }
+
+    std::string Decode(std::vector<uint8_t> &bej) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+        std::string json((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+        return json;
+    }
+
+    uint8_t Validate(std::vector<uint8_t> &bej) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        uint8_t result = bej_validate(&ctx);
+        bej_free_context(&ctx);
+        return result;
+    }
+};
+
+TEST_P(BejGenTest, DecodesToExpectedJson) {
+    std::string json;
+    std::vector<uint8_t> bej;
+    for (options.seed = 1; options.seed <= 50; options.seed++) {
+        Generate(json, bej);
+        ASSERT_FALSE(bej.empty());
+        EXPECT_EQ(Decode(bej), json) << "seed " << options.seed;
+        EXPECT_EQ(Validate(bej), SUCCESS) << "seed " << options.seed;
+    }
+}
+
+TEST_P(BejGenTest, SameSeedSameDocument) {
+    std::string first_json, second_json;
+    std::vector<uint8_t> first, second;
+    options.seed = 42;
+    Generate(first_json, first);
+    Generate(second_json, second);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first_json, second_json);
+
+    options.seed = 43;
+    Generate(second_json, second);
+    EXPECT_NE(first, second);
+}
+
+TEST_P(BejGenTest, ShapeOptions) {
+    std::string json;
+    std::vector<uint8_t> bej;
+
+    // nothing below the root, the generator can't leave it empty
+    options.max_depth = 1;
+    Generate(json, bej);
+    EXPECT_EQ(json.find('{', 1), std::string::npos);
+    EXPECT_EQ(json.find('['), std::string::npos);
+    EXPECT_EQ(Decode(bej), json);
+
+    options.max_depth = 0;
+    bej_output_t json_out, bej_out;
+    EXPECT_EQ(bej_generate(&dict, &options, &json_out, &bej_out), FAILURE);
+
+    options.max_depth = 8;
+    options.string_length = 0;
+    Generate(json, bej);
+    EXPECT_EQ(Decode(bej), json);
+}
+
+TEST_P(BejGenTest, ReachesTargetSize) {
+    std::string json;
+    std::vector<uint8_t> bej;
+    options.array_length = 2;
+    options.target_size = 64 * 1024;
+    Generate(json, bej);
+    EXPECT_GE(bej.size(), options.target_size);
+    EXPECT_LT(bej.size(), options.target_size * 5 / 4);
+    EXPECT_EQ(Decode(bej), json);
+    EXPECT_EQ(Validate(bej), SUCCESS);
+
+    // the size grows linearly with the target, not with the array length to the depth
+    options.target_size = 4 * 1024 * 1024;
+    Generate(json, bej);
+    EXPECT_GE(bej.size(), options.target_size);
+    EXPECT_LT(bej.size(), options.target_size * 5 / 4);
+}
+
+TEST_P(BejGenTest, NestedArrayLengthsAreCapped) {
+    std::string json;
+    std::vector<uint8_t> bej;
+    options.array_length = 1000000;
+    Generate(json, bej);
+    EXPECT_LT(bej.size(), 64UL << 20);
+}
+
+INSTANTIATE_TEST_SUITE_P(Dictionaries, BejGenTest,
+                         ::testing::Values("Memory_v1.bin", "PCIeDevice_v1.bin"));
@@ -0,0 +1,125 @@
+/**
+ * @file test_helpers.h
+ * @brief Shared helpers for the BEJparser unit tests
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// reads a file from examples/, empty vector if it can't be opened
+static inline std::vector<uint8_t>
+load_example(const char *name)
+{
+    std::string path = std::string(BEJ_EXAMPLES_DIR) + "/" + name;
+    std::vector<uint8_t> data;
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data.insert(data.end(), chunk, chunk + n);
+    fclose(f);
+
+    return data;
+}
+
+// minimal-length NNINT
+static inline void
+append_nnint(std::vector<uint8_t> &out, uint32_t value)
+{
+    uint8_t n = 1;
+    while (n < 4 && (value >> (8 * n)))
+        n++;
+    out.push_back(n);
+    for (uint8_t i = 0; i < n; i++)
+        out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+// SFLV tuple, selector 1 for annotations
+static inline std::vector<uint8_t>
+tuple(uint32_t sequence, uint8_t selector, uint8_t format, const std::vector<uint8_t> &value)
+{
+    std::vector<uint8_t> out;
+    append_nnint(out, (sequence << 1) | selector);
+    out.push_back((uint8_t)(format << 4));
+    append_nnint(out, (uint32_t)value.size());
+    out.insert(out.end(), value.begin(), value.end());
+    return out;
+}
+
+// set/array value: count followed by the elements
+static inline std::vector<uint8_t>
+members(const std::vector<std::vector<uint8_t>> &elements)
+{
+    std::vector<uint8_t> out;
+    append_nnint(out, (uint32_t)elements.size());
+    for (const auto &e : elements)
+        out.insert(out.end(), e.begin(), e.end());
+    return out;
+}
+
+// BEJ document of `depth` arrays nested in each other around the integer 42
+static inline std::vector<uint8_t>
+make_nested_document(size_t depth)
+{
+    std::vector<uint8_t> tuple = {0x01, 0x00, 0x30, 0x01, 0x01, 0x2A};
+    for (size_t i = 0; i < depth; i++) {
+        std::vector<uint8_t> value;
+        append_nnint(value, 1);     // count
+        value.insert(value.end(), tuple.begin(), tuple.end());
+
+        tuple = {0x01, 0x00, 0x10};
+        append_nnint(tuple, (uint32_t)value.size());
+        tuple.insert(tuple.end(), value.begin(), value.end());
+    }
+
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    doc.insert(doc.end(), tuple.begin(), tuple.end());
+    return doc;
+}
+
+// entry of a hand-built dictionary, children are the child_count entries from first_child on
+struct dict_entry_spec {
+    uint8_t format;
+    uint16_t sequence;
+    uint16_t first_child;
+    uint16_t child_count;
+    const char *name;
+};
+
+// DSP8010 dictionary: header, entry table, then the NUL terminated names
+static inline std::vector<uint8_t>
+make_dictionary(const std::vector<dict_entry_spec> &entries)
+{
+    auto put16 = [](std::vector<uint8_t> &out, size_t at, uint16_t v) {
+        out[at] = (uint8_t)v;
+        out[at + 1] = (uint8_t)(v >> 8);
+    };
+
+    size_t names = 12 + entries.size() * 10;
+    std::vector<uint8_t> dict(names, 0);
+    put16(dict, 2, (uint16_t)entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const dict_entry_spec &e = entries[i];
+        size_t at = 12 + i * 10;
+        dict[at] = (uint8_t)(e.format << 4);
+        put16(dict, at + 1, e.sequence);
+        put16(dict, at + 3, e.child_count ? (uint16_t)(12 + e.first_child * 10) : 0);
+        put16(dict, at + 5, e.child_count);
+        size_t length = std::string(e.name).size();
+        if (length) {
+            dict[at + 7] = (uint8_t)(length + 1);
+            put16(dict, at + 8, (uint16_t)dict.size());
+            dict.insert(dict.end(), e.name, e.name + length + 1);
+        }
+    }
+    uint32_t size = (uint32_t)dict.size();
+    for (int i = 0; i < 4; i++)
+        dict[8 + i] = (uint8_t)(size >> (8 * i));
+    return dict;
+}
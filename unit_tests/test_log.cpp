@@ -0,0 +1,154 @@
+/**
+ * @file test_log.cpp
+ * @brief Unit tests for the log callbacks and the library staying off stdout
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_validate.h"
+}
+
+struct log_record {
+    int level;
+    std::string func;
+    std::string message;
+};
+
+static void
+collect(void *user, int level, const char *func, int line, const char *message)
+{
+    (void)line;
+    static_cast<std::vector<log_record> *>(user)->push_back({level, func, message});
+}
+
+// {"Reading": 7} whose set claims one byte more than its member takes
+static std::vector<uint8_t>
+overlong_set_document()
+{
+    std::vector<uint8_t> set = members({tuple(0, 0, BEJ_FORMAT_INTEGER, {0x07})});
+    set.push_back(0x00);    // padding the set length counts past its member
+
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    std::vector<uint8_t> root = tuple(0, 0, BEJ_FORMAT_SET, set);
+    doc.insert(doc.end(), root.begin(), root.end());
+    return doc;
+}
+
+class BejLogTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    bej_dictionary_context_t dict;
+    std::vector<log_record> global;
+
+    void SetUp() override {
+        dict_data = make_dictionary({
+            {BEJ_FORMAT_SET, 0, 1, 1, "Sensor"},
+            {BEJ_FORMAT_INTEGER, 0, 0, 0, "Reading"},
+        });
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        bej_set_log_handler(collect, &global);
+    }
+
+    void TearDown() override {
+        bej_set_log_handler(nullptr, nullptr);
+        bej_free_dict(&dict);
+    }
+};
+
+TEST_F(BejLogTest, ContextCallbackGetsDocumentWarnings) {
+    std::vector<uint8_t> bej = overlong_set_document();
+    std::vector<log_record> own;
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_set_log_callback(&ctx, collect, &own), SUCCESS);
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+
+    bool mismatch = false;
+    for (const log_record &r : own)
+        mismatch |= r.level == BEJ_LOG_WARNING && r.message.find("length mismatch") != std::string::npos;
+    EXPECT_TRUE(mismatch);
+    for (const log_record &r : global)
+        EXPECT_GT(r.level, BEJ_LOG_WARNING) << r.func << ": " << r.message;
+}
+
+TEST_F(BejLogTest, HandlerGetsMessagesWithoutContext) {
+    std::vector<uint8_t> bej = overlong_set_document();
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+
+    ASSERT_FALSE(global.empty());
+    bool mismatch = false;
+    for (const log_record &r : global)
+        mismatch |= r.message.find("length mismatch") != std::string::npos;
+    EXPECT_TRUE(mismatch);
+
+    global.clear();
+    bej_set_log_handler(nullptr, nullptr);
+    std::vector<uint8_t> dummy(16, 0);
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(bej_parse_dict(nullptr, dummy.data(), dummy.size()), FAILURE);
+    bej_context_t bad;
+    EXPECT_EQ(bej_init_context_with_dict(&bad, nullptr, dummy.data(), dummy.size(), nullptr), FAILURE);
+    std::string err = testing::internal::GetCapturedStderr();
+    EXPECT_NE(err.find("Error at bej_init_context_with_dict()"), std::string::npos);
+    EXPECT_TRUE(global.empty());
+}
+
+TEST_F(BejLogTest, NothingAboveTheCompiledLevel) {
+    std::vector<uint8_t> bej = load_example("example_memory.bin");
+    std::vector<uint8_t> memory = load_example("Memory_v1.bin");
+    ASSERT_FALSE(bej.empty());
+    ASSERT_FALSE(memory.empty());
+
+    // owns its dictionary, so the debug dump of it is part of what gets checked
+    FILE *sink = fopen("/dev/null", "w");
+    ASSERT_NE(sink, nullptr);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context(&ctx, memory.data(), memory.size(), bej.data(), bej.size(), sink), SUCCESS);
+    std::vector<log_record> own;
+    ASSERT_EQ(bej_set_log_callback(&ctx, collect, &own), SUCCESS);
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+    fclose(sink);
+
+    for (const log_record &r : own)
+        EXPECT_LE(r.level, BEJ_LOG_LEVEL) << r.message;
+    for (const log_record &r : global)
+        EXPECT_LE(r.level, BEJ_LOG_LEVEL) << r.message;
+}
+
+// stdout belongs to the application, JSON written there must not get interleaved with chatter
+TEST_F(BejLogTest, LibraryStaysOffStdout) {
+    std::vector<uint8_t> bej = load_example("example_memory.bin");
+    std::vector<uint8_t> memory = load_example("Memory_v1.bin");
+    std::vector<uint8_t> overlong = overlong_set_document();
+    bej_set_log_handler(nullptr, nullptr);
+
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    bej_dictionary_context_t parsed;
+    ASSERT_EQ(bej_parse_dict(&parsed, memory.data(), memory.size()), SUCCESS);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &parsed, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_validate(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &parsed, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, overlong.data(), overlong.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+    bej_free_context(&ctx);
+    bej_free_dict(&parsed);
+    testing::internal::GetCapturedStderr();
+
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+}
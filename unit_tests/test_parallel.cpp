@@ -0,0 +1,235 @@
+/**
+ * @file test_parallel.cpp
+ * @brief Unit tests for decoding the elements of big sets and arrays on several threads
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_encode.h"
+}
+
+// PCIeDevice with `conditions` entries in Status/Conditions, the array that gets split up
+static std::vector<uint8_t>
+conditions_document(bej_dictionary_context_t *dict, size_t conditions)
+{
+    std::string json = "{\"Id\":\"1\",\"Name\":\"GPU\",\"Status\":{\"Health\":\"Warning\",\"Conditions\":[";
+    for (size_t i = 0; i < conditions; i++) {
+        if (i)
+            json += ",";
+        json += "{\"MessageId\":\"Base.1.0.LinkDegraded\",\"Message\":\"Link " + std::to_string(i)
+              + " retrained\",\"Severity\":\"Warning\"}";
+    }
+    json += "]}}";
+
+    std::vector<uint8_t> doc;
+    bej_encoder_t enc;
+    if (!bej_encoder_init(&enc, dict)) {
+        if (!bej_encode(&enc, json.data(), json.size()))
+            doc.assign(enc.out.data, enc.out.data + enc.out.len);
+        bej_encoder_free(&enc);
+    }
+    return doc;
+}
+
+// root set with a Readings array of integers
+static std::vector<uint8_t>
+readings_dictionary()
+{
+    return make_dictionary({
+        {BEJ_FORMAT_SET, 0, 1, 1, "Sensor"},
+        {BEJ_FORMAT_ARRAY, 0, 2, 1, "Readings"},
+        {BEJ_FORMAT_INTEGER, 0, 0, 0, "Reading"},
+    });
+}
+
+// {"Readings": [...]} of the given element tuples, claiming `count` elements and `extra` bytes more
+static std::vector<uint8_t>
+readings_document(const std::vector<std::vector<uint8_t>> &elements, uint32_t count, uint8_t extra = 0)
+{
+    std::vector<uint8_t> array;
+    append_nnint(array, count);
+    for (const std::vector<uint8_t> &e : elements)
+        array.insert(array.end(), e.begin(), e.end());
+    array.insert(array.end(), extra, 0x00);
+
+    std::vector<uint8_t> member = {0x01, 0x00, 0x10};
+    append_nnint(member, (uint32_t)array.size());
+    member.insert(member.end(), array.begin(), array.end());
+
+    std::vector<uint8_t> root;
+    append_nnint(root, 1);
+    root.insert(root.end(), member.begin(), member.end());
+
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+    append_nnint(doc, (uint32_t)root.size());
+    doc.insert(doc.end(), root.begin(), root.end());
+    return doc;
+}
+
+static std::vector<uint8_t>
+reading(uint8_t value)
+{
+    return {0x01, 0x00, 0x30, 0x01, 0x01, value};
+}
+
+struct decode_result {
+    uint8_t status;
+    std::string out;
+    bej_stats_t stats;
+};
+
+static decode_result
+decode(bej_dictionary_context_t *dict, std::vector<uint8_t> &bej, unsigned threads,
+       uint8_t style = BEJ_STYLE_PRETTY, uint8_t encoding = BEJ_ENCODING_JSON)
+{
+    decode_result r = {};
+    bej_context_t ctx;
+    EXPECT_EQ(bej_init_context_with_dict(&ctx, dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_set_style(&ctx, style), SUCCESS);
+    EXPECT_EQ(bej_set_encoding(&ctx, encoding), SUCCESS);
+    // every set/array qualifies by size, what gets split up is down to the element sizes
+    EXPECT_EQ(bej_set_parallel(&ctx, threads, 1), SUCCESS);
+    r.status = bej_decode(&ctx);
+    r.out.assign((const char *)ctx.out.data, ctx.out.len);
+    if (const bej_stats_t *stats = bej_get_stats(&ctx))
+        r.stats = *stats;
+    bej_free_context(&ctx);
+    return r;
+}
+
+static void
+expect_same(const decode_result &parallel, const decode_result &sequential)
+{
+    EXPECT_EQ(parallel.status, sequential.status);
+    EXPECT_EQ(parallel.out, sequential.out);
+    EXPECT_EQ(parallel.stats.tuples, sequential.stats.tuples);
+    EXPECT_EQ(parallel.stats.lookups, sequential.stats.lookups);
+    EXPECT_EQ(parallel.stats.length_mismatches, sequential.stats.length_mismatches);
+    EXPECT_EQ(parallel.stats.max_depth, sequential.stats.max_depth);
+    for (unsigned i = 0; i < BEJ_STATS_FORMATS; i++)
+        EXPECT_EQ(parallel.stats.format_bytes[i], sequential.stats.format_bytes[i]) << "format " << i;
+}
+
+TEST(BejParallelTest, SameOutputInEveryStyleAndEncoding) {
+    std::vector<uint8_t> dict_data = load_example("PCIeDevice_v1.bin");
+    ASSERT_FALSE(dict_data.empty());
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    std::vector<uint8_t> bej = conditions_document(&dict, 1000);
+    ASSERT_FALSE(bej.empty());
+
+    const uint8_t formats[][2] = {
+        {BEJ_STYLE_PRETTY, BEJ_ENCODING_JSON},
+        {BEJ_STYLE_COMPACT, BEJ_ENCODING_JSON},
+        {BEJ_STYLE_COMPACT, BEJ_ENCODING_CBOR},
+        {BEJ_STYLE_COMPACT, BEJ_ENCODING_MSGPACK},
+    };
+    for (const auto &f : formats) {
+        decode_result sequential = decode(&dict, bej, 1, f[0], f[1]);
+        ASSERT_EQ(sequential.status, SUCCESS);
+        for (unsigned threads : {2U, 3U, 8U}) {
+            SCOPED_TRACE("style " + std::to_string(f[0]) + " encoding " + std::to_string(f[1])
+                         + " threads " + std::to_string(threads));
+            expect_same(decode(&dict, bej, threads, f[0], f[1]), sequential);
+        }
+    }
+    bej_free_dict(&dict);
+}
+
+TEST(BejParallelTest, SameOutputForExamples) {
+    const char *examples[][2] = {
+        {"Memory_v1.bin", "example_memory.bin"},
+        {"PCIeDevice_v1.bin", "example_pciedevice.bin"},
+    };
+    for (const auto &e : examples) {
+        SCOPED_TRACE(e[1]);
+        std::vector<uint8_t> dict_data = load_example(e[0]);
+        std::vector<uint8_t> bej = load_example(e[1]);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        bej_dictionary_context_t dict;
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        expect_same(decode(&dict, bej, 4), decode(&dict, bej, 1));
+        bej_free_dict(&dict);
+    }
+}
+
+TEST(BejParallelTest, SameLengthMismatchesAndShortArrays) {
+    std::vector<uint8_t> dict_data = readings_dictionary();
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    std::vector<std::vector<uint8_t>> elements;
+    for (uint8_t i = 0; i < 64; i++)
+        elements.push_back(reading(i));
+    // an element set that ends before its length, skipped to its end
+    elements[10] = {0x01, 0x00, 0x00, 0x01, 0x04, 0x01, 0x00, 0x00, 0x00};
+
+    std::vector<std::vector<uint8_t>> docs = {
+        readings_document(elements, 64),
+        readings_document(elements, 64, 5),     // bytes after the last element
+        readings_document(elements, 80),        // fewer elements than counted
+    };
+    for (std::vector<uint8_t> &bej : docs) {
+        decode_result sequential = decode(&dict, bej, 1);
+        ASSERT_EQ(sequential.status, SUCCESS);
+        expect_same(decode(&dict, bej, 4), sequential);
+    }
+    bej_free_dict(&dict);
+}
+
+TEST(BejParallelTest, FewerElementsThanThreads) {
+    std::vector<uint8_t> dict_data = readings_dictionary();
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    // equal elements, each one exactly a thread's share once the threads are cut down to four
+    std::vector<uint8_t> bej = readings_document({reading(1), reading(2), reading(3), reading(4)}, 4);
+    decode_result sequential = decode(&dict, bej, 1);
+    ASSERT_EQ(sequential.status, SUCCESS);
+    expect_same(decode(&dict, bej, 8), sequential);
+    bej_free_dict(&dict);
+}
+
+TEST(BejParallelTest, FailingElementFailsTheDecode) {
+    std::vector<uint8_t> dict_data = readings_dictionary();
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    std::vector<std::vector<uint8_t>> elements;
+    for (uint8_t i = 0; i < 64; i++)
+        elements.push_back(reading(i));
+    // pre-scans fine, but the member of the set claims more bytes than the set has
+    elements[50] = {0x01, 0x00, 0x00, 0x01, 0x07, 0x01, 0x01, 0x01, 0x00, 0x30, 0x01, 0x09};
+    std::vector<uint8_t> bej = readings_document(elements, 64);
+
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(decode(&dict, bej, 1).status, FAILURE);
+    EXPECT_EQ(decode(&dict, bej, 4).status, FAILURE);
+    testing::internal::GetCapturedStderr();
+    bej_free_dict(&dict);
+}
+
+TEST(BejParallelTest, Defaults) {
+    std::vector<uint8_t> dict_data = readings_dictionary();
+    bej_dictionary_context_t dict;
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    std::vector<uint8_t> bej = readings_document({reading(1)}, 1);
+
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_LE(ctx.parallel_threads, 1U);
+    EXPECT_EQ(ctx.parallel_min_bytes, BEJ_PARALLEL_MIN_BYTES);
+    ASSERT_EQ(bej_set_parallel(&ctx, 0, 0), SUCCESS);
+    EXPECT_GE(ctx.parallel_threads, 1U);
+    EXPECT_EQ(ctx.parallel_min_bytes, BEJ_PARALLEL_MIN_BYTES);
+    EXPECT_EQ(bej_set_parallel(nullptr, 2, 0), FAILURE);
+    bej_free_context(&ctx);
+    bej_free_dict(&dict);
+}
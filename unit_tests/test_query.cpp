@@ -0,0 +1,144 @@
+/**
+ * @file test_query.cpp
+ * @brief Unit tests for path queries
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_query.h"
+}
+
+class BejQueryTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    std::vector<uint8_t> bej;
+    bej_dictionary_context_t dict;
+
+    void Load(const char *dict_name, const char *bej_name) {
+        dict_data = load_example(dict_name);
+        bej = load_example(bej_name);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    }
+
+    void SetUp() override {
+        memset(&dict, 0, sizeof(dict));
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    // compact JSON of the matched value, "<absent>" or "<error>" otherwise
+    std::string Query(const char *path) {
+        bej_query_t q;
+        if (bej_query_compile(&q, &dict, path) != SUCCESS)
+            return "<invalid>";
+
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        ctx.style = BEJ_STYLE_COMPACT;
+        uint8_t found = 0;
+        uint8_t result = bej_query_run(&ctx, &q, &found);
+        std::string out((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+
+        if (result != SUCCESS)
+            return "<error>";
+        if (!found) {
+            EXPECT_TRUE(out.empty());
+            return "<absent>";
+        }
+        return out;
+    }
+};
+
+TEST_F(BejQueryTest, MemoryExample) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    EXPECT_EQ(Query("/CapacityMiB"), "65536");
+    EXPECT_EQ(Query("Name"), "\"testname\"");
+    EXPECT_EQ(Query("/ErrorCorrection"), "\"NoECC\"");
+    EXPECT_EQ(Query("/AllowedSpeedsMHz"), "[2400,3200]");
+    EXPECT_EQ(Query("/AllowedSpeedsMHz/1"), "3200");
+    EXPECT_EQ(Query("/MemoryLocation/Slot"), "0");
+    EXPECT_EQ(Query("/MemoryLocation"), "{\"Channel\":0,\"Slot\":0}");
+}
+
+TEST_F(BejQueryTest, PCIeDeviceExample) {
+    Load("PCIeDevice_v1.bin", "example_pciedevice.bin");
+
+    EXPECT_EQ(Query("/Status/Health"), "\"OK\"");
+    EXPECT_EQ(Query("/Status/Conditions/0/Severity"), "\"Warning\"");
+    EXPECT_EQ(Query("/Status/Conditions/0"), "{\"Timestamp\":\"[21.672384]\",\"Severity\":\"Warning\"}");
+    EXPECT_EQ(Query("/ReadyToRemove"), "false");
+}
+
+TEST_F(BejQueryTest, RootMatchesFullDecode) {
+    Load("PCIeDevice_v1.bin", "example_pciedevice.bin");
+
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ctx.style = BEJ_STYLE_COMPACT;
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    std::string full((const char *)ctx.out.data, ctx.out.len);
+    bej_free_context(&ctx);
+
+    EXPECT_EQ(Query("/"), full);
+    EXPECT_EQ(Query(""), full);
+}
+
+TEST_F(BejQueryTest, AbsentAndInvalidPaths) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    // in the dictionary, not in the document
+    EXPECT_EQ(Query("/Manufacturer"), "<absent>");
+    EXPECT_EQ(Query("/AllowedSpeedsMHz/2"), "<absent>");
+
+    EXPECT_EQ(Query("/NoSuchProperty"), "<invalid>");
+    EXPECT_EQ(Query("/AllowedSpeedsMHz/x"), "<invalid>");
+    EXPECT_EQ(Query("/AllowedSpeedsMHz/-1"), "<invalid>");
+    EXPECT_EQ(Query("/CapacityMiB/Deeper"), "<invalid>");
+}
+
+TEST_F(BejQueryTest, SkipsValuesOffThePath) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    bej_query_t capacity, name;
+    ASSERT_EQ(bej_query_compile(&capacity, &dict, "/CapacityMiB"), SUCCESS);
+    ASSERT_EQ(bej_query_compile(&name, &dict, "/Name"), SUCCESS);
+
+    // root set with a malformed 9 byte integer in front of Name
+    std::vector<uint8_t> members;
+    append_nnint(members, 2);   // count
+    append_nnint(members, capacity.steps[0].sequence << 1);
+    members.push_back(BEJ_FORMAT_INTEGER << 4);
+    append_nnint(members, 9);
+    members.insert(members.end(), 9, 0xFF);
+    append_nnint(members, name.steps[0].sequence << 1);
+    members.push_back(BEJ_FORMAT_STRING << 4);
+    append_nnint(members, 2);
+    members.push_back('x');
+    members.push_back('\0');
+
+    bej = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, BEJ_FORMAT_SET << 4};
+    append_nnint(bej, (uint32_t)members.size());
+    bej.insert(bej.end(), members.begin(), members.end());
+
+    EXPECT_EQ(Query("/Name"), "\"x\"");
+    EXPECT_EQ(Query("/CapacityMiB"), "<error>");
+}
+
+TEST_F(BejQueryTest, TruncatedDocumentFails) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    bej.resize(bej.size() / 2);
+    EXPECT_EQ(Query("/Name"), "<error>");
+}
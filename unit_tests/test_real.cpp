@@ -0,0 +1,277 @@
+/**
+ * @file test_real.cpp
+ * @brief Unit tests for Real values and their shortest round-trip formatting
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_real.h"
+}
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+static void
+append_nnint64(std::vector<uint8_t> &out, uint64_t value)
+{
+    std::vector<uint8_t> bytes;
+    do {
+        bytes.push_back((uint8_t)value);
+        value >>= 8;
+    } while (value);
+    out.push_back((uint8_t)bytes.size());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+// length as an NNINT, then the fewest bytes that keep the sign, as an encoder would send them
+static void
+append_integer(std::vector<uint8_t> &out, int64_t value)
+{
+    std::vector<uint8_t> bytes;
+    do {
+        bytes.push_back((uint8_t)value);
+        value >>= 8;
+    } while (!((value == 0 && !(bytes.back() & 0x80)) || (value == -1 && (bytes.back() & 0x80))));
+    append_nnint64(out, bytes.size());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static std::vector<uint8_t>
+real_value(int64_t whole, uint32_t leading_zeros, uint64_t fract, int64_t exponent)
+{
+    std::vector<uint8_t> out;
+    append_integer(out, whole);         // length of whole, whole
+    append_nnint64(out, leading_zeros);
+    append_nnint64(out, fract);
+    append_integer(out, exponent);      // length of exp, exp
+    return out;
+}
+
+static std::string
+format(int64_t whole, uint32_t leading_zeros, uint64_t fract, int64_t exponent)
+{
+    bej_real_t real = {whole, leading_zeros, fract, exponent};
+    char text[BEJ_REAL_MAX_LENGTH];
+    size_t n = bej_real_format(&real, text);
+    EXPECT_EQ(n, strlen(text));
+    EXPECT_LT(n, BEJ_REAL_MAX_LENGTH);
+    return std::string(text, n);
+}
+
+// splitmix64
+static uint64_t
+next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// digits of the shortest %.*e text that reads back as x
+static size_t
+shortest_digits(double x)
+{
+    char text[40];
+    for (int precision = 1; precision <= 17; precision++) {
+        snprintf(text, sizeof(text), "%.*e", precision - 1, x);
+        if (strtod(text, NULL) == x)
+            return (size_t)precision;
+    }
+    return 17UL;
+}
+
+static size_t
+significant_digits(const std::string &text)
+{
+    std::string mantissa = text.substr(0, text.find('e'));
+    std::string digits;
+    for (char c : mantissa)
+        if (c >= '0' && c <= '9')
+            digits += c;
+    digits.erase(0, digits.find_first_not_of('0'));
+    digits.erase(digits.find_last_not_of('0') + 1);
+    return digits.size();
+}
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+TEST(BejRealParseTest, SplitsParts) {
+    std::vector<uint8_t> value = real_value(-1, 3, 5, -2);
+    bej_real_t real;
+    ASSERT_EQ(bej_real_parse(value.data(), (uint32_t)value.size(), &real), SUCCESS);
+    EXPECT_EQ(real.whole, -1);
+    EXPECT_EQ(real.leading_zeros, 3U);
+    EXPECT_EQ(real.fract, 5U);
+    EXPECT_EQ(real.exponent, -2);
+}
+
+TEST(BejRealParseTest, EmptyWholeAndExponent) {
+    // length of whole 0, no leading zeros, fract 25, length of exp 0
+    uint8_t value[] = {0x00, 0x01, 0x00, 0x01, 0x19, 0x00};
+    bej_real_t real;
+    ASSERT_EQ(bej_real_parse(value, sizeof(value), &real), SUCCESS);
+    EXPECT_EQ(real.whole, 0);
+    EXPECT_EQ(real.fract, 25U);
+    EXPECT_EQ(real.exponent, 0);
+}
+
+TEST(BejRealParseTest, RejectsTruncatedAndTrailingBytes) {
+    std::vector<uint8_t> value = real_value(12, 0, 5, 0);
+    bej_real_t real;
+    for (uint32_t length = 0; length < value.size(); length++)
+        EXPECT_EQ(bej_real_parse(value.data(), length, &real), FAILURE) << length;
+
+    value.push_back(0x00);
+    EXPECT_EQ(bej_real_parse(value.data(), (uint32_t)value.size(), &real), FAILURE);
+}
+
+TEST(BejRealParseTest, RejectsWideIntegers) {
+    // nine byte whole
+    uint8_t value[] = {0x01, 0x09, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00, 0x01, 0x00, 0x00};
+    bej_real_t real;
+    EXPECT_EQ(bej_real_parse(value, sizeof(value), &real), FAILURE);
+}
+
+// ============================================================================
+// Formatting
+// ============================================================================
+
+TEST(BejRealFormatTest, Fixed) {
+    EXPECT_EQ(format(1, 3, 5, 0), "1.0005");
+    EXPECT_EQ(format(0, 0, 5, 0), "0.5");
+    EXPECT_EQ(format(-3, 0, 25, 0), "-3.25");
+    EXPECT_EQ(format(42, 0, 0, 0), "42.0");
+    EXPECT_EQ(format(0, 0, 0, 0), "0.0");
+    EXPECT_EQ(format(23, 0, 50, 0), "23.5");
+    EXPECT_EQ(format(123, 0, 456, 2), "12345.6");
+    EXPECT_EQ(format(12345, 0, 0, -2), "123.45");
+    EXPECT_EQ(format(0, 5, 1, 0), "0.000001");
+    EXPECT_EQ(format(1, 0, 0, 20), "100000000000000000000.0");
+}
+
+TEST(BejRealFormatTest, Exponent) {
+    EXPECT_EQ(format(1, 0, 0, 21), "1e21");
+    EXPECT_EQ(format(0, 6, 1, 0), "1e-7");
+    EXPECT_EQ(format(-6, 0, 25, -10), "-6.25e-10");
+    EXPECT_EQ(format(1, 0, 7976931348623157, 308), "1.7976931348623157e308");
+}
+
+TEST(BejRealFormatTest, TooManyDigitsRoundsToShortest) {
+    EXPECT_EQ(format(0, 0, 30000000000000004ULL, 0), "0.30000000000000004");
+    EXPECT_EQ(format(0, 0, 300000000000000001ULL, 0), "0.3");
+    EXPECT_EQ(format(0, 0, 1000000000000000000ULL, 0), "0.1");
+    EXPECT_EQ(format(9007199254740993LL, 0, 0, 0), "9007199254740992.0");
+}
+
+TEST(BejRealFormatTest, FarAwayFractionStillBreaksTies) {
+    // 2^53 + 1 is halfway between two doubles, anything above it rounds up
+    EXPECT_EQ(format(9007199254740993LL, 4000000000U, 1, 0), "9007199254740994.0");
+    EXPECT_EQ(format(1, 4000000000U, 1, 0), "1.0");
+}
+
+TEST(BejRealFormatTest, OutOfRange) {
+    bej_real_t huge = {1, 0, 0, 400};
+    char text[BEJ_REAL_MAX_LENGTH];
+    EXPECT_EQ(bej_real_format(&huge, text), 0U);
+    EXPECT_EQ(format(1, 0, 0, 9000000000000000000LL), "");
+
+    EXPECT_EQ(format(1, 0, 0, -400), "0.0");
+    EXPECT_EQ(format(-1, 0, 0, -400), "-0.0");
+    EXPECT_EQ(format(5, 0, 0, -324), "5e-324");
+}
+
+TEST(BejRealFormatTest, ToDouble) {
+    bej_real_t real = {-2, 0, 5, 1};
+    double value = 0.0;
+    ASSERT_EQ(bej_real_to_double(&real, &value), SUCCESS);
+    EXPECT_EQ(value, -25.0);
+
+    real = {-1, 0, 0, 400};
+    EXPECT_EQ(bej_real_to_double(&real, &value), FAILURE);
+    EXPECT_EQ(value, -HUGE_VAL);
+}
+
+// every double written out with 17 digits, as a careless encoder would, comes back in its
+// shortest form and reads back exactly
+TEST(BejRealFormatTest, RoundTripsRandomDoubles) {
+    uint64_t rng = 1ULL;
+    for (int i = 0; i < 100000; i++) {
+        uint64_t bits = next_random(&rng);
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        if (!std::isfinite(x) || x == 0.0)
+            continue;
+
+        // d.dddddddddddddddde[+-]x
+        char text[40];
+        snprintf(text, sizeof(text), "%.16e", std::fabs(x));
+        std::string fraction(text + 2, 16);
+        size_t zeros = fraction.find_first_not_of('0');
+        int64_t whole = text[0] - '0';
+
+        bej_real_t real;
+        real.whole = (x < 0) ? -whole : whole;
+        real.leading_zeros = (zeros == std::string::npos) ? 0U : (uint32_t)zeros;
+        real.fract = (zeros == std::string::npos) ? 0U : strtoull(fraction.c_str() + zeros, NULL, 10);
+        real.exponent = strtoll(text + 19, NULL, 10);
+
+        char out[BEJ_REAL_MAX_LENGTH];
+        size_t n = bej_real_format(&real, out);
+        ASSERT_GT(n, 0U) << text;
+        ASSERT_EQ(strtod(out, NULL), x) << text << " printed as " << out;
+        ASSERT_EQ(significant_digits(out), shortest_digits(std::fabs(x))) << text << " printed as " << out;
+    }
+}
+
+// ============================================================================
+// Decoding
+// ============================================================================
+
+class BejRealDecodeTest : public ::testing::Test {
+protected:
+    bej_context_t ctx;
+
+    void SetUp() override {
+        memset(&ctx, 0, sizeof(ctx));
+    }
+
+    void TearDown() override {
+        bej_free_context(&ctx);
+    }
+
+    std::string Output() {
+        return std::string((const char *)ctx.out.data, ctx.out.len);
+    }
+};
+
+TEST_F(BejRealDecodeTest, SensorReading) {
+    std::vector<uint8_t> value = real_value(23, 0, 5, 0);
+    bej_dict_entry_t entry = {};
+    ASSERT_EQ(decode_bej_leaf(&ctx, NULL, BEJ_FORMAT_REAL, &entry, value.data(), (uint32_t)value.size()),
+              SUCCESS);
+    EXPECT_EQ(Output(), "23.5");
+}
+
+TEST_F(BejRealDecodeTest, OutOfRangeIsNull) {
+    std::vector<uint8_t> value = real_value(1, 0, 0, 400);
+    ASSERT_EQ(decode_real(&ctx, value.data(), (uint32_t)value.size()), SUCCESS);
+    EXPECT_EQ(Output(), "null");
+}
+
+TEST_F(BejRealDecodeTest, MalformedFails) {
+    // whole 23, then nothing but an empty leading zero count
+    uint8_t value[] = {0x01, 0x01, 0x17, 0x00};
+    EXPECT_EQ(decode_real(&ctx, value, sizeof(value)), FAILURE);
+}
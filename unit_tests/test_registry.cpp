@@ -0,0 +1,294 @@
+/**
+ * @file test_registry.cpp
+ * @brief Unit tests for the dictionary registry
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_registry.h"
+}
+
+static std::string
+example_path(const char *name)
+{
+    return std::string(BEJ_EXAMPLES_DIR) + "/" + name;
+}
+
+static std::string
+decode(bej_dictionary_context_t *dict, std::vector<uint8_t> &bej)
+{
+    bej_context_t ctx;
+    EXPECT_EQ(bej_init_context_with_dict(&ctx, dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_set_style(&ctx, BEJ_STYLE_COMPACT), SUCCESS);
+    uint8_t result = bej_decode(&ctx);
+    std::string json = result ? "" : std::string((const char *)ctx.out.data, ctx.out.len);
+    bej_free_context(&ctx);
+    return json;
+}
+
+// named root with one integer member, version in the header
+static std::vector<uint8_t>
+versioned_dictionary(const char *root, const char *member, uint32_t version)
+{
+    std::vector<uint8_t> dict = make_dictionary({
+        {BEJ_FORMAT_SET, 0, 1, 1, root},
+        {BEJ_FORMAT_INTEGER, 0, 0, 0, member},
+    });
+    for (int i = 0; i < 4; i++)
+        dict[4 + i] = (uint8_t)(version >> (8 * i));
+    return dict;
+}
+
+// {"<member>": 7} for the dictionaries above
+static std::vector<uint8_t>
+sensor_document()
+{
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    std::vector<uint8_t> root = tuple(0, 0, BEJ_FORMAT_SET, members({tuple(0, 0, BEJ_FORMAT_INTEGER, {0x07})}));
+    doc.insert(doc.end(), root.begin(), root.end());
+    return doc;
+}
+
+class BejRegistryTest : public ::testing::Test {
+protected:
+    bej_registry_t reg;
+    std::vector<uint8_t> memory_bej;
+    std::string memory_json;
+    uint32_t memory_version = 0;
+
+    void SetUp() override {
+        ASSERT_EQ(bej_registry_init(&reg, 0), SUCCESS);
+        memory_bej = load_example("example_memory.bin");
+        ASSERT_FALSE(memory_bej.empty());
+
+        std::vector<uint8_t> dict_data = load_example("Memory_v1.bin");
+        bej_dictionary_context_t dict;
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        memory_version = dict.schema_version;
+        memory_json = decode(&dict, memory_bej);
+        bej_free_dict(&dict);
+        ASSERT_FALSE(memory_json.empty());
+    }
+
+    void TearDown() override {
+        bej_registry_free(&reg);
+    }
+};
+
+TEST_F(BejRegistryTest, LoadAndAcquire) {
+    ASSERT_EQ(bej_registry_load(&reg, example_path("Memory_v1.bin").c_str()), SUCCESS);
+    char name[BEJ_DICT_ENTRY_NAME_LENGTH + 1];
+    ASSERT_EQ(bej_registry_load_named(&reg, example_path("PCIeDevice_v1.bin").c_str(), name), SUCCESS);
+    EXPECT_STREQ(name, "PCIeDevice");
+
+    bej_registry_dict_t *exact = bej_registry_acquire(&reg, "Memory", memory_version);
+    ASSERT_NE(exact, nullptr);
+    EXPECT_EQ(decode(&exact->dict, memory_bej), memory_json);
+
+    bej_registry_dict_t *any = bej_registry_acquire(&reg, "Memory", BEJ_REGISTRY_ANY_VERSION);
+    EXPECT_EQ(any, exact);
+    bej_registry_dict_t *other = bej_registry_acquire(&reg, "PCIeDevice", BEJ_REGISTRY_ANY_VERSION);
+    EXPECT_NE(other, nullptr);
+    EXPECT_NE(other, exact);
+
+    EXPECT_EQ(bej_registry_acquire(&reg, "Memory", memory_version + 1), nullptr);
+    EXPECT_EQ(bej_registry_acquire(&reg, "Processor", BEJ_REGISTRY_ANY_VERSION), nullptr);
+
+    bej_registry_release(any);
+    bej_registry_release(exact);
+    bej_registry_release(other);
+}
+
+TEST_F(BejRegistryTest, BufferIsCopied) {
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    ASSERT_EQ(bej_registry_load_buffer(&reg, data.data(), data.size()), SUCCESS);
+    std::fill(data.begin(), data.end(), 0);
+
+    bej_registry_dict_t *dict = bej_registry_acquire(&reg, "Memory", memory_version);
+    ASSERT_NE(dict, nullptr);
+    EXPECT_EQ(decode(&dict->dict, memory_bej), memory_json);
+    bej_registry_release(dict);
+}
+
+TEST_F(BejRegistryTest, VersionsLiveSideBySide) {
+    std::vector<uint8_t> v1 = versioned_dictionary("Sensor", "Reading", 0x01000000);
+    std::vector<uint8_t> v2 = versioned_dictionary("Sensor", "ReadingNew", 0x01010000);
+    ASSERT_EQ(bej_registry_load_buffer(&reg, v2.data(), v2.size()), SUCCESS);
+    ASSERT_EQ(bej_registry_load_buffer(&reg, v1.data(), v1.size()), SUCCESS);
+
+    std::vector<uint8_t> bej = sensor_document();
+    bej_registry_dict_t *old = bej_registry_acquire(&reg, "Sensor", 0x01000000);
+    bej_registry_dict_t *latest = bej_registry_acquire(&reg, "Sensor", BEJ_REGISTRY_ANY_VERSION);
+    ASSERT_NE(old, nullptr);
+    ASSERT_NE(latest, nullptr);
+    EXPECT_EQ(decode(&old->dict, bej), "{\"Reading\":7}");
+    EXPECT_EQ(decode(&latest->dict, bej), "{\"ReadingNew\":7}");
+    bej_registry_release(old);
+    bej_registry_release(latest);
+}
+
+TEST_F(BejRegistryTest, ReplacementKeepsBorrowedCopy) {
+    std::vector<uint8_t> first = versioned_dictionary("Sensor", "Reading", 1);
+    std::vector<uint8_t> second = versioned_dictionary("Sensor", "Renamed", 1);
+    std::vector<uint8_t> bej = sensor_document();
+
+    ASSERT_EQ(bej_registry_load_buffer(&reg, first.data(), first.size()), SUCCESS);
+    bej_registry_dict_t *before = bej_registry_acquire(&reg, "Sensor", 1);
+    ASSERT_NE(before, nullptr);
+
+    ASSERT_EQ(bej_registry_load_buffer(&reg, second.data(), second.size()), SUCCESS);
+    bej_registry_dict_t *after = bej_registry_acquire(&reg, "Sensor", 1);
+    ASSERT_NE(after, nullptr);
+    EXPECT_NE(before, after);
+    EXPECT_EQ(atomic_load(&reg.count), 1U);
+
+    // the replaced one stays usable until its last borrower lets go
+    EXPECT_EQ(decode(&before->dict, bej), "{\"Reading\":7}");
+    EXPECT_EQ(decode(&after->dict, bej), "{\"Renamed\":7}");
+    bej_registry_release(before);
+    bej_registry_release(after);
+}
+
+TEST_F(BejRegistryTest, FailedLoadChangesNothing) {
+    ASSERT_EQ(bej_registry_load(&reg, example_path("Memory_v1.bin").c_str()), SUCCESS);
+    bej_registry_dict_t *dict = bej_registry_acquire(&reg, "Memory", memory_version);
+
+    EXPECT_EQ(bej_registry_load(&reg, example_path("example_memory.bin").c_str()), FAILURE);
+    EXPECT_EQ(bej_registry_load(&reg, example_path("missing.bin").c_str()), FAILURE);
+    std::vector<uint8_t> nameless = make_dictionary({{BEJ_FORMAT_SET, 0, 0, 0, ""}});
+    EXPECT_EQ(bej_registry_load_buffer(&reg, nameless.data(), nameless.size()), FAILURE);
+
+    EXPECT_EQ(atomic_load(&reg.count), 1U);
+    bej_registry_dict_t *again = bej_registry_acquire(&reg, "Memory", memory_version);
+    EXPECT_EQ(again, dict);
+    bej_registry_release(again);
+    bej_registry_release(dict);
+}
+
+TEST_F(BejRegistryTest, CapacityIsEnforced) {
+    bej_registry_t small;
+    ASSERT_EQ(bej_registry_init(&small, 1), SUCCESS);
+    std::vector<uint8_t> a = versioned_dictionary("A", "Value", 1);
+    std::vector<uint8_t> b = versioned_dictionary("B", "Value", 1);
+    EXPECT_EQ(bej_registry_load_buffer(&small, a.data(), a.size()), SUCCESS);
+    EXPECT_EQ(bej_registry_load_buffer(&small, b.data(), b.size()), FAILURE);
+    // replacing doesn't need a new slot
+    EXPECT_EQ(bej_registry_load_buffer(&small, a.data(), a.size()), SUCCESS);
+    bej_registry_free(&small);
+}
+
+TEST_F(BejRegistryTest, LoadDirectory) {
+    char dir[] = "/tmp/bej_registry_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    for (const char *name : {"Memory_v1.bin", "PCIeDevice_v1.bin"}) {
+        std::vector<uint8_t> data = load_example(name);
+        std::string path = std::string(dir) + "/" + name;
+        FILE *f = fopen(path.c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    }
+
+    EXPECT_EQ(bej_registry_load_dir(&reg, dir), SUCCESS);
+    EXPECT_EQ(atomic_load(&reg.count), 2U);
+    bej_registry_dict_t *dict = bej_registry_acquire(&reg, "PCIeDevice", BEJ_REGISTRY_ANY_VERSION);
+    EXPECT_NE(dict, nullptr);
+    bej_registry_release(dict);
+
+    // not a dictionary, the others still load
+    std::string junk = std::string(dir) + "/junk.bin";
+    FILE *f = fopen(junk.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    fputs("junk", f);
+    fclose(f);
+    EXPECT_EQ(bej_registry_load_dir(&reg, dir), FAILURE);
+    EXPECT_EQ(atomic_load(&reg.count), 2U);
+
+    for (const char *name : {"Memory_v1.bin", "PCIeDevice_v1.bin", "junk.bin"})
+        unlink((std::string(dir) + "/" + name).c_str());
+    rmdir(dir);
+    EXPECT_EQ(bej_registry_load_dir(&reg, dir), FAILURE);
+}
+
+// decoders keep borrowing while the dictionary is replaced underneath them
+TEST_F(BejRegistryTest, ConcurrentReplace) {
+    std::vector<uint8_t> data = load_example("Memory_v1.bin");
+    ASSERT_EQ(bej_registry_load_buffer(&reg, data.data(), data.size()), SUCCESS);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> decodes{0}, mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            std::vector<uint8_t> bej = memory_bej;
+            while (!stop.load()) {
+                bej_registry_dict_t *dict = bej_registry_acquire(&reg, "Memory", memory_version);
+                if (!dict || decode(&dict->dict, bej) != memory_json)
+                    mismatches++;
+                bej_registry_release(dict);
+                decodes++;
+            }
+        });
+    }
+
+    for (int i = 0; i < 200; i++)
+        ASSERT_EQ(bej_registry_load_buffer(&reg, data.data(), data.size()), SUCCESS);
+    while (decodes.load() < 100)
+        std::this_thread::yield();
+    stop = true;
+    for (auto &t : readers)
+        t.join();
+
+    EXPECT_EQ(mismatches.load(), 0U);
+    EXPECT_EQ(atomic_load(&reg.count), 1U);
+}
+
+// borrowers that never pause must not hold up replacements, nor loads of other dictionaries
+TEST_F(BejRegistryTest, ReplaceUnderBusyBorrowers) {
+    std::vector<uint8_t> memory = load_example("Memory_v1.bin");
+    std::vector<uint8_t> pcie = load_example("PCIeDevice_v1.bin");
+    ASSERT_EQ(bej_registry_load_buffer(&reg, memory.data(), memory.size()), SUCCESS);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> missing{0};
+    std::vector<std::thread> borrowers;
+    for (int t = 0; t < 4; t++) {
+        borrowers.emplace_back([&]() {
+            while (!stop.load()) {
+                bej_registry_dict_t *dict = bej_registry_acquire(&reg, "Memory", memory_version);
+                if (!dict)
+                    missing++;
+                bej_registry_release(dict);
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 2; w++) {
+        writers.emplace_back([&]() {
+            for (int i = 0; i < 500; i++)
+                EXPECT_EQ(bej_registry_load_buffer(&reg, memory.data(), memory.size()), SUCCESS);
+        });
+    }
+    writers.emplace_back([&]() {
+        for (int i = 0; i < 100; i++)
+            EXPECT_EQ(bej_registry_load_buffer(&reg, pcie.data(), pcie.size()), SUCCESS);
+    });
+    for (auto &t : writers)
+        t.join();
+    stop = true;
+    for (auto &t : borrowers)
+        t.join();
+
+    EXPECT_EQ(missing.load(), 0U);
+    EXPECT_EQ(atomic_load(&reg.count), 2U);
+}
@@ -0,0 +1,142 @@
+/**
+ * @file test_stats.cpp
+ * @brief Unit tests for the decode counters and their JSON form
+ */
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+}
+
+// root set with three integer members A, B and C
+static std::vector<uint8_t>
+three_member_dictionary()
+{
+    return make_dictionary({
+        {BEJ_FORMAT_SET, 0, 1, 3, "Sensor"},
+        {BEJ_FORMAT_INTEGER, 0, 0, 0, "A"},
+        {BEJ_FORMAT_INTEGER, 1, 0, 0, "B"},
+        {BEJ_FORMAT_INTEGER, 2, 0, 0, "C"},
+    });
+}
+
+// {"C": 5, <sequence 7>: 1}, the set claiming `extra` bytes more than its members take
+static std::vector<uint8_t>
+sensor_document(uint8_t extra)
+{
+    std::vector<uint8_t> set = members({
+        tuple(2, 0, BEJ_FORMAT_INTEGER, {0x05}),
+        tuple(7, 0, BEJ_FORMAT_INTEGER, {0x01}),
+    });
+    for (uint8_t i = 0; i < extra; i++)
+        set.push_back(0x00);
+
+    std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00};
+    std::vector<uint8_t> root = tuple(0, 0, BEJ_FORMAT_SET, set);
+    doc.insert(doc.end(), root.begin(), root.end());
+    return doc;
+}
+
+class BejStatsTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data = three_member_dictionary();
+    bej_dictionary_context_t dict = {};
+
+    void SetUp() override {
+#ifndef BEJ_STATS
+        GTEST_SKIP() << "built without BEJ_STATS";
+#endif
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    }
+
+    void TearDown() override {
+        if (dict.data)
+            bej_free_dict(&dict);
+    }
+
+    bej_stats_t decode(std::vector<uint8_t> &bej) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        EXPECT_EQ(bej_decode(&ctx), SUCCESS);
+        bej_stats_t stats = *bej_get_stats(&ctx);
+        bej_free_context(&ctx);
+        return stats;
+    }
+};
+
+TEST_F(BejStatsTest, CountsTuplesAndFormats) {
+    std::vector<uint8_t> bej = sensor_document(0);
+    bej_stats_t stats = decode(bej);
+
+    EXPECT_EQ(stats.tuples, 3U);
+    EXPECT_EQ(stats.lookups, 3U);
+    EXPECT_EQ(stats.probes, 3U);      // indexed, one each
+    EXPECT_EQ(stats.unknown, 1U);
+    EXPECT_EQ(stats.length_mismatches, 0U);
+    EXPECT_EQ(stats.max_depth, 1U);
+    EXPECT_EQ(stats.format_tuples[BEJ_FORMAT_SET], 1U);
+    EXPECT_EQ(stats.format_bytes[BEJ_FORMAT_SET], 14U);
+    EXPECT_EQ(stats.format_tuples[BEJ_FORMAT_INTEGER], 2U);
+    EXPECT_EQ(stats.format_bytes[BEJ_FORMAT_INTEGER], 2U);
+}
+
+TEST_F(BejStatsTest, CountsLengthMismatches) {
+    std::vector<uint8_t> bej = sensor_document(3);
+    bej_stats_t stats = decode(bej);
+    EXPECT_EQ(stats.length_mismatches, 1U);
+    EXPECT_EQ(stats.format_bytes[BEJ_FORMAT_SET], 17U);
+}
+
+TEST_F(BejStatsTest, ScanCountsEveryProbe) {
+    // without the index lookups walk the member range: C is the third entry, 7 is in none
+    bej_free_dict(&dict);
+    dict.data = dict_data.data();
+    std::vector<uint8_t> bej = sensor_document(0);
+    bej_stats_t stats = decode(bej);
+    EXPECT_EQ(stats.lookups, 3U);
+    EXPECT_EQ(stats.probes, 1U + 3U + 3U);
+    dict.data = nullptr;
+}
+
+TEST_F(BejStatsTest, CountersAccumulateUntilInit) {
+    std::vector<uint8_t> bej = sensor_document(0);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    ctx.offset = 0;
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+    EXPECT_EQ(bej_get_stats(&ctx)->tuples, 6U);
+    bej_free_context(&ctx);
+
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    EXPECT_EQ(bej_get_stats(&ctx)->tuples, 0U);
+    bej_free_context(&ctx);
+}
+
+TEST_F(BejStatsTest, WritesJson) {
+    std::vector<uint8_t> bej = sensor_document(0);
+    bej_context_t ctx;
+    ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+    ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+
+    char *text = nullptr;
+    size_t length = 0;
+    FILE *out = open_memstream(&text, &length);
+    ASSERT_NE(out, nullptr);
+    EXPECT_EQ(bej_write_stats(&ctx, 0.5, out), SUCCESS);
+    fclose(out);
+    bej_free_context(&ctx);
+
+    std::string json(text, length);
+    free(text);
+    EXPECT_EQ(json.find("{\"seconds\":0.500000,\"bytes\":26,\"bytes_per_second\":52,\"tuples\":3"), 0U) << json;
+    EXPECT_NE(json.find("\"probes_per_lookup\":1.00"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"formats\":{\"set\":{\"tuples\":1,\"bytes\":14},"
+                        "\"integer\":{\"tuples\":2,\"bytes\":2}}}\n"), std::string::npos) << json;
+}
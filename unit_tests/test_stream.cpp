@@ -0,0 +1,172 @@
+/**
+ * @file test_stream.cpp
+ * @brief Unit tests for the streaming decoder
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_stream.h"
+}
+
+struct StreamCase {
+    const char *dict;
+    const char *bej;
+};
+
+class BejStreamTest : public ::testing::TestWithParam<StreamCase> {
+protected:
+    std::vector<uint8_t> dict_data;
+    std::vector<uint8_t> bej;
+    bej_dictionary_context_t dict;
+    std::string expected;
+
+    void SetUp() override {
+        dict_data = load_example(GetParam().dict);
+        bej = load_example(GetParam().bej);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+        bej_context_t ctx;
+        ASSERT_EQ(bej_init_context_with_dict(&ctx, &dict, bej.data(), bej.size(), nullptr), SUCCESS);
+        ASSERT_EQ(bej_decode(&ctx), SUCCESS);
+        expected.assign((const char *)ctx.out.data, ctx.out.len);
+        bej_free_context(&ctx);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    // feeds the document in pieces starting at the given split points
+    std::string Stream(const std::vector<size_t> &splits, uint8_t *result) {
+        bej_stream_t s;
+        EXPECT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+
+        *result = SUCCESS;
+        size_t from = 0;
+        for (size_t i = 0; i <= splits.size(); i++) {
+            size_t to = (i < splits.size()) ? splits[i] : bej.size();
+            // copy so that reads past the chunk are caught by sanitizers
+            std::vector<uint8_t> chunk(bej.begin() + from, bej.begin() + to);
+            *result |= bej_stream_feed(&s, chunk.data(), chunk.size());
+            from = to;
+        }
+        *result |= bej_stream_finish(&s);
+
+        std::string doc((const char *)s.ctx.out.data, s.ctx.out.len);
+        bej_stream_free(&s);
+        return doc;
+    }
+};
+
+TEST_P(BejStreamTest, WholeDocument) {
+    uint8_t result;
+    EXPECT_EQ(Stream({}, &result), expected);
+    EXPECT_EQ(result, SUCCESS);
+}
+
+TEST_P(BejStreamTest, SplitAtEveryByte) {
+    for (size_t split = 0; split <= bej.size(); split++) {
+        uint8_t result;
+        ASSERT_EQ(Stream({split}, &result), expected) << "split at " << split;
+        ASSERT_EQ(result, SUCCESS) << "split at " << split;
+    }
+}
+
+TEST_P(BejStreamTest, OneByteAtATime) {
+    std::vector<size_t> splits;
+    for (size_t i = 1; i < bej.size(); i++)
+        splits.push_back(i);
+
+    uint8_t result;
+    EXPECT_EQ(Stream(splits, &result), expected);
+    EXPECT_EQ(result, SUCCESS);
+}
+
+TEST_P(BejStreamTest, EmitsBeforeDocumentEnds) {
+    bej_stream_t s;
+    ASSERT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+    ASSERT_EQ(bej_stream_feed(&s, bej.data(), bej.size() / 2), SUCCESS);
+
+    EXPECT_GT(s.ctx.out.len, 0u);
+    EXPECT_EQ(expected.compare(0, s.ctx.out.len, (const char *)s.ctx.out.data, s.ctx.out.len), 0);
+    bej_stream_free(&s);
+}
+
+TEST_P(BejStreamTest, TruncatedDocumentFails) {
+    for (size_t size : {(size_t)3, (size_t)BEJ_HEADER_SIZE, bej.size() / 2, bej.size() - 1}) {
+        bej_stream_t s;
+        ASSERT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+        EXPECT_EQ(bej_stream_feed(&s, bej.data(), size), SUCCESS);
+        EXPECT_EQ(bej_stream_finish(&s), FAILURE) << "size " << size;
+        bej_stream_free(&s);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Examples, BejStreamTest,
+    ::testing::Values(StreamCase{"Memory_v1.bin", "example_memory.bin"},
+                      StreamCase{"PCIeDevice_v1.bin", "example_pciedevice.bin"}));
+
+class BejStreamErrorTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    bej_dictionary_context_t dict;
+    bej_stream_t s;
+
+    void SetUp() override {
+        dict_data = load_example("Memory_v1.bin");
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        ASSERT_EQ(bej_stream_init(&s, &dict, nullptr), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_stream_free(&s);
+        bej_free_dict(&dict);
+    }
+};
+
+TEST_F(BejStreamErrorTest, BadHeaderLatches) {
+    uint8_t header[] = {0x00, 0xF0, 0xF0, 0xF2, 0x00, 0x00, 0x00};
+    EXPECT_EQ(bej_stream_feed(&s, header, 4), SUCCESS);
+    EXPECT_EQ(bej_stream_feed(&s, header + 4, 3), FAILURE);
+    EXPECT_EQ(s.state, BEJ_STREAM_ERROR);
+    EXPECT_EQ(bej_stream_feed(&s, header, 1), FAILURE);
+    EXPECT_EQ(bej_stream_finish(&s), FAILURE);
+}
+
+TEST_F(BejStreamErrorTest, ElementOverrunsSet) {
+    // root set of length 5 whose only element claims 8 bytes of string
+    uint8_t doc[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                     0x01, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01,
+                     0x01, 0x02, 0x50, 0x01, 0x08};
+    EXPECT_EQ(bej_stream_feed(&s, doc, sizeof(doc)), FAILURE);
+}
+
+TEST_F(BejStreamErrorTest, TrailingBytesIgnored) {
+    // root set with no elements, then garbage
+    uint8_t doc[] = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+                     0x01, 0x00, 0x00, 0x01, 0x02, 0x01, 0x00,
+                     0xDE, 0xAD};
+    EXPECT_EQ(bej_stream_feed(&s, doc, sizeof(doc)), SUCCESS);
+    EXPECT_EQ(bej_stream_finish(&s), SUCCESS);
+    EXPECT_EQ(std::string((const char *)s.ctx.out.data, s.ctx.out.len), "{\n}");
+}
+
+TEST_F(BejStreamErrorTest, DeepNesting) {
+    std::vector<uint8_t> doc = make_nested_document(300);
+    s.ctx.style = BEJ_STYLE_COMPACT;
+    for (size_t i = 0; i < doc.size(); i += 7)
+        ASSERT_EQ(bej_stream_feed(&s, doc.data() + i, std::min<size_t>(7, doc.size() - i)), SUCCESS);
+    ASSERT_EQ(bej_stream_finish(&s), SUCCESS);
+
+    std::string expected = std::string(300, '[') + "42" + std::string(300, ']');
+    EXPECT_EQ(std::string((const char *)s.ctx.out.data, s.ctx.out.len), expected);
+}
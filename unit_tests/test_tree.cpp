@@ -0,0 +1,157 @@
+/**
+ * @file test_tree.cpp
+ * @brief Unit tests for the document tree API
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_tree.h"
+}
+
+class BejTreeTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    std::vector<uint8_t> bej;
+    bej_dictionary_context_t dict;
+    bej_tree_t tree;
+
+    void Load(const char *dict_name, const char *bej_name) {
+        dict_data = load_example(dict_name);
+        bej = load_example(bej_name);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+        ASSERT_EQ(bej_tree_decode(&tree, &dict, bej.data(), bej.size()), SUCCESS);
+        ASSERT_NE(tree.root, nullptr);
+    }
+
+    void SetUp() override {
+        memset(&dict, 0, sizeof(dict));
+        memset(&tree, 0, sizeof(tree));
+    }
+
+    void TearDown() override {
+        bej_tree_free(&tree);
+        bej_free_dict(&dict);
+    }
+
+    std::string String(const bej_node_t *node) {
+        const char *data = nullptr;
+        size_t length = 0;
+        if (bej_node_get_string(node, &data, &length) != SUCCESS)
+            return "<none>";
+        return std::string(data, length);
+    }
+};
+
+TEST_F(BejTreeTest, MemoryExample) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    EXPECT_EQ(tree.root->format, BEJ_FORMAT_SET);
+    EXPECT_EQ(bej_node_count(tree.root), 6u);
+
+    int64_t value = 0;
+    EXPECT_EQ(bej_node_get_int(bej_node_member(tree.root, "CapacityMiB"), &value), SUCCESS);
+    EXPECT_EQ(value, 65536);
+
+    const bej_node_t *speeds = bej_node_member(tree.root, "AllowedSpeedsMHz");
+    ASSERT_NE(speeds, nullptr);
+    EXPECT_EQ(speeds->format, BEJ_FORMAT_ARRAY);
+    ASSERT_EQ(bej_node_count(speeds), 2u);
+    EXPECT_EQ(bej_node_get_int(bej_node_at(speeds, 0), &value), SUCCESS);
+    EXPECT_EQ(value, 2400);
+    EXPECT_EQ(bej_node_get_int(bej_node_at(speeds, 1), &value), SUCCESS);
+    EXPECT_EQ(value, 3200);
+    EXPECT_EQ(bej_node_at(speeds, 2), nullptr);
+    // array elements have no name
+    EXPECT_EQ(bej_node_at(speeds, 0)->name, nullptr);
+
+    EXPECT_EQ(String(bej_node_member(tree.root, "ErrorCorrection")), "NoECC");
+    EXPECT_EQ(bej_node_get_int(bej_node_find(tree.root, "/MemoryLocation/Channel"), &value), SUCCESS);
+    EXPECT_EQ(value, 0);
+    EXPECT_EQ(String(bej_node_member(tree.root, "Name")), "testname");
+}
+
+TEST_F(BejTreeTest, ZeroCopy) {
+    Load("Memory_v1.bin", "example_memory.bin");
+
+    const uint8_t *bej_begin = bej.data();
+    const uint8_t *bej_end = bej_begin + bej.size();
+    const bej_node_t *name = bej_node_member(tree.root, "Name");
+    ASSERT_NE(name, nullptr);
+    EXPECT_GE((const uint8_t *)name->value.string.data, bej_begin);
+    EXPECT_LE((const uint8_t *)name->value.string.data + name->value.string.length, bej_end);
+
+    EXPECT_GE((const uint8_t *)name->name, dict.data);
+    EXPECT_LT((const uint8_t *)name->name, dict.data + dict.data_size);
+}
+
+TEST_F(BejTreeTest, PCIeDevicePath) {
+    Load("PCIeDevice_v1.bin", "example_pciedevice.bin");
+
+    EXPECT_EQ(String(bej_node_find(tree.root, "Status/Conditions/0/Severity")), "Warning");
+    EXPECT_EQ(String(bej_node_find(tree.root, "Status/Health")), "OK");
+    EXPECT_EQ(String(bej_node_find(tree.root, "Model")), "Geforce GTX 1070");
+
+    uint8_t flag = 1;
+    EXPECT_EQ(bej_node_get_bool(bej_node_member(tree.root, "ReadyToRemove"), &flag), SUCCESS);
+    EXPECT_EQ(flag, 0);
+
+    int64_t value = 0;
+    EXPECT_EQ(bej_node_get_int(bej_node_find(tree.root, "PCIeInterface/LanesInUse"), &value), SUCCESS);
+    EXPECT_EQ(value, 16);
+
+    EXPECT_EQ(bej_node_find(tree.root, "Status/Conditions/1"), nullptr);
+    EXPECT_EQ(bej_node_find(tree.root, "Status/Conditions/x"), nullptr);
+    EXPECT_EQ(bej_node_find(tree.root, "Status/Missing"), nullptr);
+    // wrong type accessors fail
+    EXPECT_EQ(bej_node_get_int(bej_node_find(tree.root, "Model"), &value), FAILURE);
+}
+
+TEST_F(BejTreeTest, TruncatedDocumentFails) {
+    dict_data = load_example("Memory_v1.bin");
+    bej = load_example("example_memory.bin");
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    for (size_t size : {(size_t)3, (size_t)9, bej.size() / 2}) {
+        EXPECT_EQ(bej_tree_decode(&tree, &dict, bej.data(), size), FAILURE) << size;
+        bej_tree_free(&tree);
+    }
+}
+
+TEST_F(BejTreeTest, DeepNesting) {
+    dict_data = load_example("Memory_v1.bin");
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    bej = make_nested_document(BEJ_DEFAULT_MAX_DEPTH - 1);
+    ASSERT_EQ(bej_tree_decode(&tree, &dict, bej.data(), bej.size()), SUCCESS);
+    const bej_node_t *node = tree.root;
+    while (node && node->format == BEJ_FORMAT_ARRAY)
+        node = bej_node_at(node, 0);
+    int64_t value = 0;
+    EXPECT_EQ(bej_node_get_int(node, &value), SUCCESS);
+    EXPECT_EQ(value, 42);
+    bej_tree_free(&tree);
+
+    bej = make_nested_document(BEJ_DEFAULT_MAX_DEPTH + 1);
+    EXPECT_EQ(bej_tree_decode(&tree, &dict, bej.data(), bej.size()), FAILURE);
+}
+
+TEST_F(BejTreeTest, ChildOverrunningItsSetFails) {
+    dict_data = load_example("Memory_v1.bin");
+    ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+
+    // the inner set claims the integer after it, which lies past the end of the outer set
+    bej = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00,
+           0x00, 0x00, 0x01, 0x07,                  // root set, 7 bytes
+           0x01, 0x01,                              // 1 member
+           0x00, 0x00, 0x01, 0x06, 0x01, 0x01,      // set of 6 bytes, 1 member
+           0x00, 0x30, 0x01, 0x01, 0x2A};           // integer 42
+    EXPECT_EQ(bej_tree_decode(&tree, &dict, bej.data(), bej.size()), FAILURE);
+}
@@ -0,0 +1,199 @@
+/**
+ * @file test_validate.cpp
+ * @brief Unit tests for the validate-only mode
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "test_helpers.h"
+
+extern "C" {
+#include "../src/bej.h"
+#include "../src/bej_validate.h"
+}
+
+struct ValidateCase {
+    const char *dict;
+    const char *bej;
+};
+
+class BejValidateTest : public ::testing::TestWithParam<ValidateCase> {
+protected:
+    std::vector<uint8_t> dict_data;
+    std::vector<uint8_t> bej;
+    bej_dictionary_context_t dict;
+
+    void SetUp() override {
+        dict_data = load_example(GetParam().dict);
+        bej = load_example(GetParam().bej);
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_FALSE(bej.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    uint8_t Validate(std::vector<uint8_t> &doc, size_t *offset = nullptr) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+        uint8_t result = bej_validate(&ctx);
+        EXPECT_EQ(ctx.out.len, 0u);
+        if (offset)
+            *offset = ctx.offset;
+        bej_free_context(&ctx);
+        return result;
+    }
+};
+
+TEST_P(BejValidateTest, ExampleIsValid) {
+    EXPECT_EQ(Validate(bej), SUCCESS);
+}
+
+TEST_P(BejValidateTest, EveryTruncationFails) {
+    for (size_t size = 1; size < bej.size(); size++) {
+        // copy so that reads past the end are caught by sanitizers
+        std::vector<uint8_t> doc(bej.begin(), bej.begin() + size);
+        EXPECT_EQ(Validate(doc), FAILURE) << "size " << size;
+    }
+}
+
+TEST_P(BejValidateTest, TrailingBytesFail) {
+    bej.push_back(0x00);
+    EXPECT_EQ(Validate(bej), FAILURE);
+}
+
+TEST_P(BejValidateTest, CorruptedBytesNeverCrash) {
+    for (size_t i = 0; i < bej.size(); i++) {
+        std::vector<uint8_t> doc = bej;
+        doc[i] ^= 0xFF;
+        Validate(doc);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Examples, BejValidateTest, ::testing::Values(
+    ValidateCase{"Memory_v1.bin", "example_memory.bin"},
+    ValidateCase{"PCIeDevice_v1.bin", "example_pciedevice.bin"}));
+
+// hand-built documents around a root set of Memory_v1.bin
+class BejValidateDocumentTest : public ::testing::Test {
+protected:
+    std::vector<uint8_t> dict_data;
+    bej_dictionary_context_t dict;
+
+    void SetUp() override {
+        dict_data = load_example("Memory_v1.bin");
+        ASSERT_FALSE(dict_data.empty());
+        ASSERT_EQ(bej_parse_dict(&dict, dict_data.data(), dict_data.size()), SUCCESS);
+    }
+
+    void TearDown() override {
+        bej_free_dict(&dict);
+    }
+
+    // sequence of a root member
+    uint32_t Member(const char *name) {
+        bej_dict_entry_t root, entry;
+        EXPECT_EQ(bej_dict_lookup(&dict, BEJ_DICT_HEADER_SIZE, dict.entry_count, 0, &root), SUCCESS);
+        char buf[256];
+        for (uint16_t seq = 0; seq < root.child_count; seq++) {
+            if (!bej_dict_lookup(&dict, root.child_offset, root.child_count, seq, &entry)
+                && !bej_get_entry_name(&dict, &entry, buf, sizeof(buf)) && !strcmp(buf, name))
+                return seq;
+        }
+        ADD_FAILURE() << name << " not in dictionary";
+        return 0;
+    }
+
+    // root set around the given members, set_length_delta skews its length
+    std::vector<uint8_t> Document(const std::vector<uint8_t> &members, uint32_t count, int set_length_delta = 0) {
+        std::vector<uint8_t> value;
+        append_nnint(value, count);
+        value.insert(value.end(), members.begin(), members.end());
+
+        std::vector<uint8_t> doc = {0x00, 0xF0, 0xF0, 0xF1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+        append_nnint(doc, (uint32_t)((int)value.size() + set_length_delta));
+        doc.insert(doc.end(), value.begin(), value.end());
+        return doc;
+    }
+
+    std::vector<uint8_t> Integer(uint32_t sequence, uint32_t length) {
+        std::vector<uint8_t> tuple;
+        append_nnint(tuple, sequence << 1);
+        tuple.push_back(BEJ_FORMAT_INTEGER << 4);
+        append_nnint(tuple, length);
+        tuple.insert(tuple.end(), length, 0x01);
+        return tuple;
+    }
+
+    uint8_t Validate(std::vector<uint8_t> doc) {
+        bej_context_t ctx;
+        EXPECT_EQ(bej_init_context_with_dict(&ctx, &dict, doc.data(), doc.size(), nullptr), SUCCESS);
+        uint8_t result = bej_validate(&ctx);
+        bej_free_context(&ctx);
+        return result;
+    }
+};
+
+TEST_F(BejValidateDocumentTest, WellFormed) {
+    EXPECT_EQ(Validate(Document(Integer(Member("CapacityMiB"), 2), 1)), SUCCESS);
+}
+
+TEST_F(BejValidateDocumentTest, SetLengthMismatchFails) {
+    // bej_decode() only warns about these
+    std::vector<uint8_t> members = Integer(Member("CapacityMiB"), 2);
+    members.push_back(0x00);
+    EXPECT_EQ(Validate(Document(members, 1)), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, FewerElementsThanCountFails) {
+    EXPECT_EQ(Validate(Document(Integer(Member("CapacityMiB"), 2), 2)), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, ValueOverrunningItsSetFails) {
+    std::vector<uint8_t> doc = Document(Integer(Member("CapacityMiB"), 2), 1, -1);
+    doc.pop_back();     // keep the document itself consistent
+    EXPECT_EQ(Validate(doc), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, UnknownSequenceFails) {
+    EXPECT_EQ(Validate(Document(Integer(1000, 2), 1)), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, FormatMismatchFails) {
+    std::vector<uint8_t> tuple = Integer(Member("Name"), 2);
+    EXPECT_EQ(Validate(Document(tuple, 1)), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, InvalidIntegerLengthFails) {
+    EXPECT_EQ(Validate(Document(Integer(Member("CapacityMiB"), 9), 1)), FAILURE);
+    EXPECT_EQ(Validate(Document(Integer(Member("CapacityMiB"), 0), 1)), FAILURE);
+}
+
+TEST_F(BejValidateDocumentTest, WideNnint) {
+    // 5 byte NNINT is fine while the value fits 32 bits
+    std::vector<uint8_t> tuple;
+    append_nnint(tuple, Member("CapacityMiB") << 1);
+    tuple.push_back(BEJ_FORMAT_INTEGER << 4);
+    std::vector<uint8_t> wide = {0x05, 0x01, 0x00, 0x00, 0x00, 0x00, 0x2A};
+    tuple.insert(tuple.end(), wide.begin(), wide.end());
+    EXPECT_EQ(Validate(Document(tuple, 1)), SUCCESS);
+
+    tuple[tuple.size() - 2] = 0x01;
+    EXPECT_EQ(Validate(Document(tuple, 1)), FAILURE);
+}
+
+TEST(BejNNINTBoundsTest, LengthPastBufferFails) {
+    uint8_t data[] = {0x04, 0x01, 0x02};
+    size_t offset = 0;
+    uint32_t value = 0;
+    EXPECT_EQ(bej_read_nnint(data, &offset, sizeof(data), &value), FAILURE);
+    EXPECT_EQ(offset, 0u);
+
+    data[0] = 0x02;
+    EXPECT_EQ(bej_read_nnint(data, &offset, sizeof(data), &value), SUCCESS);
+    EXPECT_EQ(value, 0x0201u);
+    EXPECT_EQ(offset, 3u);
+}